@@ -0,0 +1,44 @@
+# Locate lz4 library (optional document body codec)
+# This module defines
+#  LZ4_FOUND, if false, do not try to link with lz4
+#  LZ4_LIBRARIES, Library path and libs
+#  LZ4_INCLUDE_DIR, where to find the lz4 headers
+
+FIND_PATH(LZ4_INCLUDE_DIR lz4.h
+          HINTS
+               ENV LZ4_DIR
+          PATH_SUFFIXES include
+          PATHS
+               ~/Library/Frameworks
+               /Library/Frameworks
+               /usr/local
+               /opt/local
+               /opt/csw
+               /opt/lz4
+               /opt)
+
+FIND_LIBRARY(LZ4_LIBRARIES
+             NAMES lz4
+             HINTS
+                 ENV LZ4_DIR
+             PATH_SUFFIXES lib
+             PATHS
+                 ~/Library/Frameworks
+                 /Library/Frameworks
+                 /usr/local
+                 /opt/local
+                 /opt/csw
+                 /opt/lz4
+                 /opt)
+
+IF (LZ4_INCLUDE_DIR AND LZ4_LIBRARIES)
+  SET(LZ4_FOUND TRUE)
+  include_directories(AFTER ${LZ4_INCLUDE_DIR})
+  MESSAGE(STATUS "Found lz4 in ${LZ4_INCLUDE_DIR} : ${LZ4_LIBRARIES}")
+ELSE (LZ4_INCLUDE_DIR AND LZ4_LIBRARIES)
+  SET(LZ4_FOUND FALSE)
+  SET(LZ4_LIBRARIES "")
+  MESSAGE(STATUS "lz4 not found, building forestdb without the lz4 codec")
+ENDIF (LZ4_INCLUDE_DIR AND LZ4_LIBRARIES)
+
+MARK_AS_ADVANCED(LZ4_INCLUDE_DIR LZ4_LIBRARIES)
@@ -0,0 +1,44 @@
+# Locate zstd library (optional document body codec)
+# This module defines
+#  ZSTD_FOUND, if false, do not try to link with zstd
+#  ZSTD_LIBRARIES, Library path and libs
+#  ZSTD_INCLUDE_DIR, where to find the zstd headers
+
+FIND_PATH(ZSTD_INCLUDE_DIR zdict.h
+          HINTS
+               ENV ZSTD_DIR
+          PATH_SUFFIXES include
+          PATHS
+               ~/Library/Frameworks
+               /Library/Frameworks
+               /usr/local
+               /opt/local
+               /opt/csw
+               /opt/zstd
+               /opt)
+
+FIND_LIBRARY(ZSTD_LIBRARIES
+             NAMES zstd
+             HINTS
+                 ENV ZSTD_DIR
+             PATH_SUFFIXES lib
+             PATHS
+                 ~/Library/Frameworks
+                 /Library/Frameworks
+                 /usr/local
+                 /opt/local
+                 /opt/csw
+                 /opt/zstd
+                 /opt)
+
+IF (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARIES)
+  SET(ZSTD_FOUND TRUE)
+  include_directories(AFTER ${ZSTD_INCLUDE_DIR})
+  MESSAGE(STATUS "Found zstd in ${ZSTD_INCLUDE_DIR} : ${ZSTD_LIBRARIES}")
+ELSE (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARIES)
+  SET(ZSTD_FOUND FALSE)
+  SET(ZSTD_LIBRARIES "")
+  MESSAGE(STATUS "zstd not found, building forestdb without the zstd codec")
+ENDIF (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARIES)
+
+MARK_AS_ADVANCED(ZSTD_INCLUDE_DIR ZSTD_LIBRARIES)
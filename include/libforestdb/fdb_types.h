@@ -118,7 +118,9 @@ enum {
     FDB_DRB_NONE = 0x0,
     /**
      * Synchronous commit through the direct IO option to bypass
-     * the OS page cache.
+     * the OS page cache. If the buffer cache is disabled (buffercache_size
+     * is zero), ForestDB reads and writes the file through its own aligned
+     * buffers, so that no data is cached outside ForestDB.
      */
     FDB_DRB_ODIRECT = 0x1,
     /**
@@ -141,6 +143,31 @@ enum {
     FDB_COMPACTION_AUTO = 1
 };
 
+/**
+ * Codecs for the compression of document bodies.
+ */
+typedef uint8_t fdb_compression_codec_t;
+enum {
+    /**
+     * Use the codec of the ForestDB file. Only valid for fdb_kvs_config.
+     */
+    FDB_COMPRESSION_DEFAULT = 0,
+    /**
+     * Snappy (default).
+     */
+    FDB_COMPRESSION_SNAPPY = 1,
+    /**
+     * LZ4, which is faster than snappy at a similar compression ratio.
+     */
+    FDB_COMPRESSION_LZ4 = 2,
+    /**
+     * Zstandard, which compresses better at a lower speed. Small documents
+     * are compressed much better if the KV store has a dictionary trained
+     * by fdb_kvs_train_compression_dict().
+     */
+    FDB_COMPRESSION_ZSTD = 3
+};
+
 /**
  * Transaction isolation level.
  * Note that both serializable and repeatable-read isolation levels are not
@@ -229,6 +256,80 @@ typedef struct fdb_doc_struct {
 #define FDB_CUSTOM_SEQNUM 0x01
 } fdb_doc;
 
+/**
+ * Contiguous piece of a doc body returned by the zero-copy read APIs.
+ */
+typedef struct {
+    /**
+     * Pointer to the first byte of the piece.
+     */
+    const void *buf;
+    /**
+     * Length of the piece.
+     */
+    size_t len;
+} fdb_doc_segment;
+
+/**
+ * Read-only view of a doc, which is populated by fdb_get_view() or
+ * fdb_iterator_get_view(). Key, metadata, and body point into block buffers
+ * owned by the view, and the body is exposed as a list of segments without
+ * being reassembled. All pointers remain valid until the view is used for
+ * another read or freed by fdb_doc_view_free(). Since the buffers are reused
+ * across reads, reading through the same view does not allocate memory once
+ * the buffers have grown to the size of the largest doc.
+ */
+typedef struct fdb_doc_view_struct {
+    /**
+     * key length.
+     */
+    size_t keylen;
+    /**
+     * metadata length.
+     */
+    size_t metalen;
+    /**
+     * doc body length, i.e., the sum of all segment lengths.
+     */
+    size_t bodylen;
+    /**
+     * actual doc size written on disk.
+     */
+    size_t size_ondisk;
+    /**
+     * Pointer to doc's key.
+     */
+    const void *key;
+    /**
+     * Pointer to doc's metadata.
+     */
+    const void *meta;
+    /**
+     * Number of doc body segments.
+     */
+    size_t num_segments;
+    /**
+     * Array of doc body segments, in order.
+     */
+    const fdb_doc_segment *segments;
+    /**
+     * Sequence number assigned to a doc.
+     */
+    fdb_seqnum_t seqnum;
+    /**
+     * Offset to the doc (header + key + metadata + body) on disk.
+     */
+    uint64_t offset;
+    /**
+     * Is a doc deleted?
+     */
+    bool deleted;
+    /**
+     * Buffers owned by the view. Should not be accessed by the caller.
+     */
+    void *buffers;
+} fdb_doc_view;
+
 /**
  * Opaque reference to a ForestDB file handle, which is exposed in public APIs.
  */
@@ -336,6 +437,20 @@ typedef struct fdb_fileops_handle_opaque* fdb_fileops_handle;
 #endif
 
 typedef void* voidref;
+/**
+ * A buffer of a vectored read (see filemgr_ops.preadv).
+ */
+typedef struct {
+    /**
+     * Start address of the buffer.
+     */
+    void *base;
+    /**
+     * Length of the buffer.
+     */
+    size_t len;
+} fdb_iovec_t;
+
 /**
  * This structure can be used to perform custom operations by
  * the external client before performing a file operation on
@@ -388,6 +503,11 @@ typedef struct filemgr_ops {
                            uint64_t dst_off, uint64_t len);
     void (*destructor)(fdb_fileops_handle fops_handle);
     void *ctx;
+    // Vectored read of consecutive file data into multiple buffers using a
+    // single call (optional; data is read by pread if it is NULL)
+    fdb_ssize_t (*preadv)(fdb_fileops_handle fops_handle,
+                          const fdb_iovec_t *iov, int iovcnt,
+                          cs_off_t offset);
 } fdb_filemgr_ops_t;
 
 /**
@@ -593,6 +713,140 @@ typedef struct {
      * Flush limit in bytes for non-block aligned buffer cache
      */
     size_t bcache_flush_limit;
+    /**
+     * Number of bits per key used by the in-memory key filters (Bloom filters)
+     * that fdb_get consults before searching the main index, so that lookups
+     * of non-existent keys can skip the index traversal. Filters are built for
+     * newly created files (including files created by compaction); lookups
+     * in files that were created before being opened by this process always
+     * search the main index. Zero disables the filters (default).
+     * Allowed range: 0 ~ 64 (10 bits per key gives ~1% false positives).
+     * This is a local config to each ForestDB file.
+     */
+    uint32_t bloom_filter_bits_per_key;
+    /**
+     * Number of worker threads that move documents in parallel while a single
+     * file is compacted. The documents to be moved are split into contiguous
+     * ranges of the old file, and each worker appends its documents into its
+     * own document blocks of the new file. If set to 0 or 1 (default),
+     * documents are moved by the compactor thread only. Parallel moving is not
+     * used if a compaction callback with FDB_CS_MOVE_DOC is registered.
+     * Allowed range: 0 ~ 64.
+     * This is a local config to each ForestDB file.
+     */
+    size_t num_compaction_workers;
+    /**
+     * Maximum rate of background writes in bytes per second, shared by all
+     * compactions across all ForestDB instances. The documents and index
+     * blocks written into the new file, and the blocks copied by copy-on-write
+     * compaction on a file system without block sharing, are charged. Zero
+     * means unlimited (default).
+     * This is a global config that is configured across all ForestDB files.
+     */
+    uint64_t background_io_rate_limit;
+    /**
+     * Target p99 latency of foreground reads (fdb_get and fdb_iterator_get)
+     * in microseconds. If the latency observed in the last second exceeds
+     * this target, the background write rate is halved, and it is gradually
+     * raised back to 'background_io_rate_limit' once the latency is within
+     * the target again. Zero disables the adjustment (default). This is
+     * effective only if 'background_io_rate_limit' is set.
+     * This is a global config that is configured across all ForestDB files.
+     */
+    uint64_t background_io_latency_target;
+    /**
+     * Flag to lay out the documents of the new file in key order of each KV
+     * store when the file is compacted, so that range scans on the compacted
+     * file become mostly sequential reads. Documents are then read from the
+     * old file in key order rather than in offset order, parallel moving by
+     * 'num_compaction_workers' and copy-on-write compaction are not used, and
+     * the documents updated during the compaction are appended in key order of
+     * each batch after the clustered region. Disabled by default.
+     * This is a local config to each ForestDB file.
+     */
+    bool compaction_cluster_docs;
+    /**
+     * Maximum number of blocks that are allocated at once at the end of the
+     * file as a region dedicated to index (HB+trie) nodes. Index nodes are
+     * then placed contiguously across commits instead of being interleaved
+     * with documents, which improves the locality of the index in the block
+     * cache and the OS page cache, and makes the index prefetch sequential.
+     * Regions start small and double in size up to this value. The unused
+     * blocks of the last region are not reclaimed until the next compaction
+     * once the file is closed. New regions are not allocated while the file
+     * is reusing stale blocks. Zero or one disables it (default).
+     * This is a local config to each ForestDB file.
+     */
+    uint32_t index_region_blocks;
+    /**
+     * Flag to enable decoding the stale block info of each commit in a
+     * background task as soon as the commit is done, instead of at the time
+     * of block reclaim. The stale regions are decompressed, parsed, sorted and
+     * merged in advance, so that a block reclaim only merges the already sorted
+     * regions of the commits to be reclaimed, which reduces the latency of the
+     * commit that triggers the block reclaim. The task runs on the shared
+     * background thread pool (see num_background_threads).
+     * This is a local config to each ForestDB file.
+     */
+    bool background_stale_merge;
+    /**
+     * Codec used to compress the body of documents if compress_document_body
+     * is set. Snappy is used by default. A codec that is not built in is
+     * ignored (i.e., documents are not compressed). Each KV store can
+     * override it through fdb_kvs_config. Documents compressed by any codec
+     * can be read regardless of this option, as the codec is recorded in each
+     * document. Compaction rewrites documents with this codec, or with the
+     * codec of their KV store if the KV store has been opened with one.
+     * This is a local config to each ForestDB file.
+     */
+    fdb_compression_codec_t compression_codec;
+    /**
+     * Document bodies of at least this many bytes are written into a
+     * separate append-only blob file ('<file name>.blob'), and the main file
+     * only keeps a reference to each of them, so that compaction moves the
+     * references instead of the bodies. Blob bodies are not compressed, and
+     * this option is ignored for encrypted files. It requires
+     * multi_kv_instances to be enabled. Zero disables blob files.
+     * This is a local config to each ForestDB file.
+     */
+    uint32_t blob_threshold;
+    /**
+     * Stale ratio (in percent) of a blob file, at which compaction moves its
+     * live bodies into the new file's blob file and removes it. Blob files
+     * with a lower stale ratio are carried over to the new file as they are.
+     * Zero moves all live bodies on every compaction. The maximum is 100.
+     * This is a local config to each ForestDB file.
+     */
+    uint8_t blob_gc_stale_ratio;
+    /**
+     * Flag to separate document bodies from their keys and metadata. Every
+     * body longer than its 20-byte blob reference is written into the blob
+     * file, so that the document blocks of the main file only hold compact
+     * key and metadata records. Meta-only reads and iterations (e.g.,
+     * fdb_get_metaonly and fdb_iterator_get_metaonly) then never read the
+     * blob file. However, every full read of a separated body costs one more
+     * read from the blob file, and each separated body takes 20 more bytes
+     * for its reference. Shorter bodies stay next to their keys. It requires
+     * multi_kv_instances to be enabled, and cannot be combined with a
+     * non-zero blob_threshold, compress_document_body or encryption
+     * (fdb_open returns FDB_RESULT_INVALID_CONFIG).
+     * This is a local config to each ForestDB file.
+     */
+    bool separate_doc_bodies;
+    /**
+     * Flag to append documents in a pipelined manner. Only the space of each
+     * document is reserved while holding the file's writer lock, and the
+     * document is encoded and written after releasing the lock, so that
+     * concurrent writers on the same file don't serialize while compressing
+     * and copying their bodies. Reads and commits wait for the documents
+     * being written, if any. Deletions are appended as usual. If writing a
+     * document fails, fdb_set returns FDB_RESULT_WRITE_FAIL, and the file
+     * rejects reads of that document with FDB_RESULT_READ_FAIL and all
+     * commits with FDB_RESULT_WRITE_FAIL until it is closed and reopened,
+     * so that the previously committed version of the key is kept.
+     * This is a local config to each ForestDB file.
+     */
+    bool pipelined_doc_append;
 
 } fdb_config;
 
@@ -606,6 +860,12 @@ typedef struct {
      * Customized compare function for an KV store instance.
      */
     fdb_custom_cmp_variable custom_cmp;
+    /**
+     * Codec used to compress the body of documents in the KV store, if
+     * compress_document_body is set in fdb_config. FDB_COMPRESSION_DEFAULT
+     * (default) follows the codec of the ForestDB file.
+     */
+    fdb_compression_codec_t compression_codec;
 } fdb_kvs_config;
 
 /**
@@ -645,9 +905,35 @@ enum {
     /**
      * Return Keys and Metadata only for fdb_changes_since API.
      */
-    FDB_ITR_NO_VALUES = 0x10
+    FDB_ITR_NO_VALUES = 0x10,
+    /**
+     * Detect sequential document reads (e.g., a full scan over a compacted
+     * file, or a sequence iterator) and read the following blocks into the
+     * buffer cache ahead of the iterator cursor, using large read requests.
+     * The readahead depth can be set by FDB_ITR_READAHEAD_DEPTH().
+     * Note that this option is effective only if the buffer cache is enabled.
+     */
+    FDB_ITR_READAHEAD = 0x20
 };
 
+/**
+ * Unit of the readahead depth of FDB_ITR_READAHEAD iterators, in bytes.
+ */
+#define FDB_ITR_READAHEAD_UNIT (65536)
+/**
+ * Default readahead depth of FDB_ITR_READAHEAD iterators,
+ * in the unit of FDB_ITR_READAHEAD_UNIT.
+ */
+#define FDB_ITR_READAHEAD_DEFAULT_DEPTH (8)
+/**
+ * Readahead depth option of FDB_ITR_READAHEAD iterators, in the unit of
+ * FDB_ITR_READAHEAD_UNIT (1 ~ 255). This value is stored in the upper 8 bits of
+ * fdb_iterator_opt_t. For example, FDB_ITR_READAHEAD | FDB_ITR_READAHEAD_DEPTH(32)
+ * keeps up to 2 MB of documents cached ahead of the iterator cursor.
+ * If not given, FDB_ITR_READAHEAD_DEFAULT_DEPTH is used.
+ */
+#define FDB_ITR_READAHEAD_DEPTH(n) ((fdb_iterator_opt_t)(((n) & 0xff) << 8))
+
 /**
  * ForestDB iterator seek options.
  */
@@ -669,6 +955,48 @@ enum {
  */
 typedef struct FdbIterator fdb_iterator;
 
+/**
+ * Key range of a KV store, returned by fdb_iterator_split API.
+ */
+typedef struct {
+    /**
+     * Smallest key of the range. NULL means the smallest key in the KV store.
+     */
+    void *min_key;
+    /**
+     * Length of the smallest key.
+     */
+    size_t min_keylen;
+    /**
+     * Largest key of the range. NULL means the largest key in the KV store.
+     */
+    void *max_key;
+    /**
+     * Length of the largest key.
+     */
+    size_t max_keylen;
+    /**
+     * Iterator option to be passed to fdb_iterator_init API along with the
+     * above keys. FDB_ITR_SKIP_MAX_KEY is set if max_key is the first key
+     * of the next range.
+     */
+    fdb_iterator_opt_t opt;
+} fdb_iterator_range;
+
+/**
+ * List of key ranges of a KV store, returned by fdb_iterator_split API.
+ */
+typedef struct {
+    /**
+     * Number of key ranges listed in ranges.
+     */
+    size_t num_ranges;
+    /**
+     * Pointer to array of key ranges, in key order.
+     */
+    fdb_iterator_range *ranges;
+} fdb_iterator_range_list;
+
 /**
  * Return type for the fdb_changes_since API's callback: fdb_changes_function_fn
  */
@@ -822,6 +1150,16 @@ typedef struct {
      * Number of fdb_iterator_moves (includes next,prev,seek) operations.
      */
     uint64_t num_iterator_moves;
+    /**
+     * Number of fdb_get* lookups that skipped the main index because the
+     * key filter reported that the key does not exist.
+     */
+    uint64_t num_filter_negatives;
+    /**
+     * Number of fdb_get* lookups that the key filter let through but the key
+     * was not found in the main index (i.e., filter false positives).
+     */
+    uint64_t num_filter_false_positives;
 } fdb_kvs_ops_info;
 
 /**
@@ -298,6 +298,44 @@ LIBFDB_API
 fdb_status fdb_get_byoffset(fdb_kvs_handle *handle,
                             fdb_doc *doc);
 
+/**
+ * Create a new FDB_DOC_VIEW instance on heap, which can be passed to
+ * fdb_get_view() and fdb_iterator_get_view() as many times as needed.
+ *
+ * @param view Pointer to a FDB_DOC_VIEW instance created.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_doc_view_create(fdb_doc_view **view);
+
+/**
+ * Free a given FDB_DOC_VIEW instance and its buffers from heap.
+ *
+ * @param view Pointer to a FDB_DOC_VIEW instance to be freed from heap.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_doc_view_free(fdb_doc_view *view);
+
+/**
+ * Retrieve the metadata and doc body for a given key without allocating
+ * and copying them into separate buffers. The view's key, metadata, and body
+ * segments point into the view's block buffers, which are overwritten by the
+ * next read through the same view.
+ *
+ * @param handle Pointer to ForestDB KV store handle.
+ * @param key Pointer to the key.
+ * @param keylen Length of the key.
+ * @param view Pointer to FDB_DOC_VIEW instance created by fdb_doc_view_create,
+ *        which is populated as a result of this API call.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_get_view(fdb_kvs_handle *handle,
+                        const void *key,
+                        size_t keylen,
+                        fdb_doc_view *view);
+
 /**
  * Update the metadata and doc body for a given key.
  * Note that FDB_DOC instance should be created by calling
@@ -561,6 +599,19 @@ fdb_status fdb_iterator_get(fdb_iterator *iterator, fdb_doc **doc);
 LIBFDB_API
 fdb_status fdb_iterator_get_metaonly(fdb_iterator *iterator, fdb_doc **doc);
 
+/**
+ * Get the item (key, metadata, doc body) from the iterator without allocating
+ * and copying them into separate buffers. See fdb_get_view() for the lifetime
+ * of the returned pointers.
+ *
+ * @param iterator Pointer to the iterator.
+ * @param view Pointer to FDB_DOC_VIEW instance created by fdb_doc_view_create,
+ *        which is populated as a result of this API call.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_iterator_get_view(fdb_iterator *iterator, fdb_doc_view *view);
+
 /**
  * Fast forward / backward an iterator to return documents starting from
  * the given seek_key. If the seek key does not exist, the iterator is
@@ -596,6 +647,50 @@ fdb_status fdb_iterator_seek_to_min(fdb_iterator *iterator);
 LIBFDB_API
 fdb_status fdb_iterator_seek_to_max(fdb_iterator *iterator);
 
+/**
+ * Split the given key range of a ForestDB KV store snapshot into the given
+ * number of sub-ranges that contain roughly the same number of keys, so that
+ * the sub-ranges can be traversed by separate iterators concurrently.
+ * The split keys are estimated from the structure of the main index,
+ * without traversing the entire range. Note that the returned list may have
+ * fewer ranges than requested if the given range is too small, and keys that
+ * are not flushed from WAL into the main index yet are not considered for
+ * balancing (but are still covered by the returned ranges).
+ *
+ * Each range can be traversed by calling fdb_iterator_init API with
+ * min_key, max_key, and opt of the range (opt can be combined with other
+ * iterator options).
+ *
+ * @param handle Pointer to ForestDB KV store handle.
+ * @param min_key Pointer to the smallest key. Passing NULL means the smallest
+ *        key in the KV store.
+ * @param min_keylen Length of the smallest key.
+ * @param max_key Pointer to the largest key. Passing NULL means the largest
+ *        key in the KV store.
+ * @param max_keylen Length of the largest key.
+ * @param num_ranges Number of ranges to split into.
+ * @param range_list Pointer to a key range list. Note that this list should
+ *        be released using fdb_free_iterator_range_list API call.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_iterator_split(fdb_kvs_handle *handle,
+                              const void *min_key,
+                              size_t min_keylen,
+                              const void *max_key,
+                              size_t max_keylen,
+                              size_t num_ranges,
+                              fdb_iterator_range_list *range_list);
+
+/**
+ * Free a key range list returned by fdb_iterator_split API.
+ *
+ * @param range_list Pointer to a key range list to be freed.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_free_iterator_range_list(fdb_iterator_range_list *range_list);
+
 /**
  * Close the iterator and free its associated resources.
  *
@@ -668,9 +763,12 @@ fdb_status fdb_compact(fdb_file_handle *fhandle,
  * Compact the database file by sharing valid document blocks from
  * the old file.
  *
- * Currently this API works only on Btrfs (B-tree file system) having the
- * copy-file-range support that allows physical pages to be shared across files
- * through the copy-on-write (CoW) nature of Btrfs.
+ * Valid document blocks are cloned into the new file by Btrfs's clone-range
+ * ioctl, or by the generic FICLONERANGE ioctl on other file systems that
+ * support reflinks (e.g., XFS with reflink enabled), so that physical blocks
+ * are shared across files through copy-on-write (CoW). On other Linux file
+ * systems, the blocks are copied in the kernel by copy_file_range(2), without
+ * going through the user space.
  *
  *  WARNING: Currently this API performs best only in the offline compaction mode.
  *  NOTE: Only one compaction will be allowed per file, and any other calls made
@@ -712,9 +810,12 @@ fdb_status fdb_compact_upto(fdb_file_handle *fhandle,
  * Compact the database file by retaining the stale data upto a given file-level
  * snapshot marker and sharing valid document blocks from the old file.
  *
- * Currently this API works only on Btrfs (B-tree file system) having the
- * copy-file-range support that allows physical pages to be shared across files
- * through the copy-on-write (CoW) nature of Btrfs.
+ * Valid document blocks are cloned into the new file by Btrfs's clone-range
+ * ioctl, or by the generic FICLONERANGE ioctl on other file systems that
+ * support reflinks (e.g., XFS with reflink enabled), so that physical blocks
+ * are shared across files through copy-on-write (CoW). On other Linux file
+ * systems, the blocks are copied in the kernel by copy_file_range(2), without
+ * going through the user space.
  *
  *  WARNING: Currently this API performs best only in the offline compaction mode.
  *  NOTE: Only one compaction will be allowed per file, and any other calls made
@@ -735,6 +836,29 @@ fdb_status fdb_compact_upto_with_cow(fdb_file_handle *fhandle,
                                      const char *new_filename,
                                      fdb_snapshot_marker_t marker);
 
+/**
+ * Incrementally compact the current file in place. Instead of moving all the
+ * live documents into a new file, this API relocates only the live documents
+ * of the most fragmented blocks (i.e., blocks partially occupied by stale data)
+ * to the end of the file, so that those blocks become entirely stale and are
+ * returned to the pool of reusable blocks by the next block reclaim. The block
+ * holding the last document of the file is not relocated, as it also holds
+ * the metadata of the last commit.
+ * Note that this API commits the file before and after the relocation, and
+ * cannot be used while a transaction is active. Since fragmented blocks are
+ * found from the stale region info, the legacy file format is not supported.
+ *
+ * @param fhandle Pointer to ForestDB file handle.
+ * @param min_stale_ratio Minimum percentage (1 ~ 100) of stale data in a block
+ *                        for the block to be relocated.
+ * @param max_blocks Maximum number of blocks to be relocated by this call.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_compact_incremental(fdb_file_handle *fhandle,
+                                   uint8_t min_stale_ratio,
+                                   size_t max_blocks);
+
 /**
  * Cancel the compaction task if it is running currently.
  *
@@ -1106,6 +1230,26 @@ LIBFDB_API
 fdb_status fdb_kvs_remove(fdb_file_handle *fhandle,
                           const char *kvs_name);
 
+/**
+ * Train a zstd compression dictionary from the documents currently stored in
+ * a KV store, and use it to compress the documents subsequently written
+ * through the given handle. The dictionary is stored in the file and becomes
+ * durable with the next commit; other handles of the KV store start to use it
+ * once they are reopened. Documents compressed before keep being readable.
+ *
+ * Only allowed for KV stores whose compression codec is FDB_COMPRESSION_ZSTD
+ * in multi KV instance mode.
+ *
+ * @param handle Pointer to KV store handle.
+ * @param max_dict_size Maximum size of the dictionary in bytes.
+ * @return FDB_RESULT_SUCCESS on success, or FDB_RESULT_COMPRESSION_FAIL if
+ *         there are not enough documents to train a dictionary or zstd is not
+ *         supported by this build.
+ */
+LIBFDB_API
+fdb_status fdb_kvs_train_compression_dict(fdb_kvs_handle *handle,
+                                          size_t max_dict_size);
+
 /**
  * Change the config parameters for reusing stale blocks
  *
@@ -0,0 +1,431 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "blobfile.h"
+
+#include "memleak.h"
+
+void blob_ref_encode(const struct blob_ref *ref, void *buf)
+{
+    uint64_t _file_id = _endian_encode(ref->file_id);
+    uint64_t _offset = _endian_encode(ref->offset);
+    uint32_t _crc = _endian_encode(ref->crc);
+    memcpy(buf, &_file_id, sizeof(_file_id));
+    memcpy((uint8_t*)buf + 8, &_offset, sizeof(_offset));
+    memcpy((uint8_t*)buf + 16, &_crc, sizeof(_crc));
+}
+
+void blob_ref_decode(const void *buf, struct blob_ref *ref)
+{
+    uint64_t _file_id, _offset;
+    uint32_t _crc;
+    memcpy(&_file_id, buf, sizeof(_file_id));
+    memcpy(&_offset, (const uint8_t*)buf + 8, sizeof(_offset));
+    memcpy(&_crc, (const uint8_t*)buf + 16, sizeof(_crc));
+    ref->file_id = _endian_decode(_file_id);
+    ref->offset = _endian_decode(_offset);
+    ref->crc = _endian_decode(_crc);
+}
+
+BlobFile::BlobFile(const std::string &_path, struct filemgr_ops *_ops)
+    : path(_path), ops(_ops), fopsHandle(NULL), size(0), dirty(false)
+{
+}
+
+BlobFile::~BlobFile()
+{
+    if (fopsHandle) {
+        ops->close(fopsHandle);
+        ops->destructor(fopsHandle);
+    }
+}
+
+fdb_status BlobFile::open(bool create)
+{
+    if (fopsHandle) {
+        return FDB_RESULT_SUCCESS;
+    }
+
+    fdb_fileops_handle handle = ops->constructor(ops->ctx);
+    int flags = O_RDWR | (create ? O_CREAT : 0);
+    fdb_status fs = ops->open(path.c_str(), &handle, flags, 0666);
+    if (fs != FDB_RESULT_SUCCESS) {
+        ops->destructor(handle);
+        return fs;
+    }
+    cs_off_t eof = ops->goto_eof(handle);
+    if (eof < 0) {
+        ops->close(handle);
+        ops->destructor(handle);
+        return (fdb_status) eof;
+    }
+    size.store(eof, std::memory_order_relaxed);
+    fopsHandle = handle;
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status BlobFile::append(const void *buf, uint32_t len, uint64_t *offset)
+{
+    // reserve the range first, so that concurrent appends don't overlap
+    *offset = size.fetch_add(len, std::memory_order_relaxed);
+    ssize_t rv = ops->pwrite(fopsHandle, const_cast<void *>(buf), len,
+                             *offset);
+    if (rv != (ssize_t)len) {
+        return rv < 0 ? (fdb_status) rv : FDB_RESULT_WRITE_FAIL;
+    }
+    dirty.store(true, std::memory_order_relaxed);
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status BlobFile::read(uint64_t offset, uint32_t len, void *buf)
+{
+    ssize_t rv = ops->pread(fopsHandle, buf, len, offset);
+    if (rv != (ssize_t)len) {
+        return rv < 0 ? (fdb_status) rv : FDB_RESULT_READ_FAIL;
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status BlobFile::sync()
+{
+    if (!fopsHandle || !dirty.exchange(false)) {
+        return FDB_RESULT_SUCCESS;
+    }
+    int rv = ops->fsync(fopsHandle);
+    if (rv != FDB_RESULT_SUCCESS) {
+        dirty.store(true);
+        return FDB_RESULT_FSYNC_FAIL;
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
+BlobFileSet::BlobFileSet(const std::string &own_path,
+                         struct filemgr_ops *_ops)
+    : ownPath(own_path + BLOB_FILE_SUFFIX), ownId(0), lastId(0), ops(_ops),
+      removeOnDestroy(false)
+{
+}
+
+BlobFileSet::~BlobFileSet()
+{
+    for (auto &entry : entries) {
+        delete entry.second.file;
+        if (removeOnDestroy && entry.second.collected) {
+            remove(entry.second.path.c_str());
+        }
+    }
+}
+
+uint64_t BlobFileSet::getOwnId_UNLOCKED(bool create)
+{
+    if (ownId) {
+        return ownId;
+    }
+    // the own blob file may have been inherited, if an old file in the
+    // compaction chain had the same name
+    for (auto &entry : entries) {
+        if (entry.second.path == ownPath) {
+            ownId = entry.first;
+            return ownId;
+        }
+    }
+    if (!create) {
+        return 0;
+    }
+    // IDs are assigned deterministically from the last persisted ID, so that
+    // docs appended after the last commit still refer to the same file when
+    // they are recovered.
+    ownId = ++lastId;
+    entries[ownId].path = ownPath;
+    return ownId;
+}
+
+BlobFile *BlobFileSet::getFile_UNLOCKED(uint64_t file_id, bool create,
+                                        fdb_status *status)
+{
+    auto it = entries.find(file_id);
+    if (it == entries.end()) {
+        *status = FDB_RESULT_FILE_CORRUPTION;
+        return NULL;
+    }
+    Entry &entry = it->second;
+    if (!entry.file) {
+        entry.file = new BlobFile(entry.path, ops);
+    }
+    *status = entry.file->open(create);
+    return (*status == FDB_RESULT_SUCCESS) ? entry.file : NULL;
+}
+
+fdb_status BlobFileSet::append(const void *buf, uint32_t len,
+                               uint64_t *file_id, uint64_t *offset)
+{
+    fdb_status fs;
+    BlobFile *file;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        *file_id = getOwnId_UNLOCKED(true);
+        file = getFile_UNLOCKED(*file_id, true, &fs);
+    }
+    if (!file) {
+        return fs;
+    }
+    return file->append(buf, len, offset);
+}
+
+fdb_status BlobFileSet::read(uint64_t file_id, uint64_t offset, uint32_t len,
+                             void *buf)
+{
+    fdb_status fs;
+    BlobFile *file;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        file = getFile_UNLOCKED(file_id, false, &fs);
+    }
+    if (!file) {
+        return fs;
+    }
+    return file->read(offset, len, buf);
+}
+
+void BlobFileSet::addLiveBytes(uint64_t file_id, uint64_t bytes)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = entries.find(file_id);
+    if (it != entries.end()) {
+        it->second.liveBytes += bytes;
+    }
+}
+
+bool BlobFileSet::isCollected(uint64_t file_id)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = entries.find(file_id);
+    return it != entries.end() && it->second.collected;
+}
+
+void BlobFileSet::inherit(BlobFileSet *old_set, uint8_t stale_ratio,
+                          bool reserve_own)
+{
+    std::lock_guard<std::mutex> old_guard(old_set->lock);
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Assign the ID of the old file's own blob file now, as writers keep
+    // appending into it during the compaction.
+    uint64_t old_own_id = old_set->getOwnId_UNLOCKED(reserve_own);
+    if (old_set->lastId > lastId) {
+        lastId = old_set->lastId;
+    }
+
+    for (auto &old_entry : old_set->entries) {
+        Entry &entry = old_entry.second;
+        bool collect = false;
+        if (entry.path == ownPath) {
+            // the new file appends into it
+            collect = false;
+        } else if (stale_ratio == 0) {
+            collect = true;
+        } else if (old_entry.first != old_own_id) {
+            // The live bytes of the old file's own blob file are unknown,
+            // so that it is always inherited.
+            fdb_status fs;
+            BlobFile *file = old_set->getFile_UNLOCKED(old_entry.first,
+                                                       false, &fs);
+            if (file) {
+                uint64_t size = file->getSize();
+                collect = size >= entry.liveBytes &&
+                          (size - entry.liveBytes) * 100 >=
+                          static_cast<uint64_t>(stale_ratio) * size;
+            } else {
+                collect = (entry.liveBytes == 0);
+            }
+        }
+        entry.collected = collect;
+        if (!collect) {
+            entries[old_entry.first].path = entry.path;
+        }
+    }
+}
+
+void BlobFileSet::clearCollected()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &entry : entries) {
+        entry.second.collected = false;
+    }
+}
+
+void BlobFileSet::removeCollected(bool remove_now)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!remove_now) {
+        removeOnDestroy = true;
+        return;
+    }
+    for (auto &entry : entries) {
+        if (entry.second.collected) {
+            fdb_status fs;
+            getFile_UNLOCKED(entry.first, false, &fs);
+            remove(entry.second.path.c_str());
+        }
+    }
+}
+
+void BlobFileSet::removeAll()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &entry : entries) {
+        delete entry.second.file;
+        entry.second.file = NULL;
+        remove(entry.second.path.c_str());
+    }
+    remove(ownPath.c_str());
+    entries.clear();
+    ownId = 0;
+    removeOnDestroy = false;
+}
+
+bool BlobFileSet::empty()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return entries.empty();
+}
+
+fdb_status BlobFileSet::sync()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &entry : entries) {
+        if (entry.second.file) {
+            fdb_status fs = entry.second.file->sync();
+            if (fs != FDB_RESULT_SUCCESS) {
+                return fs;
+            }
+        }
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
+void *BlobFileSet::exportTable(size_t *len)
+{
+    /* << raw data structure >>
+     * [# blob files]:          8 bytes
+     * [last blob file ID]:     8 bytes
+     * ---
+     * [blob file ID]:          8 bytes
+     * [live bytes]:            8 bytes
+     * [path length]:           2 bytes
+     * [path]:                  x bytes
+     * ...
+     */
+    std::lock_guard<std::mutex> guard(lock);
+    if (entries.empty()) {
+        *len = 0;
+        return NULL;
+    }
+    size_t size = sizeof(uint64_t) * 2;
+    for (auto &entry : entries) {
+        size += sizeof(uint64_t) * 2 + sizeof(uint16_t) +
+                entry.second.path.length();
+    }
+
+    uint8_t *buf = static_cast<uint8_t *>(malloc(size));
+    uint8_t *ptr = buf;
+    uint64_t _n_files = _endian_encode(static_cast<uint64_t>(entries.size()));
+    uint64_t _last_id = _endian_encode(lastId);
+    memcpy(ptr, &_n_files, sizeof(_n_files));
+    ptr += sizeof(_n_files);
+    memcpy(ptr, &_last_id, sizeof(_last_id));
+    ptr += sizeof(_last_id);
+
+    for (auto &entry : entries) {
+        uint64_t _id = _endian_encode(entry.first);
+        uint64_t _live = _endian_encode(entry.second.liveBytes);
+        uint16_t path_len = entry.second.path.length();
+        uint16_t _path_len = _endian_encode(path_len);
+        memcpy(ptr, &_id, sizeof(_id));
+        ptr += sizeof(_id);
+        memcpy(ptr, &_live, sizeof(_live));
+        ptr += sizeof(_live);
+        memcpy(ptr, &_path_len, sizeof(_path_len));
+        ptr += sizeof(_path_len);
+        memcpy(ptr, entry.second.path.c_str(), path_len);
+        ptr += path_len;
+    }
+    *len = size;
+    return buf;
+}
+
+size_t BlobFileSet::importTable(const void *buf, size_t len)
+{
+    const uint8_t *ptr = static_cast<const uint8_t *>(buf);
+    const uint8_t *end = ptr + len;
+    uint64_t _n_files, _last_id, n_files, last_id;
+
+    if (len < sizeof(_n_files) + sizeof(_last_id)) {
+        return 0;
+    }
+    memcpy(&_n_files, ptr, sizeof(_n_files));
+    ptr += sizeof(_n_files);
+    memcpy(&_last_id, ptr, sizeof(_last_id));
+    ptr += sizeof(_last_id);
+    n_files = _endian_decode(_n_files);
+    last_id = _endian_decode(_last_id);
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (uint64_t i = 0; i < n_files; ++i) {
+        uint64_t _id, _live;
+        uint16_t _path_len, path_len;
+        if (ptr + sizeof(_id) + sizeof(_live) + sizeof(_path_len) > end) {
+            break;
+        }
+        memcpy(&_id, ptr, sizeof(_id));
+        ptr += sizeof(_id);
+        memcpy(&_live, ptr, sizeof(_live));
+        ptr += sizeof(_live);
+        memcpy(&_path_len, ptr, sizeof(_path_len));
+        ptr += sizeof(_path_len);
+        path_len = _endian_decode(_path_len);
+        if (ptr + path_len > end) {
+            break;
+        }
+        uint64_t id = _endian_decode(_id);
+        if (entries.find(id) == entries.end()) {
+            Entry &entry = entries[id];
+            entry.path.assign(reinterpret_cast<const char *>(ptr), path_len);
+            entry.liveBytes = _endian_decode(_live);
+        }
+        ptr += path_len;
+    }
+    if (last_id > lastId) {
+        lastId = last_id;
+    }
+    return ptr - static_cast<const uint8_t *>(buf);
+}
+
+void BlobFileSet::restoreRef(uint64_t file_id)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (entries.find(file_id) == entries.end()) {
+        // IDs are assigned deterministically, so that the own blob file gets
+        // the same ID as before the restart.
+        getOwnId_UNLOCKED(true);
+    }
+}
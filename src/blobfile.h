@@ -0,0 +1,262 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "libforestdb/fdb_types.h"
+#include "libforestdb/fdb_errors.h"
+#include "common.h"
+
+/**
+ * Suffix of the blob file owned by each database file.
+ */
+#define BLOB_FILE_SUFFIX ".blob"
+
+/**
+ * A blob reference is stored in the main file in place of a document body
+ * that was written into a blob file:
+ * [blob file ID]:          8 bytes
+ * [offset in blob file]:   8 bytes
+ * [CRC of the body]:       4 bytes
+ */
+#define BLOB_REF_SIZE (20)
+
+struct blob_ref {
+    uint64_t file_id;
+    uint64_t offset;
+    uint32_t crc;
+};
+
+void blob_ref_encode(const struct blob_ref *ref, void *buf);
+
+void blob_ref_decode(const void *buf, struct blob_ref *ref);
+
+/**
+ * Append-only file holding document bodies, which are referred to by their
+ * offsets. Bodies are appended without any framing, as their lengths and
+ * checksums are kept in the references.
+ */
+class BlobFile {
+public:
+    BlobFile(const std::string &_path, struct filemgr_ops *_ops);
+
+    ~BlobFile();
+
+    /**
+     * Open the file if it is not opened yet.
+     *
+     * @param create Create the file if it does not exist.
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status open(bool create);
+
+    /**
+     * Append data at the end of the file.
+     *
+     * @param buf Data to be appended.
+     * @param len Length of the data.
+     * @param offset Pointer to the offset where the data is written.
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status append(const void *buf, uint32_t len, uint64_t *offset);
+
+    /**
+     * Read data at the given offset.
+     */
+    fdb_status read(uint64_t offset, uint32_t len, void *buf);
+
+    /**
+     * Flush the appended data to disk, if any.
+     */
+    fdb_status sync();
+
+    const std::string &getPath() const {
+        return path;
+    }
+
+    uint64_t getSize() const {
+        return size.load(std::memory_order_relaxed);
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(BlobFile);
+
+    std::string path;
+    struct filemgr_ops *ops;
+    fdb_fileops_handle fopsHandle;
+    // Size of the file, where the next data is appended
+    std::atomic<uint64_t> size;
+    // True if data was appended since the last sync
+    std::atomic<bool> dirty;
+};
+
+/**
+ * Blob files referred to by a database file. Each database file appends
+ * large bodies into its own blob file ('<file name>.blob'), and the blob
+ * files of older files are inherited through compaction, which moves the
+ * references instead of the bodies. Every blob file has an ID that is
+ * unique along the compaction chain, and the table of the inherited blob
+ * files is persisted in the KV header.
+ *
+ * The live bytes of each inherited blob file are counted while references
+ * are moved by compaction. The next compaction then collects the blob files
+ * whose stale ratio reaches the threshold, by moving the live bodies into
+ * the new file's own blob file.
+ */
+class BlobFileSet {
+public:
+    BlobFileSet(const std::string &own_path, struct filemgr_ops *_ops);
+
+    ~BlobFileSet();
+
+    /**
+     * Append a body into the own blob file.
+     *
+     * @param buf Body to be appended.
+     * @param len Length of the body.
+     * @param file_id Pointer to the ID of the own blob file.
+     * @param offset Pointer to the offset of the body in the blob file.
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status append(const void *buf, uint32_t len,
+                      uint64_t *file_id, uint64_t *offset);
+
+    /**
+     * Read a body from the blob file of the given ID.
+     */
+    fdb_status read(uint64_t file_id, uint64_t offset, uint32_t len,
+                    void *buf);
+
+    /**
+     * Account the given number of bytes as live in the blob file of the
+     * given ID. This is done by compaction for each moved reference.
+     */
+    void addLiveBytes(uint64_t file_id, uint64_t bytes);
+
+    /**
+     * Check if the blob file of the given ID is being collected by the
+     * ongoing compaction, so that the references to it should be resolved
+     * into bodies instead of being moved.
+     */
+    bool isCollected(uint64_t file_id);
+
+    /**
+     * Inherit the blob files of the file being compacted. The old file's
+     * blob files whose stale ratio is at least 'stale_ratio' percent are
+     * marked as collected, and all other blob files (including the old
+     * file's own blob file) are inherited by this set.
+     *
+     * @param old_set Blob files of the file being compacted.
+     * @param stale_ratio Stale ratio (in percent) to collect a blob file.
+     *        Zero collects all blob files.
+     * @param reserve_own Reserve the ID of the old file's own blob file even
+     *        if it is not created yet, as the old file may append bodies
+     *        into it during the compaction.
+     */
+    void inherit(BlobFileSet *old_set, uint8_t stale_ratio, bool reserve_own);
+
+    /**
+     * Cancel collecting blob files after a compaction failure.
+     */
+    void clearCollected();
+
+    /**
+     * Remove the blob files that were collected by a successful compaction.
+     * They are opened before being removed, so that readers of the old file
+     * can still read them on POSIX systems.
+     *
+     * @param remove_now Remove the files now, or when this set is destroyed.
+     */
+    void removeCollected(bool remove_now);
+
+    /**
+     * Remove all the blob files, when the database file is destroyed.
+     */
+    void removeAll();
+
+    /**
+     * Check if there is no blob file.
+     */
+    bool empty();
+
+    /**
+     * Flush all the blob files appended since the last sync.
+     */
+    fdb_status sync();
+
+    /**
+     * Export the table of blob files into a newly allocated buffer, which
+     * should be freed by the caller.
+     *
+     * @param len Pointer to the length of the exported table.
+     * @return Exported table, or NULL if there is no blob file.
+     */
+    void *exportTable(size_t *len);
+
+    /**
+     * Import the table of blob files from the given buffer. The entries are
+     * merged into the current table.
+     *
+     * @return Number of bytes read.
+     */
+    size_t importTable(const void *buf, size_t len);
+
+    /**
+     * Register the own blob file for a reference found by the WAL restore.
+     * Bodies appended after the last commit may refer to the own blob file
+     * before it is in the persisted table.
+     */
+    void restoreRef(uint64_t file_id);
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(BlobFileSet);
+
+    struct Entry {
+        Entry() : liveBytes(0), collected(false), file(NULL) { }
+        std::string path;
+        // Live bytes counted by the compaction that created this file
+        uint64_t liveBytes;
+        // Marked by the ongoing compaction
+        bool collected;
+        // Opened lazily
+        BlobFile *file;
+    };
+
+    uint64_t getOwnId_UNLOCKED(bool create);
+
+    BlobFile *getFile_UNLOCKED(uint64_t file_id, bool create,
+                               fdb_status *status);
+
+    std::string ownPath;
+    // ID of the own blob file, or 0 if not assigned yet
+    uint64_t ownId;
+    // The last ID assigned along the compaction chain
+    uint64_t lastId;
+    struct filemgr_ops *ops;
+    std::map<uint64_t, Entry> entries;
+    // Remove the collected blob files when this set is destroyed
+    bool removeOnDestroy;
+    std::mutex lock;
+};
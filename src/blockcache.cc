@@ -891,6 +891,24 @@ int BlockCacheManager::read(FileMgr *file,
     return 0;
 }
 
+bool BlockCacheManager::isCached(FileMgr *file,
+                                 bid_t bid) {
+    FileBlockCache *fcache = file->getBCache();
+    bool cached = false;
+
+    if (fcache) {
+        size_t shard_num = bid % fcache->getNumShards();
+        spin_lock(&fcache->shards[shard_num]->lock);
+        auto block_entry = fcache->shards[shard_num]->allBlocks.find(bid);
+        if (block_entry != fcache->shards[shard_num]->allBlocks.end() &&
+            !(block_entry->second->getFlag() & BCACHE_FREE)) {
+            cached = true;
+        }
+        spin_unlock(&fcache->shards[shard_num]->lock);
+    }
+    return cached;
+}
+
 bool BlockCacheManager::invalidateBlock(FileMgr *file,
                                         bid_t bid) {
     FileBlockCache *fcache;
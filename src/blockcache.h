@@ -142,6 +142,17 @@ public:
              bid_t bid,
              void *buf);
 
+    /**
+     * Check if a given block is in the block cache, without copying it or
+     * changing its position in the eviction order.
+     *
+     * @param file Pointer to the file manager instance
+     * @param bid ID of a block to be looked up
+     * @return true if the block is cached.
+     */
+    bool isCached(FileMgr *file,
+                  bid_t bid);
+
     /**
      * Invalidate a given cached block and return its memory to the free list
      * to be used for future allocations.
@@ -0,0 +1,189 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "bloomfilter.h"
+#include "hash_functions.h"
+
+#include "memleak.h"
+
+#define KEY_FILTER_HASH_SEED (UINT64_C(0x5bd1e9955bd1e995))
+
+BloomFilter::BloomFilter(uint64_t _capacity, uint32_t bits_per_key)
+    : capacity(_capacity), numKeys(0)
+{
+    // k = ln(2) * (bits per key) minimizes the false positive rate.
+    numProbes = static_cast<uint32_t>(bits_per_key * 69 / 100);
+    if (numProbes < 1) {
+        numProbes = 1;
+    } else if (numProbes > 30) {
+        numProbes = 30;
+    }
+
+    numWords = (capacity * bits_per_key + 63) / 64;
+    if (numWords == 0) {
+        numWords = 1;
+    }
+    numBits = numWords * 64;
+    bits = new std::atomic<uint64_t>[numWords];
+    for (uint64_t i = 0; i < numWords; ++i) {
+        bits[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+BloomFilter::~BloomFilter()
+{
+    delete[] bits;
+}
+
+void BloomFilter::add(uint64_t hash)
+{
+    uint64_t delta = (hash >> 33) | (hash << 31);
+    for (uint32_t i = 0; i < numProbes; ++i) {
+        uint64_t pos = hash % numBits;
+        bits[pos / 64].fetch_or(UINT64_C(1) << (pos % 64),
+                                std::memory_order_relaxed);
+        hash += delta;
+    }
+    numKeys.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool BloomFilter::mayContain(uint64_t hash) const
+{
+    uint64_t delta = (hash >> 33) | (hash << 31);
+    for (uint32_t i = 0; i < numProbes; ++i) {
+        uint64_t pos = hash % numBits;
+        uint64_t word = bits[pos / 64].load(std::memory_order_relaxed);
+        if (!(word & (UINT64_C(1) << (pos % 64)))) {
+            return false;
+        }
+        hash += delta;
+    }
+    return true;
+}
+
+KeyFilter::KeyFilter(uint32_t bits_per_key)
+    : bitsPerKey(bits_per_key), numLayers(0)
+{
+    for (size_t i = 0; i < KEY_FILTER_MAX_LAYERS; ++i) {
+        layers[i].store(nullptr, std::memory_order_relaxed);
+    }
+    spin_init(&layerLock);
+}
+
+KeyFilter::~KeyFilter()
+{
+    size_t n = numLayers.load();
+    for (size_t i = 0; i < n; ++i) {
+        delete layers[i].load();
+    }
+    spin_destroy(&layerLock);
+}
+
+void KeyFilter::appendLayer_UNLOCKED(uint64_t nkeys)
+{
+    size_t n = numLayers.load(std::memory_order_relaxed);
+    if (n == KEY_FILTER_MAX_LAYERS) {
+        // Keep adding into the last layer. The false positive rate goes up,
+        // but the filter is still correct.
+        return;
+    }
+
+    uint64_t capacity = nkeys;
+    if (n) {
+        // Grow geometrically so that the number of layers (i.e., the number
+        // of probes per lookup) stays logarithmic in the number of keys.
+        capacity = std::max(capacity, 2 * layers[n - 1].load()->getCapacity());
+    }
+    capacity = std::max(capacity, (uint64_t)KEY_FILTER_MIN_LAYER_CAPACITY);
+
+    layers[n].store(new BloomFilter(capacity, bitsPerKey),
+                    std::memory_order_release);
+    numLayers.store(n + 1, std::memory_order_release);
+}
+
+void KeyFilter::reserve(uint64_t nkeys)
+{
+    if (nkeys == 0) {
+        return;
+    }
+
+    spin_lock(&layerLock);
+    size_t n = numLayers.load(std::memory_order_relaxed);
+    if (n) {
+        BloomFilter *tail = layers[n - 1].load(std::memory_order_relaxed);
+        if (tail->getNumKeys() + nkeys <= tail->getCapacity()) {
+            spin_unlock(&layerLock);
+            return;
+        }
+    }
+    appendLayer_UNLOCKED(nkeys);
+    spin_unlock(&layerLock);
+}
+
+void KeyFilter::add(const void *key, size_t keylen)
+{
+    size_t n = numLayers.load(std::memory_order_acquire);
+    BloomFilter *tail = n ? layers[n - 1].load(std::memory_order_acquire)
+                          : nullptr;
+    if (!tail || tail->getNumKeys() >= tail->getCapacity()) {
+        // Not reserved in advance (or more keys than reserved), grow here.
+        spin_lock(&layerLock);
+        n = numLayers.load(std::memory_order_relaxed);
+        tail = n ? layers[n - 1].load(std::memory_order_relaxed) : nullptr;
+        if (!tail || tail->getNumKeys() >= tail->getCapacity()) {
+            appendLayer_UNLOCKED(1);
+            n = numLayers.load(std::memory_order_relaxed);
+            tail = layers[n - 1].load(std::memory_order_relaxed);
+        }
+        spin_unlock(&layerLock);
+    }
+
+    tail->add(hash_murmur64(key, keylen, KEY_FILTER_HASH_SEED));
+}
+
+bool KeyFilter::mayContain(const void *key, size_t keylen) const
+{
+    size_t n = numLayers.load(std::memory_order_acquire);
+    if (!n) {
+        return false;
+    }
+
+    uint64_t hash = hash_murmur64(key, keylen, KEY_FILTER_HASH_SEED);
+    // Check the most recent layers first, as recently written keys
+    // are more likely to be looked up.
+    for (size_t i = n; i > 0; --i) {
+        if (layers[i - 1].load(std::memory_order_acquire)->mayContain(hash)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t KeyFilter::getMemoryUsage() const
+{
+    size_t usage = 0;
+    size_t n = numLayers.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; ++i) {
+        usage += layers[i].load(std::memory_order_acquire)->getMemoryUsage();
+    }
+    return usage;
+}
@@ -0,0 +1,171 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+
+#include "common.h"
+#include "arch.h"
+
+/**
+ * Smallest number of keys that a single filter layer is sized for.
+ */
+#define KEY_FILTER_MIN_LAYER_CAPACITY (1024)
+/**
+ * Maximum number of filter layers per file. Since each new layer is at least
+ * twice as large as the previous one, this bound is never reached in practice.
+ */
+#define KEY_FILTER_MAX_LAYERS (48)
+/**
+ * Maximum number of bits per key that can be configured.
+ */
+#define KEY_FILTER_MAX_BITS_PER_KEY (64)
+
+/**
+ * Fixed-size Bloom filter whose bits can be set and tested concurrently.
+ * Each key is hashed once, and the probe positions are derived from the
+ * 64-bit hash value by double hashing.
+ */
+class BloomFilter {
+public:
+    BloomFilter(uint64_t _capacity, uint32_t bits_per_key);
+
+    ~BloomFilter();
+
+    /**
+     * Add a hashed key into the filter.
+     *
+     * @param hash 64-bit hash value of the key.
+     */
+    void add(uint64_t hash);
+
+    /**
+     * Check if a hashed key may have been added into the filter.
+     *
+     * @param hash 64-bit hash value of the key.
+     * @return False if the key was never added, true otherwise.
+     */
+    bool mayContain(uint64_t hash) const;
+
+    uint64_t getCapacity() const {
+        return capacity;
+    }
+
+    uint64_t getNumKeys() const {
+        return numKeys.load(std::memory_order_relaxed);
+    }
+
+    size_t getMemoryUsage() const {
+        return sizeof(BloomFilter) + numWords * sizeof(uint64_t);
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(BloomFilter);
+
+    // Number of keys that this filter is sized for
+    uint64_t capacity;
+    // Number of keys added so far
+    std::atomic<uint64_t> numKeys;
+    // Number of bits in the filter
+    uint64_t numBits;
+    // Number of 64-bit words in 'bits'
+    uint64_t numWords;
+    // Number of probes per key
+    uint32_t numProbes;
+    // Bit array
+    std::atomic<uint64_t> *bits;
+};
+
+/**
+ * Per-file key membership filter that is consulted by point lookups
+ * before descending the main index (HB+trie). It consists of a list of
+ * Bloom filter layers: the first layer is sized when the file is created
+ * (e.g., by compaction, using the number of documents to be moved), and
+ * each WAL flush batch either fits into the tail layer or appends a new
+ * layer sized for the batch.
+ *
+ * Keys are only ever added; deletions and overwrites keep the old bits set,
+ * which keeps the filter a superset of the keys in any version of the index
+ * (i.e., it is also safe for snapshot readers).
+ */
+class KeyFilter {
+public:
+    KeyFilter(uint32_t bits_per_key);
+
+    ~KeyFilter();
+
+    /**
+     * Make sure that the tail layer has room for the given number of keys,
+     * appending a new layer if necessary. This is called at the beginning of
+     * each WAL flush batch.
+     *
+     * @param nkeys Number of keys that are about to be added.
+     */
+    void reserve(uint64_t nkeys);
+
+    /**
+     * Add a key into the filter.
+     *
+     * @param key Pointer to the key.
+     * @param keylen Length of the key.
+     */
+    void add(const void *key, size_t keylen);
+
+    /**
+     * Check if a key may exist in the file.
+     *
+     * @param key Pointer to the key.
+     * @param keylen Length of the key.
+     * @return False if the key definitely does not exist, true otherwise.
+     */
+    bool mayContain(const void *key, size_t keylen) const;
+
+    uint32_t getBitsPerKey() const {
+        return bitsPerKey;
+    }
+
+    size_t getNumLayers() const {
+        return numLayers.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Return the total memory usage of all filter layers.
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(KeyFilter);
+
+    /**
+     * Append a new layer that is sized for at least the given number of keys.
+     * Should be called while holding 'layerLock'.
+     */
+    void appendLayer_UNLOCKED(uint64_t nkeys);
+
+    // Bits per key for every layer
+    uint32_t bitsPerKey;
+    // Number of layers in use
+    std::atomic<size_t> numLayers;
+    // Filter layers, oldest first
+    std::atomic<BloomFilter *> layers[KEY_FILTER_MAX_LAYERS];
+    // Lock for appending a new layer
+    spin_t layerLock;
+};
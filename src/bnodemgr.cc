@@ -200,7 +200,7 @@ uint64_t BnodeMgr::assignDirtyNodeOffset( Bnode *bnode )
         //    => to ensure that at least the first 4 bytes of an index node
         //       is written in the same block, to fetch the size of node
         //       (stored in the first 4 bytes) easily.
-        curBid = file->alloc_FileMgr(nullptr);
+        curBid = file->allocIndexBlock(nullptr);
         curOffset = 0;
     }
 
@@ -229,7 +229,7 @@ uint64_t BnodeMgr::assignDirtyNodeOffset( Bnode *bnode )
 
     size_t i;
     for (i=0; i<n_blocks; ++i) {
-        curBid = file->alloc_FileMgr(nullptr);
+        curBid = file->allocIndexBlock(nullptr);
         bnode->addBidList(curBid);
     }
 
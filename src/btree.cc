@@ -661,6 +661,57 @@ btree_result BTree::getKeyRange(idx_t num, idx_t den, void *key_begin, void *key
     return BTREE_RESULT_SUCCESS;
 }
 
+btree_result BTree::findByRank(double& rank, void *value_buf)
+{
+    void *addr;
+    uint8_t *k = alca(uint8_t, ksize);
+    uint8_t *v = alca(uint8_t, vsize);
+    struct bnode *node;
+    bid_t bid = root_bid;
+    idx_t idx;
+    double pos;
+    int i;
+
+    if (rank < 0 || rank >= 1) {
+        return BTREE_RESULT_FAIL;
+    }
+
+    kv_ops->initKVVar(k, v);
+
+    for (i = height-1 ; i >= 0 ; --i) {
+        addr = bhandle->read(bid);
+        node = _fetch_bnode(addr, i+1);
+        if (node->nentry == 0) {
+            bhandle->operationEnd();
+            kv_ops->freeKVVar(k, v);
+            return BTREE_RESULT_FAIL;
+        }
+
+        pos = rank * node->nentry;
+        idx = (idx_t)pos;
+        if (idx >= node->nentry) {
+            idx = node->nentry - 1;
+        }
+        rank = pos - idx;
+        if (rank >= 1) {
+            rank = 0;
+        }
+
+        kv_ops->getKV(node, idx, k, v);
+        if (i > 0) {
+            // index node .. follow the child node
+            bid = kv_ops->value2bid(v);
+            bid = _endian_decode(bid);
+        } else {
+            kv_ops->setValue(value_buf, v);
+        }
+    }
+
+    bhandle->operationEnd();
+    kv_ops->freeKVVar(k, v);
+    return BTREE_RESULT_SUCCESS;
+}
+
 btree_result BTree::find(void *key, void *value_buf)
 {
     void *addr;
@@ -738,6 +789,8 @@ int BTree::splitNode(void *key, struct bnode **node, bid_t *bid, idx_t *idx,
     struct bnode **new_node = alca(struct bnode *, nnode);
     memset(new_node, 0, nnode * sizeof(struct bnode*));
     struct kv_ins_item *kv_item = NULL;
+    bool append = (nnode == 2 && isAppendSplit(node, idx, i, kv_ins_list,
+                                               minkey_replace, k));
 
     // allocate new block(s)
     new_node[0] = node[i];
@@ -747,10 +800,19 @@ int BTree::splitNode(void *key, struct bnode **node, bid_t *bid, idx_t *idx,
     }
 
     // calculate # entry
-    for (j = 0 ; j < nnode+1 ; ++j){
-        split_idx[j] = kv_ops->getNthIdx(node[i], j, nnode);
-        if (j > 0) {
-            nentry[j-1] = split_idx[j] - split_idx[j-1];
+    if (append) {
+        // keep all existing entries in the original node, and start
+        // a new (empty) right sibling for the appended key
+        split_idx[0] = 0;
+        split_idx[1] = split_idx[2] = node[i]->nentry;
+        nentry[0] = node[i]->nentry;
+        nentry[1] = 0;
+    } else {
+        for (j = 0 ; j < nnode+1 ; ++j){
+            split_idx[j] = kv_ops->getNthIdx(node[i], j, nnode);
+            if (j > 0) {
+                nentry[j-1] = split_idx[j] - split_idx[j-1];
+            }
         }
     }
 
@@ -774,7 +836,7 @@ int BTree::splitNode(void *key, struct bnode **node, bid_t *bid, idx_t *idx,
             kv_item = _get_entry(e, struct kv_ins_item, le);
 
             idx_ins[i] = BTREE_IDX_NOT_FOUND;
-            for (j=1;j<nnode;++j){
+            for (j=1;j<nnode && !append;++j){
                 kv_ops->getKV(new_node[j], 0, k, v);
                 if (kv_ops->cmp(kv_item->key, k, aux) < 0) {
                     idx_ins[i] = addEntry(new_node[j-1], kv_item->key, kv_item->value);
@@ -862,6 +924,37 @@ int BTree::splitNode(void *key, struct bnode **node, bid_t *bid, idx_t *idx,
     return 0;
 }
 
+bool BTree::isAppendSplit(struct bnode **node, idx_t *idx, int i,
+                          struct list *kv_ins_list, int8_t *minkey_replace,
+                          void *k)
+{
+    struct list_elem *e;
+    struct kv_ins_item *kv_item;
+    int j;
+
+    if (minkey_replace[i]) {
+        return false;
+    }
+
+    // only a single key-value pair is inserted into this node
+    e = list_begin(&kv_ins_list[i]);
+    if (!e || list_next(e)) {
+        return false;
+    }
+
+    // the node should be the rightmost node of its level
+    for (j = i+1 ; j < height ; ++j) {
+        if (idx[j] + 1 != node[j]->nentry) {
+            return false;
+        }
+    }
+
+    // and the key should be greater than any key in the node
+    kv_item = _get_entry(e, struct kv_ins_item, le);
+    kv_ops->getKV(node[i], node[i]->nentry - 1, k, NULL);
+    return kv_ops->cmp(kv_item->key, k, aux) > 0;
+}
+
 int BTree::moveModifiedNode(void *key, struct bnode **node, bid_t *bid,
                             idx_t *idx, int i, struct list *kv_ins_list,
                             void *k, void *v, int8_t *modified, int8_t *minkey_replace,
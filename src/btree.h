@@ -309,6 +309,18 @@ public:
      */
     btree_result getKeyRange(idx_t num, idx_t den, void *key_begin, void *key_end);
 
+    /**
+     * Get the value of the entry located at the given relative position
+     * (0 <= rank < 1) in the B+tree, assuming that every node at the same
+     * level has the same number of entries.
+     *
+     * @param rank Reference to the relative position. On return, it is set to
+     *        the relative position within the returned entry, which can be used
+     *        to continue the search in a sub-tree that the entry points to.
+     * @param value_buf Buffer where the value of the entry is copied.
+     */
+    btree_result findByRank(double& rank, void *value_buf);
+
     // Get the value for the given key.
     btree_result find(void *key, void *value_buf);
     // Insert the given key-value pair.
@@ -415,6 +427,18 @@ private:
      */
     size_t getNSplitNode(bid_t bid, struct bnode *node, size_t size);
 
+    /**
+     * Check if the split of the given node is caused by appending a key
+     * beyond the largest key of the entire B+tree (e.g., monotonically
+     * increasing sequence numbers). In that case the node is kept full and
+     * only the new key is moved to a new right sibling, instead of splitting
+     * the node in half, so that sequentially built trees do not end up with
+     * half-empty nodes.
+     */
+    bool isAppendSplit(struct bnode **node, idx_t *idx, int i,
+                       struct list *kv_ins_list, int8_t *minkey_replace,
+                       void *k);
+
     // Internal function for split.
     int splitNode(void *key, struct bnode **node, bid_t *bid, idx_t *idx,
                   int i, struct list *kv_ins_list, size_t nsplitnode,
@@ -18,7 +18,8 @@
 /*
  * Checksum abstraction functions.
  *
- * ForestDB evolved to support a software CRC and platform's CRC32-C.
+ * ForestDB evolved to support a software CRC and CRC32-C, which is taken
+ * from the platform library if linked, or the bundled utils/crc32c.cc.
  * This module provides an API for checking and creating checksums
  * utilising the correct method based upon the callers crc_mode.
  */
@@ -30,15 +31,8 @@
 // Linking with platform for crc32c
 # include <platform/crc32c.h>
 #else
-#include <stdint.h>
-// Define a crc32c which does nothing but assert.
-static uint32_t crc32c(const uint8_t* buf,
-                size_t buf_len,
-                uint32_t pre) {
-    // Non couchbase builds are configured to never turn on crc32c.
-    assert(false);
-    return 0;
-}
+// Bundled crc32c with runtime CPU dispatch
+# include "crc32c.h"
 #endif
 # include "checksum.h"
 #include "crc32.h"
@@ -88,15 +82,12 @@ bool perform_integrity_check(const uint8_t* buf,
                             uint32_t checksum,
                             crc_mode_e mode) {
     bool success = false;
-#ifdef _CRC32C
     if (mode == CRC_UNKNOWN || mode == CRC32C) {
         success = checksum == crc32c(buf, buf_len, 0);
         if (!success && mode == CRC_UNKNOWN) {
             success = checksum == crc32_8((void *)buf, buf_len, 0);
         }
-    } else
-#endif
-    {
+    } else {
         success = checksum == crc32_8((void *)buf, buf_len, 0);
     }
     return success;
@@ -114,13 +105,10 @@ bool detect_and_check_crc(const uint8_t* buf,
                           uint32_t checksum,
                           crc_mode_e* mode) {
     *mode = CRC_UNKNOWN;
-#ifdef _CRC32C
     if (perform_integrity_check(buf, buf_len, checksum, CRC32C)) {
         *mode = CRC32C;
         return true;
-    } else
-#endif
-    if (perform_integrity_check(buf, buf_len, checksum, CRC32)) {
+    } else if (perform_integrity_check(buf, buf_len, checksum, CRC32)) {
         *mode = CRC32;
         return true;
     }
@@ -18,7 +18,8 @@
 /*
  * Checksum abstraction functions.
  *
- * ForestDB evolved to support a software CRC and platform's CRC32-C.
+ * ForestDB evolved to support a software CRC and CRC32-C, which is taken
+ * from the platform library if linked, or the bundled utils/crc32c.cc.
  * This module provides an API for checking and creating checksums
  * utilising the correct method based upon the callers crc_mode.
  */
@@ -32,11 +33,9 @@ enum crc_mode_e {
     CRC_UNKNOWN,
     CRC32,
     CRC32C,
-#ifdef _CRC32C
-    CRC_DEFAULT = CRC32C // Couchbase builds pickup crc32c from plaform
-#else
-    CRC_DEFAULT = CRC32 // Non-couchbase falls back to bundled utils/crc32.cc
-#endif
+    // New files use CRC32-C. Files written with the software CRC32 (by
+    // older non-couchbase builds) are detected and keep using CRC32.
+    CRC_DEFAULT = CRC32C
 };
 
 /*
@@ -24,9 +24,14 @@
 #include <sys/time.h>
 #endif
 
+#include <algorithm>
+#include <vector>
+#include <mutex>
+
 #include "libforestdb/forestdb.h"
 
 #include "bgflusher.h"
+#include "bloomfilter.h"
 #include "btree.h"
 #include "btree_new.h"
 #include "bnodemgr.h"
@@ -39,6 +44,8 @@
 #include "fdb_internal.h"
 #include "filemgr.h"
 #include "hbtrie.h"
+#include "ratelimiter.h"
+#include "sync_object.h"
 #include "version.h"
 #include "wal.h"
 
@@ -107,6 +114,30 @@ char *_fdb_redirect_header(FileMgr *old_file, uint8_t *buf,
     return old_compact_filename_len ? old_filename : NULL;
 }
 
+// Set the codec to recompress a doc appended into the new file. As in the
+// regular write path, the KV store's codec overrides the file's codec, and
+// zstd uses the KV store's dictionary copied into the new file.
+static void _fdb_compaction_set_doc_codec(FdbKvsHandle *handle,
+                                          DocioHandle *new_dhandle,
+                                          struct docio_object *doc)
+{
+    fdb_kvs_id_t kv_id = 0;
+    fdb_compression_codec_t codec;
+    uint64_t dict_offset = BLK_NOT_FOUND;
+
+    if (handle->kvs && doc->length.keylen >= handle->config.chunksize) {
+        buf2kvid(handle->config.chunksize, doc->key, &kv_id);
+    }
+    codec = fdb_kvs_get_codec(handle->file, kv_id);
+    if (codec == FDB_COMPRESSION_DEFAULT) {
+        codec = handle->config.compression_codec;
+    }
+    if (codec == FDB_COMPRESSION_ZSTD) {
+        dict_offset = fdb_kvs_get_dict_offset(new_dhandle->getFile(), kv_id);
+    }
+    new_dhandle->setCodec_Docio(codec, dict_offset);
+}
+
 static int64_t _fdb_doc_move(void *dbhandle,
                              void *void_new_dhandle,
                              struct wal_item *item,
@@ -141,10 +172,315 @@ static int64_t _fdb_doc_move(void *dbhandle,
     fdoc->size_ondisk= _fdb_get_docsize(doc.length);
     fdoc->deleted = deleted;
 
+    _fdb_compaction_set_doc_codec(handle, new_dhandle, &doc);
     new_offset = new_dhandle->appendDoc_Docio(&doc, deleted, 1);
     return new_offset;
 }
 
+/**
+ * State shared by the compactor and its worker threads. The workers are
+ * alive for the whole compaction, and move a batch of docs in each round
+ * started by the compactor.
+ */
+struct CompactionWorkerSync {
+    SyncObject lock; // lock and condition variable for the fields below
+    uint64_t round; // incremented by the compactor to start a round
+    size_t numRunning; // number of workers that haven't finished the round
+    bool terminate; // set by the compactor to stop the workers
+};
+
+/**
+ * Context of a compaction worker thread. Each worker reads a contiguous range
+ * of the (sorted) doc offsets from the old file, and appends the docs into
+ * its own doc blocks of the new file.
+ */
+struct CompactionWorker {
+    thread_t tid; // worker thread
+    CompactionWorkerSync *sync; // shared with the compactor and other workers
+    FdbKvsHandle *handle; // KV store handle of the old file
+    FileMgr *newFile; // file manager instance for the new file
+    DocioHandle *readHandle; // doc handle for reading the old file
+    DocioHandle *writeHandle; // doc handle for appending to the new file
+    struct docio_object *doc; // batch read buffer
+    size_t docArraySize; // size of the batch read buffer
+    size_t moveUnit; // max data size of a single batch read
+    std::mutex *walLock; // lock for the new file's WAL
+    timestamp_t curTimestamp; // timestamp when the compaction started
+    uint64_t *offsetArray; // offsets of docs to be moved
+    size_t numDocs; // number of docs to be moved
+    uint64_t numMovedDocs; // number of docs appended to the new file
+    uint64_t oldOffset; // offset of the last moved doc in the old file
+    uint64_t newOffset; // offset of the last moved doc in the new file
+    fdb_status status; // result of the last run
+};
+
+static bool _fdb_frag_block_bid_cmp(const struct fragmented_block &a,
+                                    const struct fragmented_block &b)
+{
+    return a.bid < b.bid;
+}
+
+// More stale bytes first.
+static bool _fdb_frag_block_stale_cmp(const struct fragmented_block &a,
+                                      const struct fragmented_block &b)
+{
+    return a.stale_len > b.stale_len;
+}
+
+// Return true if a given doc should be moved into the new file when there
+// is no doc move callback.
+INLINE bool _fdb_compaction_keep_doc(FdbKvsHandle *handle,
+                                     struct docio_object *doc,
+                                     timestamp_t cur_timestamp)
+{
+    // re-write the document to new file when
+    // 1. the document is not deleted
+    // 2. the document is logically deleted but
+    //    its timestamp isn't overdue
+    return !(doc->length.flag & DOCIO_DELETED) ||
+           cur_timestamp < doc->timestamp + handle->config.purging_interval;
+}
+
+// Charge the documents read in a batch against the background I/O rate
+// limit, before they are appended into the new file. This must not be called
+// while holding the file lock.
+static void _fdb_compaction_throttle_io(struct docio_object *doc, size_t n)
+{
+    IoRateLimiter *limiter = IoRateLimiter::getInstance();
+    if (!limiter) {
+        return;
+    }
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (doc[i].key) {
+            bytes += _fdb_get_docsize(doc[i].length);
+        }
+    }
+    if (bytes) {
+        limiter->request(bytes);
+    }
+}
+
+// Charge the blocks that copy_file_range() copies into the new file against
+// the background I/O rate limit. Blocks shared by a copy-on-write file system
+// are not written, so they are not charged. This must not be called while
+// holding the file lock.
+static void _fdb_compaction_throttle_copy(FileMgr *file, bid_t num_blocks)
+{
+    IoRateLimiter *limiter = IoRateLimiter::getInstance();
+    if (!limiter || file->getFsType() != FILEMGR_FS_COPY_RANGE) {
+        return;
+    }
+    limiter->request(num_blocks * file->getBlockSize());
+}
+
+// Charge the index blocks that a WAL flush appended into the new file since
+// 'prev_pos' against the background I/O rate limit, as the block cache writes
+// them back later. The documents are charged when they are moved. This must
+// not be called while holding the file lock.
+static void _fdb_compaction_throttle_index(FileMgr *new_file,
+                                           uint64_t prev_pos)
+{
+    IoRateLimiter *limiter = IoRateLimiter::getInstance();
+    uint64_t pos = new_file->getPos();
+    if (limiter && pos > prev_pos) {
+        limiter->request(pos - prev_pos);
+    }
+}
+
+// Orders the indexes of a batch of delta docs by key in the same way as the
+// WAL does, i.e., by KV ID first and then by the (custom) key order.
+struct _fdb_compaction_doc_key_less {
+    struct docio_object *doc;
+    struct _fdb_key_cmp_info *info;
+
+    bool operator()(size_t a, size_t b) const {
+        void *key_a = doc[a].key, *key_b = doc[b].key;
+        size_t len_a = doc[a].length.keylen, len_b = doc[b].length.keylen;
+        if (info->kvs_config.custom_cmp) {
+            if (info->kvs) {
+                size_t size_chunk = info->kvs->getRootHandle()->config.chunksize;
+                fdb_kvs_id_t id_a, id_b;
+                buf2kvid(size_chunk, key_a, &id_a);
+                buf2kvid(size_chunk, key_b, &id_b);
+                if (id_a != id_b) {
+                    return id_a < id_b;
+                }
+                return info->kvs_config.custom_cmp(
+                           (uint8_t*)key_a + size_chunk, len_a - size_chunk,
+                           (uint8_t*)key_b + size_chunk, len_b - size_chunk) < 0;
+            }
+            return info->kvs_config.custom_cmp(key_a, len_a,
+                                               key_b, len_b) < 0;
+        }
+        int cmp = memcmp(key_a, key_b, std::min(len_a, len_b));
+        return cmp ? cmp < 0 : len_a < len_b;
+    }
+};
+
+// Move the docs assigned to a worker in the current round.
+static void _fdb_compaction_worker_move(CompactionWorker *worker)
+{
+    FdbKvsHandle *handle = worker->handle;
+    struct docio_object *doc = worker->doc;
+    struct _fdb_key_cmp_info cmp_info;
+    fdb_doc wal_doc;
+    uint8_t deleted;
+    size_t i = 0, j, num_batch_reads;
+
+    cmp_info.kvs_config = handle->kvs_config;
+    cmp_info.kvs = handle->kvs;
+    worker->numMovedDocs = 0;
+    worker->status = FDB_RESULT_SUCCESS;
+
+    while (i < worker->numDocs) {
+        num_batch_reads =
+            worker->readHandle->batchReadDocs_Docio(&worker->offsetArray[i],
+                                                    doc, worker->numDocs - i,
+                                                    worker->moveUnit,
+                                                    worker->docArraySize,
+                                                    NULL, false);
+        if (num_batch_reads == (size_t) -1) {
+            worker->status = FDB_RESULT_COMPACTION_FAIL;
+            break;
+        }
+        _fdb_compaction_throttle_io(doc, num_batch_reads);
+
+        for (j = 0; j < num_batch_reads; ++j) {
+            if (!doc[j].key) {
+                continue;
+            }
+
+            if (_fdb_compaction_keep_doc(handle, &doc[j],
+                                         worker->curTimestamp)) {
+                deleted = doc[j].length.flag & DOCIO_DELETED;
+                _fdb_compaction_set_doc_codec(handle, worker->writeHandle,
+                                              &doc[j]);
+                uint64_t new_offset =
+                    worker->writeHandle->appendDoc_Docio(&doc[j], deleted, 0);
+                if (new_offset == BLK_NOT_FOUND) {
+                    worker->status = FDB_RESULT_COMPACTION_FAIL;
+                    break;
+                }
+                worker->newOffset = new_offset;
+                worker->oldOffset = worker->offsetArray[i + j];
+
+                wal_doc.keylen = doc[j].length.keylen;
+                wal_doc.metalen = doc[j].length.metalen;
+                wal_doc.bodylen = doc[j].length.bodylen;
+                wal_doc.key = doc[j].key;
+                wal_doc.seqnum = doc[j].seqnum;
+                wal_doc.deleted = deleted;
+                wal_doc.meta = doc[j].meta;
+                wal_doc.body = doc[j].body;
+                wal_doc.size_ondisk = _fdb_get_docsize(doc[j].length);
+                wal_doc.offset = worker->newOffset;
+
+                // WAL insertion by the compactor is not thread-safe.
+                worker->walLock->lock();
+                worker->newFile->getWal()->insert_Wal(
+                                            worker->newFile->getGlobalTxn(),
+                                            &cmp_info, &wal_doc,
+                                            worker->newOffset,
+                                            WAL_INS_COMPACT_PHASE1);
+                worker->walLock->unlock();
+                worker->numMovedDocs++;
+            }
+            free(doc[j].key);
+            free(doc[j].meta);
+            free(doc[j].body);
+            doc[j].key = doc[j].meta = doc[j].body = NULL;
+        }
+        if (worker->status != FDB_RESULT_SUCCESS) {
+            // free the docs that were not moved
+            for (; j < num_batch_reads; ++j) {
+                free(doc[j].key);
+                free(doc[j].meta);
+                free(doc[j].body);
+                doc[j].key = doc[j].meta = doc[j].body = NULL;
+            }
+            break;
+        }
+        i += num_batch_reads;
+    }
+}
+
+static void *_fdb_compaction_worker_thread(void *voidargs)
+{
+    CompactionWorker *worker = reinterpret_cast<CompactionWorker *>(voidargs);
+    CompactionWorkerSync *sync = worker->sync;
+    uint64_t round = 0;
+
+    while (true) {
+        {
+            UniqueLock lh(sync->lock);
+            while (sync->round == round && !sync->terminate) {
+                sync->lock.wait(lh);
+            }
+            if (sync->terminate) {
+                break;
+            }
+            round = sync->round;
+        }
+
+        _fdb_compaction_worker_move(worker);
+
+        LockHolder lh(sync->lock);
+        if (--sync->numRunning == 0) {
+            sync->lock.notify_all();
+        }
+    }
+
+    return NULL;
+}
+
+fdb_status Compaction::moveDocsParallel(CompactionWorker *workers,
+                                        size_t num_workers,
+                                        CompactionWorkerSync *sync,
+                                        uint64_t *offset_array,
+                                        size_t num_docs,
+                                        uint64_t *n_moved_docs,
+                                        uint64_t *old_offset,
+                                        uint64_t *new_offset)
+{
+    size_t i, begin, end;
+    fdb_status fs = FDB_RESULT_SUCCESS;
+
+    // Split the offsets into contiguous ranges so that each worker
+    // reads a separate region of the old file.
+    for (i = 0; i < num_workers; ++i) {
+        begin = num_docs * i / num_workers;
+        end = num_docs * (i + 1) / num_workers;
+        workers[i].offsetArray = offset_array + begin;
+        workers[i].numDocs = end - begin;
+    }
+
+    // Start a round, and wait until all the workers finish it
+    UniqueLock lh(sync->lock);
+    sync->numRunning = num_workers;
+    sync->round++;
+    sync->lock.notify_all();
+    while (sync->numRunning) {
+        sync->lock.wait(lh);
+    }
+    lh.unlock();
+
+    for (i = 0; i < num_workers; ++i) {
+        if (workers[i].numDocs == 0) {
+            continue;
+        }
+        if (workers[i].status != FDB_RESULT_SUCCESS) {
+            fs = workers[i].status;
+        }
+        if (workers[i].numMovedDocs) {
+            *n_moved_docs += workers[i].numMovedDocs;
+            *old_offset = workers[i].oldOffset;
+            *new_offset = std::max(*new_offset, workers[i].newOffset);
+        }
+    }
+    return fs;
+}
+
 fdb_status Compaction::compactFile(FdbFileHandle *fhandle,
                                    const char *new_filename,
                                    bool in_place_compaction,
@@ -158,6 +494,11 @@ fdb_status Compaction::compactFile(FdbFileHandle *fhandle,
     fdb_status status;
     LATENCY_STAT_START();
 
+    if (handle->config.compaction_cluster_docs) {
+        // Cloning preserves the physical layout of the old file.
+        clone_docs = false;
+    }
+
     // Prevent updates to the current file
     handle->file->mutexLock();
 
@@ -187,6 +528,25 @@ fdb_status Compaction::compactFile(FdbFileHandle *fhandle,
         return status;
     }
 
+    if (compaction.fileMgr->getKeyFilter()) {
+        // Size the new file's base key filter layer for all the documents
+        // that are going to be moved.
+        KvsStatOperations *stat_ops = handle->file->getKvsStatOps();
+        compaction.fileMgr->getKeyFilter()->reserve(
+            stat_ops->statGetSum(KVS_STAT_NDOCS) +
+            stat_ops->statGetSum(KVS_STAT_NDELETES));
+    }
+
+    // Carry the blob files over to the new file, except the stale ones whose
+    // live bodies are moved by this compaction. All bodies are moved when
+    // the file is rekeyed.
+    compaction.fileMgr->getBlobFiles()->inherit(
+        handle->file->getBlobFiles(),
+        new_encryption_key ? 0 : handle->config.blob_gc_stale_ratio,
+        handle->file->getConfig()->getBlobThreshold() > 0);
+    handle->dhandle->setBlobMode_Docio(DOCIO_BLOB_MOVE_REF);
+    compaction.docHandle->setBlobMode_Docio(DOCIO_BLOB_MOVE_REF);
+
     // Prevent updates to the new file for compaction
     compaction.fileMgr->mutexLock();
 
@@ -499,6 +859,9 @@ fdb_status Compaction::compactFile(FdbFileHandle *fhandle,
 
     delete handle->dhandle;
     handle->dhandle = compaction.docHandle;
+    handle->dhandle->setBlobMode_Docio(DOCIO_BLOB_READ_BODY);
+    // the doc handle was left with the codec of the last moved doc
+    _fdb_set_doc_codec(handle);
 
     delete handle->trie;
     handle->trie = compaction.keyTrie;
@@ -554,6 +917,236 @@ fdb_status Compaction::compactFile(FdbFileHandle *fhandle,
     return status;
 }
 
+fdb_status Compaction::compactFragmentedRegions(FdbFileHandle *fhandle,
+                                                uint8_t min_stale_ratio,
+                                                size_t max_blocks)
+{
+    FdbKvsHandle *handle = fhandle->getRootHandle();
+    FileMgr *file = handle->file;
+    size_t blocksize = handle->config.blocksize;
+    size_t i, j, num_batch_reads;
+    uint8_t deleted;
+    uint64_t offset, cur_offset, new_offset;
+    uint64_t last_offset = 0;
+    uint64_t n_relocated = 0;
+    bool in_wal, stop = false;
+    hbtrie_result hr;
+    HBTrieIterator *it;
+    struct docio_object *doc;
+    struct _fdb_key_cmp_info cmp_info;
+    fdb_doc wal_doc, query;
+    std::vector<struct fragmented_block> frag_blocks, targets;
+    std::vector<struct fragmented_block>::iterator fb;
+    std::vector<uint64_t> offsets;
+    fdb_status fs;
+
+    if (handle->config.flags & FDB_OPEN_FLAG_RDONLY) {
+        return fdb_log(&handle->log_callback, FDB_RESULT_RONLY_VIOLATION,
+                       "Warning: Incremental compaction is not allowed on "
+                       "the read-only DB file '%s'.", file->getFileName());
+    }
+    if (!file->getSb()) {
+        // stale regions are not tracked in the legacy file format
+        return FDB_RESULT_FILE_VERSION_NOT_SUPPORTED;
+    }
+    if (handle->txn) {
+        return FDB_RESULT_FAIL_BY_TRANSACTION;
+    }
+
+    // Flush WAL so that every live document is indexed by the main index,
+    // and all stale regions so far are gathered.
+    fs = FdbEngine::getInstance()->commit(fhandle, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    if (fs != FDB_RESULT_SUCCESS) {
+        return fs;
+    }
+    file = handle->file;
+
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    file->mutexLock();
+    if (file->getFileStatus() != FILE_NORMAL) {
+        file->mutexUnlock();
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_FAIL_BY_COMPACTION;
+    }
+    frag_blocks = file->getStaleData()->getFragmentedBlocks(min_stale_ratio);
+    file->mutexUnlock();
+
+    if (frag_blocks.empty()) {
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_SUCCESS;
+    }
+
+    // Find all live documents beginning in the fragmented blocks. Blocks
+    // without any such document (e.g., index blocks) are not relocated.
+    it = new HBTrieIterator();
+    hr = it->init(handle->trie, NULL, 0);
+    while (hr == HBTRIE_RESULT_SUCCESS) {
+        hr = it->nextValueOnly((void*)&offset);
+        if (ver_btreev2_format(file->getVersion())) {
+            handle->bnodeMgr->releaseCleanNodes();
+        } else {
+            handle->bhandle->flushBuffer();
+        }
+        if (hr != HBTRIE_RESULT_SUCCESS) {
+            break;
+        }
+        offset = _endian_decode(offset);
+        last_offset = std::max(last_offset, offset);
+
+        struct fragmented_block key;
+        key.bid = offset / blocksize;
+        fb = std::lower_bound(frag_blocks.begin(), frag_blocks.end(), key,
+                              _fdb_frag_block_bid_cmp);
+        if (fb != frag_blocks.end() && fb->bid == key.bid) {
+            offsets.push_back(offset);
+        }
+    }
+    delete it;
+
+    // The block of the last document is shared with the metadata of the last
+    // commit (e.g., the last relocation), which becomes stale by the next
+    // commit. Relocating its documents would only leave the same
+    // fragmentation behind in a new last block, so it is skipped.
+    j = 0;
+    for (i = 0; i < offsets.size(); ++i) {
+        if (offsets[i] / blocksize != last_offset / blocksize) {
+            offsets[j++] = offsets[i];
+        }
+    }
+    offsets.resize(j);
+
+    // Choose the most fragmented blocks among them.
+    std::sort(offsets.begin(), offsets.end());
+    for (i = 0; i < offsets.size(); ++i) {
+        bid_t bid = offsets[i] / blocksize;
+        if (targets.empty() || targets.back().bid != bid) {
+            struct fragmented_block key;
+            key.bid = bid;
+            fb = std::lower_bound(frag_blocks.begin(), frag_blocks.end(), key,
+                                  _fdb_frag_block_bid_cmp);
+            targets.push_back(*fb);
+        }
+    }
+    if (targets.size() > max_blocks) {
+        std::sort(targets.begin(), targets.end(), _fdb_frag_block_stale_cmp);
+        targets.resize(max_blocks);
+        std::sort(targets.begin(), targets.end(), _fdb_frag_block_bid_cmp);
+
+        j = 0;
+        for (i = 0; i < offsets.size(); ++i) {
+            struct fragmented_block key;
+            key.bid = offsets[i] / blocksize;
+            if (std::binary_search(targets.begin(), targets.end(), key,
+                                   _fdb_frag_block_bid_cmp)) {
+                offsets[j++] = offsets[i];
+            }
+        }
+        offsets.resize(j);
+    }
+
+    cmp_info.kvs_config = handle->kvs_config;
+    cmp_info.kvs = handle->kvs;
+    doc = (struct docio_object *)
+        calloc(FDB_COMP_BATCHSIZE, sizeof(struct docio_object));
+
+    // Relocate the documents. Each of them is appended again with the same
+    // seq number and inserted into WAL as a normal update, so that the old
+    // copy is marked as stale when WAL is flushed. Bodies in blob files stay
+    // where they are.
+    handle->dhandle->setBlobMode_Docio(DOCIO_BLOB_KEEP_REF);
+    fs = FDB_RESULT_SUCCESS;
+    i = 0;
+    while (i < offsets.size() && !stop) {
+        num_batch_reads = handle->dhandle->batchReadDocs_Docio(
+                                  &offsets[i], doc, offsets.size() - i,
+                                  FDB_COMP_MOVE_UNIT, FDB_COMP_BATCHSIZE,
+                                  NULL, false);
+        if (num_batch_reads == (size_t) -1) {
+            fs = FDB_RESULT_READ_FAIL;
+            break;
+        }
+        _fdb_compaction_throttle_io(doc, num_batch_reads);
+
+        file->mutexLock();
+        if (file->getFileStatus() != FILE_NORMAL ||
+            file->getWal()->getEarliestTxn_Wal(file->getGlobalTxn())) {
+            // Regular compaction or a transaction has begun in the meantime.
+            stop = true;
+        }
+        for (j = 0; j < num_batch_reads; ++j) {
+            if (!doc[j].key || stop || fs != FDB_RESULT_SUCCESS) {
+                goto free_doc;
+            }
+
+            // Skip the document if it has been updated since the scan.
+            memset(&query, 0x0, sizeof(query));
+            query.key = doc[j].key;
+            query.keylen = doc[j].length.keylen;
+            if (_fdb_find_doc_offset(handle, &query, &cur_offset,
+                                     &in_wal) != FDB_RESULT_SUCCESS ||
+                in_wal || cur_offset != offsets[i + j]) {
+                goto free_doc;
+            }
+
+            deleted = doc[j].length.flag & DOCIO_DELETED;
+            new_offset = handle->dhandle->appendDoc_Docio(&doc[j], deleted, 0);
+            if (new_offset == BLK_NOT_FOUND) {
+                fs = FDB_RESULT_WRITE_FAIL;
+                goto free_doc;
+            }
+
+            memset(&wal_doc, 0x0, sizeof(wal_doc));
+            wal_doc.keylen = doc[j].length.keylen;
+            wal_doc.metalen = doc[j].length.metalen;
+            wal_doc.bodylen = doc[j].length.bodylen;
+            wal_doc.key = doc[j].key;
+            wal_doc.meta = doc[j].meta;
+            wal_doc.body = doc[j].body;
+            wal_doc.seqnum = doc[j].seqnum;
+            wal_doc.deleted = deleted;
+            wal_doc.size_ondisk = _fdb_get_docsize(doc[j].length);
+            wal_doc.offset = new_offset;
+            file->getWal()->insert_Wal(file->getGlobalTxn(), &cmp_info,
+                                       &wal_doc, new_offset, WAL_INS_WRITER);
+            n_relocated++;
+
+free_doc:
+            free(doc[j].key);
+            free(doc[j].meta);
+            free(doc[j].body);
+            doc[j].key = doc[j].meta = doc[j].body = NULL;
+        }
+        if (n_relocated &&
+            file->getWal()->getDirtyStatus_Wal() == FDB_WAL_CLEAN) {
+            file->getWal()->setDirtyStatus_Wal(FDB_WAL_DIRTY);
+        }
+        file->mutexUnlock();
+
+        if (fs != FDB_RESULT_SUCCESS) {
+            break;
+        }
+        i += num_batch_reads;
+    }
+    handle->dhandle->setBlobMode_Docio(DOCIO_BLOB_READ_BODY);
+    free(doc);
+    END_HANDLE_BUSY(handle);
+
+    if (n_relocated) {
+        // Flush the relocated documents, which also marks their old copies
+        // as stale. The freed blocks are returned to the pool of reusable
+        // blocks by the next block reclaim.
+        fdb_status cs = FdbEngine::getInstance()->commit(
+                                        fhandle, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        if (fs == FDB_RESULT_SUCCESS) {
+            fs = cs;
+        }
+    }
+    return fs;
+}
+
 fdb_status Compaction::checkCompactionReadiness(FdbKvsHandle *handle,
                                                 const char *new_filename)
 {
@@ -750,6 +1343,10 @@ void Compaction::cleanUpCompactionErr(FdbKvsHandle *handle) {
     }
     delete docHandle;
     delete keyTrie;
+
+    // The old file keeps all its blob files
+    handle->file->getBlobFiles()->clearCollected();
+    handle->dhandle->setBlobMode_Docio(DOCIO_BLOB_READ_BODY);
 }
 
 fdb_status Compaction::copyDocsUptoMarker(FdbKvsHandle *rhandle,
@@ -859,6 +1456,7 @@ fdb_status Compaction::copyDocsUptoMarker(FdbKvsHandle *rhandle,
     if (fs != FDB_RESULT_SUCCESS) {
         return fs;
     }
+    handle.dhandle->setBlobMode_Docio(DOCIO_BLOB_MOVE_REF);
 
     // Set the current file's sequence numbers into the header of the new file
     // so they gets migrated correctly for the fdb_set_file_header below.
@@ -1146,7 +1744,9 @@ fdb_status Compaction::copyWalDocs(FdbKvsHandle *handle,
                     }
                 }
                 if (decision == FDB_CS_KEEP_DOC) {
+                    _fdb_compaction_throttle_io(&doc, 1);
                     // Re-Write Document to new_file based on decision above
+                    _fdb_compaction_set_doc_codec(handle, docHandle, &doc);
                     new_offset = docHandle->appendDoc_Docio(&doc, deleted, 0);
                     if (new_offset == BLK_NOT_FOUND) {
                         free(doc.key);
@@ -1211,6 +1811,7 @@ fdb_status Compaction::copyWalDocs(FdbKvsHandle *handle,
             new_handle.bhandle = btreeHandle;
         }
 
+        uint64_t prev_pos = fileMgr->getPos();
         fileMgr->getWal()->flush_Wal((void*) &new_handle,
                                      WalFlushCallbacks::flushItem,
                                      WalFlushCallbacks::getOldOffset,
@@ -1219,6 +1820,7 @@ fdb_status Compaction::copyWalDocs(FdbKvsHandle *handle,
                                      &flush_items);
         fileMgr->getWal()->setDirtyStatus_Wal(FDB_WAL_PENDING);
         fileMgr->getWal()->releaseFlushedItems_Wal(&flush_items);
+        _fdb_compaction_throttle_index(fileMgr, prev_pos);
     }
 
     handle->dhandle->setLogCallback(log_callback);
@@ -1251,6 +1853,11 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
     bid_t compactor_prev_bid, writer_prev_bid;
     bool locked = false;
 
+    size_t num_workers = handle->config.num_compaction_workers;
+    CompactionWorker *workers = NULL;
+    CompactionWorkerSync worker_sync;
+    std::mutex wal_lock;
+
 #ifdef _COW_COMPACTION
     if (clone_docs) {
         if (!FileMgr::isCowSupported(handle->file, fileMgr)) {
@@ -1262,6 +1869,16 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
     (void)clone_docs;
 #endif // _COW_COMPACTION
 
+    if ((handle->config.compaction_cb &&
+         handle->config.compaction_cb_mask & FDB_CS_MOVE_DOC) ||
+        !ver_non_consecutive_doc(fileMgr->getVersion()) ||
+        handle->config.compaction_cluster_docs) {
+        // The doc move callback is always invoked by the compactor thread,
+        // concurrent appends require non-consecutive doc blocks, and
+        // clustering requires all docs to be appended in a single sequence.
+        num_workers = 1;
+    }
+
     compactor_prev_bid = 0;
     writer_prev_bid = handle->file->getPos() /
                       handle->file->getConfig()->getBlockSize();
@@ -1329,6 +1946,41 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
         calloc(FDB_COMP_BATCHSIZE, sizeof(struct docio_object));
     c = count = n_moved_docs = old_offset = new_offset = 0;
 
+    if (num_workers > 1) {
+        // Each worker has its own doc handles, so that it reads the old file
+        // and appends docs into its own doc blocks of the new file.
+        workers = new CompactionWorker[num_workers];
+        for (i = 0; i < num_workers; ++i) {
+            workers[i].handle = handle;
+            workers[i].newFile = fileMgr;
+            workers[i].readHandle =
+                new DocioHandle(handle->file,
+                                handle->config.compress_document_body,
+                                &handle->log_callback);
+            workers[i].writeHandle =
+                new DocioHandle(fileMgr,
+                                handle->config.compress_document_body,
+                                &handle->log_callback);
+            workers[i].readHandle->setBlobMode_Docio(DOCIO_BLOB_MOVE_REF);
+            workers[i].writeHandle->setBlobMode_Docio(DOCIO_BLOB_MOVE_REF);
+            workers[i].docArraySize = FDB_COMP_BATCHSIZE / num_workers + 1;
+            workers[i].doc = (struct docio_object *)
+                calloc(workers[i].docArraySize, sizeof(struct docio_object));
+            workers[i].moveUnit = FDB_COMP_MOVE_UNIT / num_workers;
+            workers[i].walLock = &wal_lock;
+            workers[i].curTimestamp = cur_timestamp;
+            workers[i].numDocs = 0;
+            workers[i].sync = &worker_sync;
+        }
+        worker_sync.round = 0;
+        worker_sync.numRunning = 0;
+        worker_sync.terminate = false;
+        for (i = 0; i < num_workers; ++i) {
+            thread_create(&workers[i].tid, _fdb_compaction_worker_thread,
+                          &workers[i]);
+        }
+    }
+
     it = new HBTrieIterator();
     hr = it->init(handle->trie, NULL, 0);
 
@@ -1356,28 +2008,52 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
         // sort and move the documents in the array
         if (c >= offset_array_max ||
             (c > 0 && hr != HBTRIE_RESULT_SUCCESS)) {
-            // Sort offsets to minimize random accesses.
-            qsort(offset_array, c, sizeof(uint64_t), _fdb_cmp_uint64_t);
+            if (!handle->config.compaction_cluster_docs) {
+                // Sort offsets to minimize random accesses.
+                qsort(offset_array, c, sizeof(uint64_t), _fdb_cmp_uint64_t);
+            }
+            // Otherwise, read and append docs in the HB+trie key order.
+            // The reads are random on the first clustered compaction, but
+            // mostly sequential afterwards as the old file is then clustered
+            // except for the docs updated since the last compaction.
 
             // 1) read all documents in offset_array, and
             // 2) move them into the new file.
             // 3) flush WAL periodically
             i = 0;
             do {
-                // === read docs from the old file ===
                 size_t start_idx = i;
-                size_t num_batch_reads =
-                    handle->dhandle->batchReadDocs_Docio(&offset_array[start_idx],
+                size_t num_batch_reads = 0;
+                if (workers) {
+                    // === read and write docs by the worker threads ===
+                    size_t num_docs = std::min(c - start_idx,
+                                               (size_t)FDB_COMP_BATCHSIZE);
+                    fs = moveDocsParallel(workers, num_workers, &worker_sync,
+                                          &offset_array[start_idx], num_docs,
+                                          &n_moved_docs, &old_offset,
+                                          &new_offset);
+                    if (fs != FDB_RESULT_SUCCESS) {
+                        break;
+                    }
+                    i += num_docs;
+                } else {
+                    // === read docs from the old file ===
+                    num_batch_reads =
+                        handle->dhandle->batchReadDocs_Docio(
+                                          &offset_array[start_idx],
                                           doc, c - start_idx,
                                           FDB_COMP_MOVE_UNIT, FDB_COMP_BATCHSIZE,
                                           aio_handle_ptr, false);
-                if (num_batch_reads == (size_t) -1) {
-                    fs = FDB_RESULT_COMPACTION_FAIL;
-                    break;
+                    if (num_batch_reads == (size_t) -1) {
+                        fs = FDB_RESULT_COMPACTION_FAIL;
+                        break;
+                    }
+                    _fdb_compaction_throttle_io(doc, num_batch_reads);
+                    i += num_batch_reads;
                 }
-                i += num_batch_reads;
 
                 // === write docs into the new file ===
+                // (nothing to do here if the workers already moved them)
                 for (j=0; j<num_batch_reads; ++j) {
                     fdb_compact_decision decision;
                     if (!doc[j].key) {
@@ -1418,22 +2094,22 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
                         wal_doc.keylen += key_offset;
                     } else {
                         // compare timestamp
-                        if (!deleted ||
-                            (cur_timestamp < doc[j].timestamp +
-                             handle->config.purging_interval &&
-                             deleted)) {
-                            // re-write the document to new file when
-                            // 1. the document is not deleted
-                            // 2. the document is logically deleted but
-                            //    its timestamp isn't overdue
+                        if (_fdb_compaction_keep_doc(handle, &doc[j],
+                                                     cur_timestamp)) {
                             decision = FDB_CS_KEEP_DOC;
                         } else {
                             decision = FDB_CS_DROP_DOC;
                         }
                     }
                     if (decision == FDB_CS_KEEP_DOC) {
+                        _fdb_compaction_set_doc_codec(handle, docHandle,
+                                                      &doc[j]);
                         new_offset = docHandle->appendDoc_Docio(&doc[j],
                                                                 deleted, 0);
+                        if (new_offset == BLK_NOT_FOUND) {
+                            fs = FDB_RESULT_COMPACTION_FAIL;
+                            break;
+                        }
                         old_offset = offset_array[start_idx + j];
 
                         wal_doc.body = doc[j].body;
@@ -1451,6 +2127,16 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
                     free(doc[j].body);
                     doc[j].key = doc[j].meta = doc[j].body = NULL;
                 }
+                if (fs != FDB_RESULT_SUCCESS) {
+                    // free the docs that were not moved
+                    for (; j < num_batch_reads; ++j) {
+                        free(doc[j].key);
+                        free(doc[j].meta);
+                        free(doc[j].body);
+                        doc[j].key = doc[j].meta = doc[j].body = NULL;
+                    }
+                    break;
+                }
 
                 if (handle->config.compaction_cb &&
                     handle->config.compaction_cb_mask & FDB_CS_BATCH_MOVE) {
@@ -1484,6 +2170,7 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
                         locked = false;
                     }
                     union wal_flush_items flush_items;
+                    uint64_t prev_pos = fileMgr->getPos();
                     fileMgr->getWal()->flushByCompactor_Wal((void*)&new_handle,
                                                     WalFlushCallbacks::flushItem,
                                                     WalFlushCallbacks::getOldOffset,
@@ -1495,6 +2182,7 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
                     if (locked) {
                         handle->file->setThrottlingDelay(0);
                     }
+                    _fdb_compaction_throttle_index(fileMgr, prev_pos);
 
                     if (handle->config.compaction_cb &&
                         handle->config.compaction_cb_mask & FDB_CS_FLUSH_WAL) {
@@ -1543,6 +2231,24 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
     free(offset_array);
     free(doc);
 
+    if (workers) {
+        {
+            LockHolder lh(worker_sync.lock);
+            worker_sync.terminate = true;
+            worker_sync.lock.notify_all();
+        }
+        void *ret;
+        for (i = 0; i < num_workers; ++i) {
+            thread_join(workers[i].tid, &ret);
+        }
+        for (i = 0; i < num_workers; ++i) {
+            delete workers[i].readHandle;
+            delete workers[i].writeHandle;
+            free(workers[i].doc);
+        }
+        delete[] workers;
+    }
+
     if (aio_handle_ptr) {
         handle->file->getOps()->aio_destroy(handle->file->getFopsHandle(),
                                             aio_handle_ptr);
@@ -1586,10 +2292,17 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
     bid_t compactor_prev_bid, writer_prev_bid;
     struct _fdb_key_cmp_info cmp_info;
     bool locked = false;
+    bool non_consecutive = ver_non_consecutive_doc(handle->file->getVersion());
+    uint32_t doc_blocksize;
+    // Docs that continue in other blocks, which are moved without cloning.
+    std::vector<uint64_t> deferred;
 
     timestamp_t cur_timestamp;
     fdb_status fs = FDB_RESULT_SUCCESS;
     blocksize = handle->file->getConfig()->getBlockSize();
+    // Usable size of a doc block (i.e., excluding its block metadata).
+    doc_blocksize = blocksize - (non_consecutive ? DOCBLK_META_SIZE
+                                                 : BLK_MARKER_SIZE);
 
     compactor_prev_bid = 0;
     writer_prev_bid = handle->file->getPos() /
@@ -1643,7 +2356,10 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
 
     _doc = (struct docio_object *)
         calloc(FDB_COMP_BATCHSIZE, sizeof(struct docio_object));
-    offset_array_max = FDB_COMP_BATCHSIZE / sizeof(uint64_t);
+    // Only keys and metadata are read, so take as many docs as '_doc' can
+    // hold per batch: the larger the batch, the longer the runs of contiguous
+    // blocks that are cloned by a single copy_file_range call.
+    offset_array_max = FDB_COMP_BATCHSIZE;
     offset_array = (uint64_t*)malloc(sizeof(uint64_t) * offset_array_max);
 
     c = old_offset = new_offset = 0;
@@ -1653,7 +2369,7 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
 
     while( hr == HBTRIE_RESULT_SUCCESS ) {
 
-        it->nextValueOnly((void*)&offset);
+        hr = it->nextValueOnly((void*)&offset);
         if (ver_btreev2_format(handle->file->getVersion())) {
             handle->bnodeMgr->releaseCleanNodes();
         } else {
@@ -1752,10 +2468,43 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
                     }
                 }
 
+                uint64_t docsize = _fdb_get_docsize(doc.length);
+                uint64_t end_bid = _bid;
+                if (DOCIO_IS_BLOB(doc.length.flag) ||
+                    DOCIO_IS_DICT_COMPRESSED(doc.length.flag)) {
+                    // A cloned reference would be neither counted as live
+                    // in its blob file nor resolved if the blob file is
+                    // collected. A cloned dict-compressed body would still
+                    // refer to the dictionary doc in the old file. Move the
+                    // doc in the usual way instead.
+                    if (decision == FDB_CS_KEEP_DOC) {
+                        deferred.push_back(offset);
+                    }
+                    decision = FDB_CS_DROP_DOC;
+                } else if ((offset % blocksize) + docsize > doc_blocksize) {
+                    // The doc spans multiple blocks.
+                    if (non_consecutive) {
+                        // The following blocks are linked by 'next_bid' of
+                        // each block, which would still point to the old
+                        // file after cloning. Move the doc in the usual way
+                        // once the blocks of this batch are cloned.
+                        if (decision == FDB_CS_KEEP_DOC) {
+                            deferred.push_back(offset);
+                        }
+                        decision = FDB_CS_DROP_DOC;
+                    } else {
+                        end_bid += ((offset % blocksize) + docsize -
+                                    doc_blocksize + doc_blocksize - 1) /
+                                   doc_blocksize;
+                    }
+                }
+
                 if (decision == FDB_CS_KEEP_DOC) { // Clone doc to new file
                     if (_bid - contiguous_bid > 1) {
                         // Non-Contiguous copy range hit!
                         // Perform file range copy over existing blocks
+                        _fdb_compaction_throttle_copy(handle->file,
+                                                      1 + clone_len);
                         fs = FileMgr::copyFileRange(handle->file, fileMgr,
                                                     src_bid, dst_bid,
                                                     1 + clone_len);
@@ -1779,16 +2528,14 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
                                + (offset % blocksize);
 
                     // Adjust contiguous_bid & clone_len if doc spans 1+ blocks
-                    if (_offset / blocksize > offset / blocksize) {
-                        uint64_t more_blocks = _offset / blocksize
-                                             - offset / blocksize;
-                        contiguous_bid = _offset / blocksize;
-                        clone_len += more_blocks;
+                    if (end_bid > contiguous_bid) {
+                        clone_len += end_bid - contiguous_bid;
+                        contiguous_bid = end_bid;
                     }
 
                     old_offset = offset;
                     wal_doc.offset = new_offset;
-                    wal_doc.size_ondisk= _fdb_get_docsize(doc.length);
+                    wal_doc.size_ondisk = docsize;
 
                     fileMgr->getWal()->insert_Wal(fileMgr->getGlobalTxn(), &cmp_info,
                                                   &wal_doc, new_offset,
@@ -1810,11 +2557,54 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
             } // repeat until no more offset in the offset_array
 
             // copy out the last set of contiguous blocks
+            _fdb_compaction_throttle_copy(handle->file, 1 + clone_len);
             fs = FileMgr::copyFileRange(handle->file, fileMgr, src_bid,
                                         dst_bid, 1 + clone_len);
             if (fs != FDB_RESULT_SUCCESS) {
                 break;
             }
+
+            // move the docs spanning non-consecutive blocks
+            for (i = 0; i < deferred.size(); ++i) {
+                doc.key = doc.meta = doc.body = NULL;
+                _offset = handle->dhandle->readDoc_Docio(deferred[i], &doc,
+                                                         true);
+                if ((int64_t)_offset <= 0) {
+                    fs = FDB_RESULT_COMPACTION_FAIL;
+                    break;
+                }
+                deleted = doc.length.flag & DOCIO_DELETED;
+                _fdb_compaction_set_doc_codec(handle, docHandle, &doc);
+                new_offset = docHandle->appendDoc_Docio(&doc, deleted, 0);
+                if (new_offset == BLK_NOT_FOUND) {
+                    free(doc.key);
+                    free(doc.meta);
+                    free(doc.body);
+                    fs = FDB_RESULT_COMPACTION_FAIL;
+                    break;
+                }
+                old_offset = deferred[i];
+
+                wal_doc.keylen = doc.length.keylen;
+                wal_doc.metalen = doc.length.metalen;
+                wal_doc.bodylen = doc.length.bodylen;
+                wal_doc.key = doc.key;
+                wal_doc.seqnum = doc.seqnum;
+                wal_doc.deleted = deleted;
+                wal_doc.offset = new_offset;
+                wal_doc.size_ondisk = _fdb_get_docsize(doc.length);
+                fileMgr->getWal()->insert_Wal(fileMgr->getGlobalTxn(),
+                                              &cmp_info, &wal_doc, new_offset,
+                                              WAL_INS_COMPACT_PHASE1);
+                ++n_moved_docs;
+                free(doc.key);
+                free(doc.meta);
+                free(doc.body);
+            }
+            deferred.clear();
+            if (fs != FDB_RESULT_SUCCESS) {
+                break;
+            }
             // === flush WAL entries by compactor ===
             if (fileMgr->getWal()->getNumFlushable_Wal() > 0) {
                 uint64_t delay_us = calculateWriteThrottlingDelay(n_moved_docs, tv);
@@ -1832,6 +2622,7 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
                     locked = false;
                 }
                 union wal_flush_items flush_items;
+                uint64_t prev_pos = fileMgr->getPos();
                 fileMgr->getWal()->flushByCompactor_Wal((void*)&new_handle,
                                        WalFlushCallbacks::flushItem,
                                        WalFlushCallbacks::getOldOffset,
@@ -1843,6 +2634,7 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
                 if (locked) {
                     handle->file->setThrottlingDelay(0);
                 }
+                _fdb_compaction_throttle_index(fileMgr, prev_pos);
 
                 if (handle->config.compaction_cb &&
                     handle->config.compaction_cb_mask & FDB_CS_FLUSH_WAL) {
@@ -2362,7 +3154,15 @@ void Compaction::appendBatchedDelta(FdbKvsHandle *handle,
         // invoked if the blocks of the old-file have not been synced to disk
         bool flushed_blocks = (!got_lock || // blocks before committed DB header
                 !handle->file->getConfig()->getNcacheBlock()); // buffer cache is disabled
-        if (flushed_blocks &&
+        // References to blob bodies should be moved through the doc handles
+        bool has_blobs = !handle->file->getBlobFiles()->empty();
+        // Dict-compressed bodies refer to the dictionary doc in the old file,
+        // so they should be recompressed through the doc handles
+        bool has_dicts = false;
+        for (i = 0; i < n_buf && !has_dicts; ++i) {
+            has_dicts = DOCIO_IS_DICT_COMPRESSED(doc[i].length.flag);
+        }
+        if (flushed_blocks && !has_blobs && !has_dicts &&
             FileMgr::isCowSupported(handle->file, new_handle->file)) {
             cloneBatchedDelta(handle, new_handle, doc,
                               old_offset_array, n_buf, got_lock, prob, delay_us);
@@ -2374,9 +3174,28 @@ void Compaction::appendBatchedDelta(FdbKvsHandle *handle,
     cmp_info.kvs_config = handle->kvs_config;
     cmp_info.kvs = handle->kvs;
 
+    if (!got_lock) {
+        // The last batch of delta, which is moved while holding the file
+        // lock, is never throttled not to block the normal writers.
+        _fdb_compaction_throttle_io(doc, n_buf);
+    }
+
+    // Append the batch in key order if docs are clustered. The sort is stable
+    // so that multiple versions of the same key are still inserted into the
+    // WAL in their original order.
+    std::vector<size_t> order(n_buf);
+    for (i = 0; i < n_buf; ++i) {
+        order[i] = i;
+    }
+    if (handle->config.compaction_cluster_docs) {
+        struct _fdb_compaction_doc_key_less key_less = {doc, &cmp_info};
+        std::stable_sort(order.begin(), order.end(), key_less);
+    }
+
     gettimeofday(&tv, NULL);
     cur_timestamp  = tv.tv_sec;
-    for (i = 0; i < n_buf; ++i) {
+    for (uint64_t k = 0; k < n_buf; ++k) {
+        i = order[k];
         bool deleted = doc[i].length.flag & DOCIO_DELETED;
         fdb_compact_decision decision;
         fdb_doc wal_doc;
@@ -2421,6 +3240,7 @@ void Compaction::appendBatchedDelta(FdbKvsHandle *handle,
         }
         if (decision == FDB_CS_KEEP_DOC) {
             // append into the new file
+            _fdb_compaction_set_doc_codec(handle, new_handle->dhandle, &doc[i]);
             doc_offset = new_handle->dhandle->appendDoc_Docio(&doc[i],
                                         doc[i].length.flag & DOCIO_DELETED, 0);
         } else {
@@ -2453,6 +3273,7 @@ void Compaction::appendBatchedDelta(FdbKvsHandle *handle,
 
     // WAL flush
     union wal_flush_items flush_items;
+    uint64_t prev_pos = new_handle->file->getPos();
     new_handle->file->getWal()->commit_Wal(new_handle->file->getGlobalTxn(), NULL,
                                            &handle->log_callback);
     new_handle->file->getWal()->flush_Wal((void*)new_handle,
@@ -2467,13 +3288,16 @@ void Compaction::appendBatchedDelta(FdbKvsHandle *handle,
     if (locked) {
         handle->file->setThrottlingDelay(0);
     }
+    if (!got_lock) {
+        _fdb_compaction_throttle_index(new_handle->file, prev_pos);
+    }
 
     if (handle->config.compaction_cb &&
         handle->config.compaction_cb_mask & FDB_CS_FLUSH_WAL) {
         auto curApi = handle->suspendBusy();
         handle->config.compaction_cb(
             handle->fhandle, FDB_CS_FLUSH_WAL, NULL, NULL,
-            old_offset_array[i-1], doc_offset,
+            old_offset_array[i], doc_offset,
             handle->config.compaction_cb_ctx);
         handle->resumeBusy(curApi);
     }
@@ -2523,6 +3347,9 @@ void Compaction::cloneBatchedDelta(FdbKvsHandle *handle,
             // Non-Contiguous copy range hit!
             // Perform file range copy over existing blocks
             // IF AND ONLY IF block is evicted to disk!.....
+            if (!got_lock) {
+                _fdb_compaction_throttle_copy(file, 1 + clone_len);
+            }
             fs = FileMgr::copyFileRange(file, new_file, src_bid, dst_bid,
                                         1 + clone_len);
             if (fs != FDB_RESULT_SUCCESS) {
@@ -2592,6 +3419,9 @@ void Compaction::cloneBatchedDelta(FdbKvsHandle *handle,
     }
 
     // copy out the last set of contiguous blocks
+    if (!got_lock) {
+        _fdb_compaction_throttle_copy(file, 1 + clone_len);
+    }
     FileMgr::copyFileRange(file, new_file, src_bid, dst_bid, 1 + clone_len);
     new_handle->dhandle->reset_Docio();
 
@@ -2611,6 +3441,7 @@ void Compaction::cloneBatchedDelta(FdbKvsHandle *handle,
 
     // WAL flush
     union wal_flush_items flush_items;
+    uint64_t prev_pos = new_handle->file->getPos();
     new_handle->file->getWal()->commit_Wal(new_handle->file->getGlobalTxn(),
                                            NULL, &handle->log_callback);
     new_handle->file->getWal()->flush_Wal((void*)new_handle,
@@ -2625,6 +3456,9 @@ void Compaction::cloneBatchedDelta(FdbKvsHandle *handle,
     if (locked) {
         handle->file->setThrottlingDelay(0);
     }
+    if (!got_lock) {
+        _fdb_compaction_throttle_index(new_handle->file, prev_pos);
+    }
 
     if (handle->config.compaction_cb &&
         handle->config.compaction_cb_mask & FDB_CS_FLUSH_WAL) {
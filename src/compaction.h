@@ -33,6 +33,8 @@ class DocioHandle;
 class HBTrie;
 class BTree;
 class BtreeV2;
+struct CompactionWorker;
+struct CompactionWorkerSync;
 
 /**
  * Abstraction that defines all operations related to compaction
@@ -65,6 +67,22 @@ public:
                                   bool clone_docs,
                                   const fdb_encryption_key *new_encryption_key);
 
+    /**
+     * Compact a given file in place by relocating the live documents of its
+     * most fragmented blocks (i.e., blocks that are partially stale) to the
+     * current end of the file, so that those blocks become entirely stale and
+     * are returned to the pool of reusable blocks by the next block reclaim.
+     *
+     * @param fhandle Pointer to the file handle whose file is compacted
+     * @param min_stale_ratio Minimum percentage of stale data in a block for
+     *        the block to be relocated
+     * @param max_blocks Maximum number of blocks to be relocated
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    static fdb_status compactFragmentedRegions(FdbFileHandle *fhandle,
+                                               uint8_t min_stale_ratio,
+                                               size_t max_blocks);
+
 private:
 
     /**
@@ -170,6 +188,33 @@ private:
                            bid_t start_bid,
                            bid_t stop_bid);
 
+    /**
+     * Move the given documents from the current file to the new file by
+     * using multiple worker threads, each of which reads a contiguous range
+     * of the offsets and appends the documents into its own doc blocks.
+     * The worker threads are started once per compaction, and this runs a
+     * single round of them.
+     *
+     * @param workers Array of worker contexts
+     * @param num_workers Number of workers
+     * @param sync State shared with the worker threads
+     * @param offset_array Pointer to the array containing the sorted offsets
+     *        of documents to be moved
+     * @param num_docs Number of documents to be moved
+     * @param n_moved_docs Number of moved documents to be increased
+     * @param old_offset Offset of the last moved document in the current file
+     * @param new_offset Offset of the last moved document in the new file
+     * @return FDB_RESULT_SUCCESS on a successful move operation
+     */
+    fdb_status moveDocsParallel(CompactionWorker *workers,
+                                size_t num_workers,
+                                CompactionWorkerSync *sync,
+                                uint64_t *offset_array,
+                                size_t num_docs,
+                                uint64_t *n_moved_docs,
+                                uint64_t *old_offset,
+                                uint64_t *new_offset);
+
 #ifdef _COW_COMPACTION
     /**
      * Copy all the active blocks belonging to the last commit marker from
@@ -19,6 +19,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <math.h>
+
+#include <set>
 
 #if defined(WIN32) || defined(_WIN32)
 #ifdef _MSC_VER
@@ -65,6 +68,11 @@
 #define COMPACTOR_META_VERSION (1)
 #define MAX_FNAMELEN (FDB_MAX_FILENAME_LEN)
 
+// Time since the last compaction (in seconds) that doubles the priority of a
+// file. The age bonus is capped at COMPACTOR_MAX_AGE_WEIGHT.
+#define COMPACTOR_AGE_UNIT (86400)
+#define COMPACTOR_MAX_AGE_WEIGHT (4.0)
+
 std::atomic<CompactionManager *> CompactionManager::instance(nullptr);
 std::mutex CompactionManager::instanceMutex;
 
@@ -177,7 +185,12 @@ public:
         removalActivated = removal_activated;
     }
 
-    bool isCompactionThresholdSatisfied();
+    /**
+     * Return the priority of compacting this file relative to the other
+     * registered files, or zero if the file doesn't satisfy the compaction
+     * threshold (or is being compacted).
+     */
+    double getCompactionScore();
 
 private:
     uint64_t estimateActiveSpace();
@@ -209,7 +222,7 @@ uint64_t FileCompactionEntry::estimateActiveSpace() {
     return ret;
 }
 
-bool FileCompactionEntry::isCompactionThresholdSatisfied() {
+double FileCompactionEntry::getCompactionScore() {
     uint64_t filesize;
     uint64_t active_data;
     int threshold;
@@ -217,7 +230,7 @@ bool FileCompactionEntry::isCompactionThresholdSatisfied() {
     if (compactionFlag || file->isRollbackOn()) {
         // do not perform compaction if the file is already being compacted or
         // in rollback.
-        return false;
+        return 0;
     }
 
     struct timeval curr_time, gap;
@@ -225,23 +238,43 @@ bool FileCompactionEntry::isCompactionThresholdSatisfied() {
     gap = _utime_gap(lastCompactionTimestamp, curr_time);
     uint64_t elapsed_us = (uint64_t)gap.tv_sec * 1000000 + gap.tv_usec;
     if (elapsed_us < (interval * 1000000)) {
-        return false;
+        return 0;
     }
 
     threshold = config.compaction_threshold;
-    if (config.compaction_mode == FDB_COMPACTION_AUTO &&
-        threshold > 0) {
-        filesize = file->getPos();
-        active_data = estimateActiveSpace();
-        if (active_data == 0 || active_data >= filesize ||
-            filesize < config.compaction_minimum_filesize) {
-            return false;
-        }
+    if (config.compaction_mode != FDB_COMPACTION_AUTO || threshold <= 0) {
+        return 0;
+    }
 
-        return ((filesize / 100.0 * threshold) < (filesize - active_data));
-    } else {
-        return false;
+    filesize = file->getPos();
+    active_data = estimateActiveSpace();
+    if (active_data == 0 || active_data >= filesize ||
+        filesize < config.compaction_minimum_filesize) {
+        return 0;
     }
+    if ((filesize / 100.0 * threshold) >= (filesize - active_data)) {
+        return 0;
+    }
+
+    // Reclaimable bytes per byte of compaction I/O: compaction reads and
+    // writes (roughly) the active data only.
+    double yield = (double)(filesize - active_data) /
+                   (double)(active_data + config.blocksize);
+    // Read amplification: live data is spread over 'filesize / active_data'
+    // bytes, which only costs something if the file is actually read from
+    // disk, so weigh it by the number of block cache misses since the file
+    // was created (i.e., since its last compaction).
+    double read_amp = (double)filesize / active_data;
+    double read_weight = 1.0 + (read_amp - 1.0) *
+                         log2(1.0 + file->fetchBlockCacheMisses()) / 16.0;
+    // Files that have not been compacted for a long time get a bonus, so
+    // that a steady stream of small gains elsewhere doesn't starve them.
+    double age_weight = 1.0 + (double)gap.tv_sec / COMPACTOR_AGE_UNIT;
+    if (age_weight > COMPACTOR_MAX_AGE_WEIGHT) {
+        age_weight = COMPACTOR_MAX_AGE_WEIGHT;
+    }
+
+    return yield * read_weight * age_weight;
 }
 
 class CompactorThread {
@@ -291,8 +324,17 @@ void CompactorThread::run() {
         manager->syncMutex.wait_for(lh, static_cast<double>(manager->sleepDuration));
     }
 
+    // Virtual names of the files compacted by this thread since it woke up.
+    // Each file is compacted at most once per wake-up, as before.
+    std::set<std::string> compacted;
     while (true) {
         manager->cptLock.lock();
+        // Rank all the files that satisfy the compaction threshold, and pick
+        // the one that yields the most. Each compactor thread compacts one
+        // file at a time, so that at most 'numThreads' files are compacted
+        // concurrently, in the order of their scores.
+        std::string best_file_name;
+        double best_score = 0;
         auto entry = manager->openFiles.begin();
         while (entry != manager->openFiles.end()) {
             FileCompactionEntry *file_entry = entry->second;
@@ -303,59 +345,19 @@ void CompactorThread::run() {
                 continue;
             }
 
-            if (file_entry->isCompactionThresholdSatisfied()) {
-                file_entry->setDaemonCompactRunning(true);
-                // set compaction flag
-                file_entry->setCompactionFlag(true);
-                // Copy the file name and config as they are accessed after
-                // releasing the lock.
-                std::string file_name = file_entry->getFileName();
-                fdb_config fconfig = file_entry->getFdbConfig();
-                manager->cptLock.unlock();
-
-                std::string vfilename = manager->getVirtualFileName(file_name);
-                // Get the list of custom compare functions.
-                struct list cmp_func_list;
-                list_init(&cmp_func_list);
-                fdb_cmp_func_list_from_filemgr(file, &cmp_func_list);
-                fs = fdb_open_for_compactor(&fhandle, vfilename.c_str(),
-                                            &fconfig,
-                                            &cmp_func_list);
-                fdb_free_cmp_func_list(&cmp_func_list);
-
-                if (fs == FDB_RESULT_SUCCESS) {
-                    std::string new_filename = manager->getNextFileName(file_name);
-                    Compaction::compactFile(fhandle, new_filename.c_str(), false,
-                                            (bid_t) -1, false, NULL);
-                    fdb_close(fhandle);
-
-                    manager->cptLock.lock();
-                    // Search the next file for compaction.
-                    entry = manager->openFiles.upper_bound(new_filename);
-                } else {
-                    // As a workaround for MB-17009, call fprintf instead of fdb_log
-                    // until c->cgo->go callback trace issue is resolved.
-                    fprintf(stderr,
-                            "Error status code: %d, Failed to open the file "
-                            "'%s' for auto daemon compaction.\n",
-                            fs, vfilename.c_str());
-                    // fail to open file
-                    manager->cptLock.lock();
-                    // As cptLock was released and grabbed again in the above,
-                    // the iterator entry should be refreshed again in case other
-                    // threads modified the map structure between them.
-                    entry = manager->openFiles.find(file_name);
-                    if (entry != manager->openFiles.end()) {
-                        file_entry = entry->second;
-                        file_entry->setDaemonCompactRunning(false);
-                        // clear compaction flag
-                        file_entry->setCompactionFlag(false);
-                    }
-                    // Get the next file for compaction.
-                    entry = manager->openFiles.upper_bound(file_name);
+            double score = file_entry->getCompactionScore();
+            if (score > 0) {
+                if (score > best_score &&
+                    !compacted.count(manager->getVirtualFileName(
+                                                file_entry->getFileName()))) {
+                    best_score = score;
+                    best_file_name = file_entry->getFileName();
                 }
+                ++entry;
+                continue;
+            }
 
-            } else if (manager->checkFileRemoval(file_entry)) {
+            if (manager->checkFileRemoval(file_entry)) {
                 // remove file
                 int ret;
 
@@ -417,7 +419,67 @@ void CompactorThread::run() {
                 return;
             }
         }
+
+        // The best file might have been removed or taken by another thread
+        // while cptLock was released in the above.
+        entry = manager->openFiles.find(best_file_name);
+        if (best_score > 0 && entry != manager->openFiles.end() &&
+            entry->second->getFileManager() &&
+            entry->second->getCompactionScore() > 0) {
+            FileCompactionEntry *file_entry = entry->second;
+            FileMgr *file = file_entry->getFileManager();
+            file_entry->setDaemonCompactRunning(true);
+            // set compaction flag
+            file_entry->setCompactionFlag(true);
+            // Copy the config as it is accessed after releasing the lock.
+            fdb_config fconfig = file_entry->getFdbConfig();
+            manager->cptLock.unlock();
+
+            std::string vfilename = manager->getVirtualFileName(best_file_name);
+            compacted.insert(vfilename);
+            // Get the list of custom compare functions.
+            struct list cmp_func_list;
+            list_init(&cmp_func_list);
+            fdb_cmp_func_list_from_filemgr(file, &cmp_func_list);
+            fs = fdb_open_for_compactor(&fhandle, vfilename.c_str(),
+                                        &fconfig,
+                                        &cmp_func_list);
+            fdb_free_cmp_func_list(&cmp_func_list);
+
+            if (fs == FDB_RESULT_SUCCESS) {
+                std::string new_filename = manager->getNextFileName(best_file_name);
+                Compaction::compactFile(fhandle, new_filename.c_str(), false,
+                                        (bid_t) -1, false, NULL);
+                fdb_close(fhandle);
+                if (manager->terminateSignal) {
+                    return;
+                }
+                // Rank the files again right away, as other files may
+                // still be waiting for compaction.
+                continue;
+            }
+
+            // As a workaround for MB-17009, call fprintf instead of fdb_log
+            // until c->cgo->go callback trace issue is resolved.
+            fprintf(stderr,
+                    "Error status code: %d, Failed to open the file "
+                    "'%s' for auto daemon compaction.\n",
+                    fs, vfilename.c_str());
+            // fail to open file
+            manager->cptLock.lock();
+            // As cptLock was released and grabbed again in the above,
+            // the entry should be searched again in case other threads
+            // modified the map structure between them.
+            entry = manager->openFiles.find(best_file_name);
+            if (entry != manager->openFiles.end()) {
+                file_entry = entry->second;
+                file_entry->setDaemonCompactRunning(false);
+                // clear compaction flag
+                file_entry->setCompactionFlag(false);
+            }
+        }
         manager->cptLock.unlock();
+        compacted.clear();
 
         {
             UniqueLock lh(manager->syncMutex);
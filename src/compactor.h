@@ -42,7 +42,10 @@ typedef std::map<std::string, FileCompactionEntry *> compaction_file_map;
 
 /**
  * Compaction manager that monitors the fragmentation degree of each registered
- * file and performs the compaction through the daemon threads.
+ * file and performs the compaction through the daemon threads. Among the files
+ * that exceed their compaction threshold, the ones with the most reclaimable
+ * space per byte of compaction I/O (weighted by their read amplification and
+ * the time since their last compaction) are compacted first.
  */
 class CompactionManager {
 
@@ -22,6 +22,7 @@
 #include "fdb_internal.h"
 
 #include "configuration.h"
+#include "bloomfilter.h"
 #include "system_resource_stats.h"
 
 static ssize_t prime_size_table[] = {
@@ -116,6 +117,37 @@ fdb_config get_default_config(void) {
     // Flush limit in bytes for non-block aligned buffer cache
     fconfig.bcache_flush_limit = 1048576;
 
+    // Key filters for negative lookups are disabled by default
+    fconfig.bloom_filter_bits_per_key = 0;
+
+    // Documents are moved by the compactor thread only by default
+    fconfig.num_compaction_workers = 1;
+
+    // Background writes are not rate limited by default
+    fconfig.background_io_rate_limit = 0;
+    fconfig.background_io_latency_target = 0;
+
+    // Compaction does not reorder documents by key by default
+    fconfig.compaction_cluster_docs = false;
+
+    // Index nodes are not separated from documents by default
+    fconfig.index_region_blocks = 0;
+
+    // Stale block info is decoded at the time of block reclaim by default
+    fconfig.background_stale_merge = false;
+
+    // Compress document bodies using snappy if compression is enabled
+    fconfig.compression_codec = FDB_COMPRESSION_SNAPPY;
+
+    // Document bodies are not separated into blob files by default
+    fconfig.blob_threshold = 0;
+    fconfig.blob_gc_stale_ratio = 50;
+    // Document bodies are stored next to their keys and metadata by default
+    fconfig.separate_doc_bodies = false;
+
+    // Documents are appended while holding the writer lock by default
+    fconfig.pipelined_doc_append = false;
+
     return fconfig;
 }
 
@@ -126,6 +158,8 @@ fdb_kvs_config get_default_kvs_config(void) {
     kvs_config.create_if_missing = true;
     // lexicographical key order by default
     kvs_config.custom_cmp = NULL;
+    // follow the compression codec of the file
+    kvs_config.compression_codec = FDB_COMPRESSION_DEFAULT;
 
     return kvs_config;
 }
@@ -251,6 +285,28 @@ bool validate_fdb_config(fdb_config *fconfig) {
         // num_keeping_headers should be greater than zero
         return false;
     }
+    if (fconfig->bloom_filter_bits_per_key > KEY_FILTER_MAX_BITS_PER_KEY) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Bloom filter bits per key (%u) greater than "
+                "allowed value (%d)!\n",
+                fconfig->bloom_filter_bits_per_key, KEY_FILTER_MAX_BITS_PER_KEY);
+        return false;
+    }
+    if (fconfig->index_region_blocks > FILEMGR_MAX_INDEX_REGION_BLOCKS) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Index region blocks (%u) greater than "
+                "allowed value (%d)!\n",
+                fconfig->index_region_blocks, FILEMGR_MAX_INDEX_REGION_BLOCKS);
+        return false;
+    }
+    if (fconfig->num_compaction_workers > FDB_COMP_MAX_WORKERS) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Num compaction workers (%" _F64 ") greater than "
+                "allowed value (%d)!\n",
+                static_cast<uint64_t>(fconfig->num_compaction_workers),
+                FDB_COMP_MAX_WORKERS);
+        return false;
+    }
     if (fconfig->num_background_threads > FDB_EXPOOL_MAX_THREADS) {
         fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
                 "Config Error: Num background threads (%" _F64 ") greater than "
@@ -258,11 +314,57 @@ bool validate_fdb_config(fdb_config *fconfig) {
                 (uint64_t)fconfig->num_background_threads, FDB_EXPOOL_MAX_THREADS);
         return false;
     }
+    if (fconfig->compression_codec > FDB_COMPRESSION_ZSTD) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Invalid compression codec (%d)!\n",
+                fconfig->compression_codec);
+        return false;
+    }
+    if (fconfig->blob_gc_stale_ratio > 100) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Blob GC stale ratio (%d) greater than 100!\n",
+                fconfig->blob_gc_stale_ratio);
+        return false;
+    }
+    if ((fconfig->blob_threshold || fconfig->separate_doc_bodies) &&
+        !fconfig->multi_kv_instances) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Blob files require multi KV instances!\n");
+        return false;
+    }
+    if (fconfig->separate_doc_bodies) {
+        // The options that separate_doc_bodies would silently override or
+        // be ignored by are rejected instead.
+        if (fconfig->blob_threshold) {
+            fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                    "Config Error: Separate doc bodies cannot be combined "
+                    "with blob threshold (%u)!\n", fconfig->blob_threshold);
+            return false;
+        }
+        if (fconfig->compress_document_body) {
+            fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                    "Config Error: Separate doc bodies cannot be combined "
+                    "with document body compression!\n");
+            return false;
+        }
+        if (fconfig->encryption_key.algorithm != FDB_ENCRYPTION_NONE) {
+            fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                    "Config Error: Separate doc bodies cannot be combined "
+                    "with encryption!\n");
+            return false;
+        }
+    }
 
     return true;
 }
 
 bool validate_fdb_kvs_config(fdb_kvs_config *kvs_config) {
+    if (kvs_config->compression_codec > FDB_COMPRESSION_ZSTD) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Invalid compression codec (%d) of KV store!\n",
+                kvs_config->compression_codec);
+        return false;
+    }
     return true;
 }
 
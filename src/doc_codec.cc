@@ -0,0 +1,98 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "doc_codec.h"
+
+#ifdef _DOC_COMP
+#include "snappy-c.h"
+
+static size_t snappy_max_len(size_t len)
+{
+    return snappy_max_compressed_length(len);
+}
+
+static fdb_status snappy_comp(void **ctx,
+                              const doc_codec_dict *dict,
+                              const void *src,
+                              size_t len,
+                              void *dst,
+                              size_t *dst_len)
+{
+    if (snappy_compress((const char*)src, len, (char*)dst, dst_len) != SNAPPY_OK) {
+        return FDB_RESULT_COMPRESSION_FAIL;
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
+static fdb_status snappy_uncomp(void **ctx,
+                                const doc_codec_dict *dict,
+                                const void *src,
+                                size_t len,
+                                void *dst,
+                                size_t *dst_len)
+{
+    if (snappy_uncompress((const char*)src, len, (char*)dst, dst_len) != SNAPPY_OK) {
+        return FDB_RESULT_COMPRESSION_FAIL;
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
+static void snappy_free_ctx(void *ctx)
+{
+}
+
+static doc_codec_ops snappy_ops = {
+    snappy_max_len,
+    snappy_comp,
+    snappy_uncomp,
+    snappy_free_ctx
+};
+
+const doc_codec_ops* const fdb_doc_codec_ops_snappy = &snappy_ops;
+
+#else // snappy not available:
+
+const doc_codec_ops* const fdb_doc_codec_ops_snappy = NULL;
+
+#endif // _DOC_COMP
+
+const doc_codec_ops* get_doc_codec_ops(doc_codec_id_t codec)
+{
+    switch (codec) {
+        case DOC_CODEC_SNAPPY:
+            return fdb_doc_codec_ops_snappy;
+        case DOC_CODEC_LZ4:
+            return fdb_doc_codec_ops_lz4;
+        case DOC_CODEC_ZSTD:
+        case DOC_CODEC_ZSTD_DICT:
+            return fdb_doc_codec_ops_zstd;
+        default:
+            return NULL;
+    }
+}
+
+doc_codec_id_t doc_codec_from_config(fdb_compression_codec_t codec)
+{
+    switch (codec) {
+        case FDB_COMPRESSION_LZ4:
+            return DOC_CODEC_LZ4;
+        case FDB_COMPRESSION_ZSTD:
+            return DOC_CODEC_ZSTD;
+        default:
+            return DOC_CODEC_SNAPPY;
+    }
+}
@@ -0,0 +1,100 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _FDB_DOC_CODEC_H
+#define _FDB_DOC_CODEC_H
+
+#include "libforestdb/fdb_types.h"
+#include "libforestdb/fdb_errors.h"
+#include "common.h"
+
+/**
+ * Codecs for document bodies. The ID is recorded in the flag bits of each
+ * compressed document (see DOCIO_CODEC_MASK), so that documents compressed
+ * by different codecs can be mixed in a file. Snappy is zero, as documents
+ * written before the codec ID was introduced are all compressed by snappy.
+ */
+typedef uint8_t doc_codec_id_t;
+enum {
+    DOC_CODEC_SNAPPY = 0,
+    DOC_CODEC_LZ4 = 1,
+    DOC_CODEC_ZSTD = 2,
+    // zstd with a dictionary. The compressed body is prefixed with the file
+    // offset of the system doc that holds the dictionary.
+    DOC_CODEC_ZSTD_DICT = 3,
+    NUM_DOC_CODECS = 4
+};
+
+// Key of the system docs holding compression dictionaries.
+#define DOC_CODEC_DICT_KEY "compression_dict"
+
+// Documents sampled for training a dictionary are limited to this many times
+// the dictionary size.
+#define DOC_CODEC_DICT_SAMPLE_RATIO (100)
+
+// Compression dictionary, created from the raw dictionary data.
+typedef struct doc_codec_dict doc_codec_dict;
+
+// Callbacks provided by a codec implementation. Each caller keeps its own
+// context ('ctx', initially NULL) that the codec may allocate on first use,
+// so the callbacks are thread-safe as long as contexts are not shared.
+typedef struct doc_codec_ops {
+    size_t (*max_compressed_len)(size_t len);
+    fdb_status (*compress)(void **ctx,
+                           const doc_codec_dict *dict,
+                           const void *src,
+                           size_t len,
+                           void *dst,
+                           size_t *dst_len);
+    fdb_status (*uncompress)(void **ctx,
+                             const doc_codec_dict *dict,
+                             const void *src,
+                             size_t len,
+                             void *dst,
+                             size_t *dst_len);
+    void (*free_ctx)(void *ctx);
+} doc_codec_ops;
+
+// Provides the doc_codec_ops (callbacks) for a particular codec.
+// Returns NULL if the codec is not built in.
+const doc_codec_ops* get_doc_codec_ops(doc_codec_id_t codec);
+
+// Converts the codec given by the user config to the codec ID.
+doc_codec_id_t doc_codec_from_config(fdb_compression_codec_t codec);
+
+// Trains a dictionary from the given samples, which are concatenated in
+// 'samples'. Returns the size of the dictionary written into 'dict_buf', or
+// zero if the samples are not sufficient or dictionaries are not supported.
+size_t doc_codec_train_dict(void *dict_buf,
+                            size_t dict_buf_size,
+                            const void *samples,
+                            const size_t *sample_lens,
+                            unsigned num_samples);
+
+// Creates a dictionary from the data returned by doc_codec_train_dict().
+// Returns NULL if the data is not a valid dictionary.
+doc_codec_dict* doc_codec_dict_create(const void *buf, size_t len);
+
+void doc_codec_dict_free(doc_codec_dict *dict);
+
+// Declarations of doc_codec_ops for specific codecs.
+// Will be NULL if the codec library is not linked.
+extern const doc_codec_ops* const fdb_doc_codec_ops_snappy;
+extern const doc_codec_ops* const fdb_doc_codec_ops_lz4;
+extern const doc_codec_ops* const fdb_doc_codec_ops_zstd;
+
+#endif /* _FDB_DOC_CODEC_H */
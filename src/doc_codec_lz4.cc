@@ -0,0 +1,77 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "doc_codec.h"
+
+#ifdef _DOC_COMP_LZ4
+#include <lz4.h>
+
+static size_t lz4_max_len(size_t len)
+{
+    return LZ4_compressBound((int)len);
+}
+
+static fdb_status lz4_comp(void **ctx,
+                           const doc_codec_dict *dict,
+                           const void *src,
+                           size_t len,
+                           void *dst,
+                           size_t *dst_len)
+{
+    int ret = LZ4_compress_default((const char*)src, (char*)dst,
+                                   (int)len, (int)*dst_len);
+    if (ret <= 0) {
+        return FDB_RESULT_COMPRESSION_FAIL;
+    }
+    *dst_len = ret;
+    return FDB_RESULT_SUCCESS;
+}
+
+static fdb_status lz4_uncomp(void **ctx,
+                             const doc_codec_dict *dict,
+                             const void *src,
+                             size_t len,
+                             void *dst,
+                             size_t *dst_len)
+{
+    int ret = LZ4_decompress_safe((const char*)src, (char*)dst,
+                                  (int)len, (int)*dst_len);
+    if (ret < 0) {
+        return FDB_RESULT_COMPRESSION_FAIL;
+    }
+    *dst_len = ret;
+    return FDB_RESULT_SUCCESS;
+}
+
+static void lz4_free_ctx(void *ctx)
+{
+}
+
+static doc_codec_ops lz4_ops = {
+    lz4_max_len,
+    lz4_comp,
+    lz4_uncomp,
+    lz4_free_ctx
+};
+
+const doc_codec_ops* const fdb_doc_codec_ops_lz4 = &lz4_ops;
+
+#else // LZ4 not available:
+
+const doc_codec_ops* const fdb_doc_codec_ops_lz4 = NULL;
+
+#endif // _DOC_COMP_LZ4
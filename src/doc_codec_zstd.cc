@@ -0,0 +1,190 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "doc_codec.h"
+
+#ifdef _DOC_COMP_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+
+#include "memleak.h"
+
+// Compression level of zstd (same as the library default).
+#define DOC_CODEC_ZSTD_LEVEL (3)
+
+struct doc_codec_dict {
+    ZSTD_CDict *cdict;
+    ZSTD_DDict *ddict;
+};
+
+struct zstd_ctx {
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+};
+
+static struct zstd_ctx *zstd_get_ctx(void **ctx)
+{
+    if (!*ctx) {
+        *ctx = calloc(1, sizeof(struct zstd_ctx));
+    }
+    return (struct zstd_ctx *)*ctx;
+}
+
+static size_t zstd_max_len(size_t len)
+{
+    return ZSTD_compressBound(len);
+}
+
+static fdb_status zstd_comp(void **ctx,
+                            const doc_codec_dict *dict,
+                            const void *src,
+                            size_t len,
+                            void *dst,
+                            size_t *dst_len)
+{
+    struct zstd_ctx *zctx = zstd_get_ctx(ctx);
+    if (!zctx->cctx) {
+        zctx->cctx = ZSTD_createCCtx();
+        if (!zctx->cctx) {
+            return FDB_RESULT_ALLOC_FAIL;
+        }
+    }
+
+    size_t ret;
+    if (dict) {
+        ret = ZSTD_compress_usingCDict(zctx->cctx, dst, *dst_len, src, len,
+                                       dict->cdict);
+    } else {
+        ret = ZSTD_compressCCtx(zctx->cctx, dst, *dst_len, src, len,
+                                DOC_CODEC_ZSTD_LEVEL);
+    }
+    if (ZSTD_isError(ret)) {
+        return FDB_RESULT_COMPRESSION_FAIL;
+    }
+    *dst_len = ret;
+    return FDB_RESULT_SUCCESS;
+}
+
+static fdb_status zstd_uncomp(void **ctx,
+                              const doc_codec_dict *dict,
+                              const void *src,
+                              size_t len,
+                              void *dst,
+                              size_t *dst_len)
+{
+    struct zstd_ctx *zctx = zstd_get_ctx(ctx);
+    if (!zctx->dctx) {
+        zctx->dctx = ZSTD_createDCtx();
+        if (!zctx->dctx) {
+            return FDB_RESULT_ALLOC_FAIL;
+        }
+    }
+
+    size_t ret;
+    if (dict) {
+        ret = ZSTD_decompress_usingDDict(zctx->dctx, dst, *dst_len, src, len,
+                                         dict->ddict);
+    } else {
+        ret = ZSTD_decompressDCtx(zctx->dctx, dst, *dst_len, src, len);
+    }
+    if (ZSTD_isError(ret)) {
+        return FDB_RESULT_COMPRESSION_FAIL;
+    }
+    *dst_len = ret;
+    return FDB_RESULT_SUCCESS;
+}
+
+static void zstd_free_ctx(void *ctx)
+{
+    struct zstd_ctx *zctx = (struct zstd_ctx *)ctx;
+    if (zctx) {
+        ZSTD_freeCCtx(zctx->cctx);
+        ZSTD_freeDCtx(zctx->dctx);
+        free(zctx);
+    }
+}
+
+static doc_codec_ops zstd_ops = {
+    zstd_max_len,
+    zstd_comp,
+    zstd_uncomp,
+    zstd_free_ctx
+};
+
+const doc_codec_ops* const fdb_doc_codec_ops_zstd = &zstd_ops;
+
+size_t doc_codec_train_dict(void *dict_buf,
+                            size_t dict_buf_size,
+                            const void *samples,
+                            const size_t *sample_lens,
+                            unsigned num_samples)
+{
+    size_t ret = ZDICT_trainFromBuffer(dict_buf, dict_buf_size, samples,
+                                       sample_lens, num_samples);
+    if (ZDICT_isError(ret)) {
+        return 0;
+    }
+    return ret;
+}
+
+doc_codec_dict* doc_codec_dict_create(const void *buf, size_t len)
+{
+    doc_codec_dict *dict = (doc_codec_dict *)calloc(1, sizeof(doc_codec_dict));
+    // both digested dictionaries copy the raw data
+    dict->cdict = ZSTD_createCDict(buf, len, DOC_CODEC_ZSTD_LEVEL);
+    dict->ddict = ZSTD_createDDict(buf, len);
+    if (!dict->cdict || !dict->ddict) {
+        doc_codec_dict_free(dict);
+        return NULL;
+    }
+    return dict;
+}
+
+void doc_codec_dict_free(doc_codec_dict *dict)
+{
+    if (dict) {
+        ZSTD_freeCDict(dict->cdict);
+        ZSTD_freeDDict(dict->ddict);
+        free(dict);
+    }
+}
+
+#else // zstd not available:
+
+const doc_codec_ops* const fdb_doc_codec_ops_zstd = NULL;
+
+size_t doc_codec_train_dict(void *dict_buf,
+                            size_t dict_buf_size,
+                            const void *samples,
+                            const size_t *sample_lens,
+                            unsigned num_samples)
+{
+    return 0;
+}
+
+doc_codec_dict* doc_codec_dict_create(const void *buf, size_t len)
+{
+    return NULL;
+}
+
+void doc_codec_dict_free(doc_codec_dict *dict)
+{
+}
+
+#endif // _DOC_COMP_ZSTD
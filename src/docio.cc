@@ -19,23 +19,24 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "docio.h"
 #include "wal.h"
 #include "fdb_internal.h"
 #include "version.h"
-#ifdef _DOC_COMP
-#include "snappy-c.h"
-#endif
 
 #include "memleak.h"
 
 DocioHandle::DocioHandle(FileMgr *file, bool compress_doc_body,
                          ErrLogCallback *log_callback) :
    file_Docio(file), curblock(BLK_NOT_FOUND), curpos(0), cur_bmp_revnum_hash(0),
-   compress_document_body(compress_doc_body),
+   compress_document_body(compress_doc_body), codecId(DOC_CODEC_SNAPPY),
+   codecDictOffset(BLK_NOT_FOUND), blobMode(DOCIO_BLOB_READ_BODY),
    log_callback(log_callback), lastbid(BLK_NOT_FOUND),
    lastBmpRevnum(0), readbuffer(NULL)
 {
+    memset(codecCtx, 0x0, sizeof(codecCtx));
     malloc_align(readbuffer, FDB_SECTOR_SIZE, file->getBlockSize());
 }
 
@@ -45,6 +46,63 @@ DocioHandle::~DocioHandle()
         free_align(readbuffer); // calls to the destructor (make idempotent)
         readbuffer = NULL;
     }
+    for (doc_codec_id_t i = 0; i < NUM_DOC_CODECS; ++i) {
+        if (codecCtx[i]) {
+            get_doc_codec_ops(i)->free_ctx(codecCtx[i]);
+            codecCtx[i] = NULL;
+        }
+    }
+}
+
+void DocioHandle::setCodec_Docio(fdb_compression_codec_t codec,
+                                 uint64_t dict_offset)
+{
+    codecId = doc_codec_from_config(codec);
+    codecDictOffset = BLK_NOT_FOUND;
+    if (codecId == DOC_CODEC_ZSTD && dict_offset != BLK_NOT_FOUND) {
+        codecId = DOC_CODEC_ZSTD_DICT;
+        codecDictOffset = dict_offset;
+    }
+}
+
+doc_codec_dict *DocioHandle::getCodecDict_Docio(uint64_t dict_offset)
+{
+    doc_codec_dict *dict = file_Docio->getCodecDict(dict_offset);
+    if (dict) {
+        return dict;
+    }
+
+    struct docio_object doc;
+    memset(&doc, 0x0, sizeof(doc));
+    int64_t _offset = readDoc_Docio(dict_offset, &doc, true);
+    if (_offset <= 0) {
+        fdb_log(log_callback, FDB_RESULT_READ_FAIL,
+                "Error in reading the compression dictionary with offset "
+                "%" _F64 " from a database file '%s'", dict_offset,
+                file_Docio->getFileName());
+        return NULL;
+    }
+    if (!(doc.length.flag & DOCIO_SYSTEM) ||
+        doc.length.keylen != sizeof(DOC_CODEC_DICT_KEY) ||
+        memcmp(doc.key, DOC_CODEC_DICT_KEY, sizeof(DOC_CODEC_DICT_KEY))) {
+        fdb_log(log_callback, FDB_RESULT_FILE_CORRUPTION,
+                "The doc with offset %" _F64 " in a database file '%s' is "
+                "not a compression dictionary", dict_offset,
+                file_Docio->getFileName());
+        free_docio_object(&doc, true, true, true);
+        return NULL;
+    }
+
+    dict = doc_codec_dict_create(doc.body, doc.length.bodylen);
+    free_docio_object(&doc, true, true, true);
+    if (!dict) {
+        fdb_log(log_callback, FDB_RESULT_COMPRESSION_FAIL,
+                "Error in loading the compression dictionary with offset "
+                "%" _F64 " from a database file '%s'", dict_offset,
+                file_Docio->getFileName());
+        return NULL;
+    }
+    return file_Docio->addCodecDict(dict_offset, dict);
 }
 
 #ifdef __CRC32
@@ -91,7 +149,30 @@ fdb_status DocioHandle::_fillZero_Docio(bid_t bid,
     }
 }
 
+inline
+fdb_status DocioHandle::_writeDocData_Docio(bid_t bid, uint32_t pos,
+                                            uint64_t len, void *buf,
+                                            uint64_t buf_offset,
+                                            bool final_write,
+                                            std::vector<docio_segment> *segments)
+{
+    if (segments) {
+        // only reserve the range, which is written by writeDoc_Docio()
+        struct docio_segment seg = {bid, pos, len, buf_offset, final_write};
+        segments->push_back(seg);
+        return FDB_RESULT_SUCCESS;
+    }
+    return file_Docio->writeOffset(bid, pos, len, (uint8_t *)buf + buf_offset,
+                                   final_write, log_callback);
+}
+
 bid_t DocioHandle::appendDocRaw_Docio(uint64_t size, void *buf)
+{
+    return _appendDocRaw_Docio(size, buf, NULL);
+}
+
+bid_t DocioHandle::_appendDocRaw_Docio(uint64_t size, void *buf,
+                                       std::vector<docio_segment> *segments)
 {
     uint32_t offset;
     uint8_t marker[BLK_MARKER_SIZE];
@@ -162,8 +243,8 @@ bid_t DocioHandle::appendDocRaw_Docio(uint64_t size, void *buf)
                     file_Docio->getFileName());
             return BLK_NOT_FOUND;
         }
-        fs = file_Docio->writeOffset(curblock, offset, size,
-                                  buf, (size == remaining_space), log_callback);
+        fs = _writeDocData_Docio(curblock, offset, size, buf, 0,
+                                 (size == remaining_space), segments);
         if (fs != FDB_RESULT_SUCCESS) {
             fdb_log(log_callback, fs,
                     "Error in writing a doc block with id %" _F64 ", offset %d, size %"
@@ -221,10 +302,10 @@ bid_t DocioHandle::appendDocRaw_Docio(uint64_t size, void *buf)
                 return BLK_NOT_FOUND;
             }
             if (offset > 0) {
-                fs = file_Docio->writeOffset(curblock,
-                                          curpos, offset, buf,
-                                          true, // mark block as immutable
-                                          log_callback);
+                fs = _writeDocData_Docio(curblock,
+                                         curpos, offset, buf, 0,
+                                         true, // mark block as immutable
+                                         segments);
                 if (fs != FDB_RESULT_SUCCESS) {
                     fdb_log(log_callback, fs,
                             "Error in writing a doc block with id %" _F64 ", offset %d, "
@@ -303,10 +384,10 @@ bid_t DocioHandle::appendDocRaw_Docio(uint64_t size, void *buf)
 
                 // write the front part of the doc
                 if (offset > 0) {
-                    fs = file_Docio->writeOffset(curblock,
-                                              curpos, offset, buf,
-                                              true, // mark block as immutable
-                                              log_callback);
+                    fs = _writeDocData_Docio(curblock,
+                                             curpos, offset, buf, 0,
+                                             true, // mark block as immutable
+                                             segments);
                     if (fs != FDB_RESULT_SUCCESS) {
                         fdb_log(log_callback, fs,
                                 "Error in writing a doc block with id %" _F64 ", offset %d, "
@@ -355,10 +436,10 @@ bid_t DocioHandle::appendDocRaw_Docio(uint64_t size, void *buf)
                     return BLK_NOT_FOUND;
                 }
                 if (offset > 0) {
-                    fs = file_Docio->writeOffset(curblock,
-                                              curpos, offset, buf,
-                                              true, // mark block as immutable
-                                              log_callback);
+                    fs = _writeDocData_Docio(curblock,
+                                             curpos, offset, buf, 0,
+                                             true, // mark block as immutable
+                                             segments);
                     if (fs != FDB_RESULT_SUCCESS) {
                         fdb_log(log_callback, fs,
                                 "Error in writing a doc block with id %" _F64 ", offset %d, "
@@ -429,10 +510,10 @@ bid_t DocioHandle::appendDocRaw_Docio(uint64_t size, void *buf)
             if (remainsize >= blocksize) {
                 // write entire block
 
-                fs = file_Docio->writeOffset(block_list[i], 0, blocksize,
-                                          (uint8_t *)buf + offset,
-                                          true, // mark block as immutable
-                                          log_callback);
+                fs = _writeDocData_Docio(block_list[i], 0, blocksize,
+                                         buf, offset,
+                                         true, // mark block as immutable
+                                         segments);
                 if (fs != FDB_RESULT_SUCCESS) {
                     fdb_log(log_callback, fs,
                             "Error in writing an entire doc block with id %"
@@ -450,10 +531,10 @@ bid_t DocioHandle::appendDocRaw_Docio(uint64_t size, void *buf)
                 // write rest of document
                 fdb_assert(i==block_list_size-1, i, block_list_size-1);
 
-                fs = file_Docio->writeOffset(block_list[i], 0, remainsize,
-                                          (uint8_t *)buf + offset,
-                                          (remainsize == blocksize),
-                                          log_callback);
+                fs = _writeDocData_Docio(block_list[i], 0, remainsize,
+                                         buf, offset,
+                                         (remainsize == blocksize),
+                                         segments);
                 if (fs != FDB_RESULT_SUCCESS) {
                     fdb_log(log_callback, fs,
                             "Error in writing a doc block with id %" _F64 ", "
@@ -532,65 +613,123 @@ DocioHandle::_docio_length_checksum(struct docio_length length)
                                 file_Docio->getCrcMode()) & 0xff);
 }
 
-inline bid_t DocioHandle::_appendDoc_Docio(struct docio_object *doc)
+fdb_status DocioHandle::_encodeDoc_Docio(struct docio_object *doc,
+                                         struct docio_encoded *enc)
 {
     size_t _len;
-    uint32_t offset = 0;
-    uint32_t crc;
     uint64_t docsize;
-    void *buf = NULL;
-    bid_t ret_offset;
-    fdb_seqnum_t _seqnum;
-    timestamp_t _timestamp;
-    struct docio_length length, _length;
+    struct docio_length length;
 
     length = doc->length;
     length.bodylen_ondisk = length.bodylen;
 
-#ifdef _DOC_COMP
-    int ret;
-    void *compbuf = NULL;
-    uint32_t compbuf_len = 0;
-    if (doc->length.bodylen > 0 && compress_document_body) {
-        compbuf_len = snappy_max_compressed_length(length.bodylen);
-        compbuf = (void *)malloc(compbuf_len);
-
-        _len = compbuf_len;
-        ret = snappy_compress((char*)doc->body, length.bodylen, (char*)compbuf, &_len);
-        if (ret < 0) { // LCOV_EXCL_START
+    enc->compbuf = NULL;
+    enc->compbuf_len = 0;
+
+    if (length.flag & DOCIO_BLOB) {
+        // reference moved from another file
+        memcpy(enc->ref_buf, doc->body, BLOB_REF_SIZE);
+        if (blobMode == DOCIO_BLOB_MOVE_REF) {
+            struct blob_ref ref;
+            blob_ref_decode(enc->ref_buf, &ref);
+            file_Docio->getBlobFiles()->addLiveBytes(ref.file_id,
+                                                     length.bodylen);
+        }
+        length.bodylen_ondisk = BLOB_REF_SIZE;
+    } else if (length.bodylen > 0 &&
+               file_Docio->getConfig()->getBlobThreshold() &&
+               length.bodylen >= file_Docio->getConfig()->getBlobThreshold() &&
+               !(length.flag & DOCIO_SYSTEM) &&
+               file_Docio->getConfig()->getEncryptionKey()->algorithm ==
+                   FDB_ENCRYPTION_NONE) {
+        fdb_status fs = _appendBlobBody_Docio(doc, enc->ref_buf);
+        if (fs != FDB_RESULT_SUCCESS) {
+            return fs;
+        }
+        length.flag |= DOCIO_BLOB;
+        length.bodylen_ondisk = BLOB_REF_SIZE;
+    }
+
+    const doc_codec_ops *codec_ops = NULL;
+    if (doc->length.bodylen > 0 && compress_document_body &&
+        !(length.flag & DOCIO_BLOB)) {
+        // NULL if the codec is not built in
+        codec_ops = get_doc_codec_ops(codecId);
+    }
+    if (codec_ops) {
+        fdb_status fs;
+        doc_codec_id_t codec = codecId;
+        doc_codec_dict *dict = NULL;
+        size_t prefix_len = 0;
+        if (codec == DOC_CODEC_ZSTD_DICT && (length.flag & DOCIO_SYSTEM)) {
+            // system docs (including dictionaries themselves) should be
+            // readable without loading any dictionary
+            codec = DOC_CODEC_ZSTD;
+        }
+        if (codec == DOC_CODEC_ZSTD_DICT) {
+            dict = getCodecDict_Docio(codecDictOffset);
+            if (dict) {
+                // prefix the body with the offset of the dictionary
+                prefix_len = sizeof(uint64_t);
+            } else {
+                codec = DOC_CODEC_ZSTD;
+            }
+        }
+        enc->compbuf_len = prefix_len +
+                           codec_ops->max_compressed_len(length.bodylen);
+        enc->compbuf = (void *)malloc(enc->compbuf_len);
+        if (prefix_len) {
+            uint64_t _dict_offset = _endian_encode(codecDictOffset);
+            memcpy(enc->compbuf, &_dict_offset, prefix_len);
+        }
+
+        _len = enc->compbuf_len - prefix_len;
+        fs = codec_ops->compress(&codecCtx[codec], dict, doc->body,
+                                 length.bodylen,
+                                 (uint8_t*)enc->compbuf + prefix_len, &_len);
+        if (fs != FDB_RESULT_SUCCESS) { // LCOV_EXCL_START
             fdb_log(log_callback, FDB_RESULT_COMPRESSION_FAIL,
                     "Error in compressing the doc body of key '%s' from "
                     "a database file '%s'",
                     (char *) doc->key, file_Docio->getFileName());
-            free(compbuf);
-            // we use BLK_NOT_FOUND for error code of appending instead of 0
-            // because document can be written at the byte offset 0
-            return BLK_NOT_FOUND;
+            free(enc->compbuf);
+            enc->compbuf = NULL;
+            return FDB_RESULT_COMPRESSION_FAIL;
         } // LCOV_EXCL_STOP
 
-        length.bodylen_ondisk = compbuf_len = _len;
-        length.flag |= DOCIO_COMPRESSED;
+        length.bodylen_ondisk = enc->compbuf_len = prefix_len + _len;
+        length.flag |= DOCIO_COMPRESSED | (codec << DOCIO_CODEC_SHIFT);
 
         docsize = sizeof(struct docio_length) + length.keylen + length.metalen;
-        docsize += compbuf_len;
+        docsize += enc->compbuf_len;
     } else {
-        docsize = sizeof(struct docio_length) + length.keylen + length.metalen + length.bodylen;
-        compbuf_len = length.bodylen;
+        docsize = sizeof(struct docio_length) + length.keylen + length.metalen +
+                  length.bodylen_ondisk;
+        enc->compbuf_len = length.bodylen_ondisk;
     }
-#else
-    docsize = sizeof(struct docio_length) + length.keylen + length.metalen + length.bodylen;
-#endif
     docsize += sizeof(timestamp_t);
 
     docsize += sizeof(fdb_seqnum_t);
 
 #ifdef __CRC32
-    docsize += sizeof(crc);
+    docsize += sizeof(uint32_t);
 #endif
 
     doc->length = length;
-    buf = (void *)malloc(docsize);
+    enc->docsize = docsize;
+    return FDB_RESULT_SUCCESS;
+}
+
+void DocioHandle::_buildDoc_Docio(struct docio_object *doc,
+                                  struct docio_encoded *enc, void *buf)
+{
+    uint32_t offset = 0;
+    uint32_t crc;
+    fdb_seqnum_t _seqnum;
+    timestamp_t _timestamp;
+    struct docio_length length, _length;
 
+    length = doc->length;
     _length = _encodeLength_Docio(length);
 
     // calculate checksum of LENGTH using crc
@@ -621,37 +760,73 @@ inline bid_t DocioHandle::_appendDoc_Docio(struct docio_object *doc)
 
     // copy body (optional)
     if (length.bodylen > 0) {
-#ifdef _DOC_COMP
         if (length.flag & DOCIO_COMPRESSED) {
             // compressed body
-            if (compbuf) {
-                memcpy((uint8_t*)buf + offset, compbuf, compbuf_len);
-                offset += compbuf_len;
-                free(compbuf);
+            if (enc->compbuf) {
+                memcpy((uint8_t*)buf + offset, enc->compbuf, enc->compbuf_len);
+                offset += enc->compbuf_len;
+                free(enc->compbuf);
+                enc->compbuf = NULL;
             }
+        } else if (length.flag & DOCIO_BLOB) {
+            memcpy((uint8_t *)buf + offset, enc->ref_buf, BLOB_REF_SIZE);
+            offset += BLOB_REF_SIZE;
         } else {
             memcpy((uint8_t *)buf + offset, doc->body, length.bodylen);
             offset += length.bodylen;
         }
-#else
-        memcpy((uint8_t *)buf + offset, doc->body, length.bodylen);
-        offset += length.bodylen;
-#endif
     }
 
 #ifdef __CRC32
     crc = get_checksum(reinterpret_cast<const uint8_t*>(buf),
-                       docsize - sizeof(crc),
+                       enc->docsize - sizeof(crc),
                        file_Docio->getCrcMode());
     memcpy((uint8_t *)buf + offset, &crc, sizeof(crc));
 #endif
+}
 
-    ret_offset = appendDocRaw_Docio(docsize, buf);
+inline bid_t DocioHandle::_appendDoc_Docio(struct docio_object *doc)
+{
+    void *buf = NULL;
+    bid_t ret_offset;
+    struct docio_encoded enc;
+
+    if (_encodeDoc_Docio(doc, &enc) != FDB_RESULT_SUCCESS) {
+        // we use BLK_NOT_FOUND for error code of appending instead of 0
+        // because document can be written at the byte offset 0
+        return BLK_NOT_FOUND;
+    }
+
+    buf = (void *)malloc(enc.docsize);
+    _buildDoc_Docio(doc, &enc, buf);
+
+    ret_offset = appendDocRaw_Docio(enc.docsize, buf);
     free(buf);
 
     return ret_offset;
 }
 
+fdb_status DocioHandle::_appendBlobBody_Docio(struct docio_object *doc,
+                                              void *ref_buf)
+{
+    struct blob_ref ref;
+    fdb_status fs = file_Docio->getBlobFiles()->append(doc->body,
+                                                       doc->length.bodylen,
+                                                       &ref.file_id,
+                                                       &ref.offset);
+    if (fs != FDB_RESULT_SUCCESS) {
+        fdb_log(log_callback, fs,
+                "Error in appending the doc body of key '%s' into the blob "
+                "file of a database file '%s'",
+                (char *) doc->key, file_Docio->getFileName());
+        return fs;
+    }
+    ref.crc = get_checksum(reinterpret_cast<const uint8_t*>(doc->body),
+                           doc->length.bodylen, file_Docio->getCrcMode());
+    blob_ref_encode(&ref, ref_buf);
+    return FDB_RESULT_SUCCESS;
+}
+
 bid_t DocioHandle::appendCommitMark_Docio(uint64_t doc_offset)
 {
     // Note: should adapt DOCIO_COMMIT_MARK_SIZE if this function is modified.
@@ -686,16 +861,29 @@ bid_t DocioHandle::appendCommitMark_Docio(uint64_t doc_offset)
     return ret_offset;
 }
 
-bid_t DocioHandle::appendDoc_Docio(struct docio_object *doc,
-                       uint8_t deleted, uint8_t txn_enabled)
+inline void DocioHandle::_setDocFlags_Docio(struct docio_object *doc,
+                                            uint8_t deleted,
+                                            uint8_t txn_enabled)
 {
+    // the body is a blob reference read by this handle
+    bool keep_ref = blobMode != DOCIO_BLOB_READ_BODY &&
+                    DOCIO_IS_BLOB(doc->length.flag);
     doc->length.flag = DOCIO_NORMAL;
+    if (keep_ref) {
+        doc->length.flag |= DOCIO_BLOB;
+    }
     if (deleted) {
         doc->length.flag |= DOCIO_DELETED;
     }
     if (txn_enabled) {
         doc->length.flag |= DOCIO_TXN_DIRTY;
     }
+}
+
+bid_t DocioHandle::appendDoc_Docio(struct docio_object *doc,
+                       uint8_t deleted, uint8_t txn_enabled)
+{
+    _setDocFlags_Docio(doc, deleted, txn_enabled);
     return _appendDoc_Docio(doc);
 }
 
@@ -705,6 +893,56 @@ bid_t DocioHandle::appendSystemDoc_Docio(struct docio_object *doc)
     return _appendDoc_Docio(doc);
 }
 
+fdb_status DocioHandle::prepareDoc_Docio(struct docio_object *doc,
+                                         uint8_t deleted, uint8_t txn_enabled,
+                                         struct docio_encoded *enc)
+{
+    _setDocFlags_Docio(doc, deleted, txn_enabled);
+    enc->segments.clear();
+    return _encodeDoc_Docio(doc, enc);
+}
+
+bid_t DocioHandle::reserveDoc_Docio(struct docio_encoded *enc)
+{
+    enc->segments.clear();
+    return _appendDocRaw_Docio(enc->docsize, NULL, &enc->segments);
+}
+
+fdb_status DocioHandle::writeDoc_Docio(struct docio_object *doc,
+                                       struct docio_encoded *enc)
+{
+    size_t i;
+    fdb_status fs = FDB_RESULT_SUCCESS;
+    void *buf = (void *)malloc(enc->docsize);
+
+    _buildDoc_Docio(doc, enc, buf);
+
+    for (i = 0; i < enc->segments.size(); ++i) {
+        struct docio_segment *seg = &enc->segments[i];
+        fs = file_Docio->writeOffset(seg->bid, seg->pos, seg->len,
+                                     (uint8_t *)buf + seg->buf_offset,
+                                     seg->final_write, log_callback);
+        if (fs != FDB_RESULT_SUCCESS) {
+            fdb_log(log_callback, fs,
+                    "Error in writing a doc block with id %" _F64 ", offset %d, "
+                    "size %" _F64 " to a database file '%s'", seg->bid,
+                    seg->pos, seg->len, file_Docio->getFileName());
+            break;
+        }
+    }
+
+    free(buf);
+    enc->segments.clear();
+    return fs;
+}
+
+void DocioHandle::releaseDoc_Docio(struct docio_encoded *enc)
+{
+    free(enc->compbuf);
+    enc->compbuf = NULL;
+    enc->segments.clear();
+}
+
 inline
 fdb_status DocioHandle::_readThroughBuffer_Docio(bid_t bid,
                                                    bool read_on_cache_miss)
@@ -806,6 +1044,15 @@ int64_t DocioHandle::_readLength_Docio(uint64_t offset,
         restsize = blocksize - pos;
     }
 
+    if (file_Docio->isDocAppendFailed(offset)) {
+        // WAL points to a pipelined doc that failed to be written
+        fdb_log(log_callback, FDB_RESULT_READ_FAIL,
+                "Error in reading a doc from offset %" _F64 " that failed "
+                "to be written into a database file '%s'", offset,
+                file_Docio->getFileName());
+        return (int64_t) FDB_RESULT_READ_FAIL;
+    }
+
     // read length structure
     fdb_status fs = _readThroughBuffer_Docio(bid, read_on_cache_miss);
     if (fs != FDB_RESULT_SUCCESS) {
@@ -919,6 +1166,17 @@ int64_t DocioHandle::_readDocComponent_Docio(uint64_t offset,
             pos = 0;
             rest_len -= restsize;
 
+            if (rest_len > blocksize) {
+                // The blocks entirely covered by the rest of the component
+                // are read directly into the output buffer, together with
+                // the last block that is read into the read buffer.
+                size_t n = _readFullBlocks_Docio(&bid,
+                                                 (rest_len - 1) / blocksize,
+                                                 (uint8_t *)buf_out +
+                                                     (len - rest_len));
+                rest_len -= n * blocksize;
+            }
+
             if (rest_len > 0 &&
                 bid >= file_Docio->getPos() / file_Docio->getBlockSize()) {
                 // no more data in the file .. the file is corrupted
@@ -933,36 +1191,126 @@ int64_t DocioHandle::_readDocComponent_Docio(uint64_t offset,
     return bid * real_blocksize + pos;
 }
 
-#ifdef _DOC_COMP
+// Read the given number of doc blocks chained from '*bid' into the output
+// buffer using vectored reads, which assume that the blocks are consecutive.
+// The block following them is read into the read buffer. Returns the number
+// of blocks read, and '*bid' is set to the next block to be read.
+size_t DocioHandle::_readFullBlocks_Docio(bid_t *bid, size_t num_blocks,
+                                          void *buf_out)
+{
+    size_t real_blocksize = file_Docio->getBlockSize();
+    size_t blocksize = real_blocksize;
+    bool non_consecutive = ver_non_consecutive_doc(file_Docio->getVersion());
+#ifdef __CRC32
+    if (non_consecutive) {
+        blocksize -= DOCBLK_META_SIZE;
+    } else {
+        blocksize -= BLK_MARKER_SIZE;
+    }
+#endif
+    size_t meta_size = real_blocksize - blocksize;
+    if (!meta_size) {
+        // blocks cannot be verified without their metadata
+        return 0;
+    }
+
+    uint8_t *metas = alca(uint8_t,
+                          meta_size * DOCIO_VECTORED_READ_MAX_BLOCKS);
+    struct docblk_meta blk_meta;
+    size_t num_read = 0;
+
+    while (num_read < num_blocks) {
+        size_t n = std::min(num_blocks - num_read,
+                            (size_t)DOCIO_VECTORED_READ_MAX_BLOCKS);
+        bool last = (num_read + n == num_blocks);
+        if (last) {
+            // the read buffer is overwritten by the following block
+            lastbid = BLK_NOT_FOUND;
+        }
+        fdb_status fs = file_Docio->readBlocksVectored(
+                            *bid, n, meta_size,
+                            (uint8_t *)buf_out + num_read * blocksize, metas,
+                            last ? readbuffer : NULL, log_callback);
+        if (fs != FDB_RESULT_SUCCESS) {
+            // the blocks are read one by one
+            return num_read;
+        }
 
-int64_t DocioHandle::_readCompressedDocComponent_Docio(uint64_t offset,
-                                                    uint32_t len,
-                                                    uint32_t comp_len,
-                                                    void *buf_out,
-                                                    void *comp_data_out)
+        // accept the blocks as long as they are chained consecutively
+        bid_t start_bid = *bid;
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t *meta = metas + i * meta_size;
+            if (meta[meta_size - 1] != BLK_MARKER_DOC) {
+                *bid = start_bid + i;
+                return num_read + i;
+            }
+            if (non_consecutive) {
+                memcpy(&blk_meta, meta, sizeof(blk_meta));
+                *bid = _endian_decode(blk_meta.next_bid);
+            } else {
+                *bid = start_bid + i + 1;
+            }
+            if (i + 1 < n && *bid != start_bid + i + 1) {
+                return num_read + i + 1;
+            }
+        }
+        num_read += n;
+
+        if (last && *bid == start_bid + n) {
+            lastbid = *bid;
+            lastBmpRevnum = file_Docio->getSbBmpRevnum();
+        }
+    }
+    return num_read;
+}
+
+fdb_status DocioHandle::_uncompressBody_Docio(uint64_t offset,
+                                              uint8_t flag,
+                                              const void *comp_data,
+                                              uint32_t comp_len,
+                                              void *buf_out,
+                                              uint32_t len)
 {
-    int ret;
+    fdb_status fs;
     size_t uncomp_size;
-    int64_t _offset;
-
-    _offset = _readDocComponent_Docio(offset, comp_len, comp_data_out);
-    if (_offset < 0) {
-        fdb_log(log_callback, (fdb_status) _offset,
-                "Error in reading the file with offset %" _F64 ", length %d "
-                "from a database file '%s'", offset, len,
-                file_Docio->getFileName());
-        return _offset;
+    doc_codec_id_t codec = (flag & DOCIO_CODEC_MASK) >> DOCIO_CODEC_SHIFT;
+    const doc_codec_ops *codec_ops = get_doc_codec_ops(codec);
+    doc_codec_dict *dict = NULL;
+
+    if (!codec_ops) {
+        return fdb_log(log_callback, FDB_RESULT_COMPRESSION_FAIL,
+                       "Error in decompressing the data with the file offset "
+                       "%" _F64 " in a database file '%s', because the codec "
+                       "%d is not supported by this build",
+                       offset, file_Docio->getFileName(), codec);
+    }
+    if (codec == DOC_CODEC_ZSTD_DICT) {
+        uint64_t _dict_offset;
+        if (comp_len < sizeof(_dict_offset)) {
+            return fdb_log(log_callback, FDB_RESULT_FILE_CORRUPTION,
+                           "Error in decompressing the data with the file "
+                           "offset %" _F64 " in a database file '%s', because "
+                           "the compressed length %d is too short",
+                           offset, file_Docio->getFileName(), comp_len);
+        }
+        memcpy(&_dict_offset, comp_data, sizeof(_dict_offset));
+        dict = getCodecDict_Docio(_endian_decode(_dict_offset));
+        if (!dict) {
+            return FDB_RESULT_COMPRESSION_FAIL;
+        }
+        comp_data = (const uint8_t *)comp_data + sizeof(_dict_offset);
+        comp_len -= sizeof(_dict_offset);
     }
 
     uncomp_size = len;
-    ret = snappy_uncompress((char*)comp_data_out, comp_len,
-                            (char*)buf_out, &uncomp_size);
-    if (ret < 0) {
+    fs = codec_ops->uncompress(&codecCtx[codec], dict, comp_data, comp_len,
+                               buf_out, &uncomp_size);
+    if (fs != FDB_RESULT_SUCCESS) {
         fdb_log(log_callback, FDB_RESULT_COMPRESSION_FAIL,
                 "Error in decompressing the data that was read with the file "
                 "offset %" _F64 ", length %d from a database file '%s'",
                 offset, len, file_Docio->getFileName());
-        return (int64_t) FDB_RESULT_COMPRESSION_FAIL;
+        return FDB_RESULT_COMPRESSION_FAIL;
     }
     if (uncomp_size != len) {
         fdb_log(log_callback, FDB_RESULT_COMPRESSION_FAIL,
@@ -971,12 +1319,37 @@ int64_t DocioHandle::_readCompressedDocComponent_Docio(uint64_t offset,
                 " is not same as the expected length %d",
                 offset, file_Docio->getFileName(),
                 static_cast<uint64_t>(uncomp_size), len);
-        return (int64_t) FDB_RESULT_COMPRESSION_FAIL;
+        return FDB_RESULT_COMPRESSION_FAIL;
     }
-    return _offset;
+    return FDB_RESULT_SUCCESS;
 }
 
-#endif
+int64_t DocioHandle::_readCompressedDocComponent_Docio(uint64_t offset,
+                                                    uint32_t len,
+                                                    uint32_t comp_len,
+                                                    uint8_t flag,
+                                                    void *buf_out,
+                                                    void *comp_data_out)
+{
+    fdb_status fs;
+    int64_t _offset;
+
+    _offset = _readDocComponent_Docio(offset, comp_len, comp_data_out);
+    if (_offset < 0) {
+        fdb_log(log_callback, (fdb_status) _offset,
+                "Error in reading the file with offset %" _F64 ", length %d "
+                "from a database file '%s'", offset, len,
+                file_Docio->getFileName());
+        return _offset;
+    }
+
+    fs = _uncompressBody_Docio(offset, flag, comp_data_out, comp_len,
+                               buf_out, len);
+    if (fs != FDB_RESULT_SUCCESS) {
+        return (int64_t) fs;
+    }
+    return _offset;
+}
 
 /**
  * Helper function that validates offset and checksum
@@ -1211,14 +1584,45 @@ int64_t DocioHandle::readDocKeyMeta_Docio(uint64_t offset,
     return _offset;
 }
 
+fdb_status DocioHandle::_readBlobBody_Docio(uint64_t offset,
+                                            const void *ref_buf,
+                                            void *buf_out,
+                                            uint32_t len)
+{
+    struct blob_ref ref;
+    blob_ref_decode(ref_buf, &ref);
+    fdb_status fs = file_Docio->getBlobFiles()->read(ref.file_id, ref.offset,
+                                                     len, buf_out);
+    if (fs != FDB_RESULT_SUCCESS) {
+        fdb_log(log_callback, fs,
+                "Error in reading a blob body (file ID %" _F64 ", offset %"
+                _F64 ", length %d) of a doc with offset %" _F64 " in a "
+                "database file '%s'", ref.file_id, ref.offset, len, offset,
+                file_Docio->getFileName());
+        return fs;
+    }
+    uint32_t crc = get_checksum(reinterpret_cast<const uint8_t*>(buf_out),
+                                len, file_Docio->getCrcMode());
+    if (crc != ref.crc) {
+        fdb_log(log_callback, FDB_RESULT_CHECKSUM_ERROR,
+                "Blob body checksum mismatch error in a database file '%s'"
+                " crc %x != %x (crc in reference) bodylen %d offset %" _F64,
+                file_Docio->getFileName(), crc, ref.crc, len, offset);
+        return FDB_RESULT_CHECKSUM_ERROR;
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
 int64_t DocioHandle::readDoc_Docio(uint64_t offset,
                        struct docio_object *doc,
                        bool read_on_cache_miss)
 {
     bool key_alloc = false, meta_alloc = false, body_alloc = false;
+    bool blob = false;
     fdb_seqnum_t _seqnum;
     timestamp_t _timestamp;
     void *comp_body = NULL;
+    uint8_t ref_buf[BLOB_REF_SIZE];
 
     fdb_status status = FDB_RESULT_SUCCESS;
     struct docio_length _length;
@@ -1290,7 +1694,9 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
         doc->meta = (void *)malloc(doc->length.metalen);
         meta_alloc = true;
     }
-    if (doc->body == NULL && doc->length.bodylen) {
+    // the body of a blob doc is allocated once its reference is verified
+    blob = DOCIO_IS_BLOB(doc->length.flag);
+    if (doc->body == NULL && doc->length.bodylen && !blob) {
         doc->body = (void *)malloc(doc->length.bodylen);
         body_alloc = true;
     }
@@ -1348,11 +1754,11 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
         return _offset;
     }
 
-#ifdef _DOC_COMP
     if (doc->length.flag & DOCIO_COMPRESSED) {
         comp_body = (void*)malloc(doc->length.bodylen_ondisk);
         _offset = _readCompressedDocComponent_Docio(_offset, doc->length.bodylen,
-                                                 doc->length.bodylen_ondisk, doc->body,
+                                                 doc->length.bodylen_ondisk,
+                                                 doc->length.flag, doc->body,
                                                  comp_body);
         if (_offset < 0) {
             fdb_log(log_callback, (fdb_status) _offset,
@@ -1365,6 +1771,25 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
             free_docio_object(doc, key_alloc, meta_alloc, body_alloc);
             return _offset;
         }
+    } else if (blob) {
+        if (doc->length.bodylen_ondisk != BLOB_REF_SIZE) {
+            fdb_log(log_callback, FDB_RESULT_FILE_CORRUPTION,
+                    "File corruption: Invalid blob reference length %d "
+                    "with offset %" _F64 " in a database file '%s'",
+                    doc->length.bodylen_ondisk, offset,
+                    file_Docio->getFileName());
+            free_docio_object(doc, key_alloc, meta_alloc, body_alloc);
+            return (int64_t) FDB_RESULT_FILE_CORRUPTION;
+        }
+        _offset = _readDocComponent_Docio(_offset, BLOB_REF_SIZE, ref_buf);
+        if (_offset < 0) {
+            fdb_log(log_callback, (fdb_status) _offset,
+                    "Error in reading a blob reference with offset %" _F64
+                    " from a database file '%s'", offset,
+                    file_Docio->getFileName());
+            free_docio_object(doc, key_alloc, meta_alloc, body_alloc);
+            return _offset;
+        }
     } else {
         _offset = _readDocComponent_Docio(_offset, doc->length.bodylen,
                                             doc->body);
@@ -1377,18 +1802,6 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
             return _offset;
         }
     }
-#else
-    _offset = _readDocComponent_Docio(_offset, doc->length.bodylen,
-                                        doc->body);
-    if (_offset < 0) {
-        fdb_log(log_callback, (fdb_status) _offset,
-                "Error in reading a doc with offset %" _F64 ", length %d "
-                "from a database file '%s'", offset, doc->length.bodylen,
-                file_Docio->getFileName());
-        free_docio_object(doc, key_alloc, meta_alloc, body_alloc);
-        return _offset;
-    }
-#endif
 
 #ifdef __CRC32
     uint32_t crc_file, crc;
@@ -1436,6 +1849,9 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
         if (comp_body) {
             free(comp_body);
         }
+    } else if (blob) {
+        crc = get_checksum(ref_buf, BLOB_REF_SIZE, crc,
+                           file_Docio->getCrcMode());
     } else {
         crc = get_checksum(reinterpret_cast<const uint8_t*>(doc->body),
                            doc->length.bodylen,
@@ -1454,6 +1870,34 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
     }
 #endif
 
+    if (blob) {
+        struct blob_ref ref;
+        blob_ref_decode(ref_buf, &ref);
+        if (blobMode != DOCIO_BLOB_READ_BODY &&
+            !file_Docio->getBlobFiles()->isCollected(ref.file_id) &&
+            (doc->body == NULL || doc->length.bodylen >= BLOB_REF_SIZE)) {
+            // hand over the reference itself, to be appended as it is
+            if (doc->body == NULL) {
+                doc->body = (void *)malloc(std::max(doc->length.bodylen,
+                                                    (uint32_t)BLOB_REF_SIZE));
+                body_alloc = true;
+            }
+            memcpy(doc->body, ref_buf, BLOB_REF_SIZE);
+        } else {
+            if (doc->body == NULL) {
+                doc->body = (void *)malloc(doc->length.bodylen);
+                body_alloc = true;
+            }
+            status = _readBlobBody_Docio(offset, ref_buf, doc->body,
+                                         doc->length.bodylen);
+            if (status != FDB_RESULT_SUCCESS) {
+                free_docio_object(doc, key_alloc, meta_alloc, body_alloc);
+                return (int64_t) status;
+            }
+            doc->length.flag &= ~DOCIO_BLOB;
+        }
+    }
+
     uint8_t free_meta = meta_alloc && !doc->length.metalen;
     uint8_t free_body = body_alloc && !doc->length.bodylen;
     free_docio_object(doc, false, free_meta, free_body);
@@ -1461,6 +1905,326 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
     return _offset;
 }
 
+DocViewBuffer::DocViewBuffer()
+    : blockSize(0), numUsedBlocks(0), lastBid(BLK_NOT_FOUND), lastBlock(NULL)
+{
+}
+
+DocViewBuffer::~DocViewBuffer()
+{
+    for (auto &entry : blocks) {
+        free_align(entry);
+    }
+}
+
+void DocViewBuffer::reset(size_t blocksize)
+{
+    if (blockSize != blocksize) {
+        // read from a file with a different block size
+        for (auto &entry : blocks) {
+            free_align(entry);
+        }
+        blocks.clear();
+        blockSize = blocksize;
+    }
+    numUsedBlocks = 0;
+    lastBid = BLK_NOT_FOUND;
+    lastBlock = NULL;
+    segments.clear();
+}
+
+uint8_t *DocViewBuffer::getNewBlock(bid_t bid)
+{
+    if (numUsedBlocks == blocks.size()) {
+        void *addr;
+        malloc_align(addr, FDB_SECTOR_SIZE, blockSize);
+        blocks.push_back(addr);
+    }
+    lastBid = bid;
+    lastBlock = static_cast<uint8_t *>(blocks[numUsedBlocks++]);
+    return lastBlock;
+}
+
+uint8_t *DocViewBuffer::getScratch(ScratchType type, size_t len)
+{
+    if (scratch[type].size() < len) {
+        scratch[type].resize(len);
+    }
+    return scratch[type].data();
+}
+
+int64_t DocioHandle::_mapDocComponent_Docio(uint64_t offset,
+                                            uint32_t len,
+                                            DocViewBuffer *vbuf)
+{
+    uint32_t rest_len;
+    size_t blocksize = file_Docio->getBlockSize();
+    size_t real_blocksize = blocksize;
+    bool non_consecutive = ver_non_consecutive_doc(file_Docio->getVersion());
+    struct docblk_meta blk_meta;
+#ifdef __CRC32
+    if (non_consecutive) {
+        // new version: support non-consecutive document block
+        blocksize -= DOCBLK_META_SIZE;
+    } else {
+        // old version: block marker only
+        blocksize -= BLK_MARKER_SIZE;
+    }
+#endif
+
+    bid_t bid = offset / real_blocksize;
+    uint32_t pos = offset % real_blocksize;
+    uint32_t restsize;
+    uint8_t *buf;
+    fdb_status fs;
+
+    rest_len = len;
+
+    while (rest_len > 0) {
+        buf = vbuf->getLastBlock(bid);
+        if (!buf) {
+            // read the block directly into the view's own buffer,
+            // instead of going through 'readbuffer'.
+            buf = vbuf->getNewBlock(bid);
+            fs = file_Docio->read_FileMgr(bid, buf, log_callback, true);
+            if (fs != FDB_RESULT_SUCCESS) {
+                fdb_log(log_callback, fs,
+                        "Error in reading a doc block with block id %" _F64
+                        " from a database file '%s'", bid,
+                        file_Docio->getFileName());
+                return (int64_t)fs;
+            }
+        }
+        restsize = blocksize - pos;
+
+        if (restsize >= rest_len) {
+            vbuf->segments.push_back({buf + pos, rest_len});
+            pos += rest_len;
+            rest_len = 0;
+        } else {
+            if (restsize) {
+                vbuf->segments.push_back({buf + pos, restsize});
+            }
+
+            if (non_consecutive) {
+                memcpy(&blk_meta, buf + blocksize, sizeof(blk_meta));
+                bid = _endian_decode(blk_meta.next_bid);
+            } else {
+                bid++;
+            }
+
+            pos = 0;
+            rest_len -= restsize;
+
+            if (bid >= file_Docio->getPos() / file_Docio->getBlockSize()) {
+                // no more data in the file .. the file is corrupted
+                fdb_log(log_callback, FDB_RESULT_FILE_CORRUPTION,
+                        "Fatal error!!! Database file '%s' is corrupted.",
+                        file_Docio->getFileName());
+                return (int64_t)FDB_RESULT_FILE_CORRUPTION;
+            }
+        }
+    }
+
+    return bid * real_blocksize + pos;
+}
+
+const void *DocioHandle::_mapContiguous_Docio(size_t first_seg,
+                                              uint32_t len,
+                                              DocViewBuffer *vbuf,
+                                              DocViewBuffer::ScratchType type)
+{
+    std::vector<fdb_doc_segment> &segs = vbuf->segments;
+    const void *ptr = NULL;
+
+    if (segs.size() == first_seg + 1) {
+        // in a single block: no need to copy
+        ptr = segs[first_seg].buf;
+    } else if (segs.size() > first_seg + 1) {
+        uint8_t *scratch = vbuf->getScratch(type, len);
+        size_t copied = 0;
+        for (size_t i = first_seg; i < segs.size(); ++i) {
+            memcpy(scratch + copied, segs[i].buf, segs[i].len);
+            copied += segs[i].len;
+        }
+        ptr = scratch;
+    }
+    segs.resize(first_seg);
+    return ptr;
+}
+
+int64_t DocioHandle::readDocView_Docio(uint64_t offset,
+                                       fdb_doc_view *view,
+                                       struct docio_length *length_out)
+{
+    DocViewBuffer *vbuf = static_cast<DocViewBuffer *>(view->buffers);
+    fdb_seqnum_t _seqnum;
+    timestamp_t _timestamp;
+    const void *comp_body = NULL;
+    const void *ref = NULL;
+    bool compressed = false, blob = false;
+
+    fdb_status status = FDB_RESULT_SUCCESS;
+    struct docio_length _length, length;
+    int64_t _offset = offset;
+
+    vbuf->reset(file_Docio->getBlockSize());
+
+    if (!validateChecksum_Docio(true, &_offset, &_length, &status)) {
+        return (int64_t) status;
+    }
+
+    length = _decodeLength_Docio(_length);
+    // Note that a transaction commit marker has zero key length, so that
+    // it is also regarded as an invalid doc here.
+    if (length.keylen == 0 || length.keylen > FDB_MAX_KEYLEN_INTERNAL) {
+        fdb_log(log_callback, FDB_RESULT_FILE_CORRUPTION,
+                "Error in decoding the doc length metadata (key length: %d) from "
+                "a database file '%s' offset %" _F64, length.keylen,
+                file_Docio->getFileName(), offset);
+        return (int64_t) FDB_RESULT_FILE_CORRUPTION;
+    }
+
+    _offset = _mapDocComponent_Docio(_offset, length.keylen, vbuf);
+    if (_offset < 0) {
+        return _offset;
+    }
+    view->key = _mapContiguous_Docio(0, length.keylen, vbuf,
+                                     DocViewBuffer::SCRATCH_KEY);
+
+    _offset = _mapDocComponent_Docio(_offset, sizeof(timestamp_t), vbuf);
+    if (_offset < 0) {
+        return _offset;
+    }
+    memcpy(&_timestamp,
+           _mapContiguous_Docio(0, sizeof(timestamp_t), vbuf,
+                                DocViewBuffer::SCRATCH_FIELD),
+           sizeof(timestamp_t));
+
+    _offset = _mapDocComponent_Docio(_offset, sizeof(fdb_seqnum_t), vbuf);
+    if (_offset < 0) {
+        return _offset;
+    }
+    memcpy(&_seqnum,
+           _mapContiguous_Docio(0, sizeof(fdb_seqnum_t), vbuf,
+                                DocViewBuffer::SCRATCH_FIELD),
+           sizeof(fdb_seqnum_t));
+
+    _offset = _mapDocComponent_Docio(_offset, length.metalen, vbuf);
+    if (_offset < 0) {
+        return _offset;
+    }
+    view->meta = _mapContiguous_Docio(0, length.metalen, vbuf,
+                                      DocViewBuffer::SCRATCH_META);
+
+    compressed = length.flag & DOCIO_COMPRESSED;
+    if (compressed) {
+        _offset = _mapDocComponent_Docio(_offset, length.bodylen_ondisk, vbuf);
+        if (_offset < 0) {
+            return _offset;
+        }
+        comp_body = _mapContiguous_Docio(0, length.bodylen_ondisk, vbuf,
+                                         DocViewBuffer::SCRATCH_COMP);
+        uint8_t *body = vbuf->getScratch(DocViewBuffer::SCRATCH_BODY,
+                                         length.bodylen);
+        status = _uncompressBody_Docio(offset, length.flag, comp_body,
+                                       length.bodylen_ondisk, body,
+                                       length.bodylen);
+        if (status != FDB_RESULT_SUCCESS) {
+            return (int64_t) status;
+        }
+        vbuf->segments.push_back({body, length.bodylen});
+    } else if (DOCIO_IS_BLOB(length.flag)) {
+        if (length.bodylen_ondisk != BLOB_REF_SIZE) {
+            fdb_log(log_callback, FDB_RESULT_FILE_CORRUPTION,
+                    "File corruption: Invalid blob reference length %d "
+                    "with offset %" _F64 " in a database file '%s'",
+                    length.bodylen_ondisk, offset, file_Docio->getFileName());
+            return (int64_t) FDB_RESULT_FILE_CORRUPTION;
+        }
+        blob = true;
+        _offset = _mapDocComponent_Docio(_offset, BLOB_REF_SIZE, vbuf);
+        if (_offset < 0) {
+            return _offset;
+        }
+        ref = _mapContiguous_Docio(0, BLOB_REF_SIZE, vbuf,
+                                   DocViewBuffer::SCRATCH_COMP);
+    } else {
+        _offset = _mapDocComponent_Docio(_offset, length.bodylen, vbuf);
+        if (_offset < 0) {
+            return _offset;
+        }
+    }
+
+#ifdef __CRC32
+    uint32_t crc_file, crc;
+    size_t num_body_segs = vbuf->segments.size();
+    _offset = _mapDocComponent_Docio(_offset, sizeof(crc_file), vbuf);
+    if (_offset < 0) {
+        return _offset;
+    }
+    memcpy(&crc_file,
+           _mapContiguous_Docio(num_body_segs, sizeof(crc_file), vbuf,
+                                DocViewBuffer::SCRATCH_FIELD),
+           sizeof(crc_file));
+
+    crc_mode_e crc_mode = file_Docio->getCrcMode();
+    crc = get_checksum(reinterpret_cast<const uint8_t*>(&_length),
+                       sizeof(_length), crc_mode);
+    crc = get_checksum(reinterpret_cast<const uint8_t*>(view->key),
+                       length.keylen, crc, crc_mode);
+    crc = get_checksum(reinterpret_cast<const uint8_t*>(&_timestamp),
+                       sizeof(timestamp_t), crc, crc_mode);
+    crc = get_checksum(reinterpret_cast<const uint8_t*>(&_seqnum),
+                       sizeof(fdb_seqnum_t), crc, crc_mode);
+    crc = get_checksum(reinterpret_cast<const uint8_t*>(view->meta),
+                       length.metalen, crc, crc_mode);
+    if (compressed) {
+        crc = get_checksum(reinterpret_cast<const uint8_t*>(comp_body),
+                           length.bodylen_ondisk, crc, crc_mode);
+    } else if (blob) {
+        crc = get_checksum(reinterpret_cast<const uint8_t*>(ref),
+                           BLOB_REF_SIZE, crc, crc_mode);
+    } else {
+        for (auto &entry : vbuf->segments) {
+            crc = get_checksum(reinterpret_cast<const uint8_t*>(entry.buf),
+                               entry.len, crc, crc_mode);
+        }
+    }
+    if (crc != crc_file) {
+        fdb_log(log_callback, FDB_RESULT_CHECKSUM_ERROR,
+                "doc_body checksum mismatch error in a database file '%s'"
+                " crc %x != %x (crc in doc) keylen %d metalen %d bodylen %d "
+                "bodylen_ondisk %d offset %" _F64, file_Docio->getFileName(),
+                crc, crc_file, length.keylen, length.metalen,
+                length.bodylen, length.bodylen_ondisk, offset);
+        return (int64_t) FDB_RESULT_CHECKSUM_ERROR;
+    }
+#endif
+
+    if (blob) {
+        uint8_t *body = vbuf->getScratch(DocViewBuffer::SCRATCH_BODY,
+                                         length.bodylen);
+        status = _readBlobBody_Docio(offset, ref, body, length.bodylen);
+        if (status != FDB_RESULT_SUCCESS) {
+            return (int64_t) status;
+        }
+        vbuf->segments.push_back({body, length.bodylen});
+        length.flag &= ~DOCIO_BLOB;
+    }
+
+    view->keylen = length.keylen;
+    view->metalen = length.metalen;
+    view->bodylen = length.bodylen;
+    view->num_segments = vbuf->segments.size();
+    view->segments = vbuf->segments.data();
+    view->seqnum = _endian_decode(_seqnum);
+    view->deleted = length.flag & DOCIO_DELETED;
+    *length_out = length;
+
+    return _offset;
+}
+
 int DocioHandle::_submitAsyncIORequests_Docio(struct docio_object *doc_array,
                                      size_t doc_idx,
                                      struct async_io_handle *aio_handle,
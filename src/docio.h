@@ -18,12 +18,119 @@
 #ifndef _JSAHN_DOCIO_H
 #define _JSAHN_DOCIO_H
 
+#include <vector>
+
 #include "filemgr.h"
 #include "common.h"
+#include "doc_codec.h"
 
 typedef uint16_t keylen_t;
 typedef uint32_t timestamp_t;
 
+/**
+ * Buffers backing a fdb_doc_view. Document blocks are read into block-sized
+ * buffers that are kept and reused by subsequent reads, and the view points
+ * directly into them.
+ */
+class DocViewBuffer {
+public:
+    enum ScratchType {
+        SCRATCH_KEY,
+        SCRATCH_META,
+        SCRATCH_FIELD,
+        SCRATCH_COMP,
+        SCRATCH_BODY,
+        NUM_SCRATCH
+    };
+
+    DocViewBuffer();
+    ~DocViewBuffer();
+
+    /**
+     * Prepare for a new read. All pointers handed out by the previous read
+     * become invalid.
+     *
+     * @param blocksize Block size of the file to be read.
+     */
+    void reset(size_t blocksize);
+
+    /**
+     * Return the buffer holding the given block, if it is the block that was
+     * mapped most recently.
+     */
+    uint8_t *getLastBlock(bid_t bid) const {
+        return (bid == lastBid) ? lastBlock : NULL;
+    }
+
+    /**
+     * Return an unused block buffer for the given block, allocating a new one
+     * if all buffers are in use.
+     */
+    uint8_t *getNewBlock(bid_t bid);
+
+    /**
+     * Return a contiguous scratch buffer of at least the given length, which
+     * is used when an item spans multiple blocks or needs to be uncompressed.
+     */
+    uint8_t *getScratch(ScratchType type, size_t len);
+
+    std::vector<fdb_doc_segment> segments;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(DocViewBuffer);
+
+    size_t blockSize;
+    size_t numUsedBlocks;
+    bid_t lastBid;
+    uint8_t *lastBlock;
+    std::vector<void *> blocks;
+    std::vector<uint8_t> scratch[NUM_SCRATCH];
+};
+
+/**
+ * How the bodies of documents in blob files (see DOCIO_BLOB) are handled.
+ */
+typedef uint8_t docio_blob_mode_t;
+enum {
+    // Reads resolve the references into bodies
+    DOCIO_BLOB_READ_BODY = 0,
+    // Reads return the references as bodies, which are appended as they are
+    // (unless the blob file is being collected by compaction)
+    DOCIO_BLOB_KEEP_REF = 1,
+    // Same as KEEP_REF, and appending a reference also counts its body as
+    // live in the blob file, which is done by compaction
+    DOCIO_BLOB_MOVE_REF = 2
+};
+
+/**
+ * Range of a document that is reserved in a document block, which is written
+ * from the given offset in the document's buffer.
+ */
+struct docio_segment {
+    bid_t bid;
+    uint32_t pos;
+    uint64_t len;
+    uint64_t buf_offset;
+    // the rest of the block is not written afterwards
+    bool final_write;
+};
+
+/**
+ * Document encoded to be appended, whose body is already compressed or
+ * written into a blob file, so that its size on disk is known.
+ */
+struct docio_encoded {
+    // size of the document on disk
+    uint64_t docsize;
+    // compressed body, or NULL
+    void *compbuf;
+    uint32_t compbuf_len;
+    // reference to the body in a blob file
+    uint8_t ref_buf[BLOB_REF_SIZE];
+    // ranges reserved by DocioHandle::reserveDoc_Docio()
+    std::vector<struct docio_segment> segments;
+};
+
 class DocioHandle {
 public:
     DocioHandle(FileMgr *file, bool compress_body,
@@ -63,6 +170,53 @@ public:
      */
     bid_t appendSystemDoc_Docio(struct docio_object *doc);
 
+    /**
+     * Encode a doc to be appended in two steps: the space of the doc is
+     * reserved by reserveDoc_Docio() under the file's writer lock, and the
+     * doc is written by writeDoc_Docio() after releasing the lock, so that
+     * concurrent writers don't serialize while copying their bodies.
+     * The body is compressed or written into a blob file here, and
+     * doc->length is updated accordingly.
+     *
+     * @param doc - the doc to be persisted
+     * @param deleted - is the doc deleted
+     * @param txn_enabled - is it an uncommitted transactional doc
+     * @param enc - pointer to the encoded doc to be populated
+     * @return FDB_RESULT_SUCCESS on success
+     */
+    fdb_status prepareDoc_Docio(struct docio_object *doc,
+                                uint8_t deleted, uint8_t txn_enabled,
+                                struct docio_encoded *enc);
+
+    /**
+     * Reserve the space of an encoded doc. Blocks are allocated and their
+     * metadata is written, but the doc itself is not written yet.
+     *
+     * @param enc - the doc encoded by prepareDoc_Docio()
+     * @return - offset of the doc, or BLK_NOT_FOUND on failure
+     */
+    bid_t reserveDoc_Docio(struct docio_encoded *enc);
+
+    /**
+     * Write a doc into the space reserved by reserveDoc_Docio(). This does
+     * not require the file's writer lock, as the reserved byte ranges are
+     * not written by others. Note that the blocks, and even the sectors, of
+     * the ranges may be shared with other docs being written concurrently;
+     * FileMgr serializes the partial writes of each sector.
+     *
+     * @param doc - the doc given to prepareDoc_Docio(), whose seqnum and
+     *        timestamp may have been assigned since then
+     * @param enc - the encoded doc, which is released by this call
+     * @return FDB_RESULT_SUCCESS on success
+     */
+    fdb_status writeDoc_Docio(struct docio_object *doc,
+                              struct docio_encoded *enc);
+
+    /**
+     * Release an encoded doc that is not going to be written.
+     */
+    void releaseDoc_Docio(struct docio_encoded *enc);
+
     /**
      * Retrieve the length info of a KV item at a given file offset.
      *
@@ -113,6 +267,21 @@ public:
                           struct docio_object *doc,
                           bool read_on_cache_miss);
 
+    /**
+     * Read a KV item at a given file offset into a view, without assembling
+     * the key, metadata, and body into separate buffers.
+     *
+     * @param offset File offset to a KV item
+     * @param view Pointer to fdb_doc_view instance. Its 'offset' and
+     *        'size_ondisk' fields are not populated.
+     * @param length Pointer to docio_length instance to be populated
+     * @return next offset right after a key and its value on succcessful read,
+     *         otherwise, the corresponding error code is returned.
+     */
+    int64_t readDocView_Docio(uint64_t offset,
+                              fdb_doc_view *view,
+                              struct docio_length *length);
+
     /**
      * Read a batch of docs using async reads if possible
      *
@@ -190,6 +359,38 @@ public:
         return compress_document_body;
     }
 
+    /**
+     * Set the codec that compresses the body of documents appended by this
+     * handle, if body compression is enabled.
+     *
+     * @param codec Codec given by the config.
+     * @param dict_offset Offset of the system doc holding the dictionary to
+     *        be used by zstd, or BLK_NOT_FOUND if none.
+     */
+    void setCodec_Docio(fdb_compression_codec_t codec, uint64_t dict_offset);
+
+    /**
+     * Set how the bodies of documents in blob files are read and appended by
+     * this handle.
+     */
+    void setBlobMode_Docio(docio_blob_mode_t mode) {
+        blobMode = mode;
+    }
+
+    docio_blob_mode_t getBlobMode_Docio() const {
+        return blobMode;
+    }
+
+    /**
+     * Return the compression dictionary held by the system doc at the given
+     * offset. The dictionary is read from the file only once, and shared by
+     * all handles of the file.
+     *
+     * @param dict_offset Offset of the system doc holding the dictionary.
+     * @return Dictionary, or NULL if it cannot be read.
+     */
+    doc_codec_dict *getCodecDict_Docio(uint64_t dict_offset);
+
     static struct docio_length encodeLength_Docio(struct docio_length length);
 
     static struct docio_length decodeLength_Docio(struct docio_length length);
@@ -210,6 +411,23 @@ private:
     uint8_t _docio_length_checksum(struct docio_length length);
     bid_t _appendDoc_Docio(struct docio_object *doc);
 
+    void _setDocFlags_Docio(struct docio_object *doc,
+                            uint8_t deleted, uint8_t txn_enabled);
+
+    fdb_status _encodeDoc_Docio(struct docio_object *doc,
+                                struct docio_encoded *enc);
+
+    void _buildDoc_Docio(struct docio_object *doc,
+                         struct docio_encoded *enc, void *buf);
+
+    bid_t _appendDocRaw_Docio(uint64_t size, void *buf,
+                              std::vector<docio_segment> *segments);
+
+    fdb_status _writeDocData_Docio(bid_t bid, uint32_t pos, uint64_t len,
+                                   void *buf, uint64_t buf_offset,
+                                   bool final_write,
+                                   std::vector<docio_segment> *segments);
+
     fdb_status _readThroughBuffer_Docio(bid_t bid, bool read_on_cache_miss);
     bool _checkBuffer_Docio(uint64_t bmp_revnum);
     int64_t _readLength_Docio(uint64_t offset,
@@ -220,18 +438,54 @@ private:
                                     uint32_t len,
                                     void *buf_out);
 
+    size_t _readFullBlocks_Docio(bid_t *bid, size_t num_blocks,
+                                 void *buf_out);
+
+    int64_t _mapDocComponent_Docio(uint64_t offset,
+                                   uint32_t len,
+                                   DocViewBuffer *vbuf);
+
+    const void *_mapContiguous_Docio(size_t first_seg,
+                                     uint32_t len,
+                                     DocViewBuffer *vbuf,
+                                     DocViewBuffer::ScratchType type);
+
     int64_t _readCompressedDocComponent_Docio(uint64_t offset,
                                               uint32_t len,
                                               uint32_t comp_len,
+                                              uint8_t flag,
                                               void *buf_out,
                                               void *comp_data_out);
 
+    fdb_status _readBlobBody_Docio(uint64_t offset,
+                                   const void *ref_buf,
+                                   void *buf_out,
+                                   uint32_t len);
+
+    fdb_status _appendBlobBody_Docio(struct docio_object *doc,
+                                     void *ref_buf);
+
+    fdb_status _uncompressBody_Docio(uint64_t offset,
+                                     uint8_t flag,
+                                     const void *comp_data,
+                                     uint32_t comp_len,
+                                     void *buf_out,
+                                     uint32_t len);
+
     FileMgr *file_Docio;
     bid_t curblock;
     uint32_t curpos;
     uint16_t cur_bmp_revnum_hash;
     // for buffer purpose
     bool compress_document_body;
+    // Codec of the documents appended by this handle
+    doc_codec_id_t codecId;
+    // Offset of the dictionary if 'codecId' is DOC_CODEC_ZSTD_DICT
+    uint64_t codecDictOffset;
+    // Contexts of each codec, which are private to this handle
+    void *codecCtx[NUM_DOC_CODECS];
+    // How blob bodies are handled
+    docio_blob_mode_t blobMode;
     ErrLogCallback *log_callback;
     bid_t lastbid;
     uint64_t lastBmpRevnum;
@@ -246,6 +500,19 @@ private:
 #define DOCIO_TXN_DIRTY (0x08)
 #define DOCIO_TXN_COMMITTED (0x10)
 #define DOCIO_SYSTEM (0x20) /* system document */
+/* codec of the compressed body (doc_codec_id_t) */
+#define DOCIO_CODEC_MASK (0xc0)
+#define DOCIO_CODEC_SHIFT (6)
+/* body is stored in a blob file, and the doc holds a reference to it. This
+ * shares the codec bits, as blob bodies are never compressed. */
+#define DOCIO_BLOB (0x40)
+#define DOCIO_IS_BLOB(flag) \
+    (((flag) & (DOCIO_COMPRESSED | DOCIO_BLOB)) == DOCIO_BLOB)
+/* body is compressed with a trained dictionary, and refers to the offset of
+ * the dictionary doc in the file */
+#define DOCIO_IS_DICT_COMPRESSED(flag) \
+    (((flag) & DOCIO_COMPRESSED) && \
+     (((flag) & DOCIO_CODEC_MASK) >> DOCIO_CODEC_SHIFT) == DOC_CODEC_ZSTD_DICT)
 #ifdef DOCIO_LEN_STRUCT_ALIGN
     // this structure will occupy 16 bytes
     struct docio_length {
@@ -282,6 +549,9 @@ struct docio_object {
 
 #define DOCIO_COMMIT_MARK_SIZE (sizeof(struct docio_length) + sizeof(uint64_t))
 
+// Max number of doc blocks read by a single vectored read
+#define DOCIO_VECTORED_READ_MAX_BLOCKS (511)
+
 void free_docio_object(struct docio_object *doc, bool key_alloc,
                        bool meta_alloc, bool body_alloc);
 
@@ -50,6 +50,35 @@ fdb_status fdb_decrypt_block(encryptor *e,
     return e->ops->crypt(e, false, buf, buf, blocksize, bid);
 }
 
+fdb_status fdb_decrypt_blocks(encryptor *e,
+                              void *buf,
+                              size_t blocksize,
+                              unsigned num_blocks,
+                              bid_t start_bid)
+{
+#ifdef FDB_LOG_CRYPTO
+    fprintf(stderr, "CRYPT: Decrypting blocks #%llu-%llu with key %d:%llx\n",
+            start_bid, start_bid+num_blocks-1,
+            e->key.algorithm, *(uint64_t*)e->key.bytes);
+#endif
+    if (e->ops->crypt_blocks) {
+        return e->ops->crypt_blocks(e, false, buf, buf, blocksize,
+                                    num_blocks, start_bid);
+    }
+    fdb_status status = FDB_RESULT_SUCCESS;
+    for (unsigned i = 0; i < num_blocks; i++) {
+        status = e->ops->crypt(e,
+                               false,
+                               (uint8_t*)buf + i*blocksize,
+                               (const uint8_t*)buf + i*blocksize,
+                               blocksize,
+                               start_bid + i);
+        if (status != FDB_RESULT_SUCCESS)
+            break;
+    }
+    return status;
+}
+
 fdb_status fdb_encrypt_blocks(encryptor *e,
                               void *dst_buf,
                               const void *src_buf,
@@ -62,6 +91,10 @@ fdb_status fdb_encrypt_blocks(encryptor *e,
             start_bid, start_bid+num_blocks-1,
             e->key.algorithm, *(uint64_t*)e->key.bytes);
 #endif
+    if (e->ops->crypt_blocks) {
+        return e->ops->crypt_blocks(e, true, dst_buf, src_buf, blocksize,
+                                    num_blocks, start_bid);
+    }
     fdb_status status = FDB_RESULT_SUCCESS;
     for (unsigned i = 0; i < num_blocks; i++) {
         status = e->ops->crypt(e,
@@ -79,6 +112,10 @@ fdb_status fdb_encrypt_blocks(encryptor *e,
 const encryption_ops* get_encryption_ops(fdb_encryption_algorithm_t algorithm) {
     switch (algorithm) {
         case FDB_ENCRYPTION_AES256:
+            // prefer AES-NI over the crypto library, if the CPU supports it
+            if (get_aesni_encryption_ops()) {
+                return get_aesni_encryption_ops();
+            }
             return fdb_encryption_ops_aes;
         case FDB_ENCRYPTION_BOGUS:
             return fdb_encryption_ops_bogus;
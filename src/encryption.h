@@ -27,11 +27,16 @@ enum {
     FDB_ENCRYPTION_BOGUS = -1
 };
 
+// Room for expanded keys: 15 AES-256 round keys for each of encryption,
+// decryption and the auxiliary (IV) key.
+#define ENCRYPTOR_ROUND_KEYS_SIZE (3 * 15 * 16)
+
 // An "object" that can perform encryption.
 typedef struct {
     const struct encryption_ops *ops;       // callbacks
     fdb_encryption_key key;                 // key + algorithm
     uint8_t extra[32];                      // scratch space for encryptor to use
+    uint8_t round_keys[ENCRYPTOR_ROUND_KEYS_SIZE]; // expanded keys, if any
 } encryptor;
 
 // Initializes an encryptor given a key.
@@ -44,6 +49,13 @@ fdb_status fdb_decrypt_block(encryptor*,
                              size_t blocksize,
                              bid_t bid);
 
+// Decrypts one or more consecutive blocks of data in place.
+fdb_status fdb_decrypt_blocks(encryptor*,
+                              void *buf,
+                              size_t blocksize,
+                              unsigned num_blocks,
+                              bid_t start_bid);
+
 // Encrypts one or more consecutive blocks of data.
 fdb_status fdb_encrypt_blocks(encryptor*,
                               void *dst_buf,
@@ -61,6 +73,15 @@ typedef struct encryption_ops {
                         const void *src_buf,
                         size_t size,
                         bid_t bid);
+    // Optional. Encrypts or decrypts consecutive blocks in a single call;
+    // if NULL, crypt() is called for each block.
+    fdb_status (*crypt_blocks)(encryptor*,
+                               bool encrypt,
+                               void *dst_buf,
+                               const void *src_buf,
+                               size_t blocksize,
+                               unsigned num_blocks,
+                               bid_t start_bid);
 } encryption_ops;
 
 // Provides the encryption_ops (callbacks) for a particular algorithm.
@@ -71,4 +92,8 @@ const encryption_ops* get_encryption_ops(fdb_encryption_algorithm_t);
 extern const encryption_ops* const fdb_encryption_ops_aes;
 extern const encryption_ops* const fdb_encryption_ops_bogus;
 
+// AES-256 using the AES-NI instructions, compatible with
+// fdb_encryption_ops_aes. Returns NULL if the CPU doesn't support AES-NI.
+const encryption_ops* get_aesni_encryption_ops();
+
 #endif /* _FDB_ENCRYPTION_H */
@@ -56,7 +56,8 @@ static fdb_status aes_crypt(encryptor *e,
 
 static encryption_ops aes_ops = {
     aes_setup,
-    aes_crypt
+    aes_crypt,
+    NULL
 };
 
 const encryption_ops* const fdb_encryption_ops_aes = &aes_ops;
@@ -0,0 +1,437 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * AES-256 encryption using the AES-NI instructions, selected at runtime by
+ * CPU detection. The on-disk format is the same as encryption_aes.cc
+ * (AES-256-CBC per block with an ESSIV derived from the block number), so
+ * files can be read by either implementation.
+ *
+ * Each block is an independent CBC chain. Encryption within a chain is
+ * serial, so consecutive blocks are encrypted in an interleaved way to hide
+ * the latency of the aesenc instruction. Decryption within a chain is
+ * parallel, so each block is decrypted in groups of AES blocks.
+ */
+
+#include <string.h>
+
+#include "encryption.h"
+#include "crypto_primitives.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define AESNI_X86_64
+#include <wmmintrin.h>
+#endif
+
+#ifdef AESNI_X86_64
+
+#define AES_BLOCK (16)
+#define AES256_ROUNDS (14)
+#define AES256_NUM_KEYS (AES256_ROUNDS + 1)
+
+// Number of blocks encrypted together.
+#define AESNI_ENC_LANES (4)
+// Number of AES blocks decrypted together within a block.
+#define AESNI_DEC_LANES (8)
+
+// Offsets of the expanded keys in encryptor::round_keys
+#define AESNI_ENC_KEYS (0)
+#define AESNI_DEC_KEYS (AES256_NUM_KEYS)
+#define AESNI_IV_KEYS (2 * AES256_NUM_KEYS)
+
+#if !SHA256_AVAILABLE
+
+// SHA-256 used only for deriving the ESSIV key when no crypto library is
+// linked.
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t sha256_rotr(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256_block(uint32_t *h, const uint8_t *p)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, hh, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; ++i) {
+        w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) |
+               ((uint32_t)p[i * 4 + 2] << 8) | (uint32_t)p[i * 4 + 3];
+    }
+    for (i = 16; i < 64; ++i) {
+        uint32_t s0 = sha256_rotr(w[i - 15], 7) ^ sha256_rotr(w[i - 15], 18) ^
+                      (w[i - 15] >> 3);
+        uint32_t s1 = sha256_rotr(w[i - 2], 17) ^ sha256_rotr(w[i - 2], 19) ^
+                      (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = h[0]; b = h[1]; c = h[2]; d = h[3];
+    e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+    for (i = 0; i < 64; ++i) {
+        t1 = hh + (sha256_rotr(e, 6) ^ sha256_rotr(e, 11) ^
+                   sha256_rotr(e, 25)) +
+             ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        t2 = (sha256_rotr(a, 2) ^ sha256_rotr(a, 13) ^ sha256_rotr(a, 22)) +
+             ((a & b) ^ (a & c) ^ (b & c));
+        hh = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+static void sha256(const void *src_buf, size_t size, void *digest)
+{
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    const uint8_t *src = (const uint8_t *)src_buf;
+    uint8_t last[128];
+    size_t i, rest, last_len;
+
+    for (i = 0; i + 64 <= size; i += 64) {
+        sha256_block(h, src + i);
+    }
+    // padding: 0x80, zeros, and the message length in bits
+    rest = size - i;
+    last_len = (rest < 56) ? 64 : 128;
+    memset(last, 0, sizeof(last));
+    memcpy(last, src + i, rest);
+    last[rest] = 0x80;
+    uint64_t bits = (uint64_t)size * 8;
+    for (i = 0; i < 8; ++i) {
+        last[last_len - 1 - i] = (uint8_t)(bits >> (i * 8));
+    }
+    sha256_block(h, last);
+    if (last_len == 128) {
+        sha256_block(h, last + 64);
+    }
+
+    uint8_t *out = (uint8_t *)digest;
+    for (i = 0; i < 8; ++i) {
+        out[i * 4] = (uint8_t)(h[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)h[i];
+    }
+}
+
+#endif // !SHA256_AVAILABLE
+
+__attribute__((target("aes")))
+static inline __m128i aes256_expand_even(__m128i prev, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    prev = _mm_xor_si128(prev, _mm_slli_si128(prev, 4));
+    prev = _mm_xor_si128(prev, _mm_slli_si128(prev, 8));
+    return _mm_xor_si128(prev, assist);
+}
+
+__attribute__((target("aes")))
+static inline __m128i aes256_expand_odd(__m128i prev, __m128i even)
+{
+    __m128i assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(even, 0x00),
+                                       0xaa);
+    prev = _mm_xor_si128(prev, _mm_slli_si128(prev, 4));
+    prev = _mm_xor_si128(prev, _mm_slli_si128(prev, 8));
+    return _mm_xor_si128(prev, assist);
+}
+
+// aeskeygenassist takes the round constant as an immediate.
+#define AES256_EXPAND_EVEN(k, i, rcon)                                      \
+    k[i] = aes256_expand_even(k[i - 2],                                     \
+                              _mm_aeskeygenassist_si128(k[i - 1], rcon))
+#define AES256_EXPAND_PAIR(k, i, rcon)                                      \
+    AES256_EXPAND_EVEN(k, i, rcon);                                         \
+    k[i + 1] = aes256_expand_odd(k[i - 1], k[i])
+
+__attribute__((target("aes")))
+static void aes256_expand_key(const uint8_t *key, __m128i *k)
+{
+    k[0] = _mm_loadu_si128((const __m128i *)key);
+    k[1] = _mm_loadu_si128((const __m128i *)(key + AES_BLOCK));
+    AES256_EXPAND_PAIR(k, 2, 0x01);
+    AES256_EXPAND_PAIR(k, 4, 0x02);
+    AES256_EXPAND_PAIR(k, 6, 0x04);
+    AES256_EXPAND_PAIR(k, 8, 0x08);
+    AES256_EXPAND_PAIR(k, 10, 0x10);
+    AES256_EXPAND_PAIR(k, 12, 0x20);
+    AES256_EXPAND_EVEN(k, 14, 0x40);
+}
+
+__attribute__((target("aes")))
+static inline void aesni_load_keys(const encryptor *e, int which, __m128i *k)
+{
+    const __m128i *src = (const __m128i *)e->round_keys + which;
+    for (int i = 0; i < AES256_NUM_KEYS; ++i) {
+        k[i] = _mm_loadu_si128(src + i);
+    }
+}
+
+__attribute__((target("aes")))
+static inline __m128i aes256_encrypt1(__m128i x, const __m128i *k)
+{
+    x = _mm_xor_si128(x, k[0]);
+    for (int r = 1; r < AES256_ROUNDS; ++r) {
+        x = _mm_aesenc_si128(x, k[r]);
+    }
+    return _mm_aesenclast_si128(x, k[AES256_ROUNDS]);
+}
+
+__attribute__((target("aes")))
+static inline __m128i aes256_decrypt1(__m128i x, const __m128i *k)
+{
+    x = _mm_xor_si128(x, k[0]);
+    for (int r = 1; r < AES256_ROUNDS; ++r) {
+        x = _mm_aesdec_si128(x, k[r]);
+    }
+    return _mm_aesdeclast_si128(x, k[AES256_ROUNDS]);
+}
+
+// Loads an AES block, zero-padding it if 'len' is shorter than a block.
+static inline __m128i aesni_load(const uint8_t *src, size_t len)
+{
+    if (len >= AES_BLOCK) {
+        return _mm_loadu_si128((const __m128i *)src);
+    }
+    uint8_t tmp[AES_BLOCK] = {0};
+    memcpy(tmp, src, len);
+    return _mm_loadu_si128((const __m128i *)tmp);
+}
+
+static inline void aesni_store(uint8_t *dst, __m128i x, size_t len)
+{
+    if (len >= AES_BLOCK) {
+        _mm_storeu_si128((__m128i *)dst, x);
+        return;
+    }
+    uint8_t tmp[AES_BLOCK];
+    _mm_storeu_si128((__m128i *)tmp, x);
+    memcpy(dst, tmp, len);
+}
+
+// ESSIV: the block number encrypted with the auxiliary key.
+__attribute__((target("aes")))
+static inline __m128i aesni_essiv(bid_t bid, const __m128i *iv_keys)
+{
+    uint64_t big_block_no = _endian_encode(bid);
+    return aes256_encrypt1(_mm_set_epi64x(0, (long long)big_block_no),
+                           iv_keys);
+}
+
+__attribute__((target("aes")))
+static fdb_status aesni_setup(encryptor *e)
+{
+    __m128i k[AES256_NUM_KEYS];
+    __m128i *dst = (__m128i *)e->round_keys;
+    int i;
+
+    // Same auxiliary key as encryption_aes.cc
+    sha256(&e->key.bytes, sizeof(e->key.bytes), e->extra);
+
+    aes256_expand_key(e->key.bytes, k);
+    for (i = 0; i < AES256_NUM_KEYS; ++i) {
+        _mm_storeu_si128(dst + AESNI_ENC_KEYS + i, k[i]);
+    }
+    // Equivalent inverse cipher: reversed keys with InvMixColumns applied
+    _mm_storeu_si128(dst + AESNI_DEC_KEYS, k[AES256_ROUNDS]);
+    for (i = 1; i < AES256_ROUNDS; ++i) {
+        _mm_storeu_si128(dst + AESNI_DEC_KEYS + i,
+                         _mm_aesimc_si128(k[AES256_ROUNDS - i]));
+    }
+    _mm_storeu_si128(dst + AESNI_DEC_KEYS + AES256_ROUNDS, k[0]);
+
+    aes256_expand_key(e->extra, k);
+    for (i = 0; i < AES256_NUM_KEYS; ++i) {
+        _mm_storeu_si128(dst + AESNI_IV_KEYS + i, k[i]);
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
+// Encrypts up to AESNI_ENC_LANES blocks, with their CBC chains interleaved.
+__attribute__((target("aes")))
+static void aesni_encrypt_lanes(const __m128i *k,
+                                const __m128i *iv_keys,
+                                uint8_t *dst,
+                                const uint8_t *src,
+                                size_t blocksize,
+                                unsigned lanes,
+                                bid_t bid)
+{
+    __m128i c[AESNI_ENC_LANES];
+    unsigned j;
+    int r;
+
+    for (j = 0; j < lanes; ++j) {
+        c[j] = aesni_essiv(bid + j, iv_keys);
+    }
+    for (size_t off = 0; off < blocksize; off += AES_BLOCK) {
+        size_t len = blocksize - off;
+        for (j = 0; j < lanes; ++j) {
+            c[j] = _mm_xor_si128(c[j],
+                                 aesni_load(src + j * blocksize + off, len));
+            c[j] = _mm_xor_si128(c[j], k[0]);
+        }
+        for (r = 1; r < AES256_ROUNDS; ++r) {
+            for (j = 0; j < lanes; ++j) {
+                c[j] = _mm_aesenc_si128(c[j], k[r]);
+            }
+        }
+        for (j = 0; j < lanes; ++j) {
+            c[j] = _mm_aesenclast_si128(c[j], k[AES256_ROUNDS]);
+            aesni_store(dst + j * blocksize + off, c[j], len);
+        }
+    }
+}
+
+// Decrypts a block, AESNI_DEC_LANES AES blocks at a time.
+__attribute__((target("aes")))
+static void aesni_decrypt_block(const __m128i *k,
+                                const __m128i *iv_keys,
+                                uint8_t *dst,
+                                const uint8_t *src,
+                                size_t blocksize,
+                                bid_t bid)
+{
+    __m128i prev = aesni_essiv(bid, iv_keys);
+    __m128i c[AESNI_DEC_LANES], x[AESNI_DEC_LANES];
+    size_t off = 0;
+    int j, r;
+
+    for (; off + AESNI_DEC_LANES * AES_BLOCK <= blocksize;
+         off += AESNI_DEC_LANES * AES_BLOCK) {
+        // load all ciphertexts first, as 'dst' may be the same as 'src'
+        for (j = 0; j < AESNI_DEC_LANES; ++j) {
+            c[j] = _mm_loadu_si128((const __m128i *)(src + off) + j);
+            x[j] = _mm_xor_si128(c[j], k[0]);
+        }
+        for (r = 1; r < AES256_ROUNDS; ++r) {
+            for (j = 0; j < AESNI_DEC_LANES; ++j) {
+                x[j] = _mm_aesdec_si128(x[j], k[r]);
+            }
+        }
+        for (j = 0; j < AESNI_DEC_LANES; ++j) {
+            x[j] = _mm_aesdeclast_si128(x[j], k[AES256_ROUNDS]);
+        }
+        x[0] = _mm_xor_si128(x[0], prev);
+        for (j = 1; j < AESNI_DEC_LANES; ++j) {
+            x[j] = _mm_xor_si128(x[j], c[j - 1]);
+        }
+        prev = c[AESNI_DEC_LANES - 1];
+        for (j = 0; j < AESNI_DEC_LANES; ++j) {
+            _mm_storeu_si128((__m128i *)(dst + off) + j, x[j]);
+        }
+    }
+    for (; off < blocksize; off += AES_BLOCK) {
+        size_t len = blocksize - off;
+        __m128i cur = aesni_load(src + off, len);
+        aesni_store(dst + off,
+                    _mm_xor_si128(aes256_decrypt1(cur, k), prev), len);
+        prev = cur;
+    }
+}
+
+__attribute__((target("aes")))
+static fdb_status aesni_crypt_blocks(encryptor *e,
+                                     bool encrypt,
+                                     void *dst_buf,
+                                     const void *src_buf,
+                                     size_t blocksize,
+                                     unsigned num_blocks,
+                                     bid_t start_bid)
+{
+    __m128i k[AES256_NUM_KEYS], iv_keys[AES256_NUM_KEYS];
+    uint8_t *dst = (uint8_t *)dst_buf;
+    const uint8_t *src = (const uint8_t *)src_buf;
+    unsigned i;
+
+    aesni_load_keys(e, AESNI_IV_KEYS, iv_keys);
+    if (encrypt) {
+        aesni_load_keys(e, AESNI_ENC_KEYS, k);
+        for (i = 0; i < num_blocks; i += AESNI_ENC_LANES) {
+            unsigned lanes = num_blocks - i;
+            if (lanes > AESNI_ENC_LANES) {
+                lanes = AESNI_ENC_LANES;
+            }
+            aesni_encrypt_lanes(k, iv_keys, dst + i * blocksize,
+                                src + i * blocksize, blocksize, lanes,
+                                start_bid + i);
+        }
+    } else {
+        aesni_load_keys(e, AESNI_DEC_KEYS, k);
+        for (i = 0; i < num_blocks; ++i) {
+            aesni_decrypt_block(k, iv_keys, dst + i * blocksize,
+                                src + i * blocksize, blocksize,
+                                start_bid + i);
+        }
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
+static fdb_status aesni_crypt(encryptor *e,
+                              bool encrypt,
+                              void *dst_buf,
+                              const void *src_buf,
+                              size_t size,
+                              bid_t bid)
+{
+    return aesni_crypt_blocks(e, encrypt, dst_buf, src_buf, size, 1, bid);
+}
+
+static encryption_ops aesni_ops = {
+    aesni_setup,
+    aesni_crypt,
+    aesni_crypt_blocks
+};
+
+static const encryption_ops* aesni_select()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("aes")) {
+        return &aesni_ops;
+    }
+    return NULL;
+}
+
+const encryption_ops* get_aesni_encryption_ops()
+{
+    static const encryption_ops* const ops = aesni_select();
+    return ops;
+}
+
+#else // AES-NI not available:
+
+const encryption_ops* get_aesni_encryption_ops()
+{
+    return NULL;
+}
+
+#endif // AESNI_X86_64
@@ -44,7 +44,8 @@ static fdb_status bogus_crypt(encryptor *e,
 
 static encryption_ops bogus_ops = {
     bogus_setup,
-    bogus_crypt
+    bogus_crypt,
+    NULL
 };
 
 const encryption_ops* const fdb_encryption_ops_bogus = &bogus_ops;
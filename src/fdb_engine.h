@@ -220,6 +220,21 @@ public:
                    fdb_doc *doc,
                    bool metaOnly);
 
+    /**
+     * Retrieve the metadata and doc body for a given key into a doc view,
+     * without copying them into separately allocated buffers.
+     *
+     * @param handle Pointer to ForestDB KV store handle.
+     * @param key Pointer to the key.
+     * @param keylen Length of the key.
+     * @param view Pointer to doc view instance to be populated.
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status getView(FdbKvsHandle *handle,
+                       const void *key,
+                       size_t keylen,
+                       fdb_doc_view *view);
+
     /**
      * Retrieve the metadata and doc body for a given sequence number.
      * Note that FDB_DOC instance should be created by calling
@@ -424,6 +439,20 @@ public:
                        bool clone_docs,
                        const fdb_encryption_key *new_encryption_key);
 
+    /**
+     * Incrementally compact the current file in place, by relocating only the
+     * live documents of its most fragmented blocks.
+     *
+     * @param fhandle Pointer to ForestDB file handle
+     * @param min_stale_ratio Minimum percentage of stale data in a block for
+     *        the block to be relocated
+     * @param max_blocks Maximum number of blocks to be relocated
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status compactIncremental(FdbFileHandle *fhandle,
+                                  uint8_t min_stale_ratio,
+                                  size_t max_blocks);
+
     /**
      * Cancel the compaction task if it is running currently.
      *
@@ -559,6 +588,17 @@ public:
      */
     fdb_status getKvsSeqnum(FdbKvsHandle *handle, fdb_seqnum_t *seqnum);
 
+    /**
+     * Train a zstd compression dictionary from the documents of a KV store,
+     * and use it for the documents subsequently written through the handle.
+     *
+     * @param handle Pointer to KV store handle.
+     * @param max_dict_size Maximum size of the dictionary in bytes.
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status trainCompressionDict(FdbKvsHandle *handle,
+                                    size_t max_dict_size);
+
     /**
      * Return the name of the latency stat
      *
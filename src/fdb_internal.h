@@ -79,6 +79,10 @@ fdb_status fdb_log(ErrLogCallback *callback,
 
 fdb_status _fdb_clone_snapshot(FdbKvsHandle *handle_in,
                                FdbKvsHandle *handle_out);
+fdb_status _fdb_find_doc_offset(FdbKvsHandle *handle, fdb_doc *doc,
+                                uint64_t *offset, bool *in_wal);
+
+void _fdb_set_doc_codec(FdbKvsHandle *handle);
 
 fdb_status fdb_check_file_reopen(FdbKvsHandle *handle, file_status_t *status);
 void fdb_sync_db_header(FdbKvsHandle *handle);
@@ -177,6 +181,18 @@ void fdb_kvs_set_seqnum(FileMgr *file,
                         fdb_kvs_id_t id,
                         fdb_seqnum_t seqnum);
 
+uint64_t fdb_kvs_get_dict_offset(FileMgr *file, fdb_kvs_id_t id);
+
+void fdb_kvs_set_dict_offset(FileMgr *file,
+                             fdb_kvs_id_t id,
+                             uint64_t dict_offset);
+
+fdb_compression_codec_t fdb_kvs_get_codec(FileMgr *file, fdb_kvs_id_t id);
+
+void fdb_kvs_set_codec(FileMgr *file,
+                       fdb_kvs_id_t id,
+                       fdb_compression_codec_t codec);
+
 /**
  * Return the smallest commit revision number that are currently being referred.
  *
@@ -25,6 +25,7 @@
 #include <sys/time.h>
 #endif
 
+#include <algorithm>
 #include <sstream>
 
 #include "filemgr.h"
@@ -32,12 +33,14 @@
 #include "hash_functions.h"
 #include "blockcache.h"
 #include "bnodecache.h"
+#include "bloomfilter.h"
 #include "wal.h"
 #include "list.h"
 #include "fdb_internal.h"
 #include "time_utils.h"
 #include "executorpool.h"
 #include "version.h"
+#include "ratelimiter.h"
 
 #include "memleak.h"
 
@@ -63,6 +66,7 @@ spin_t FileMgr::fileMgrOpenlock;
 
 struct list FileMgr::tempBuf;
 spin_t FileMgr::tempBufLock;
+MemoryPool *FileMgr::alignedBufPool(nullptr);
 bool FileMgr::lazyFileDeletionEnabled(false);
 register_file_removal_func FileMgr::registerFileRemoval(nullptr);
 check_file_removal_func FileMgr::isFileRemoved(nullptr);
@@ -280,12 +284,17 @@ void FileMgrMap::freeEntries(filemgr_factory_free_cb free_callback) {
 FileMgr::FileMgr()
     : refCount(1), fMgrFlags(0x00), blockSize(global_config.getBlockSize()),
       fopsHandle(nullptr), lastPos(0), lastCommit(0), lastWritableBmpRevnum(0),
+      idxRegionNext(BLK_NOT_FOUND), idxRegionEnd(BLK_NOT_FOUND),
+      idxRegionSize(0),
+      idxCarryBegin(BLK_NOT_FOUND), idxCarryEnd(BLK_NOT_FOUND),
       ioInprog(0), fMgrWal(nullptr), exPoolCtx(this), fMgrOps(nullptr),
       fMgrStatus(FILE_NORMAL), fileConfig(nullptr), bCache(nullptr),
       bnodeCache(nullptr), inPlaceCompaction(false),
       fsType(0), kvHeader(nullptr), throttlingDelay(0), fMgrVersion(0),
-      fMgrSb(nullptr), kvsStatOps(this), crcMode(CRC_DEFAULT),
-      staleData(nullptr), latestDirtyUpdate(nullptr),
+      fMgrSb(nullptr), kvsStatOps(this), appendNext(0), appendDone(0),
+      appendFailed(false), appendIssuerTicket(0), crcMode(CRC_DEFAULT),
+      staleData(nullptr), keyFilter(nullptr), blobFiles(nullptr),
+      latestDirtyUpdate(nullptr),
       bcacheHits(0), bcacheMisses(0)
 {
 
@@ -305,6 +314,8 @@ FileMgr::FileMgr()
 
     spin_init(&fMgrLock);
 
+    memset(appendWritten, 0, sizeof(appendWritten));
+
 #ifdef __FILEMGR_DATA_PARTIAL_LOCK
     struct plock_ops pops;
     struct plock_config pconfig;
@@ -340,6 +351,9 @@ FileMgr::FileMgr()
 
     mutex_init(&writerLock.mutex);
     writerLock.locked = false;
+    for (int j = 0; j < DLOCK_MAX; ++j) {
+        mutex_init(&sectorLock[j]);
+    }
 
     memset(&fMgrEncryption, 0, sizeof(encryptor));
 
@@ -375,11 +389,21 @@ FileMgr::~FileMgr()
 #endif //__FILEMGR_DATA_PARTIAL_LOCK
 
     mutex_destroy(&writerLock.mutex);
+    for (int j = 0; j < DLOCK_MAX; ++j) {
+        mutex_destroy(&sectorLock[j]);
+    }
 
     dirtyUpdateFree();
 
     freeFileHandleIdx();
     spin_destroy(&handleIdxLock);
+
+    delete keyFilter;
+    delete blobFiles;
+
+    for (auto &entry : codecDicts) {
+        doc_codec_dict_free(entry.second);
+    }
  }
 
 void FileMgr::init(FileMgrConfig *config)
@@ -410,6 +434,11 @@ void FileMgr::init(FileMgrConfig *config)
             list_init(&tempBuf);
             spin_init(&tempBufLock);
 
+            // initialize aligned buffer pool for direct I/O
+            alignedBufPool = new MemoryPool(FILEMGR_ALIGNED_BUF_BINS,
+                                            global_config.getBlockSize(),
+                                            FDB_SECTOR_SIZE);
+
             // initialize global lock
             spin_init(&fileMgrOpenlock);
 
@@ -485,11 +514,139 @@ void FileMgr::shutdownTempBuf()
     spin_unlock(&tempBufLock);
 }
 
+int FileMgr::allocateAlignedBuffer(uint8_t **buf, size_t size)
+{
+    if (alignedBufPool && size <= (size_t)global_config.getBlockSize()) {
+        int index = alignedBufPool->fetchBlock(buf);
+        if (index >= 0) {
+            return index;
+        }
+    }
+    void *addr = NULL;
+    malloc_align(addr, FDB_SECTOR_SIZE, size);
+    *buf = (uint8_t *)addr;
+    return -1;
+}
+
+void FileMgr::deallocateAlignedBuffer(uint8_t *buf, int index)
+{
+    if (alignedBufPool && index >= 0) {
+        alignedBufPool->returnBlock(index);
+    } else {
+        free_align(buf);
+    }
+}
+
+INLINE bool _is_sector_aligned(const void *buf, size_t nbytes,
+                               cs_off_t offset)
+{
+    return ((uintptr_t)buf % FDB_SECTOR_SIZE) == 0 &&
+           (nbytes % FDB_SECTOR_SIZE) == 0 &&
+           (offset % FDB_SECTOR_SIZE) == 0;
+}
+
+ssize_t FileMgr::preadAligned(void *buf, size_t nbytes, cs_off_t offset) {
+    if (!isDirectIO() || _is_sector_aligned(buf, nbytes, offset)) {
+        return fMgrOps->pread(fopsHandle, buf, nbytes, offset);
+    }
+
+    // read the sectors covering the requested range
+    size_t head = offset % FDB_SECTOR_SIZE;
+    size_t span = (head + nbytes + FDB_SECTOR_SIZE - 1) /
+                  FDB_SECTOR_SIZE * FDB_SECTOR_SIZE;
+    uint8_t *abuf;
+    int index = allocateAlignedBuffer(&abuf, span);
+    ssize_t r = fMgrOps->pread(fopsHandle, abuf, span, offset - head);
+    if (r >= 0) {
+        // the range may be cut by the end of the file
+        r = (r > (ssize_t)head) ? std::min((size_t)r - head, nbytes) : 0;
+        memcpy(buf, abuf + head, r);
+    }
+    deallocateAlignedBuffer(abuf, index);
+    return r;
+}
+
+ssize_t FileMgr::pwriteAligned(void *buf, size_t nbytes, cs_off_t offset) {
+    if (!isDirectIO() || _is_sector_aligned(buf, nbytes, offset)) {
+        return fMgrOps->pwrite(fopsHandle, buf, nbytes, offset);
+    }
+
+    size_t head = offset % FDB_SECTOR_SIZE;
+    size_t span = (head + nbytes + FDB_SECTOR_SIZE - 1) /
+                  FDB_SECTOR_SIZE * FDB_SECTOR_SIZE;
+    cs_off_t start = offset - head;
+    uint8_t *abuf;
+    int index = allocateAlignedBuffer(&abuf, span);
+    ssize_t r = 0;
+
+    // Lock the first and last sectors, which are read and written back as a
+    // whole, so that a concurrent partial write of the same sector is not
+    // overwritten by its stale copy. Locks are taken in order.
+    size_t lock_first = (start / FDB_SECTOR_SIZE) % DLOCK_MAX;
+    size_t lock_last = ((start + span) / FDB_SECTOR_SIZE - 1) % DLOCK_MAX;
+    if (lock_first > lock_last) {
+        std::swap(lock_first, lock_last);
+    }
+    mutex_lock(&sectorLock[lock_first]);
+    if (lock_last != lock_first) {
+        mutex_lock(&sectorLock[lock_last]);
+    }
+
+    // preserve the rest of the first and last sectors, which are
+    // zero-filled if they are beyond the end of the file
+    if (head) {
+        r = fMgrOps->pread(fopsHandle, abuf, FDB_SECTOR_SIZE, start);
+        if (r >= 0) {
+            memset(abuf + r, 0x0, FDB_SECTOR_SIZE - r);
+        }
+    }
+    if (r >= 0 && (head + nbytes) % FDB_SECTOR_SIZE &&
+        (span > FDB_SECTOR_SIZE || !head)) {
+        uint8_t *last = abuf + span - FDB_SECTOR_SIZE;
+        r = fMgrOps->pread(fopsHandle, last, FDB_SECTOR_SIZE,
+                           start + span - FDB_SECTOR_SIZE);
+        if (r >= 0) {
+            memset(last + r, 0x0, FDB_SECTOR_SIZE - r);
+        }
+    }
+    if (r >= 0) {
+        memcpy(abuf + head, buf, nbytes);
+        r = fMgrOps->pwrite(fopsHandle, abuf, span, start);
+    }
+
+    if (lock_last != lock_first) {
+        mutex_unlock(&sectorLock[lock_last]);
+    }
+    mutex_unlock(&sectorLock[lock_first]);
+    deallocateAlignedBuffer(abuf, index);
+    if (r < 0) {
+        return r;
+    }
+    return r == (ssize_t)span ? (ssize_t)nbytes : 0;
+}
+
 // Read a block from the file, decrypting if necessary.
 ssize_t FileMgr::readBlock(void *buf, bid_t bid) {
     return readBuf(buf, blockSize, blockSize * bid);
 }
 
+// Read consecutive block(s) from the file, decrypting if necessary.
+ssize_t FileMgr::readBlocks(void *buf, unsigned num_blocks, bid_t start_bid) {
+    size_t nbytes = (size_t)num_blocks * blockSize;
+    ssize_t result = preadAligned(buf, nbytes, start_bid * blockSize);
+    if (result != (ssize_t)nbytes || fMgrEncryption.ops == nullptr) {
+        return result;
+    }
+    fdb_status status = fdb_decrypt_blocks(&fMgrEncryption, buf, blockSize,
+                                           num_blocks, start_bid);
+    if (status != FDB_RESULT_SUCCESS) {
+        fdb_log(nullptr, status,
+                "FileMgr::readBlocks: fdb_decrypt_blocks failed!");
+        return status;
+    }
+    return result;
+}
+
 // Write consecutive block(s) to the file, encrypting if necessary.
 ssize_t FileMgr::writeBlocks(void *buf, unsigned num_blocks,
                              bid_t start_bid) {
@@ -511,7 +668,7 @@ ssize_t FileMgr::readBuf(void* buf, size_t nbytes, cs_off_t offset) {
         return FDB_RESULT_READ_FAIL;
     }
     if (fMgrEncryption.ops == nullptr) {
-        return fMgrOps->pread(fopsHandle, buf, nbytes, offset);
+        return preadAligned(buf, nbytes, offset);
     } else {    // Decryption (at a block level)
         void* new_buf;
         size_t new_nbytes;
@@ -533,8 +690,7 @@ ssize_t FileMgr::readBuf(void* buf, size_t nbytes, cs_off_t offset) {
             new_nbytes = nbytes;
         }
 
-        ssize_t result = fMgrOps->pread(fopsHandle, new_buf,
-                                        new_nbytes, new_offset);
+        ssize_t result = preadAligned(new_buf, new_nbytes, new_offset);
 
         if (result != (ssize_t)new_nbytes) {
             if (new_offset != offset) {
@@ -572,7 +728,7 @@ ssize_t FileMgr::readBuf(void* buf, size_t nbytes, cs_off_t offset) {
 // Write buf to file, encrypting if necessary.
 ssize_t FileMgr::writeBuf(void* buf, size_t nbytes, cs_off_t offset) {
     if (fMgrEncryption.ops == nullptr) {
-        return fMgrOps->pwrite(fopsHandle, buf, nbytes, offset);
+        return pwriteAligned(buf, nbytes, offset);
     } else {    // Encryption (at a block level)
         void* new_buf;
         size_t new_nbytes;
@@ -631,19 +787,28 @@ ssize_t FileMgr::writeBuf(void* buf, size_t nbytes, cs_off_t offset) {
             free(new_buf);
         }
 
-        if (new_nbytes > FDB_BLOCKSIZE) {
-            free(encrypted_buf);
+        ssize_t result = status;
+        if (status == FDB_RESULT_SUCCESS) {
+            // the leading bytes of the first block are written back as well
+            result = pwriteAligned(encrypted_buf, new_nbytes, new_offset);
+            if (result == static_cast<ssize_t>(new_nbytes)) {
+                result = nbytes;
+            }
         }
 
-        if (status != FDB_RESULT_SUCCESS) {
-            return status;
+        if (new_nbytes > FDB_BLOCKSIZE) {
+            free(encrypted_buf);
         }
 
-        return fMgrOps->pwrite(fopsHandle, encrypted_buf, nbytes, offset);
+        return result;
     }
 }
 
 int FileMgr::isWritable(bid_t bid) {
+    if (bid >= idxCarryBegin.load() && bid < idxCarryEnd.load()) {
+        // index region blocks allocated after the last commit
+        return true;
+    }
     if (fMgrSb && fMgrSb->bmpExists()) {
         // block reusing is enabled
         return fMgrSb->isWritable(bid);
@@ -829,11 +994,9 @@ fdb_status FileMgr::readHeader(ErrLogCallback *log_callback)
                         crc32 = get_checksum(reinterpret_cast<const uint8_t*>(buf),
                                              len - sizeof(crc),
                                              CRC32);
-#ifdef _CRC32C
                         crc32c = get_checksum(reinterpret_cast<const uint8_t*>(buf),
                                               len - sizeof(crc),
                                               CRC32C);
-#endif
                         const char *msg = "Crash Detected: CRC on disk %u != (%u | %u) "
                             "in a database file '%s'\n";
                         DBG(msg, crc_file, crc32, crc32c, getFileName());
@@ -1023,6 +1186,178 @@ void FileMgr::prefetch(ErrLogCallback *log_callback)
     releaseSpinLock();
 }
 
+size_t FileMgr::readAhead(bid_t start_bid, size_t num_blocks,
+                          ErrLogCallback *log_callback)
+{
+    // Applies to block-aligned buffer cache only for now
+    if (global_config.getNcacheBlock() == 0 ||
+        ver_btreev2_format(getVersion())) {
+        return 0;
+    }
+
+    BlockCacheManager *bcache = BlockCacheManager::getInstance();
+    // Only committed blocks are loaded, as uncommitted blocks may be
+    // overwritten by the writer.
+    bid_t end_bid = getLastCommit() / blockSize;
+    if (end_bid > start_bid + num_blocks) {
+        end_bid = start_bid + num_blocks;
+    }
+    // Don't let readahead evict more than half of the free cache space.
+    uint64_t max_blocks = bcache->getNumFreeBlocks() / 2;
+    if (end_bid > start_bid + max_blocks) {
+        end_bid = start_bid + max_blocks;
+    }
+    if (start_bid >= end_bid) {
+        return 0;
+    }
+
+    uint8_t *buf = nullptr;
+    size_t num_loaded = 0;
+    bid_t bid = start_bid;
+
+    while (bid < end_bid) {
+        // skip blocks that are cached or not committed yet
+        if (isWritable(bid) || bcache->isCached(this, bid)) {
+            ++bid;
+            continue;
+        }
+
+        // find the run of uncached blocks starting from 'bid'
+        bid_t run_end = bid + 1;
+        while (run_end < end_bid && !isWritable(run_end) &&
+               !bcache->isCached(this, run_end)) {
+            ++run_end;
+        }
+
+        if (!buf) {
+            // aligned for the direct I/O mode
+            void *addr = NULL;
+            malloc_align(addr, FDB_SECTOR_SIZE,
+                         (end_bid - start_bid) * blockSize);
+            buf = (uint8_t*)addr;
+            if (!buf) { // LCOV_EXCL_START
+                return num_loaded;
+            } // LCOV_EXCL_STOP
+        }
+
+        unsigned nblocks = run_end - bid;
+        ssize_t r = readBlocks(buf, nblocks, bid);
+        if (r != (ssize_t)(nblocks * blockSize)) {
+            // Readahead is best-effort; the regular read path will report
+            // the error when the block is actually accessed.
+            _log_errno_str(fopsHandle, fMgrOps, log_callback,
+                           (fdb_status) r, "READ", fileName);
+            break;
+        }
+
+        for (unsigned i = 0; i < nblocks; ++i) {
+            uint8_t *block = buf + i * blockSize;
+            if (checkCRC32(block) != FDB_RESULT_SUCCESS) {
+                break;
+            }
+            if (bcache->write(this, bid + i, block, BCACHE_REQ_CLEAN,
+                              false) != (int)blockSize) {
+                break;
+            }
+            ++num_loaded;
+        }
+        bid = run_end;
+    }
+
+    free_align(buf);
+    return num_loaded;
+}
+
+fdb_status FileMgr::readBlocksVectored(bid_t start_bid, size_t num_blocks,
+                                       size_t meta_size, void *buf_out,
+                                       void *meta_out, void *tail_out,
+                                       ErrLogCallback *log_callback)
+{
+    if (!fMgrOps->preadv || fMgrEncryption.ops || isDirectIO() ||
+        !num_blocks || meta_size >= blockSize) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    size_t total = num_blocks + (tail_out ? 1 : 0);
+    // Uncommitted blocks may be dirty in the block cache, or overwritten
+    // by the writer.
+    if ((start_bid + total) * blockSize > getLastCommit()) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    for (size_t i = 0; i < total; ++i) {
+        if (isWritable(start_bid + i)) {
+            return FDB_RESULT_INVALID_ARGS;
+        }
+    }
+
+    bool use_cache = global_config.getNcacheBlock() > 0 &&
+                     !ver_btreev2_format(getVersion());
+    BlockCacheManager *bcache = BlockCacheManager::getInstance();
+    size_t data_size = blockSize - meta_size;
+    uint8_t *probe = use_cache ? alca(uint8_t, blockSize) : NULL;
+    fdb_iovec_t *iov = alca(fdb_iovec_t, FILEMGR_MAX_IOVCNT);
+    int iovcnt = 0;
+    bid_t run_bid = start_bid;
+
+    for (size_t i = 0; i <= total; ++i) {
+        bid_t bid = start_bid + i;
+        bool tail = tail_out && i == num_blocks;
+        bool cached = false;
+        if (i < total && use_cache) {
+            if (tail) {
+                cached = bcache->read(this, bid, tail_out) > 0;
+            } else if (bcache->read(this, bid, probe) > 0) {
+                memcpy((uint8_t*)buf_out + i * data_size, probe, data_size);
+                memcpy((uint8_t*)meta_out + i * meta_size, probe + data_size,
+                       meta_size);
+                cached = true;
+            }
+            if (cached) {
+                incrBlockCacheHits();
+            } else {
+                incrBlockCacheMisses();
+            }
+        }
+
+        // issue the pending run if it ends here, or is full
+        if (iovcnt && (i == total || cached ||
+                       iovcnt + 2 > FILEMGR_MAX_IOVCNT)) {
+            size_t nbytes = (bid - run_bid) * blockSize;
+            ssize_t r = fMgrOps->preadv(fopsHandle, iov, iovcnt,
+                                        run_bid * blockSize);
+            if (r != (ssize_t)nbytes) {
+                _log_errno_str(fopsHandle, fMgrOps, log_callback,
+                               (fdb_status) r, "READ", fileName);
+                const char *msg = "Read error: BIDs %" _F64 " ~ %" _F64
+                                  " in a database file '%s' are not read "
+                                  "correctly: only %d bytes read";
+                fdb_log(log_callback, FDB_RESULT_READ_FAIL, msg, run_bid,
+                        bid - 1, fileName, (int)r);
+                return r < 0 ? (fdb_status) r : FDB_RESULT_READ_FAIL;
+            }
+            iovcnt = 0;
+        }
+        if (i == total || cached) {
+            continue;
+        }
+
+        if (!iovcnt) {
+            run_bid = bid;
+        }
+        if (tail) {
+            iov[iovcnt].base = tail_out;
+            iov[iovcnt++].len = blockSize;
+            continue;
+        }
+        iov[iovcnt].base = (uint8_t*)buf_out + i * data_size;
+        iov[iovcnt++].len = data_size;
+        if (meta_size) {
+            iov[iovcnt].base = (uint8_t*)meta_out + i * meta_size;
+            iov[iovcnt++].len = meta_size;
+        }
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
 fdb_status FileMgr::doesFileExist(const char *filename) {
     struct filemgr_ops *ops = get_filemgr_ops();
     fdb_fileops_handle fops_handle;
@@ -1225,6 +1560,7 @@ filemgr_open_result FileMgr::open(std::string filename,
     file->fileConfig->setBlockSize(global_config.getBlockSize());
     file->fileConfig->setNcacheBlock(global_config.getNcacheBlock());
     file->fopsHandle = fops_handle;
+    file->blobFiles = new BlobFileSet(filename, ops);
 
     cs_off_t offset = file->fMgrOps->goto_eof(file->fopsHandle);
     if (offset < 0) {
@@ -1241,6 +1577,12 @@ filemgr_open_result FileMgr::open(std::string filename,
     file->lastPos = offset;
     file->lastCommit = offset;
 
+    if (offset == 0 && config->getBloomBitsPerKey()) {
+        // A new empty file: every key will be added through WAL flushes,
+        // so the key filter can be trusted for negative lookups.
+        file->keyFilter = new KeyFilter(config->getBloomBitsPerKey());
+    }
+
     // Note: CRC must be initialized before superblock loading
     // initialize CRC mode
     if (file->fileConfig && file->fileConfig->getOptions() & FILEMGR_CREATE_CRC32) {
@@ -1860,6 +2202,27 @@ fdb_status FileMgr::close(FileMgr *file,
     return (fdb_status) rv;
 }
 
+doc_codec_dict* FileMgr::getCodecDict(uint64_t dict_offset)
+{
+    std::lock_guard<std::mutex> lock(codecDictLock);
+    auto entry = codecDicts.find(dict_offset);
+    if (entry == codecDicts.end()) {
+        return NULL;
+    }
+    return entry->second;
+}
+
+doc_codec_dict* FileMgr::addCodecDict(uint64_t dict_offset,
+                                      doc_codec_dict *dict)
+{
+    std::lock_guard<std::mutex> lock(codecDictLock);
+    auto ret = codecDicts.insert(std::make_pair(dict_offset, dict));
+    if (!ret.second) {
+        doc_codec_dict_free(dict);
+    }
+    return ret.first->second;
+}
+
 void FileMgr::removeAllBufferBlocks() {
     // remove all cached blocks
     if (global_config.getNcacheBlock() > 0) {
@@ -1992,6 +2355,8 @@ fdb_status FileMgr::shutdown()
             }
             fileMgrInitialized.store(false);
             shutdownTempBuf();
+            delete alignedBufPool;
+            alignedBufPool = nullptr;
         } else {
             ret = FDB_RESULT_FILE_IS_BUSY;
         }
@@ -2016,7 +2381,7 @@ bid_t FileMgr::alloc_FileMgr(ErrLogCallback *log_callback) {
     if (global_config.getNcacheBlock() <= 0) {
         // if block cache is turned off, write the allocated block before use
         uint8_t _buf = 0x0;
-        ssize_t rv = fMgrOps->pwrite(fopsHandle, &_buf, 1,
+        ssize_t rv = pwriteAligned(&_buf, 1,
                                      (bid + 1) * blockSize - 1);
         _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status) rv,
                        "WRITE", fileName);
@@ -2026,6 +2391,55 @@ bid_t FileMgr::alloc_FileMgr(ErrLogCallback *log_callback) {
     return bid;
 }
 
+bid_t FileMgr::allocIndexBlock(ErrLogCallback *log_callback) {
+    uint32_t region_blocks = fileConfig->getIndexRegionBlocks();
+    if (region_blocks <= 1 && idxRegionNext.load() == BLK_NOT_FOUND) {
+        return alloc_FileMgr(log_callback);
+    }
+
+    acquireSpinLock();
+    bid_t bid = idxRegionNext.load();
+    if (bid == BLK_NOT_FOUND) {
+        if (region_blocks <= 1 ||
+            (getFileStatus() == FILE_NORMAL && fMgrSb &&
+             fMgrSb->getNumFreeBlocks())) {
+            // reusable blocks should be consumed first
+            releaseSpinLock();
+            return alloc_FileMgr(log_callback);
+        }
+
+        // Start a new region at the end of the file. As it is located beyond
+        // the last commit position, its blocks are writable until the next
+        // commit without being tracked by 'idxCarryBegin/End'.
+        // The region size grows geometrically up to the configured size, so
+        // that small files do not end with a large unused region.
+        idxRegionSize = std::max(idxRegionSize * 2,
+                                 (uint32_t)FILEMGR_MIN_INDEX_REGION_BLOCKS);
+        idxRegionSize = std::min(idxRegionSize, region_blocks);
+        bid = lastPos.load() / blockSize;
+        idxRegionEnd = bid + idxRegionSize - 1;
+        lastPos.fetch_add(blockSize * idxRegionSize);
+
+        if (global_config.getNcacheBlock() <= 0) {
+            // if block cache is turned off, write the allocated block before use
+            uint8_t _buf = 0x0;
+            ssize_t rv = pwriteAligned(&_buf, 1,
+                                         lastPos.load() - 1);
+            _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status) rv,
+                           "WRITE", fileName);
+        }
+    }
+
+    if (bid == idxCarryEnd.load()) {
+        // the region was allocated before the last commit
+        idxCarryEnd.store(bid + 1);
+    }
+    idxRegionNext.store(bid == idxRegionEnd ? BLK_NOT_FOUND : bid + 1);
+    releaseSpinLock();
+
+    return bid;
+}
+
 // Note that both alloc_multiple & alloc_multiple_cond are not used in
 // the new version of DB file (with superblock support).
 void FileMgr::allocMultiple(int nblock, bid_t *begin,
@@ -2038,7 +2452,7 @@ void FileMgr::allocMultiple(int nblock, bid_t *begin,
     if (global_config.getNcacheBlock() <= 0) {
         // if block cache is turned off, write the allocated block before use
         uint8_t _buf = 0x0;
-        ssize_t rv = fMgrOps->pwrite(fopsHandle, &_buf, 1, lastPos.load() - 1);
+        ssize_t rv = pwriteAligned(&_buf, 1, lastPos.load() - 1);
         _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status) rv,
                        "WRITE", fileName);
     }
@@ -2062,7 +2476,7 @@ bid_t FileMgr::allocMultipleCond(bid_t nextbid, int nblock,
         if (global_config.getNcacheBlock() <= 0) {
             // if block cache is turned off, write the allocated block before use
             uint8_t _buf = 0x0;
-            ssize_t rv = fMgrOps->pwrite(fopsHandle, &_buf, 1, lastPos.load());
+            ssize_t rv = pwriteAligned(&_buf, 1, lastPos.load());
             _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status) rv,
                            "WRITE", fileName);
         }
@@ -2178,6 +2592,12 @@ fdb_status FileMgr::read_FileMgr(bid_t bid, void *buf,
         return FDB_RESULT_READ_FAIL;
     }
 
+    if (appendDone.load() != appendNext.load() && isWritable(bid)) {
+        // the block may hold a document that is reserved by a pipelined
+        // append but not written yet
+        waitDocAppends(bid);
+    }
+
     if (global_config.getNcacheBlock() > 0 &&
         !ver_btreev2_format(getVersion())) {
         lock_no = bid % DLOCK_MAX;
@@ -2371,7 +2791,9 @@ fdb_status FileMgr::writeOffset(bid_t bid, uint64_t offset, uint64_t len,
         return FDB_RESULT_WRITE_FAIL;
     }
 
-    if (fMgrSb && fMgrSb->bmpExists()) {
+    if (bid >= idxCarryBegin.load() && bid < idxCarryEnd.load()) {
+        // index region blocks allocated after the last commit
+    } else if (fMgrSb && fMgrSb->bmpExists()) {
         // block reusing is enabled
         if (!fMgrSb->isWritable(bid)) {
             const char *msg = "Write error: trying to write at the offset "
@@ -2522,7 +2944,7 @@ fdb_status FileMgr::writeOffset(bid_t bid, uint64_t offset, uint64_t len,
         }
 #endif
 
-        r = fMgrOps->pwrite(fopsHandle, buf, len, pos);
+        r = pwriteAligned(buf, len, pos);
         _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status) r,
                        "WRITE", fileName);
         if ((uint64_t)r != len) {
@@ -2559,6 +2981,16 @@ fdb_status FileMgr::commitBid(bid_t bid, uint64_t bmp_revnum, bool sync,
     int result = FDB_RESULT_SUCCESS;
     bool block_reusing = false;
 
+    // documents appended before this commit should be written before the
+    // header. No more appends begin as the caller holds the writer lock.
+    result = waitDocAppends();
+    if (result != FDB_RESULT_SUCCESS) {
+        fdb_log(log_callback, (fdb_status)result,
+                "Commit error: a document failed to be written into "
+                "a database file '%s'", fileName);
+        return (fdb_status)result;
+    }
+
     setIoInprog();
     if (global_config.getNcacheBlock() > 0) {
         if (ver_btreev2_format(getVersion())) {
@@ -2582,6 +3014,18 @@ fdb_status FileMgr::commitBid(bid_t bid, uint64_t bmp_revnum, bool sync,
         }
     }
 
+    if (sync && blobFiles) {
+        // bodies in blob files should be durable before the header
+        // referring to them
+        result = blobFiles->sync();
+        if (result != FDB_RESULT_SUCCESS) {
+            _log_errno_str(fopsHandle, fMgrOps, log_callback,
+                           (fdb_status)result, "FSYNC", fileName);
+            clearIoInprog();
+            return (fdb_status)result;
+        }
+    }
+
     acquireSpinLock();
 
     uint16_t header_len = fMgrHeader.size;
@@ -2714,6 +3158,10 @@ fdb_status FileMgr::commitBid(bid_t bid, uint64_t bmp_revnum, bool sync,
     } else {
         lastCommit.store(lastPos.load());
     }
+    // The rest of the current index region is kept for the next commit.
+    idxCarryBegin.store(BLK_NOT_FOUND);
+    idxCarryEnd.store(idxRegionNext.load());
+    idxCarryBegin.store(idxRegionNext.load());
 
     if (fMgrSb) {
         // Since some more blocks may be allocated after the header block
@@ -2737,7 +3185,12 @@ fdb_status FileMgr::commitBid(bid_t bid, uint64_t bmp_revnum, bool sync,
 
 fdb_status FileMgr::sync_FileMgr(bool sync_option,
                                  ErrLogCallback *log_callback) {
-    fdb_status result = FDB_RESULT_SUCCESS;
+    fdb_status result = waitDocAppends();
+    if (result != FDB_RESULT_SUCCESS) {
+        fdb_log(log_callback, result, "Sync error: a document failed to be "
+                "written into a database file '%s'", fileName);
+        return result;
+    }
     if (global_config.getNcacheBlock() > 0) {
         if (ver_btreev2_format(getVersion())) {
             result = BnodeCacheMgr::get()->flush(this);
@@ -2753,6 +3206,14 @@ fdb_status FileMgr::sync_FileMgr(bool sync_option,
     }
 
     if (sync_option && (fMgrFlags & FILEMGR_SYNC)) {
+        if (blobFiles) {
+            result = blobFiles->sync();
+            if (result != FDB_RESULT_SUCCESS) {
+                _log_errno_str(fopsHandle, fMgrOps, log_callback, result,
+                               "FSYNC", fileName);
+                return result;
+            }
+        }
         int rv = fMgrOps->fsync(fopsHandle);
         _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status)rv, "FSYNC",
                        fileName);
@@ -2936,6 +3397,11 @@ void FileMgr::removePending(FileMgr *old_file,
                            log_callback, (fdb_status)ret, "UNLINK",
                            old_file->fileName);
         }
+        // blob files collected by the compaction can be unlinked as well,
+        // as they are kept open for the remaining readers
+        old_file->blobFiles->removeCollected(true);
+#else
+        old_file->blobFiles->removeCollected(false);
 #endif
 
         spin_unlock(&old_file->fMgrLock);
@@ -2952,6 +3418,7 @@ void FileMgr::removePending(FileMgr *old_file,
             (new_file && new_file->inPlaceCompaction)) {
             remove(old_file->fileName);
         }
+        old_file->blobFiles->removeCollected(true);
         FileMgr::removeFile(old_file, log_callback);
         // LCOV_EXCL_STOP
     }
@@ -3007,6 +3474,7 @@ fdb_status FileMgr::destroyFile(std::string filename,
         }
 
         // Cleanup file from in-memory as well as on-disk
+        file->blobFiles->removeAll();
         FileMgr::freeFunc(file);
         if (doesFileExist(filename.c_str()) == FDB_RESULT_SUCCESS) {
             if (remove(filename.c_str())) {
@@ -3108,6 +3576,14 @@ fdb_status FileMgr::destroyFile(std::string filename,
                 }
             }
         }
+        if (status == FDB_RESULT_SUCCESS) {
+            // Only the own blob file is known without the KV header; the
+            // inherited ones are removed along with the older files.
+            std::string blob_filename = filename + BLOB_FILE_SUFFIX;
+            if (doesFileExist(blob_filename.c_str()) == FDB_RESULT_SUCCESS) {
+                remove(blob_filename.c_str());
+            }
+        }
     }
 
     if (!destroy_file_set) { // top level or non-recursive call
@@ -3237,6 +3713,101 @@ void FileMgr::mutexUnlock() {
     }
 }
 
+void FileMgr::beginDocAppend(bid_t first_bid, bid_t last_bid,
+                             uint64_t *ticket) {
+    UniqueLock lh(appendSync);
+    while (appendNext.load() - appendDone.load() >= FILEMGR_APPEND_RING_SIZE) {
+        // all slots in the ring are in use
+        appendSync.wait(lh);
+    }
+    appendIssuer = std::this_thread::get_id();
+    appendIssuerTicket = appendNext.load();
+    appendFirstBid[appendIssuerTicket % FILEMGR_APPEND_RING_SIZE] = first_bid;
+    appendLastBid[appendIssuerTicket % FILEMGR_APPEND_RING_SIZE] = last_bid;
+    *ticket = appendNext.fetch_add(1);
+}
+
+void FileMgr::endDocAppend(uint64_t ticket) {
+    LockHolder lh(appendSync);
+    appendWritten[ticket % FILEMGR_APPEND_RING_SIZE] = true;
+    if (appendIssuerTicket == ticket) {
+        appendIssuer = std::thread::id();
+    }
+
+    uint64_t done = appendDone.load();
+    uint64_t next = appendNext.load();
+    while (done < next && appendWritten[done % FILEMGR_APPEND_RING_SIZE]) {
+        appendWritten[done % FILEMGR_APPEND_RING_SIZE] = false;
+        ++done;
+    }
+    appendDone.store(done);
+    // readers may be waiting for this ticket only, even if an earlier one
+    // is still being written
+    appendSync.notify_all();
+}
+
+void FileMgr::failDocAppend(uint64_t ticket, uint64_t offset) {
+    {
+        LockHolder lh(appendSync);
+        failedAppendOffsets.insert(offset);
+        appendFailed.store(true);
+    }
+    endDocAppend(ticket);
+}
+
+fdb_status FileMgr::waitDocAppends() {
+    if (appendFailed.load()) {
+        return FDB_RESULT_WRITE_FAIL;
+    }
+    if (appendDone.load() >= appendNext.load()) {
+        return FDB_RESULT_SUCCESS;
+    }
+
+    UniqueLock lh(appendSync);
+    uint64_t target = appendNext.load();
+    if (appendIssuer == std::this_thread::get_id()) {
+        // The caller is inserting its own doc into WAL, which may read the
+        // previous version of the doc. Only the earlier appends are waited.
+        target = appendIssuerTicket;
+    }
+    while (appendDone.load() < target) {
+        appendSync.wait(lh);
+    }
+    // an append may have failed in the meantime
+    return appendFailed.load() ? FDB_RESULT_WRITE_FAIL : FDB_RESULT_SUCCESS;
+}
+
+void FileMgr::waitDocAppends(bid_t bid) {
+    if (appendDone.load() >= appendNext.load()) {
+        return;
+    }
+
+    UniqueLock lh(appendSync);
+    uint64_t target = appendNext.load();
+    if (appendIssuer == std::this_thread::get_id()) {
+        target = appendIssuerTicket;
+    }
+    uint64_t ticket = appendDone.load();
+    while (ticket < target) {
+        size_t slot = ticket % FILEMGR_APPEND_RING_SIZE;
+        if (ticket >= appendDone.load() && !appendWritten[slot] &&
+            appendFirstBid[slot] <= bid && bid <= appendLastBid[slot]) {
+            // the block is reserved by this ticket .. wait and check again
+            appendSync.wait(lh);
+            continue;
+        }
+        ++ticket;
+    }
+}
+
+bool FileMgr::isDocAppendFailed(uint64_t offset) {
+    if (!appendFailed.load()) {
+        return false;
+    }
+    LockHolder lh(appendSync);
+    return failedAppendOffsets.find(offset) != failedAppendOffsets.end();
+}
+
 bool FileMgr::isCommitHeader(void *head_buffer, size_t blocksize) {
     uint8_t marker[BLK_MARKER_SIZE];
     filemgr_magic_t magic;
@@ -4037,6 +4608,13 @@ void LatencyStats::update(FileMgr *file, fdb_latency_stat_type type,
 #ifdef _PLATFORM_LIB_AVAILABLE
     file->histStats[type].add(val / 1000);
 #endif
+    if (type == FDB_LATENCY_GETS || type == FDB_LATENCY_ITR_GET) {
+        // Foreground reads drive the backoff of background writes.
+        IoRateLimiter *limiter = IoRateLimiter::getInstance();
+        if (limiter) {
+            limiter->addLatencySample(val);
+        }
+    }
 }
 
 void LatencyStats::get(FileMgr *file, fdb_latency_stat_type type,
@@ -39,13 +39,19 @@
 #include "checksum.h"
 #include "filemgr_ops.h"
 #include "encryption.h"
+#include "doc_codec.h"
+#include "blobfile.h"
 #include "superblock.h"
 #include "staleblock.h"
 #include "taskable.h"
+#include "memory_pool.h"
+#include "sync_object.h"
+#include "ratelimiter.h"
 
 #include <atomic>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -62,6 +68,19 @@
 #define FILEMGR_CANCEL_COMPACTION 0x40 // Cancel the compaction
 #define FILEMGR_EXCL_CREATE 0x80 // fail open if file already exists
 
+// Minimum and maximum number of blocks in a region dedicated to index nodes
+#define FILEMGR_MIN_INDEX_REGION_BLOCKS (16)
+#define FILEMGR_MAX_INDEX_REGION_BLOCKS (4096)
+
+// Number of buffers in the aligned buffer pool for direct I/O
+#define FILEMGR_ALIGNED_BUF_BINS (16)
+
+// Max number of buffers passed to a single vectored read
+#define FILEMGR_MAX_IOVCNT (1024)
+
+// Max number of pipelined document appends in flight
+#define FILEMGR_APPEND_RING_SIZE (256)
+
 class SuperblockBase;
 
 class FileMgrConfig {
@@ -73,7 +92,11 @@ public:
           num_wal_shards(DEFAULT_NUM_WAL_PARTITIONS),
           num_bcache_shards(DEFAULT_NUM_BCACHE_PARTITIONS),
           block_reusing_threshold(65/*default*/),
-          num_keeping_headers(5/*default*/)
+          num_keeping_headers(5/*default*/),
+          bloom_bits_per_key(0),
+          index_region_blocks(0),
+          background_stale_merge(false),
+          blob_threshold(0)
     {
         encryption_key.algorithm = FDB_ENCRYPTION_NONE;
         memset(encryption_key.bytes, 0, sizeof(encryption_key.bytes));
@@ -98,7 +121,11 @@ public:
           num_wal_shards(_num_wal_shards),
           num_bcache_shards(_num_bcache_shards),
           block_reusing_threshold(_block_reusing_threshold),
-          num_keeping_headers(_num_keeping_headers)
+          num_keeping_headers(_num_keeping_headers),
+          bloom_bits_per_key(0),
+          index_region_blocks(0),
+          background_stale_merge(false),
+          blob_threshold(0)
     {
         encryption_key.algorithm = _algorithm;
         memset(encryption_key.bytes,
@@ -122,6 +149,10 @@ public:
                                       std::memory_order_relaxed);
         num_keeping_headers.store(config.num_keeping_headers.load(),
                                   std::memory_order_relaxed);
+        bloom_bits_per_key = config.bloom_bits_per_key;
+        index_region_blocks = config.index_region_blocks;
+        background_stale_merge = config.background_stale_merge;
+        blob_threshold = config.blob_threshold;
     }
 
     void setBlockSize(int to) {
@@ -190,6 +221,22 @@ public:
         num_keeping_headers.store(to, std::memory_order_relaxed);
     }
 
+    void setBloomBitsPerKey(uint32_t to) {
+        bloom_bits_per_key = to;
+    }
+
+    void setIndexRegionBlocks(uint32_t to) {
+        index_region_blocks = to;
+    }
+
+    void setBackgroundStaleMerge(bool to) {
+        background_stale_merge = to;
+    }
+
+    void setBlobThreshold(uint32_t to) {
+        blob_threshold = to;
+    }
+
     int getBlockSize() const {
         return blocksize;
     }
@@ -242,6 +289,22 @@ public:
         return num_keeping_headers.load(std::memory_order_relaxed);
     }
 
+    uint32_t getBloomBitsPerKey() const {
+        return bloom_bits_per_key;
+    }
+
+    uint32_t getIndexRegionBlocks() const {
+        return index_region_blocks;
+    }
+
+    bool getBackgroundStaleMerge() const {
+        return background_stale_merge;
+    }
+
+    uint32_t getBlobThreshold() const {
+        return blob_threshold;
+    }
+
 private:
     int blocksize;
     int ncacheblock;
@@ -259,11 +322,22 @@ private:
     // Number of the last commit headders whose stale blocks should
     // be kept for snapshot readers.
     std::atomic<uint64_t> num_keeping_headers;
+    // Bits per key for the key filters of newly created files
+    uint32_t bloom_bits_per_key;
+    // Number of blocks allocated at once for index nodes (0 or 1: disabled)
+    uint32_t index_region_blocks;
+    // Decode stale block info in a background task
+    bool background_stale_merge;
+    // Minimum body length written into a blob file (0: disabled)
+    uint32_t blob_threshold;
 };
 
 #ifndef _LATENCY_STATS
-#define LATENCY_STAT_START()
-#define LATENCY_STAT_END(file, type)
+// Foreground reads are still timed if they adjust the background write rate
+#define LATENCY_STAT_START() \
+    uint64_t begin = IoRateLimiter::sampleStart();
+#define LATENCY_STAT_END(file, type) \
+    IoRateLimiter::sampleEnd(type, begin);
 #else
 class LatencyStats;
 #define LATENCY_STAT_START() \
@@ -300,7 +374,13 @@ typedef int filemgr_fs_type_t;
 enum {
     FILEMGR_FS_NO_COW = 0x01,
     FILEMGR_FS_EXT4_WITH_COW = 0x02,
-    FILEMGR_FS_BTRFS = 0x03
+    FILEMGR_FS_BTRFS = 0x03,
+    // Any file system supporting the generic FICLONERANGE ioctl (e.g., XFS
+    // with reflink enabled), where cloned extents are shared.
+    FILEMGR_FS_REFLINK = 0x04,
+    // No block sharing, but the kernel can copy ranges between files without
+    // going through the user space (copy_file_range(2)).
+    FILEMGR_FS_COPY_RANGE = 0x05
 };
 
 struct filemgr_buffer {
@@ -418,6 +498,7 @@ class Wal;
 class KvsHeader;
 class FileBlockCache;
 class FileBnodeCache;
+class KeyFilter;
 
 typedef struct {
     mutex_t mutex;
@@ -604,6 +685,10 @@ public:
         return fopsHandle;
     }
 
+    filemgr_fs_type_t getFsType() const {
+        return fsType;
+    }
+
     void decrPos(uint64_t by) {
         lastPos.fetch_sub(by);
     }
@@ -818,6 +903,68 @@ public:
 
     void mutexUnlock();
 
+    /**
+     * Begin a pipelined document append, whose space was reserved under the
+     * writer lock and is written after releasing it. This should be called
+     * with the writer lock held, and blocks if too many appends are in
+     * flight.
+     *
+     * @param first_bid First block reserved for the document.
+     * @param last_bid Last block reserved for the document.
+     * @param ticket Pointer to the ticket to be passed to endDocAppend()
+     *        once the document is written.
+     * @return void.
+     */
+    void beginDocAppend(bid_t first_bid, bid_t last_bid, uint64_t *ticket);
+
+    /**
+     * Mark the pipelined document append of the given ticket as done.
+     */
+    void endDocAppend(uint64_t ticket);
+
+    /**
+     * Mark the pipelined document append of the given ticket as done but
+     * failed to be written. Its document stays in WAL, so that the file is
+     * put into an error state until it is reopened: reads of the document
+     * return FDB_RESULT_READ_FAIL, and commits and syncs return
+     * FDB_RESULT_WRITE_FAIL, so that the document never becomes durable
+     * and the previously committed version of its key is kept.
+     *
+     * @param ticket Ticket of the append.
+     * @param offset Offset of the document.
+     * @return void.
+     */
+    void failDocAppend(uint64_t ticket, uint64_t offset);
+
+    /**
+     * Wait until all the pipelined document appends that have begun so far
+     * (except the one begun by the calling thread) are written. Commits
+     * call this, so that they never persist a reserved but unwritten
+     * document.
+     *
+     * @return FDB_RESULT_SUCCESS on success, or FDB_RESULT_WRITE_FAIL if
+     *         an append has ever failed in this file.
+     */
+    fdb_status waitDocAppends();
+
+    /**
+     * Same as waitDocAppends(), but wait only for the appends whose
+     * reserved blocks include the given block. Readers call this.
+     *
+     * @param bid ID of the block to be read.
+     * @return void.
+     */
+    void waitDocAppends(bid_t bid);
+
+    /**
+     * Check if the document at the given offset failed to be written by a
+     * pipelined append.
+     *
+     * @param offset Offset of the document.
+     * @return True if the document failed to be written.
+     */
+    bool isDocAppendFailed(uint64_t offset);
+
     void setCrcMode(crc_mode_e to) {
         crcMode = to;
     }
@@ -838,6 +985,31 @@ public:
         return staleData;
     }
 
+    /**
+     * Return the key filter of this file, or NULL if the file does not have
+     * a complete key filter (e.g., the file was not created by this process).
+     */
+    KeyFilter* getKeyFilter() {
+        return keyFilter;
+    }
+
+    BlobFileSet* getBlobFiles() {
+        return blobFiles;
+    }
+
+    /**
+     * Return the compression dictionary held by the system doc at the given
+     * offset, or NULL if it is not loaded yet.
+     */
+    doc_codec_dict* getCodecDict(uint64_t dict_offset);
+
+    /**
+     * Register a compression dictionary loaded from the system doc at the
+     * given offset. If the same dictionary was registered by another thread
+     * in the meantime, 'dict' is freed and the registered one is returned.
+     */
+    doc_codec_dict* addCodecDict(uint64_t dict_offset, doc_codec_dict *dict);
+
     void removeAllBufferBlocks();
 
     bid_t alloc_FileMgr(ErrLogCallback *log_callback);
@@ -845,6 +1017,19 @@ public:
     void allocMultiple(int nblock, bid_t *begin,
                        bid_t *end, ErrLogCallback *log_callback);
 
+    /**
+     * Allocate a block for index nodes. If index regions are enabled, blocks
+     * are handed out in order from a region of consecutive blocks allocated
+     * at the end of the file, which is kept across commits until it is used
+     * up, so that index nodes are not interleaved with documents. Otherwise
+     * (or while stale blocks are being reused) this is the same as
+     * alloc_FileMgr().
+     *
+     * @param log_callback Pointer to log callback function.
+     * @return ID of the allocated block.
+     */
+    bid_t allocIndexBlock(ErrLogCallback *log_callback);
+
     bid_t allocMultipleCond(bid_t nextbid, int nblock,
                             bid_t *begin, bid_t *end,
                             ErrLogCallback *log_callback);
@@ -872,10 +1057,58 @@ public:
        decrypts if necessary */
     ssize_t readBlock(void *buf, bid_t bid);
 
+    /* Reads consecutive block(s) of data at offset, calculated as
+       start_bid * blocksize, using a single read call, decrypts if necessary */
+    ssize_t readBlocks(void *buf, unsigned num_blocks, bid_t start_bid);
+
     /* Writes block(s) of data at offset, calculated as start_bid * blocksize,
        encrypts if necessary */
     ssize_t writeBlocks(void *buf, unsigned num_blocks, bid_t start_bid);
 
+    /**
+     * Load the given range of committed blocks into the block cache, if they
+     * are not cached yet. Consecutive uncached blocks are read from the file
+     * using a single large read, so that a sequential scan does not issue a
+     * separate read for each block.
+     *
+     * @param start_bid ID of the first block to be loaded.
+     * @param num_blocks Number of blocks to be loaded.
+     * @param log_callback Pointer to the log callback function.
+     * @return Number of blocks that are newly loaded into the block cache.
+     */
+    size_t readAhead(bid_t start_bid, size_t num_blocks,
+                     ErrLogCallback *log_callback);
+
+    /**
+     * Read the given range of committed blocks, split into their data and
+     * their trailing block metadata. The data of the blocks is stored
+     * contiguously into 'buf_out', and the metadata into 'meta_out'.
+     * Blocks found in the block cache are copied from it, and each run of
+     * consecutive blocks missing in the cache is read directly into the
+     * output buffers using a single vectored read. The blocks read from the
+     * file are not inserted into the block cache, so that reading a large
+     * document does not evict other blocks.
+     *
+     * This is only available if the file ops support vectored reads, and
+     * the file is neither encrypted nor opened with the direct I/O option.
+     *
+     * @param start_bid ID of the first block to be read.
+     * @param num_blocks Number of blocks to be read.
+     * @param meta_size Size of the trailing metadata of each block.
+     * @param buf_out Buffer of (block size - meta_size) * num_blocks bytes.
+     * @param meta_out Buffer of meta_size * num_blocks bytes.
+     * @param tail_out If not NULL, the entire block following the range is
+     *        read into this buffer as well.
+     * @param log_callback Pointer to the log callback function.
+     * @return FDB_RESULT_SUCCESS on success, or FDB_RESULT_INVALID_ARGS if
+     *         the vectored read is not available for the given blocks, so
+     *         that they should be read one by one.
+     */
+    fdb_status readBlocksVectored(bid_t start_bid, size_t num_blocks,
+                                  size_t meta_size, void *buf_out,
+                                  void *meta_out, void *tail_out,
+                                  ErrLogCallback *log_callback);
+
     /* Reads block of data from specified offset,
        decrypts if necessary */
     ssize_t readBuf(void *buf, size_t nbytes, cs_off_t offset);
@@ -884,6 +1117,15 @@ public:
        encrypts if necessary */
     ssize_t writeBuf(void *buf, size_t nbytes, cs_off_t offset);
 
+    /* Reads data at specified offset. In the direct I/O mode, unaligned
+       reads are done through an aligned buffer */
+    ssize_t preadAligned(void *buf, size_t nbytes, cs_off_t offset);
+
+    /* Writes data at specified offset. In the direct I/O mode, unaligned
+       writes are done through an aligned buffer, by reading the partially
+       overwritten sectors first */
+    ssize_t pwriteAligned(void *buf, size_t nbytes, cs_off_t offset);
+
     int isWritable(bid_t bid);
 
     fdb_status commit_FileMgr(bool sync, ErrLogCallback *log_callback);
@@ -1352,6 +1594,33 @@ private:
      */
     static void shutdownTempBuf();
 
+    /**
+     * Get a sector-aligned buffer for direct I/O. Buffers no larger than
+     * a block are taken from the aligned buffer pool if available.
+     *
+     * @param buf Pointer to the buffer to be returned.
+     * @param size Size of the buffer.
+     * @return Index of the bin in the pool, or -1 if the buffer is allocated
+     *         separately.
+     */
+    static int allocateAlignedBuffer(uint8_t **buf, size_t size);
+
+    /**
+     * Release a buffer obtained by allocateAlignedBuffer().
+     *
+     * @param buf Pointer to the buffer to be released.
+     * @param index Index returned by allocateAlignedBuffer().
+     */
+    static void deallocateAlignedBuffer(uint8_t *buf, int index);
+
+    /**
+     * Check if the file is opened with the direct I/O option, which
+     * requires all reads and writes to be aligned to sectors.
+     */
+    bool isDirectIO() const {
+        return fileConfig && (fileConfig->getFlag() & _ARCH_O_DIRECT);
+    }
+
     /**
      * Check if a given file exists or not
      *
@@ -1369,6 +1638,16 @@ private:
     std::atomic<uint64_t> lastPos;
     std::atomic<uint64_t> lastCommit;
     std::atomic<uint64_t> lastWritableBmpRevnum;
+    // Next unused block and the last block of the current index region
+    std::atomic<bid_t> idxRegionNext;
+    bid_t idxRegionEnd;
+    // Number of blocks in the current index region
+    uint32_t idxRegionSize;
+    // Blocks handed out since the last commit from an index region that was
+    // allocated before the last commit, [begin, end). They are located before
+    // the last commit position, but are still writable.
+    std::atomic<bid_t> idxCarryBegin;
+    std::atomic<bid_t> idxCarryEnd;
     std::atomic<uint8_t> ioInprog;
     Wal *fMgrWal;
     FdbTaskable exPoolCtx; // executor pool context
@@ -1410,6 +1689,32 @@ private:
     // mutex for synchronization among multiple writers
     mutex_lock_t writerLock;
 
+    // locks for partial sector writes in direct I/O mode, which read and
+    // write back the whole sector. Documents appended concurrently without
+    // the writer lock may share a sector.
+    mutex_t sectorLock[DLOCK_MAX];
+
+    // Pipelined document appends. Tickets are issued in order under the
+    // writer lock, while the documents are written out of order; each
+    // written ticket sets its flag in the ring, and 'appendDone' (the first
+    // ticket not written yet) advances over the consecutive flags.
+    std::atomic<uint64_t> appendNext;
+    std::atomic<uint64_t> appendDone;
+    bool appendWritten[FILEMGR_APPEND_RING_SIZE];
+    // Blocks reserved by each ticket in the ring. The blocks of a document
+    // are not always contiguous, so this range may also cover blocks of
+    // other documents, which only makes their readers wait a bit longer.
+    bid_t appendFirstBid[FILEMGR_APPEND_RING_SIZE];
+    bid_t appendLastBid[FILEMGR_APPEND_RING_SIZE];
+    // Offsets of the documents failed to be written, which are still in
+    // WAL. They are kept until the file is closed.
+    std::unordered_set<uint64_t> failedAppendOffsets;
+    std::atomic<bool> appendFailed;
+    // Thread that got the latest ticket, which doesn't wait for itself
+    std::thread::id appendIssuer;
+    uint64_t appendIssuerTicket;
+    SyncObject appendSync;
+
     // CRC the file is using
     crc_mode_e crcMode;
 
@@ -1418,6 +1723,18 @@ private:
 
     StaleDataManagerBase *staleData;
 
+    // Key filter for negative lookups, exists only if the file was created
+    // empty in this process so that every key in the file passed through it.
+    KeyFilter *keyFilter;
+
+    // Blob files holding large document bodies
+    BlobFileSet *blobFiles;
+
+    // Compression dictionaries loaded from this file, indexed by the offset
+    // of the system doc holding each dictionary
+    std::unordered_map<uint64_t, doc_codec_dict *> codecDicts;
+    std::mutex codecDictLock;
+
     // in-memory index for a set of dirty index block updates
     struct avl_tree dirtyUpdateIdx;
     // counter for the set of dirty index updates
@@ -1447,6 +1764,8 @@ private:
     static struct list tempBuf;
     // Lock to synchronize I/O buffer pool accesses
     static spin_t tempBufLock;
+    // Pool of sector-aligned block buffers for direct I/O
+    static MemoryPool *alignedBufPool;
     // Flag indicating if the lazy file deletion is enabled or not
     static bool lazyFileDeletionEnabled;
     // Pointer to the file removal registration function
@@ -23,6 +23,7 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 
 #include "filemgr.h"
 #include "filemgr_ops.h"
@@ -82,6 +83,28 @@ ssize_t _filemgr_linux_pread(fdb_fileops_handle fileops_handle, void *buf, size_
     return rv;
 }
 
+ssize_t _filemgr_linux_preadv(fdb_fileops_handle fileops_handle,
+                              const fdb_iovec_t *iov, int iovcnt,
+                              cs_off_t offset)
+{
+    struct iovec *_iov = alca(struct iovec, iovcnt);
+    for (int i = 0; i < iovcnt; ++i) {
+        _iov[i].iov_base = iov[i].base;
+        _iov[i].iov_len = iov[i].len;
+    }
+
+    ssize_t rv;
+    do {
+        rv = preadv(handle_to_fd(fileops_handle), _iov, iovcnt, offset);
+    } while (rv == -1 && errno == EINTR); // LCOV_EXCL_LINE
+
+    if (rv < 0) {
+        return (ssize_t) convert_errno_to_fdb_status(errno, // LCOV_EXCL_LINE
+                                                     FDB_RESULT_READ_FAIL);
+    }
+    return rv;
+}
+
 int _filemgr_linux_close(fdb_fileops_handle fileops_handle)
 {
     int rv = 0;
@@ -395,6 +418,16 @@ struct btrfs_ioctl_clone_range_args {
 #define EXT4_SUPER_MAGIC 0xEF53
 #endif
 
+// FICLONERANGE is the VFS-level successor of BTRFS_IOC_CLONE_RANGE, with the
+// same ioctl number and argument layout.
+#ifndef FICLONERANGE
+#define FICLONERANGE BTRFS_IOC_CLONE_RANGE
+#endif
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <sys/syscall.h>
+#endif
+
 #ifndef EXT4_IOC_TRANFER_BLK_OWNERSHIP
 /* linux/fs/ext4/ext4.h */
 #define EXT4_IOC_TRANFER_BLK_OWNERSHIP  _IOWR('f', 22, struct tranfer_blk_ownership)
@@ -426,6 +459,68 @@ int _filemgr_linux_ext4_share_blks(int src_fd, int dst_fd, uint64_t src_off,
 }
 #endif
 
+#ifndef __sun
+static
+int _filemgr_linux_clone_range(int src_fd, int dst_fd, uint64_t src_off,
+                               uint64_t dst_off, uint64_t len)
+{
+    struct btrfs_ioctl_clone_range_args cr_args;
+
+    memset(&cr_args, 0, sizeof(cr_args));
+    cr_args.src_fd = src_fd;
+    cr_args.src_offset = src_off;
+    cr_args.src_length = len;
+    cr_args.dest_offset = dst_off;
+    if (ioctl(dst_fd, FICLONERANGE, &cr_args) != 0) {
+        return errno;
+    }
+    return 0;
+}
+
+// Check if FICLONERANGE is supported by the file system of a given file.
+// Cloning a range onto itself is always rejected with EINVAL by the file
+// systems that support it, so nothing is actually cloned here.
+static bool _filemgr_linux_probe_clone(int fd)
+{
+    int err = _filemgr_linux_clone_range(fd, fd, 0, 0, 4096);
+    return err == 0 || err == EINVAL;
+}
+#endif
+
+#if defined(__linux__) && defined(SYS_copy_file_range)
+static
+int _filemgr_linux_copy_range(int src_fd, int dst_fd, uint64_t src_off,
+                              uint64_t dst_off, uint64_t len)
+{
+    loff_t off_in = src_off;
+    loff_t off_out = dst_off;
+    while (len) {
+        ssize_t rv = syscall(SYS_copy_file_range, src_fd, &off_in,
+                             dst_fd, &off_out, (size_t)len, 0u);
+        if (rv < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (rv == 0) {
+            // Unexpected EOF of the source file.
+            return (int)FDB_RESULT_READ_FAIL;
+        }
+        len -= rv;
+    }
+    return 0;
+}
+
+static bool _filemgr_linux_probe_copy_range(int fd)
+{
+    loff_t off_in = 0, off_out = 0;
+    // Zero-length copy only checks if the system call is available.
+    return syscall(SYS_copy_file_range, fd, &off_in,
+                   fd, &off_out, (size_t)0, 0u) == 0;
+}
+#endif
+
 int _filemgr_linux_get_fs_type(fdb_fileops_handle src_fileops_handle)
 {
 #ifdef __sun
@@ -454,6 +549,16 @@ int _filemgr_linux_get_fs_type(fdb_fileops_handle src_fileops_handle)
         default:
             ret = FILEMGR_FS_NO_COW;
     }
+    if (ret == FILEMGR_FS_NO_COW) {
+        if (_filemgr_linux_probe_clone(src_fd)) {
+            ret = FILEMGR_FS_REFLINK;
+        }
+#if defined(__linux__) && defined(SYS_copy_file_range)
+        else if (_filemgr_linux_probe_copy_range(src_fd)) {
+            ret = FILEMGR_FS_COPY_RANGE;
+        }
+#endif
+    }
     return ret;
 #endif
 }
@@ -469,20 +574,25 @@ int _filemgr_linux_copy_file_range(int fs_type,
     int dst_fd = handle_to_fd(dst_fileops_handle);
 #ifndef __sun
     if (fs_type == FILEMGR_FS_BTRFS) {
-        struct btrfs_ioctl_clone_range_args cr_args;
-
-        memset(&cr_args, 0, sizeof(cr_args));
-        cr_args.src_fd = src_fd;
-        cr_args.src_offset = src_off;
-        cr_args.src_length = len;
-        cr_args.dest_offset = dst_off;
-        ret = ioctl(dst_fd, BTRFS_IOC_CLONE_RANGE, &cr_args);
-        if (ret != 0) { // LCOV_EXCL_START
-            ret = errno;
-        }              // LCOV_EXCL_STOP
+        ret = _filemgr_linux_clone_range(src_fd, dst_fd, src_off,
+                                         dst_off, len);
     } else if (fs_type == FILEMGR_FS_EXT4_WITH_COW) {
         ret = _filemgr_linux_ext4_share_blks(src_fd, dst_fd, src_off,
                                              dst_off, len);
+    } else if (fs_type == FILEMGR_FS_REFLINK) {
+        ret = _filemgr_linux_clone_range(src_fd, dst_fd, src_off,
+                                         dst_off, len);
+#if defined(__linux__) && defined(SYS_copy_file_range)
+        if (ret == EINVAL) {
+            // The range is not aligned to the file system block size;
+            // let the kernel copy (or partially share) it instead.
+            ret = _filemgr_linux_copy_range(src_fd, dst_fd, src_off,
+                                            dst_off, len);
+        }
+    } else if (fs_type == FILEMGR_FS_COPY_RANGE) {
+        ret = _filemgr_linux_copy_range(src_fd, dst_fd, src_off,
+                                        dst_off, len);
+#endif
     }
 #endif
     return ret;
@@ -514,7 +624,8 @@ struct filemgr_ops linux_ops = {
     _filemgr_linux_get_fs_type,
     _filemgr_linux_copy_file_range,
     _filemgr_linux_destructor,
-    NULL
+    NULL,
+    _filemgr_linux_preadv
 };
 
 struct filemgr_ops * get_linux_filemgr_ops()
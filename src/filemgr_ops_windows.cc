@@ -329,7 +329,8 @@ struct filemgr_ops win_ops = {
     _filemgr_win_get_fs_type,
     _filemgr_win_copy_file_range,
     _filemgr_win_destructor,
-    NULL
+    NULL,
+    NULL // vectored read is not supported
 };
 
 struct filemgr_ops * get_win_filemgr_ops()
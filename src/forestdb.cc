@@ -40,6 +40,7 @@
 #include "executorpool.h"
 #include "btreeblock.h"
 #include "bnodemgr.h"
+#include "bloomfilter.h"
 #include "common.h"
 #include "wal.h"
 #include "filemgr_ops.h"
@@ -48,6 +49,7 @@
 #include "bgflusher.h"
 #include "compaction.h"
 #include "compactor.h"
+#include "ratelimiter.h"
 #include "memleak.h"
 #include "time_utils.h"
 #include "timing.h"
@@ -345,6 +347,9 @@ INLINE void _fdb_restore_wal(FdbKvsHandle *handle,
     dummy_cb.setCallback(fdb_dummy_log_callback);
     dummy_cb.setCtxData(NULL);
     handle->dhandle->setLogCallback(&dummy_cb);
+    // Bodies are not restored, so there is no need to read them from blob
+    // files.
+    handle->dhandle->setBlobMode_Docio(DOCIO_BLOB_KEEP_REF);
 
     if (!handle->shandle) {
         file->mutexLock();
@@ -457,6 +462,12 @@ INLINE void _fdb_restore_wal(FdbKvsHandle *handle,
                             continue;
                         }
 
+                        if (DOCIO_IS_BLOB(doc.length.flag) && doc.body) {
+                            struct blob_ref ref;
+                            blob_ref_decode(doc.body, &ref);
+                            file->getBlobFiles()->restoreRef(ref.file_id);
+                        }
+
                         // restore document
                         fdb_doc wal_doc;
                         wal_doc.keylen = doc.length.keylen;
@@ -556,6 +567,7 @@ INLINE void _fdb_restore_wal(FdbKvsHandle *handle,
         wal->commit_Wal(file->getGlobalTxn(), NULL, &handle->log_callback);
         file->mutexUnlock();
     }
+    handle->dhandle->setBlobMode_Docio(DOCIO_BLOB_READ_BODY);
     handle->dhandle->setLogCallback(log_callback);
 }
 
@@ -821,6 +833,27 @@ fdb_status fdb_snapshot_open(FdbKvsHandle *handle_in,
     return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
 }
 
+// Set the codec used to compress document bodies appended by the handle.
+// KV store's codec overrides the file's codec, and zstd uses the KV store's
+// dictionary if it has been trained.
+void _fdb_set_doc_codec(FdbKvsHandle *handle)
+{
+    fdb_compression_codec_t codec = handle->kvs_config.compression_codec;
+    uint64_t dict_offset = BLK_NOT_FOUND;
+
+    if (codec == FDB_COMPRESSION_DEFAULT) {
+        codec = handle->config.compression_codec;
+    }
+    if (codec == FDB_COMPRESSION_ZSTD) {
+        fdb_kvs_id_t kv_id = 0;
+        if (handle->kvs && handle->kvs->getKvsType() == KVS_SUB) {
+            kv_id = handle->kvs->getKvsId();
+        }
+        dict_offset = fdb_kvs_get_dict_offset(handle->file, kv_id);
+    }
+    handle->dhandle->setCodec_Docio(codec, dict_offset);
+}
+
 static fdb_status _fdb_reset(FdbKvsHandle *handle, FdbKvsHandle *handle_in);
 
 LIBFDB_API
@@ -863,6 +896,7 @@ fdb_status _fdb_clone_snapshot(FdbKvsHandle *handle_in,
     handle_out->dhandle = new DocioHandle(handle_out->file,
                               handle_out->config.compress_document_body,
                               &handle_out->log_callback);
+    _fdb_set_doc_codec(handle_out);
 
     if (ver_btreev2_format(handle_out->file->getVersion())) {
         // initialize the Bnode Manager
@@ -1141,6 +1175,31 @@ fdb_status fdb_doc_free(fdb_doc *doc)
     return FDB_RESULT_SUCCESS;
 }
 
+LIBFDB_API
+fdb_status fdb_doc_view_create(fdb_doc_view **view)
+{
+    if (view == NULL) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    *view = (fdb_doc_view*)calloc(1, sizeof(fdb_doc_view));
+    if (*view == NULL) { // LCOV_EXCL_START
+        return FDB_RESULT_ALLOC_FAIL;
+    } // LCOV_EXCL_STOP
+    (*view)->buffers = new DocViewBuffer();
+    return FDB_RESULT_SUCCESS;
+}
+
+LIBFDB_API
+fdb_status fdb_doc_view_free(fdb_doc_view *view)
+{
+    if (view) {
+        delete static_cast<DocViewBuffer *>(view->buffers);
+        free(view);
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
 void fdb_sync_db_header(FdbKvsHandle *handle)
 {
     uint64_t cur_revnum = handle->file->getHeaderRevnum();
@@ -1382,6 +1441,17 @@ fdb_status fdb_get(FdbKvsHandle *handle, fdb_doc *doc)
     return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
 }
 
+LIBFDB_API
+fdb_status fdb_get_view(FdbKvsHandle *handle, const void *key, size_t keylen,
+                        fdb_doc_view *view)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->getView(handle, key, keylen, view);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
 // search document metadata using key
 LIBFDB_API
 fdb_status fdb_get_metaonly(FdbKvsHandle *handle, fdb_doc *doc)
@@ -1712,6 +1782,7 @@ static fdb_status _fdb_reset(FdbKvsHandle *handle, FdbKvsHandle *handle_in)
     if (!handle->dhandle) { // LCOV_EXCL_START
         return handle->freeIOHandles(useBtreeV2);
     } // LCOV_EXCL_STOP
+    _fdb_set_doc_codec(handle);
 
     if (useBtreeV2) {
         handle->bnodeMgr = new BnodeMgr();
@@ -1904,6 +1975,19 @@ fdb_status fdb_compact_upto_with_cow(fdb_file_handle *fhandle,
     return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
 }
 
+LIBFDB_API
+fdb_status fdb_compact_incremental(fdb_file_handle *fhandle,
+                                   uint8_t min_stale_ratio,
+                                   size_t max_blocks)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->compactIncremental(fhandle, min_stale_ratio,
+                                              max_blocks);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
 LIBFDB_API
 fdb_status fdb_rekey(fdb_file_handle *fhandle,
                      fdb_encryption_key new_key)
@@ -2130,6 +2214,7 @@ fdb_status FdbEngine::init(fdb_config *config) {
 
             compactor_config c_config;
             bgflusher_config bgf_config;
+            ratelimiter_config rl_config;
             threadpool_config thrd_config;
             FileMgrConfig f_config;
 
@@ -2155,6 +2240,10 @@ fdb_status FdbEngine::init(fdb_config *config) {
             // issue is resolved.
             bgf_config.num_threads = 0; //_config.num_bgflusher_threads;
             BgFlusher::createBgFlusher(&bgf_config);
+            // Initialize the rate limiter for background writes
+            rl_config.bytes_per_sec = _config.background_io_rate_limit;
+            rl_config.latency_target_us = _config.background_io_latency_target;
+            IoRateLimiter::init(rl_config);
             // Initialize HBtrie's memory pool
             HBTrie::initMemoryPool(get_num_cores(), _config.buffercache_size);
 
@@ -2187,6 +2276,7 @@ fdb_status FdbEngine::destroyInstance() {
         }
         CompactionManager::destroyInstance();
         BgFlusher::destroyBgFlusher();
+        IoRateLimiter::destroyInstance();
         fdb_status ret = FileMgr::shutdown();
         if (ret == FDB_RESULT_SUCCESS) {
             if (!ExecutorPool::shutdown()) {
@@ -2224,8 +2314,9 @@ void FdbEngine::initFileConfig(const fdb_config *config,
     }
 
     fconfig->setFlag(0x0);
-    if ((config->durability_opt & FDB_DRB_ODIRECT) &&
-        config->buffercache_size) {
+    if (config->durability_opt & FDB_DRB_ODIRECT) {
+        // Without the buffer cache, unaligned I/O is done through the
+        // aligned buffer pool of the file manager.
         fconfig->addFlag(_ARCH_O_DIRECT);
     }
 
@@ -2235,6 +2326,13 @@ void FdbEngine::initFileConfig(const fdb_config *config,
     fconfig->setEncryptionKey(config->encryption_key);
     fconfig->setBlockReusingThreshold(config->block_reusing_threshold);
     fconfig->setNumKeepingHeaders(config->num_keeping_headers);
+    fconfig->setBloomBitsPerKey(config->bloom_filter_bits_per_key);
+    fconfig->setIndexRegionBlocks(config->index_region_blocks);
+    fconfig->setBackgroundStaleMerge(config->background_stale_merge);
+    // Separated bodies are blob bodies longer than their reference, as
+    // separating a shorter body would only grow its record.
+    fconfig->setBlobThreshold(config->separate_doc_bodies ?
+                              BLOB_REF_SIZE + 1 : config->blob_threshold);
 }
 
 fdb_status FdbEngine::openFile(FdbFileHandle **ptr_fhandle,
@@ -2497,6 +2595,7 @@ fdb_status FdbEngine::openFdb(FdbKvsHandle *handle,
                     if (!handle->file->getKVHeader()) {
                         KvsHeader *kv_header;
                         _fdb_kvs_header_create(&kv_header);
+                        kv_header->blob_files = handle->file->getBlobFiles();
                         // KV header already exists but not loaded .. read & import
                         fdb_kvs_header_read(kv_header, handle->dhandle,
                                             kv_info_offset, version, false);
@@ -2852,6 +2951,7 @@ fdb_status FdbEngine::openFdb(FdbKvsHandle *handle,
         // only super handle can be opened using fdb_open(...)
         handle->initRootHandle();
     }
+    _fdb_set_doc_codec(handle);
 
     if (handle->shandle) { // Populate snapshot stats..
         if (kv_info_offset == BLK_NOT_FOUND) { // Single KV mode
@@ -3104,50 +3204,29 @@ fdb_status FdbEngine::setLogCallback(FdbKvsHandle *handle,
     return FDB_RESULT_SUCCESS;
 }
 
-fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
-                          bool metaOnly)
+/**
+ * Find the offset of the latest version of a given key from WAL or the main
+ * index. In multi KV instance mode, the key in 'doc' should be prefixed with
+ * the KV ID. The caller should have marked the handle busy.
+ *
+ * @param handle Pointer to ForestDB KV store handle.
+ * @param doc Pointer to doc instance containing the key, whose 'deleted' field
+ *        is updated if the key is found in WAL.
+ * @param offset Pointer to a variable where the doc offset is returned.
+ * @param in_wal Pointer to a flag indicating if the key is found in WAL.
+ * @return FDB_RESULT_SUCCESS if the key is found.
+ */
+fdb_status _fdb_find_doc_offset(FdbKvsHandle *handle, fdb_doc *doc,
+                                uint64_t *offset, bool *in_wal)
 {
-    uint64_t offset;
-    struct docio_object _doc;
-    DocioHandle *dhandle;
-    FileMgr *wal_file = NULL;
     struct _fdb_key_cmp_info cmp_info;
     fdb_status wr;
     hbtrie_result hr = HBTRIE_RESULT_FAIL;
     fdb_txn *txn;
-    fdb_doc doc_kv;
-    LATENCY_STAT_START();
-
-    if (!handle) {
-        return FDB_RESULT_INVALID_HANDLE;
-    }
-
-    if (!doc || !doc->key ||
-        doc->keylen == 0 || doc->keylen > FDB_MAX_KEYLEN ||
-        (handle->kvs_config.custom_cmp &&
-            doc->keylen > handle->config.blocksize - HBTRIE_HEADROOM)) {
-        return FDB_RESULT_INVALID_ARGS;
-    }
-
-    if (!BEGIN_HANDLE_BUSY(handle)) {
-        return FDB_RESULT_HANDLE_BUSY;
-    }
-
-    doc_kv = *doc;
-
-    if (handle->kvs) {
-        // multi KV instance mode
-        int size_chunk = handle->config.chunksize;
-        doc_kv.keylen = doc->keylen + size_chunk;
-        doc_kv.key = alca(uint8_t, doc_kv.keylen);
-        kvid2buf(size_chunk, handle->kvs->getKvsId(), doc_kv.key);
-        memcpy((uint8_t*)doc_kv.key + size_chunk, doc->key, doc->keylen);
-    }
 
     if (!handle->shandle) {
         wr = fdb_check_file_reopen(handle, NULL);
         if (wr != FDB_RESULT_SUCCESS) {
-            END_HANDLE_BUSY(handle);
             return wr;
         }
 
@@ -3161,16 +3240,9 @@ fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
 
     cmp_info.kvs_config = handle->kvs_config;
     cmp_info.kvs = handle->kvs;
-    wal_file = handle->file;
-    dhandle = handle->dhandle;
 
-    if (handle->kvs) {
-        wr = wal_file->getWal()->find_Wal(txn, &cmp_info, handle->shandle, &doc_kv,
-                                     &offset);
-    } else {
-        wr = wal_file->getWal()->find_Wal(txn, &cmp_info, handle->shandle, doc,
-                                     &offset);
-    }
+    wr = handle->file->getWal()->find_Wal(txn, &cmp_info, handle->shandle, doc,
+                                          offset);
 
     if (!handle->shandle) {
         fdb_sync_db_header(handle);
@@ -3178,17 +3250,22 @@ fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
 
     handle->op_stats->num_gets++;
 
-    if (wr == FDB_RESULT_KEY_NOT_FOUND) {
+    // Key filter is not used for custom comparison functions, since
+    // different byte strings can be regarded as the same key.
+    KeyFilter *key_filter = handle->kvs_config.custom_cmp ?
+                            NULL : handle->file->getKeyFilter();
+
+    if (wr == FDB_RESULT_KEY_NOT_FOUND && key_filter &&
+        !key_filter->mayContain(doc->key, doc->keylen)) {
+        // The key has never been flushed into this file's main index.
+        handle->op_stats->num_filter_negatives++;
+    } else if (wr == FDB_RESULT_KEY_NOT_FOUND) {
         _fdb_sync_dirty_root(handle);
 
         // as 'offset' is located at the beginning of doc_meta,
         // we can use it for legacy code as well.
         DocMetaForIndex doc_meta;
-        if (handle->kvs) {
-            hr = handle->trie->find(doc_kv.key, doc_kv.keylen, &doc_meta);
-        } else {
-            hr = handle->trie->find(doc->key, doc->keylen, &doc_meta);
-        }
+        hr = handle->trie->find(doc->key, doc->keylen, &doc_meta);
 
         if (ver_btreev2_format(handle->file->getVersion())) {
             handle->bnodeMgr->releaseCleanNodes();
@@ -3196,13 +3273,69 @@ fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
             handle->bhandle->flushBuffer();
         }
         doc_meta.decode();
-        offset = doc_meta.offset;
+        *offset = doc_meta.offset;
 
         _fdb_release_dirty_root(handle);
+
+        if (key_filter && hr != HBTRIE_RESULT_SUCCESS) {
+            handle->op_stats->num_filter_false_positives++;
+        }
     }
 
-    if ((wr == FDB_RESULT_SUCCESS && offset != BLK_NOT_FOUND) ||
+    *in_wal = (wr == FDB_RESULT_SUCCESS);
+    if ((wr == FDB_RESULT_SUCCESS && *offset != BLK_NOT_FOUND) ||
         hr == HBTRIE_RESULT_SUCCESS) {
+        return FDB_RESULT_SUCCESS;
+    }
+    return FDB_RESULT_KEY_NOT_FOUND;
+}
+
+fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
+                          bool metaOnly)
+{
+    uint64_t offset;
+    struct docio_object _doc;
+    DocioHandle *dhandle;
+    fdb_status fs;
+    bool in_wal;
+    fdb_doc doc_kv;
+    LATENCY_STAT_START();
+
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!doc || !doc->key ||
+        doc->keylen == 0 || doc->keylen > FDB_MAX_KEYLEN ||
+        (handle->kvs_config.custom_cmp &&
+            doc->keylen > handle->config.blocksize - HBTRIE_HEADROOM)) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    doc_kv = *doc;
+
+    if (handle->kvs) {
+        // multi KV instance mode
+        int size_chunk = handle->config.chunksize;
+        doc_kv.keylen = doc->keylen + size_chunk;
+        doc_kv.key = alca(uint8_t, doc_kv.keylen);
+        kvid2buf(size_chunk, handle->kvs->getKvsId(), doc_kv.key);
+        memcpy((uint8_t*)doc_kv.key + size_chunk, doc->key, doc->keylen);
+    }
+
+    fs = _fdb_find_doc_offset(handle, handle->kvs ? &doc_kv : doc,
+                              &offset, &in_wal);
+    if (fs != FDB_RESULT_SUCCESS && fs != FDB_RESULT_KEY_NOT_FOUND) {
+        END_HANDLE_BUSY(handle);
+        return fs;
+    }
+    dhandle = handle->dhandle;
+
+    if (fs == FDB_RESULT_SUCCESS) {
 
         bool alloced_meta = doc->meta ? false : true;
         bool alloced_body = (metaOnly || doc->body) ? false : true;
@@ -3221,7 +3354,7 @@ fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
         _doc.meta = doc->meta;
         _doc.body = doc->body;
 
-        if (!metaOnly && wr == FDB_RESULT_SUCCESS && doc->deleted) {
+        if (!metaOnly && in_wal && doc->deleted) {
             END_HANDLE_BUSY(handle);
             return FDB_RESULT_KEY_NOT_FOUND;
         }
@@ -3263,6 +3396,81 @@ fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
     return FDB_RESULT_KEY_NOT_FOUND;
 }
 
+fdb_status FdbEngine::getView(FdbKvsHandle *handle,
+                              const void *key,
+                              size_t keylen,
+                              fdb_doc_view *view)
+{
+    uint64_t offset;
+    struct docio_length length;
+    fdb_status fs;
+    bool in_wal;
+    fdb_doc doc_kv;
+    size_t size_chunk = 0;
+    LATENCY_STAT_START();
+
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!key || keylen == 0 || keylen > FDB_MAX_KEYLEN ||
+        (handle->kvs_config.custom_cmp &&
+            keylen > handle->config.blocksize - HBTRIE_HEADROOM) ||
+        !view || !view->buffers) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    memset(&doc_kv, 0x0, sizeof(doc_kv));
+    doc_kv.key = (void *)key;
+    doc_kv.keylen = keylen;
+    doc_kv.seqnum = SEQNUM_NOT_USED;
+
+    if (handle->kvs) {
+        // multi KV instance mode
+        size_chunk = handle->config.chunksize;
+        doc_kv.keylen = keylen + size_chunk;
+        doc_kv.key = alca(uint8_t, doc_kv.keylen);
+        kvid2buf(size_chunk, handle->kvs->getKvsId(), doc_kv.key);
+        memcpy((uint8_t*)doc_kv.key + size_chunk, key, keylen);
+    }
+
+    fs = _fdb_find_doc_offset(handle, &doc_kv, &offset, &in_wal);
+    if (fs != FDB_RESULT_SUCCESS) {
+        END_HANDLE_BUSY(handle);
+        return fs;
+    }
+    if (in_wal && doc_kv.deleted) {
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_KEY_NOT_FOUND;
+    }
+
+    int64_t _offset = handle->dhandle->readDocView_Docio(offset, view,
+                                                         &length);
+    if (_offset <= 0) {
+        END_HANDLE_BUSY(handle);
+        return _offset < 0 ? (fdb_status)_offset : FDB_RESULT_KEY_NOT_FOUND;
+    }
+
+    if (length.keylen != doc_kv.keylen || (length.flag & DOCIO_DELETED)) {
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_KEY_NOT_FOUND;
+    }
+
+    // skip KV ID in front of the key
+    view->key = (const uint8_t*)view->key + size_chunk;
+    view->keylen -= size_chunk;
+    view->size_ondisk = _fdb_get_docsize(length);
+    view->offset = offset;
+
+    LATENCY_STAT_END(handle->file, FDB_LATENCY_GETS);
+    END_HANDLE_BUSY(handle);
+    return FDB_RESULT_SUCCESS;
+}
+
 fdb_status FdbEngine::getBySeq(FdbKvsHandle *handle,
                                fdb_doc *doc,
                                bool metaOnly)
@@ -3539,6 +3747,10 @@ fdb_status FdbEngine::set(FdbKvsHandle *handle, fdb_doc *doc)
     bool sub_handle = false;
     bool wal_flushed = false;
     bool immediate_remove = false;
+    bool pipelined = false;
+    uint64_t append_ticket = 0;
+    struct docio_encoded enc;
+    struct docio_length orig_length;
     file_status_t fMgrStatus;
     fdb_txn *txn = handle->fhandle->getRootHandle()->txn;
     struct _fdb_key_cmp_info cmp_info;
@@ -3567,6 +3779,7 @@ fdb_status FdbEngine::set(FdbKvsHandle *handle, fdb_doc *doc)
     _doc.length.keylen = doc->keylen;
     _doc.length.metalen = doc->metalen;
     _doc.length.bodylen = doc->deleted ? 0 : doc->bodylen;
+    _doc.length.flag = DOCIO_NORMAL;
     _doc.key = doc->key;
     _doc.meta = doc->meta;
     _doc.body = doc->deleted ? NULL : doc->body;
@@ -3589,6 +3802,12 @@ fdb_status FdbEngine::set(FdbKvsHandle *handle, fdb_doc *doc)
         }
     }
 
+    if (handle->config.pipelined_doc_append && _doc.length.bodylen > 0) {
+        // the doc is appended in two steps (see DocioHandle::prepareDoc_Docio)
+        pipelined = true;
+    }
+    orig_length = _doc.length;
+
 fdb_set_start:
     wr = fdb_check_file_reopen(handle, NULL);
     if (wr != FDB_RESULT_SUCCESS) {
@@ -3604,11 +3823,26 @@ fdb_set_start:
     cmp_info.kvs_config = handle->kvs_config;
     cmp_info.kvs = handle->kvs;
 
+    if (pipelined) {
+        // compress the body or write it into a blob file before grabbing
+        // the writer lock, so that the size of the doc is known.
+        _doc.length = orig_length;
+        wr = handle->dhandle->prepareDoc_Docio(&_doc, doc->deleted,
+                                               (txn != NULL), &enc);
+        if (wr != FDB_RESULT_SUCCESS) {
+            END_HANDLE_BUSY(handle);
+            return FDB_RESULT_WRITE_FAIL;
+        }
+    }
+
     handle->file->mutexLock();
     fdb_sync_db_header(handle);
 
     if (handle->file->isRollbackOn()) {
         handle->file->mutexUnlock();
+        if (pipelined) {
+            handle->dhandle->releaseDoc_Docio(&enc);
+        }
         END_HANDLE_BUSY(handle);
         return FDB_RESULT_FAIL_BY_ROLLBACK;
     }
@@ -3621,6 +3855,9 @@ fdb_set_start:
         // we must not write into this file
         // file status was changed by other thread .. start over
         file->mutexUnlock();
+        if (pipelined) {
+            dhandle->releaseDoc_Docio(&enc);
+        }
         goto fdb_set_start;
     }
 
@@ -3671,7 +3908,28 @@ fdb_set_start:
         txn_enabled = true;
     }
 
-    offset = dhandle->appendDoc_Docio(&_doc, doc->deleted, txn_enabled);
+    if (pipelined) {
+        // only reserve the space of the doc, which is written after
+        // releasing the writer lock.
+        offset = dhandle->reserveDoc_Docio(&enc);
+        if (offset != BLK_NOT_FOUND) {
+            bid_t first_bid = BLK_NOT_FOUND;
+            bid_t last_bid = 0;
+            for (size_t i = 0; i < enc.segments.size(); ++i) {
+                if (enc.segments[i].bid < first_bid) {
+                    first_bid = enc.segments[i].bid;
+                }
+                if (enc.segments[i].bid > last_bid) {
+                    last_bid = enc.segments[i].bid;
+                }
+            }
+            file->beginDocAppend(first_bid, last_bid, &append_ticket);
+        } else {
+            dhandle->releaseDoc_Docio(&enc);
+        }
+    } else {
+        offset = dhandle->appendDoc_Docio(&_doc, doc->deleted, txn_enabled);
+    }
     if (offset == BLK_NOT_FOUND) {
         file->mutexUnlock();
         END_HANDLE_BUSY(handle);
@@ -3713,6 +3971,39 @@ fdb_set_start:
         file->getWal()->setDirtyStatus_Wal(FDB_WAL_DIRTY);
     }
 
+    if (pipelined) {
+        // Write the doc without holding the writer lock. The doc is already
+        // in WAL (so that no commit can separate the doc from its WAL
+        // entry), and readers and commits wait for the ticket to be done.
+        file->mutexUnlock();
+        wr = dhandle->writeDoc_Docio(&_doc, &enc);
+        if (wr != FDB_RESULT_SUCCESS) {
+            // The WAL entry of the unwritten doc can't be undone, as the
+            // previous version in WAL may have been overwritten and marked
+            // as stale. Instead, the file rejects reads of the doc and all
+            // commits until it is reopened, so that the previously
+            // committed version of the key is kept.
+            file->failDocAppend(append_ticket, offset);
+            END_HANDLE_BUSY(handle);
+            return FDB_RESULT_WRITE_FAIL;
+        }
+        file->endDocAppend(append_ticket);
+
+        file->mutexLock();
+        if (file->getFileStatus() == FILE_REMOVED_PENDING ||
+            file->isRollbackOn()) {
+            // the doc has been moved into the new file by compaction, or
+            // is going to be rolled back .. WAL should not be flushed here.
+            file->mutexUnlock();
+            if (!doc->deleted) {
+                handle->op_stats->num_sets++;
+            }
+            END_HANDLE_BUSY(handle);
+            return FDB_RESULT_SUCCESS;
+        }
+        fdb_sync_db_header(handle);
+    }
+
     if (handle->config.auto_commit &&
         file->getWal()->getNumFlushable_Wal() > _fdb_get_wal_threshold(handle)) {
         // we don't need dirty WAL flushing in auto commit mode
@@ -4682,6 +4973,37 @@ fdb_status FdbEngine::compact(FdbFileHandle *fhandle,
     return fs;
 }
 
+fdb_status FdbEngine::compactIncremental(FdbFileHandle *fhandle,
+                                         uint8_t min_stale_ratio,
+                                         size_t max_blocks)
+{
+    if (!fhandle || !fhandle->getRootHandle()) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+    if (min_stale_ratio == 0 || min_stale_ratio > 100 || max_blocks == 0) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    FdbKvsHandle *handle = fhandle->getRootHandle();
+    fdb_status fs;
+
+    if (handle->config.compaction_mode == FDB_COMPACTION_MANUAL) {
+        fs = Compaction::compactFragmentedRegions(fhandle, min_stale_ratio,
+                                                  max_blocks);
+    } else {
+        // prevent the daemon from compacting the file in the meantime
+        FileMgr *file = handle->file;
+        if (!CompactionManager::getInstance()->switchCompactionFlag(file,
+                                                                    true)) {
+            return FDB_RESULT_FILE_IS_BUSY;
+        }
+        fs = Compaction::compactFragmentedRegions(fhandle, min_stale_ratio,
+                                                  max_blocks);
+        CompactionManager::getInstance()->switchCompactionFlag(file, false);
+    }
+    return fs;
+}
+
 fdb_status FdbEngine::cancelCompaction(FdbFileHandle *fhandle)
 {
     if (!fhandle) {
@@ -5784,7 +6106,10 @@ fdb_status WalFlushCallbacks::flushItem(void *dbhandle,
             }
 
             // Avoid duplicates (remove previous sequence number)
-            if (handle->config.seqtree_opt == FDB_SEQTREE_USE) {
+            // If the same version was relocated within the file (i.e., the
+            // seq number is unchanged), its entry is already overwritten above.
+            if (handle->config.seqtree_opt == FDB_SEQTREE_USE &&
+                old_seqnum != item->seqnum) {
                 struct wal_stale_seq_entry *entry = (struct wal_stale_seq_entry *)
                     calloc(1, sizeof(struct wal_stale_seq_entry));
                 entry->kv_id = kv_id;
@@ -4,6 +4,8 @@
  * (C) 2013  Jung-Sang Ahn <jungsang.ahn@gmail.com>
  */
 
+#include <string.h>
+
 #include "hash_functions.h"
 #include "common.h"
 
@@ -63,3 +65,39 @@ uint32_t hash_shuffle_2uint(uint64_t a, uint64_t b)
 }
 // LCOV_EXCL_STOP
 
+
+// MurmurHash64A (by Austin Appleby, public domain)
+uint64_t hash_murmur64(const void *value, size_t len, uint64_t seed)
+{
+    const uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
+    const int r = 47;
+    const uint8_t *data = (const uint8_t *)value;
+    const uint8_t *end = data + (len / 8) * 8;
+    uint64_t h = seed ^ (len * m);
+    uint64_t k;
+
+    for (; data != end; data += 8) {
+        memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (len & 7) {
+    case 7: h ^= (uint64_t)data[6] << 48;
+    case 6: h ^= (uint64_t)data[5] << 40;
+    case 5: h ^= (uint64_t)data[4] << 32;
+    case 4: h ^= (uint64_t)data[3] << 24;
+    case 3: h ^= (uint64_t)data[2] << 16;
+    case 2: h ^= (uint64_t)data[1] << 8;
+    case 1: h ^= (uint64_t)data[0];
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
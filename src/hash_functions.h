@@ -18,6 +18,7 @@
 #ifndef _JSAHN_HASH_FUNCTIONS_H
 #define _JSAHN_HASH_FUNCTIONS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -28,6 +29,7 @@ uint32_t hash_djb2(uint8_t *value, int len);
 uint32_t hash_djb2_last8(uint8_t *value, int len);
 uint32_t hash_uint_modular(uint64_t value, uint64_t mod);
 uint32_t hash_shuffle_2uint(uint64_t a, uint64_t b);
+uint64_t hash_murmur64(const void *value, size_t len, uint64_t seed);
 
 #ifdef __cplusplus
 }
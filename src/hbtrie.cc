@@ -932,6 +932,62 @@ hbtrie_result HBTrie::findPartial(void *rawkey, int rawkeylen, void *valuebuf)
 }
 
 
+hbtrie_result HBTrie::findKeyByRank(double rank, void *keybuf,
+                                    size_t& keylen_out)
+{
+    // Applies to the B+tree (not BtreeV2) based trie only for now
+    if (ver_btreev2_format(fileHB->getVersion()) ||
+        root_bid == BLK_NOT_FOUND) {
+        return HBTRIE_RESULT_FAIL;
+    }
+
+    BTree btree;
+    btree_result r;
+    struct hbtrie_meta hbmeta;
+    struct btree_meta meta;
+    uint8_t *buf = alca(uint8_t, btree_nodesize);
+    uint8_t *btree_value = alca(uint8_t, valuelen);
+    bid_t bid = root_bid;
+
+    meta.data = buf;
+    while (true) {
+        r = btree.initFromBid(btreeblk_handle, btree_kv_ops,
+                              btree_nodesize, bid);
+        if (r != BTREE_RESULT_SUCCESS) {
+            return HBTRIE_RESULT_FAIL;
+        }
+        btree.setAux(aux);
+
+        meta.size = btree.readMeta(meta.data);
+        fetchMeta(meta.size, &hbmeta, meta.data);
+        if (_is_leaf_btree(hbmeta.chunkno)) {
+            btree.setKVOps(btree_leaf_kv_ops);
+        }
+
+        // 'rank' becomes the relative position within the returned entry
+        r = btree.findByRank(rank, btree_value);
+        if (r != BTREE_RESULT_SUCCESS) {
+            return HBTRIE_RESULT_FAIL;
+        }
+
+        if (!valueIsMsbSet(btree_value)) {
+            // document offset
+            break;
+        }
+        // sub-tree
+        valueClearMsb(btree_value);
+        bid = btree_kv_ops->value2bid(btree_value);
+        bid = _endian_decode(bid);
+    }
+
+    uint64_t offset = btree_kv_ops->value2bid(btree_value);
+    keylen_out = readKey(offset, keybuf);
+    if (keylen_out == 0) {
+        return HBTRIE_RESULT_FAIL;
+    }
+    return HBTRIE_RESULT_SUCCESS;
+}
+
 hbtrie_result HBTrie::_remove(void *rawkey, int rawkeylen, uint8_t flag)
 {
     int nchunk = getNchunkRaw(rawkey, rawkeylen);
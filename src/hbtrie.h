@@ -496,6 +496,19 @@ public:
     hbtrie_result findOffset(void *rawkey, int rawkeylen, void *valuebuf);
     hbtrie_result findPartial(void *rawkey, int rawkeylen, void *valuebuf);
 
+    /**
+     * Find the key located at the given relative position (0 <= rank < 1)
+     * in the key order of the trie. The position is estimated by assuming
+     * that every B+tree node at the same level has the same number of
+     * entries, so this is only an approximation, but the returned key is
+     * monotonically non-decreasing as the rank increases.
+     *
+     * @param rank Relative position of the key.
+     * @param keybuf Buffer where the raw key is copied.
+     * @param keylen_out Reference to the length of the returned key.
+     */
+    hbtrie_result findKeyByRank(double rank, void *keybuf, size_t& keylen_out);
+
     hbtrie_result remove(void *rawkey, int rawkeylen);
     hbtrie_result removePartial(void *rawkey, int rawkeylen);
     hbtrie_result remove_vlen(void *rawkey, int rawkeylen,
@@ -32,6 +32,7 @@ extern "C" {
 
 struct btree;
 class FileMgr;
+class BlobFileSet;
 struct btreeblk_handle;
 class DocioHandle;
 struct btree_blk_ops;
@@ -239,7 +240,8 @@ class KvsOpsStat {
 public:
     KvsOpsStat() :
         num_sets(0), num_dels(0), num_commits(0), num_compacts(0),
-        num_gets(0), num_iterator_gets(0), num_iterator_moves(0) { }
+        num_gets(0), num_iterator_gets(0), num_iterator_moves(0),
+        num_filter_negatives(0), num_filter_false_positives(0) { }
 
     void reset() {
         num_sets = 0;
@@ -249,6 +251,8 @@ public:
         num_gets = 0;
         num_iterator_gets = 0;
         num_iterator_moves = 0;
+        num_filter_negatives = 0;
+        num_filter_false_positives = 0;
     }
 
     KvsOpsStat& operator=(const KvsOpsStat& ops_stat) {
@@ -266,6 +270,12 @@ public:
                                 std::memory_order_relaxed);
         num_iterator_moves.store(ops_stat.num_iterator_moves.load(std::memory_order_relaxed),
                                  std::memory_order_relaxed);
+        num_filter_negatives.store(
+                ops_stat.num_filter_negatives.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        num_filter_false_positives.store(
+                ops_stat.num_filter_false_positives.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
         return *this;
     }
 
@@ -297,6 +307,14 @@ public:
      * Number of fdb_iterator_moves (includes next,prev,seek) operations.
      */
     std::atomic<uint64_t> num_iterator_moves;
+    /**
+     * Number of lookups that skipped the main index due to the key filter.
+     */
+    std::atomic<uint64_t> num_filter_negatives;
+    /**
+     * Number of lookups that passed the key filter but missed in the main index.
+     */
+    std::atomic<uint64_t> num_filter_false_positives;
 };
 
 /**
@@ -357,7 +375,9 @@ public:
     KvsHeader(fdb_kvs_id_t _id_counter,
               size_t _num_kv_stores)
         : id_counter(_id_counter), default_kvs_cmp(nullptr),
-          custom_cmp_enabled(0), num_kv_stores(_num_kv_stores)
+          custom_cmp_enabled(0), num_kv_stores(_num_kv_stores),
+          default_dict_offset(BLK_NOT_FOUND),
+          default_kvs_codec(FDB_COMPRESSION_DEFAULT), blob_files(nullptr)
     {
         idx_name = (struct avl_tree*)malloc(sizeof(struct avl_tree));
         avl_init(idx_name, nullptr);
@@ -396,6 +416,20 @@ public:
      * Number of KV store instances
      */
     size_t num_kv_stores;
+    /**
+     * Offset of the system doc holding the compression dictionary of the
+     * default KV store, or BLK_NOT_FOUND if none.
+     */
+    uint64_t default_dict_offset;
+    /**
+     * Compression codec of the default KV store if set by user.
+     */
+    fdb_compression_codec_t default_kvs_codec;
+    /**
+     * Blob files of the file that this header belongs to (not owned), or
+     * NULL if the header is not attached to a file.
+     */
+    BlobFileSet *blob_files;
     /**
      * lock to protect access to the idx_name and idx_id trees above
      */
@@ -423,10 +457,19 @@ struct kvs_node {
      * Flags indicating various states of the KV store.
      */
     uint64_t flags;
+    /**
+     * Offset of the system doc holding the compression dictionary of this
+     * KV store, or BLK_NOT_FOUND if none.
+     */
+    uint64_t dict_offset;
     /**
      * Custom compare function set by user (in-memory only).
      */
     fdb_custom_cmp_variable custom_cmp;
+    /**
+     * Compression codec set by user (in-memory only).
+     */
+    fdb_compression_codec_t codec;
     /**
      * Operational CRUD statistics for this KV store (in-memory only).
      */
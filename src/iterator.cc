@@ -63,15 +63,15 @@ static int _fdb_keycmp(void *key1, size_t keylen1, void *key2, size_t keylen2)
     }
 }
 
-static int _fdb_key_cmp(fdb_iterator *iterator, void *key1, size_t keylen1,
-                        void *key2, size_t keylen2) {
+static int _fdb_kvs_key_cmp(FdbKvsHandle *handle, void *key1, size_t keylen1,
+                            void *key2, size_t keylen2) {
     int cmp;
-    if (iterator->getHandle()->kvs_config.custom_cmp) {
+    if (handle->kvs_config.custom_cmp) {
         // custom compare function for variable length key
-        if (iterator->getHandle()->kvs) {
+        if (handle->kvs) {
             // multi KV instance mode
             // KV ID should be compared separately
-            size_t size_chunk = iterator->getHandle()->config.chunksize;
+            size_t size_chunk = handle->config.chunksize;
             fdb_kvs_id_t a_id, b_id;
             buf2kvid(size_chunk, key1, &a_id);
             buf2kvid(size_chunk, key2, &b_id);
@@ -86,13 +86,12 @@ static int _fdb_key_cmp(fdb_iterator *iterator, void *key1, size_t keylen1,
                 } else if (keylen2 == size_chunk) { // key1 > key2
                     return 1;
                 }
-                cmp = iterator->getHandle()->kvs_config.custom_cmp(
+                cmp = handle->kvs_config.custom_cmp(
                           (uint8_t*)key1 + size_chunk, keylen1 - size_chunk,
                           (uint8_t*)key2 + size_chunk, keylen2 - size_chunk);
             }
         } else {
-            cmp = iterator->getHandle()->kvs_config.custom_cmp(key1, keylen1,
-                                                       key2, keylen2);
+            cmp = handle->kvs_config.custom_cmp(key1, keylen1, key2, keylen2);
         }
     } else {
         cmp = _fdb_keycmp(key1, keylen1, key2, keylen2);
@@ -100,6 +99,12 @@ static int _fdb_key_cmp(fdb_iterator *iterator, void *key1, size_t keylen1,
     return cmp;
 }
 
+static int _fdb_key_cmp(fdb_iterator *iterator, void *key1, size_t keylen1,
+                        void *key2, size_t keylen2) {
+    return _fdb_kvs_key_cmp(iterator->getHandle(), key1, keylen1,
+                            key2, keylen2);
+}
+
 FdbIterator::FdbIterator(FdbKvsHandle *_handle,
                          bool snapshoted_handle,
                          const void *start_key,
@@ -111,7 +116,8 @@ FdbIterator::FdbIterator(FdbKvsHandle *_handle,
       seqtreeIterator(nullptr), seqtrieIterator(nullptr),
       seqNum(0), iterOpt(opt), iterDirection(FDB_ITR_DIR_NONE),
       iterStatus(FDB_ITR_IDX), iterOffset(BLK_NOT_FOUND),
-      dHandle(nullptr), getOffset(0), iterType(FDB_ITR_REG)
+      dHandle(nullptr), getOffset(0), iterType(FDB_ITR_REG),
+      raLastBid(BLK_NOT_FOUND), raSeqCount(0), raEndBid(BLK_NOT_FOUND)
 {
     iterKey.data = (void*)malloc(FDB_MAX_KEYLEN_INTERNAL);
     // set to zero the first <chunksize> bytes
@@ -226,7 +232,8 @@ FdbIterator::FdbIterator(FdbKvsHandle *_handle,
       startSeqnum(start_seq), iterOpt(opt), iterDirection(FDB_ITR_DIR_NONE),
       iterStatus(FDB_ITR_IDX), iterKey({nullptr, 0}),
       iterOffset(BLK_NOT_FOUND), dHandle(nullptr), getOffset(0),
-      iterType(FDB_ITR_SEQ)
+      iterType(FDB_ITR_SEQ), raLastBid(BLK_NOT_FOUND), raSeqCount(0),
+      raEndBid(BLK_NOT_FOUND)
 {
     // For easy API call, treat zero seq as 0xffff...
     // (because zero seq number is not used)
@@ -398,6 +405,210 @@ fdb_status FdbIterator::initIterator(FdbKvsHandle *handle,
     return FDB_RESULT_SUCCESS;
 }
 
+// Number of bisection steps to find the relative position of a key
+#define ITR_SPLIT_BISECTION_STEPS (32)
+
+// Find the smallest relative position whose key is larger than (or equal to,
+// if 'inclusive' is set) the given key.
+static double _fdb_find_rank(FdbKvsHandle *handle, void *key, size_t keylen,
+                             bool inclusive, uint8_t *keybuf)
+{
+    double lo = 0, hi = 1, mid;
+    size_t len;
+    int cmp, i;
+
+    for (i = 0; i < ITR_SPLIT_BISECTION_STEPS; ++i) {
+        mid = (lo + hi) / 2;
+        if (handle->trie->findKeyByRank(mid, keybuf, len) !=
+            HBTRIE_RESULT_SUCCESS) {
+            break;
+        }
+        cmp = _fdb_kvs_key_cmp(handle, keybuf, len, key, keylen);
+        if (cmp > 0 || (inclusive && cmp == 0)) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+    return hi;
+}
+
+static void _fdb_set_range_key(FdbKvsHandle *handle, void *key, size_t keylen,
+                               void **key_out, size_t *keylen_out)
+{
+    size_t size_chunk = handle->kvs ? handle->config.chunksize : 0;
+    // strip KV ID
+    *keylen_out = keylen - size_chunk;
+    *key_out = (void *)malloc(*keylen_out);
+    memcpy(*key_out, (uint8_t*)key + size_chunk, *keylen_out);
+}
+
+fdb_status FdbIterator::splitRange(FdbKvsHandle *handle,
+                                   const void *min_key,
+                                   size_t min_keylen,
+                                   const void *max_key,
+                                   size_t max_keylen,
+                                   size_t num_ranges,
+                                   fdb_iterator_range_list *range_list)
+{
+    fdb_status fs = FDB_RESULT_SUCCESS;
+
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!range_list || !num_ranges ||
+        min_keylen > FDB_MAX_KEYLEN || max_keylen > FDB_MAX_KEYLEN ||
+        (min_key && !min_keylen) || (max_key && !max_keylen)) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (!handle->shandle) {
+        // If compaction is already done before this line,
+        // handle->file needs to be replaced with handle->new_file.
+        fs = fdb_check_file_reopen(handle, NULL);
+        if (fs != FDB_RESULT_SUCCESS) {
+            return fs;
+        }
+        fdb_sync_db_header(handle);
+    }
+
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    // Build the boundary keys in the form of the keys in the main index
+    // (i.e., with KV ID prefix in multi KV instance mode).
+    size_t size_chunk = handle->kvs ? handle->config.chunksize : 0;
+    uint8_t *lo_key = NULL, *hi_key = NULL;
+    size_t lo_keylen = 0, hi_keylen = 0;
+    if (handle->kvs) {
+        lo_key = alca(uint8_t, size_chunk + min_keylen);
+        kvid2buf(size_chunk, handle->kvs->getKvsId(), lo_key);
+        if (min_key) {
+            memcpy(lo_key + size_chunk, min_key, min_keylen);
+        }
+        lo_keylen = size_chunk + min_keylen;
+
+        hi_key = alca(uint8_t, size_chunk + max_keylen);
+        if (max_key) {
+            kvid2buf(size_chunk, handle->kvs->getKvsId(), hi_key);
+            memcpy(hi_key + size_chunk, max_key, max_keylen);
+            hi_keylen = size_chunk + max_keylen;
+        } else {
+            // NULL key of the next KV ID
+            kvid2buf(size_chunk, handle->kvs->getKvsId() + 1, hi_key);
+            hi_keylen = size_chunk;
+        }
+    } else {
+        lo_key = (uint8_t*)min_key;
+        lo_keylen = min_keylen;
+        hi_key = (uint8_t*)max_key;
+        hi_keylen = max_keylen;
+    }
+
+    // Relative positions of the boundary keys in the main index
+    uint8_t *keybuf = alca(uint8_t, FDB_MAX_KEYLEN_INTERNAL);
+    uint8_t *prevbuf = alca(uint8_t, FDB_MAX_KEYLEN_INTERNAL);
+    size_t keylen = 0, prevlen = 0;
+    double rank_lo = 0, rank_hi = 1;
+    bool splittable = num_ranges > 1 &&
+        handle->trie->findKeyByRank(0, keybuf, keylen) == HBTRIE_RESULT_SUCCESS;
+
+    if (splittable) {
+        if (lo_keylen) {
+            rank_lo = _fdb_find_rank(handle, lo_key, lo_keylen, true, keybuf);
+        }
+        if (hi_keylen) {
+            // for the NULL key of the next KV ID, the keys of the next
+            // KV ID should be excluded
+            rank_hi = _fdb_find_rank(handle, hi_key, hi_keylen,
+                                     handle->kvs && !max_key, keybuf);
+        }
+        if (rank_hi <= rank_lo) {
+            splittable = false;
+        }
+    }
+
+    range_list->ranges = (fdb_iterator_range*)
+                         calloc(num_ranges, sizeof(fdb_iterator_range));
+    if (!range_list->ranges) { // LCOV_EXCL_START
+        if (!ver_btreev2_format(handle->file->getVersion())) {
+            handle->bhandle->flushBuffer();
+        }
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_ALLOC_FAIL;
+    } // LCOV_EXCL_STOP
+    size_t n = 0;
+    fdb_iterator_range *cur = &range_list->ranges[0];
+    if (min_key) {
+        cur->min_keylen = min_keylen;
+        cur->min_key = (void *)malloc(min_keylen);
+        memcpy(cur->min_key, min_key, min_keylen);
+    }
+
+    for (size_t i = 1; splittable && i < num_ranges; ++i) {
+        double rank = rank_lo + (rank_hi - rank_lo) * i / num_ranges;
+        if (handle->trie->findKeyByRank(rank, keybuf, keylen) !=
+            HBTRIE_RESULT_SUCCESS) {
+            break;
+        }
+        // each split key should be unique, and strictly inside the range
+        if ((prevlen &&
+             _fdb_kvs_key_cmp(handle, keybuf, keylen, prevbuf, prevlen) <= 0) ||
+            (lo_keylen &&
+             _fdb_kvs_key_cmp(handle, keybuf, keylen, lo_key, lo_keylen) <= 0) ||
+            keylen <= size_chunk) {
+            continue;
+        }
+        if (hi_keylen &&
+            _fdb_kvs_key_cmp(handle, keybuf, keylen, hi_key, hi_keylen) >= 0) {
+            break;
+        }
+        memcpy(prevbuf, keybuf, keylen);
+        prevlen = keylen;
+
+        // close the current range, and open the next one
+        _fdb_set_range_key(handle, keybuf, keylen,
+                           &cur->max_key, &cur->max_keylen);
+        cur->opt = FDB_ITR_SKIP_MAX_KEY;
+        cur = &range_list->ranges[++n];
+        _fdb_set_range_key(handle, keybuf, keylen,
+                           &cur->min_key, &cur->min_keylen);
+    }
+
+    if (max_key) {
+        cur->max_keylen = max_keylen;
+        cur->max_key = (void *)malloc(max_keylen);
+        memcpy(cur->max_key, max_key, max_keylen);
+    }
+    range_list->num_ranges = n + 1;
+
+    if (!ver_btreev2_format(handle->file->getVersion())) {
+        handle->bhandle->flushBuffer();
+    }
+    END_HANDLE_BUSY(handle);
+
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status FdbIterator::freeRangeList(fdb_iterator_range_list *range_list)
+{
+    if (!range_list) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    for (size_t i = 0; i < range_list->num_ranges; ++i) {
+        free(range_list->ranges[i].min_key);
+        free(range_list->ranges[i].max_key);
+    }
+    free(range_list->ranges);
+    range_list->ranges = NULL;
+    range_list->num_ranges = 0;
+
+    return FDB_RESULT_SUCCESS;
+}
+
 fdb_status FdbIterator::initSeqIterator(FdbKvsHandle *handle,
                                         fdb_iterator **ptr_iterator,
                                         const fdb_seqnum_t start_seq,
@@ -1063,6 +1274,55 @@ fdb_status FdbIterator::iterateToNext() {
     return result;
 }
 
+// Number of consecutive sequential doc reads to start readahead
+#define ITR_READAHEAD_TRIGGER (4)
+
+void FdbIterator::readAhead(DocioHandle *dhandle, uint64_t offset)
+{
+    FileMgr *file = dhandle->getFile();
+    size_t blocksize = file->getBlockSize();
+    size_t depth = (iterOpt >> 8) & 0xff;
+    if (!depth) {
+        depth = FDB_ITR_READAHEAD_DEFAULT_DEPTH;
+    }
+    // readahead window in the number of blocks
+    size_t window = depth * FDB_ITR_READAHEAD_UNIT / blocksize;
+    if (!window) {
+        window = 1;
+    }
+    bid_t bid = offset / blocksize;
+
+    // The doc is regarded as sequential if it is located after the previous
+    // doc within a quarter of the window (i.e., a few docs can be skipped).
+    if (raLastBid != BLK_NOT_FOUND && bid >= raLastBid &&
+        bid - raLastBid <= window / 4 + 1) {
+        ++raSeqCount;
+    } else {
+        raSeqCount = 0;
+        raEndBid = BLK_NOT_FOUND;
+    }
+    raLastBid = bid;
+
+    if (raSeqCount < ITR_READAHEAD_TRIGGER) {
+        return;
+    }
+
+    // Issue the next readahead when the cursor passes the middle of
+    // the current window, so that the following blocks are already cached
+    // by the time the cursor reaches them.
+    if (raEndBid == BLK_NOT_FOUND || raEndBid <= bid ||
+        raEndBid - bid <= window / 2) {
+        bid_t start_bid = (raEndBid == BLK_NOT_FOUND || raEndBid <= bid) ?
+                          bid : raEndBid;
+        bid_t end_bid = bid + window;
+        if (start_bid < end_bid) {
+            file->readAhead(start_bid, end_bid - start_bid,
+                            &iterHandle->log_callback);
+        }
+        raEndBid = end_bid;
+    }
+}
+
 fdb_status FdbIterator::get(fdb_doc **doc, bool metaOnly) {
 
     if (!doc) {
@@ -1111,6 +1371,10 @@ fdb_status FdbIterator::get(fdb_doc **doc, bool metaOnly) {
         alloced_body = (metaOnly || _doc.body) ? false : true;
     }
 
+    if (iterOpt & FDB_ITR_READAHEAD) {
+        readAhead(dhandle, offset);
+    }
+
     int64_t _offset = 0;
     if (metaOnly) {
         _offset = dhandle->readDocKeyMeta_Docio(offset, &_doc, true);
@@ -1164,6 +1428,58 @@ fdb_status FdbIterator::get(fdb_doc **doc, bool metaOnly) {
     return ret;
 }
 
+fdb_status FdbIterator::getView(fdb_doc_view *view) {
+
+    if (!view || !view->buffers) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    uint64_t offset;
+    struct docio_length length;
+    DocioHandle *dhandle;
+    size_t size_chunk = iterHandle->config.chunksize;
+    LATENCY_STAT_START();
+
+    dhandle = dHandle;
+    if (!dhandle || getOffset == BLK_NOT_FOUND) {
+        return FDB_RESULT_ITERATOR_FAIL;
+    }
+
+    if (!BEGIN_HANDLE_BUSY(iterHandle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    offset = getOffset;
+
+    if (iterOpt & FDB_ITR_READAHEAD) {
+        readAhead(dhandle, offset);
+    }
+
+    int64_t _offset = dhandle->readDocView_Docio(offset, view, &length);
+    if (_offset <= 0) {
+        END_HANDLE_BUSY(iterHandle);
+        return _offset < 0 ? (fdb_status) _offset : FDB_RESULT_KEY_NOT_FOUND;
+    }
+    if ((length.flag & DOCIO_DELETED) && (iterOpt & FDB_ITR_NO_DELETES)) {
+        END_HANDLE_BUSY(iterHandle);
+        return FDB_RESULT_KEY_NOT_FOUND;
+    }
+
+    if (iterHandle->kvs) {
+        // skip KV ID in front of the key
+        view->key = (const uint8_t*)view->key + size_chunk;
+        view->keylen -= size_chunk;
+    }
+    view->offset = offset;
+    view->size_ondisk = _fdb_get_docsize(length);
+
+    END_HANDLE_BUSY(iterHandle);
+    iterHandle->op_stats->num_iterator_gets++;
+    LATENCY_STAT_END(iterHandle->file, FDB_LATENCY_ITR_GET);
+
+    return FDB_RESULT_SUCCESS;
+}
+
 fdb_status FdbIterator::iterate(itr_seek_t seek_type) {
     int cmp;
     void *key;
@@ -1933,6 +2249,26 @@ fdb_status fdb_iterator_sequence_init(FdbKvsHandle *handle,
 }
 
 
+LIBFDB_API
+fdb_status fdb_iterator_split(FdbKvsHandle *handle,
+                              const void *min_key,
+                              size_t min_keylen,
+                              const void *max_key,
+                              size_t max_keylen,
+                              size_t num_ranges,
+                              fdb_iterator_range_list *range_list)
+{
+    return FdbIterator::splitRange(handle, min_key, min_keylen,
+                                   max_key, max_keylen,
+                                   num_ranges, range_list);
+}
+
+LIBFDB_API
+fdb_status fdb_free_iterator_range_list(fdb_iterator_range_list *range_list)
+{
+    return FdbIterator::freeRangeList(range_list);
+}
+
 LIBFDB_API
 fdb_status fdb_iterator_seek(fdb_iterator *iterator,
                              const void *seek_key,
@@ -2017,6 +2353,16 @@ fdb_status fdb_iterator_get_metaonly(fdb_iterator *iterator, fdb_doc **doc)
     return iterator->get(doc, /*metaOnly*/true);
 }
 
+LIBFDB_API
+fdb_status fdb_iterator_get_view(fdb_iterator *iterator, fdb_doc_view *view)
+{
+    if (!iterator || !iterator->getHandle()) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    return iterator->getView(view);
+}
+
 LIBFDB_API
 fdb_status fdb_iterator_close(fdb_iterator *iterator)
 {
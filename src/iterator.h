@@ -124,6 +124,18 @@ public:
     /* To close & delete an iterator */
     static fdb_status destroyIterator(fdb_iterator *iterator);
 
+    /* To split a key range into sub-ranges of similar number of keys */
+    static fdb_status splitRange(FdbKvsHandle *handle,
+                                 const void *min_key,
+                                 size_t min_keylen,
+                                 const void *max_key,
+                                 size_t max_keylen,
+                                 size_t num_ranges,
+                                 fdb_iterator_range_list *range_list);
+
+    /* To free a key range list returned by splitRange() */
+    static fdb_status freeRangeList(fdb_iterator_range_list *range_list);
+
     /**
      * Iterate through the changes since sequence number `since` with a provided
      * callback function.
@@ -162,6 +174,9 @@ public:
     /* Gets the item pointed to by the iterator */
     fdb_status get(fdb_doc **doc, bool metaOnly);
 
+    /* Gets the item pointed to by the iterator into a doc view */
+    fdb_status getView(fdb_doc_view *view);
+
 private:
     /* Constructor for regular iterator */
     FdbIterator(FdbKvsHandle *_handle,
@@ -200,6 +215,10 @@ private:
     /* Operation for a sequence iterator to move forward */
     fdb_status iterateSeqNext();
 
+    /* Read ahead the blocks following the given doc offset into the buffer
+       cache, if the docs are being read sequentially */
+    void readAhead(DocioHandle *dhandle, uint64_t offset);
+
     // ForestDB KV store handle
     FdbKvsHandle *iterHandle;
 
@@ -249,5 +268,11 @@ private:
     uint64_t getOffset;
     // Type of iterator
     fdb_iterator_type_t iterType;
+    // Block ID of the last doc read through the iterator
+    bid_t raLastBid;
+    // Number of consecutive sequential doc reads
+    uint32_t raSeqCount;
+    // End (exclusive) of the block range that has been read ahead
+    bid_t raEndBid;
 };
 
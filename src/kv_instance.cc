@@ -17,6 +17,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 #include "libforestdb/forestdb.h"
 #include "fdb_engine.h"
@@ -293,6 +294,7 @@ void fdb_kvs_header_create(FileMgr *file)
     }
 
     _fdb_kvs_header_create(&kv_header);
+    kv_header->blob_files = file->getBlobFiles();
     file->setKVHeader_UNLOCKED(kv_header);
     file->setFreeKVHeaderCB(fdb_kvs_header_free);
     file->releaseSpinLock();
@@ -314,6 +316,30 @@ void fdb_kvs_header_reset_all_stats(FileMgr *file)
     spin_unlock(&kv_header->lock);
 }
 
+// copy a compression dictionary doc into a new file, and return its new offset
+static uint64_t _fdb_kvs_copy_dict(DocioHandle *dhandle,
+                                   DocioHandle *new_dhandle,
+                                   uint64_t dict_offset)
+{
+    int64_t _offset;
+    uint64_t new_offset;
+    struct docio_object doc;
+
+    if (dict_offset == BLK_NOT_FOUND) {
+        return BLK_NOT_FOUND;
+    }
+
+    memset(&doc, 0, sizeof(struct docio_object));
+    _offset = dhandle->readDoc_Docio(dict_offset, &doc, true);
+    if (_offset <= 0 || !(doc.length.flag & DOCIO_SYSTEM)) {
+        free_docio_object(&doc, true, true, true);
+        return BLK_NOT_FOUND;
+    }
+    new_offset = new_dhandle->appendSystemDoc_Docio(&doc);
+    free_docio_object(&doc, true, true, true);
+    return new_offset;
+}
+
 void fdb_kvs_header_copy(FdbKvsHandle *handle,
                          FileMgr *new_file,
                          DocioHandle *new_dhandle,
@@ -331,6 +357,23 @@ void fdb_kvs_header_copy(FdbKvsHandle *handle,
         fdb_kvs_header_read(kv_header, handle->dhandle,
                             handle->kv_info_offset, handle->file->getVersion(), false);
 
+        // copy compression dictionaries, which are referred to by their
+        // offsets in the file
+        kv_header->default_dict_offset =
+            _fdb_kvs_copy_dict(handle->dhandle, new_dhandle,
+                               kv_header->default_dict_offset);
+        a = avl_first(kv_header->idx_id);
+        while (a) {
+            node_new = _get_entry(a, struct kvs_node, avl_id);
+            node_new->dict_offset = _fdb_kvs_copy_dict(handle->dhandle,
+                                                       new_dhandle,
+                                                       node_new->dict_offset);
+            a = avl_next(a);
+        }
+
+        // the blob files were already inherited by 'new_file'
+        kv_header->blob_files = new_file->getBlobFiles();
+
         // write KV header in 'new_file' using 'new_dhandle'
         uint64_t new_kv_info_offset;
         FdbKvsHandle new_handle;
@@ -356,6 +399,8 @@ void fdb_kvs_header_copy(FdbKvsHandle *handle,
         handle->file->getKVHeader_UNLOCKED()->default_kvs_cmp;
     new_file->getKVHeader_UNLOCKED()->custom_cmp_enabled =
         handle->file->getKVHeader_UNLOCKED()->custom_cmp_enabled;
+    new_file->getKVHeader_UNLOCKED()->default_kvs_codec =
+        handle->file->getKVHeader_UNLOCKED()->default_kvs_codec;
     a = avl_first(handle->file->getKVHeader_UNLOCKED()->idx_id);
     while (a) {
         node_old = _get_entry(a, struct kvs_node, avl_id);
@@ -364,6 +409,7 @@ void fdb_kvs_header_copy(FdbKvsHandle *handle,
         assert(aa); // MUST exist
         node_new = _get_entry(aa, struct kvs_node, avl_id);
         node_new->custom_cmp = node_old->custom_cmp;
+        node_new->codec = node_old->codec;
         node_new->seqnum = node_old->seqnum;
         node_new->op_stat = node_old->op_stat;
         a = avl_next(a);
@@ -391,6 +437,19 @@ static void _fdb_kvs_header_export(KvsHeader *kv_header,
      * [delta size]:            8 bytes (since MAGIC_001)
      * [# deleted docs]:        8 bytes (since MAGIC_001)
      * ...
+     * --- (optional, only if any compression dictionary exists)
+     * [# dictionaries]:        8 bytes
+     * [KV ID]:                 8 bytes (0 for the default KV instance)
+     * [dict doc offset]:       8 bytes
+     * ...
+     * --- (optional, only if any blob file exists)
+     * [# blob files]:          8 bytes
+     * [last blob file ID]:     8 bytes
+     * [blob file ID]:          8 bytes
+     * [live bytes]:            8 bytes
+     * [path length]:           2 bytes
+     * [path]:                  x bytes
+     * ...
      *    Please note that if the above format is changed, please also change...
      *    _fdb_kvs_get_snap_info()
      *    _fdb_kvs_header_import()
@@ -402,6 +461,9 @@ static void _fdb_kvs_header_export(KvsHeader *kv_header,
     int offset = 0;
     uint16_t name_len, _name_len;
     uint64_t c = 0;
+    uint64_t n_dicts = 0, _n_dicts, _dict_offset;
+    size_t blob_size = 0;
+    void *blob_buf;
     uint64_t _n_kv, _kv_id, _flags;
     uint64_t _nlivenodes, _ndocs, _datasize, _ndeletes;
     int64_t _deltasize;
@@ -437,8 +499,24 @@ static void _fdb_kvs_header_export(KvsHeader *kv_header,
             size += sizeof(node->stat.deltasize); // delta size since commit
             size += sizeof(node->stat.ndeletes); // # deleted docs
         }
+        if (node->dict_offset != BLK_NOT_FOUND) {
+            n_dicts++;
+        }
         a = avl_next(a);
     }
+    if (kv_header->default_dict_offset != BLK_NOT_FOUND) {
+        n_dicts++;
+    }
+    // export the blob file table at once, as blob files can be added
+    // concurrently
+    blob_buf = kv_header->blob_files ?
+               kv_header->blob_files->exportTable(&blob_size) : NULL;
+    if (n_dicts || blob_size) {
+        // the blob file table follows the dictionaries, even if none
+        size += sizeof(n_dicts);
+        size += n_dicts * (sizeof(fdb_kvs_id_t) + sizeof(uint64_t));
+    }
+    size += blob_size;
 
     *data = (void *)malloc(size);
 
@@ -511,6 +589,44 @@ static void _fdb_kvs_header_export(KvsHeader *kv_header,
         a = avl_next(a);
     }
 
+    if (n_dicts || blob_size) {
+        // # dictionaries
+        _n_dicts = _endian_encode(n_dicts);
+        memcpy((uint8_t*)*data + offset, &_n_dicts, sizeof(_n_dicts));
+        offset += sizeof(_n_dicts);
+
+        if (kv_header->default_dict_offset != BLK_NOT_FOUND) {
+            _kv_id = 0;
+            memcpy((uint8_t*)*data + offset, &_kv_id, sizeof(_kv_id));
+            offset += sizeof(_kv_id);
+            _dict_offset = _endian_encode(kv_header->default_dict_offset);
+            memcpy((uint8_t*)*data + offset, &_dict_offset,
+                   sizeof(_dict_offset));
+            offset += sizeof(_dict_offset);
+        }
+
+        a = avl_first(kv_header->idx_name);
+        while(a) {
+            node = _get_entry(a, struct kvs_node, avl_name);
+            if (node->dict_offset != BLK_NOT_FOUND) {
+                _kv_id = _endian_encode(node->id);
+                memcpy((uint8_t*)*data + offset, &_kv_id, sizeof(_kv_id));
+                offset += sizeof(_kv_id);
+                _dict_offset = _endian_encode(node->dict_offset);
+                memcpy((uint8_t*)*data + offset, &_dict_offset,
+                       sizeof(_dict_offset));
+                offset += sizeof(_dict_offset);
+            }
+            a = avl_next(a);
+        }
+    }
+
+    if (blob_buf) {
+        memcpy((uint8_t*)*data + offset, blob_buf, blob_size);
+        offset += blob_size;
+        free(blob_buf);
+    }
+
     *len = size;
 
     spin_unlock(&kv_header->lock);
@@ -542,6 +658,9 @@ void _fdb_kvs_header_import(KvsHeader *kv_header,
 
     spin_lock(&kv_header->lock);
     kv_header->id_counter = id_counter;
+    if (!only_seq_nums) {
+        kv_header->default_dict_offset = BLK_NOT_FOUND;
+    }
 
     // Version control
     if (!ver_is_atleast_magic_001(version)) {
@@ -580,6 +699,7 @@ void _fdb_kvs_header_import(KvsHeader *kv_header,
             node->kvs_name = (char *)malloc(name_len);
             memcpy(node->kvs_name, (uint8_t*)data + name_offset, name_len);
             node->id = kv_id;
+            node->dict_offset = BLK_NOT_FOUND;
             node->op_stat.reset();
         }
 
@@ -624,6 +744,7 @@ void _fdb_kvs_header_import(KvsHeader *kv_header,
             node->stat.ndeletes = _endian_decode(_ndeletes);
             node->flags = flags;
             node->custom_cmp = NULL;
+            node->dict_offset = BLK_NOT_FOUND;
         }
 
         if (!a) { // Insert a new KV header node if not exist.
@@ -632,6 +753,44 @@ void _fdb_kvs_header_import(KvsHeader *kv_header,
             ++kv_header->num_kv_stores;
         }
     }
+
+    // Compression dictionaries (optional). They refer to docs in the file
+    // that the header was read from, so are not imported into another file.
+    if (!only_seq_nums && offset + sizeof(uint64_t) <= len) {
+        uint64_t n_dicts, _n_dicts, _dict_offset;
+        memcpy(&_n_dicts, (uint8_t*)data + offset, sizeof(_n_dicts));
+        offset += sizeof(_n_dicts);
+        n_dicts = _endian_decode(_n_dicts);
+
+        for (i=0;i<n_dicts;++i) {
+            memcpy(&_kv_id, (uint8_t*)data + offset, sizeof(_kv_id));
+            offset += sizeof(_kv_id);
+            kv_id = _endian_decode(_kv_id);
+            memcpy(&_dict_offset, (uint8_t*)data + offset,
+                   sizeof(_dict_offset));
+            offset += sizeof(_dict_offset);
+
+            if (kv_id == 0) {
+                kv_header->default_dict_offset = _endian_decode(_dict_offset);
+                continue;
+            }
+            struct kvs_node query;
+            query.id = kv_id;
+            struct avl_node *a = avl_search(kv_header->idx_id, &query.avl_id,
+                                            _kvs_cmp_id);
+            if (a) {
+                node = _get_entry(a, struct kvs_node, avl_id);
+                node->dict_offset = _endian_decode(_dict_offset);
+            }
+        }
+
+        // Blob files (optional). They are merged only into the blob files of
+        // the file that the header belongs to.
+        if (kv_header->blob_files && offset < len) {
+            offset += kv_header->blob_files->importTable(
+                                (uint8_t*)data + offset, len - offset);
+        }
+    }
     spin_unlock(&kv_header->lock);
 }
 
@@ -937,6 +1096,106 @@ void fdb_kvs_set_seqnum(FileMgr *file,
     spin_unlock(&kv_header->lock);
 }
 
+uint64_t fdb_kvs_get_dict_offset(FileMgr *file, fdb_kvs_id_t id)
+{
+    KvsHeader *kv_header = file->getKVHeader_UNLOCKED();
+    struct kvs_node query, *node;
+    struct avl_node *a;
+    uint64_t dict_offset = BLK_NOT_FOUND;
+
+    if (!kv_header) {
+        return BLK_NOT_FOUND;
+    }
+
+    spin_lock(&kv_header->lock);
+    if (id == 0) {
+        dict_offset = kv_header->default_dict_offset;
+    } else {
+        query.id = id;
+        a = avl_search(kv_header->idx_id, &query.avl_id, _kvs_cmp_id);
+        if (a) {
+            node = _get_entry(a, struct kvs_node, avl_id);
+            dict_offset = node->dict_offset;
+        }
+    }
+    spin_unlock(&kv_header->lock);
+    return dict_offset;
+}
+
+void fdb_kvs_set_dict_offset(FileMgr *file,
+                             fdb_kvs_id_t id,
+                             uint64_t dict_offset)
+{
+    KvsHeader *kv_header = file->getKVHeader_UNLOCKED();
+    struct kvs_node query, *node;
+    struct avl_node *a;
+
+    spin_lock(&kv_header->lock);
+    if (id == 0) {
+        kv_header->default_dict_offset = dict_offset;
+    } else {
+        query.id = id;
+        a = avl_search(kv_header->idx_id, &query.avl_id, _kvs_cmp_id);
+        if (a) {
+            node = _get_entry(a, struct kvs_node, avl_id);
+            node->dict_offset = dict_offset;
+        }
+    }
+    spin_unlock(&kv_header->lock);
+}
+
+fdb_compression_codec_t fdb_kvs_get_codec(FileMgr *file, fdb_kvs_id_t id)
+{
+    KvsHeader *kv_header = file->getKVHeader_UNLOCKED();
+    struct kvs_node query, *node;
+    struct avl_node *a;
+    fdb_compression_codec_t codec = FDB_COMPRESSION_DEFAULT;
+
+    if (!kv_header) {
+        return FDB_COMPRESSION_DEFAULT;
+    }
+
+    spin_lock(&kv_header->lock);
+    if (id == 0) {
+        codec = kv_header->default_kvs_codec;
+    } else {
+        query.id = id;
+        a = avl_search(kv_header->idx_id, &query.avl_id, _kvs_cmp_id);
+        if (a) {
+            node = _get_entry(a, struct kvs_node, avl_id);
+            codec = node->codec;
+        }
+    }
+    spin_unlock(&kv_header->lock);
+    return codec;
+}
+
+void fdb_kvs_set_codec(FileMgr *file,
+                       fdb_kvs_id_t id,
+                       fdb_compression_codec_t codec)
+{
+    KvsHeader *kv_header = file->getKVHeader_UNLOCKED();
+    struct kvs_node query, *node;
+    struct avl_node *a;
+
+    if (!kv_header) {
+        return;
+    }
+
+    spin_lock(&kv_header->lock);
+    if (id == 0) {
+        kv_header->default_kvs_codec = codec;
+    } else {
+        query.id = id;
+        a = avl_search(kv_header->idx_id, &query.avl_id, _kvs_cmp_id);
+        if (a) {
+            node = _get_entry(a, struct kvs_node, avl_id);
+            node->codec = codec;
+        }
+    }
+    spin_unlock(&kv_header->lock);
+}
+
 void _fdb_kvs_header_free(KvsHeader *kv_header)
 {
     struct kvs_node *node;
@@ -1436,6 +1695,10 @@ fdb_status FdbEngine::getKvsOpsInfo(FdbKvsHandle *handle, fdb_kvs_ops_info *info
                                                      std::memory_order_relaxed);
     info->num_iterator_moves = stat.num_iterator_moves.load(
                                                      std::memory_order_relaxed);
+    info->num_filter_negatives = stat.num_filter_negatives.load(
+                                                     std::memory_order_relaxed);
+    info->num_filter_false_positives = stat.num_filter_false_positives.load(
+                                                     std::memory_order_relaxed);
 
     info->num_commits = root_stat.num_commits.load(std::memory_order_relaxed);
     info->num_compacts = root_stat.num_compacts.load(std::memory_order_relaxed);
@@ -1486,6 +1749,158 @@ fdb_status FdbEngine::getKvsSeqnum(FdbKvsHandle *handle, fdb_seqnum_t *seqnum)
     return status;
 }
 
+fdb_status FdbEngine::trainCompressionDict(FdbKvsHandle *handle,
+                                           size_t max_dict_size)
+{
+    fdb_status fs;
+    fdb_iterator *iterator;
+    fdb_doc *doc;
+    fdb_compression_codec_t codec;
+    size_t dict_size, sample_limit;
+    uint64_t dict_offset;
+    void *dict_buf;
+    std::vector<uint8_t> samples;
+    std::vector<size_t> sample_lens;
+    struct docio_object dict_doc;
+    doc_codec_dict *dict;
+    FileMgr *file;
+
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+    if (handle->config.flags & FDB_OPEN_FLAG_RDONLY) {
+        return fdb_log(&handle->log_callback, FDB_RESULT_RONLY_VIOLATION,
+                       "Warning: Training a compression dictionary is not "
+                       "allowed on the read-only DB file '%s'.",
+                       handle->file->getFileName());
+    }
+    if (handle->shandle || max_dict_size == 0) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    if (!handle->kvs) {
+        return fdb_log(&handle->log_callback, FDB_RESULT_INVALID_CONFIG,
+                       "Compression dictionaries are only supported in "
+                       "multi KV instance mode.");
+    }
+    codec = handle->kvs_config.compression_codec;
+    if (codec == FDB_COMPRESSION_DEFAULT) {
+        codec = handle->config.compression_codec;
+    }
+    if (codec != FDB_COMPRESSION_ZSTD) {
+        return fdb_log(&handle->log_callback, FDB_RESULT_INVALID_ARGS,
+                       "Compression dictionaries are only supported by the "
+                       "zstd codec.");
+    }
+
+    // sample the bodies of the current documents
+    fs = fdb_iterator_init(handle, &iterator, NULL, 0, NULL, 0,
+                           FDB_ITR_NO_DELETES);
+    if (fs != FDB_RESULT_SUCCESS) {
+        return fs;
+    }
+    sample_limit = max_dict_size * DOC_CODEC_DICT_SAMPLE_RATIO;
+    do {
+        doc = NULL;
+        if (fdb_iterator_get(iterator, &doc) != FDB_RESULT_SUCCESS) {
+            break;
+        }
+        if (doc->bodylen) {
+            samples.insert(samples.end(), (uint8_t*)doc->body,
+                           (uint8_t*)doc->body + doc->bodylen);
+            sample_lens.push_back(doc->bodylen);
+        }
+        fdb_doc_free(doc);
+    } while (samples.size() < sample_limit &&
+             fdb_iterator_next(iterator) == FDB_RESULT_SUCCESS);
+    fdb_iterator_close(iterator);
+
+    dict_buf = malloc(max_dict_size);
+    dict_size = 0;
+    if (!sample_lens.empty()) {
+        dict_size = doc_codec_train_dict(dict_buf, max_dict_size,
+                                         samples.data(), sample_lens.data(),
+                                         sample_lens.size());
+    }
+    if (dict_size == 0) {
+        free(dict_buf);
+        return fdb_log(&handle->log_callback, FDB_RESULT_COMPRESSION_FAIL,
+                       "Failed to train a compression dictionary from %d "
+                       "documents in a database file '%s'",
+                       (int)sample_lens.size(), handle->file->getFileName());
+    }
+
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        free(dict_buf);
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+fdb_train_dict_start:
+    fs = fdb_check_file_reopen(handle, NULL);
+    if (fs != FDB_RESULT_SUCCESS) {
+        free(dict_buf);
+        END_HANDLE_BUSY(handle);
+        return fs;
+    }
+
+    handle->file->mutexLock();
+    fdb_sync_db_header(handle);
+
+    if (handle->file->isRollbackOn()) {
+        handle->file->mutexUnlock();
+        free(dict_buf);
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_FAIL_BY_ROLLBACK;
+    }
+
+    file = handle->file;
+    if (file->getFileStatus() == FILE_REMOVED_PENDING) {
+        // we must not write into this file
+        // file status was changed by other thread .. start over
+        file->mutexUnlock();
+        goto fdb_train_dict_start;
+    }
+
+    // append the dictionary as a system doc
+    memset(&dict_doc, 0, sizeof(struct docio_object));
+    dict_doc.key = (void *)DOC_CODEC_DICT_KEY;
+    dict_doc.length.keylen = sizeof(DOC_CODEC_DICT_KEY);
+    dict_doc.body = dict_buf;
+    dict_doc.length.bodylen = dict_size;
+    dict_offset = handle->dhandle->appendSystemDoc_Docio(&dict_doc);
+    if (dict_offset == BLK_NOT_FOUND) {
+        file->mutexUnlock();
+        free(dict_buf);
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_WRITE_FAIL;
+    }
+    dict = doc_codec_dict_create(dict_buf, dict_size);
+    if (dict) {
+        file->addCodecDict(dict_offset, dict);
+    }
+    fdb_kvs_set_dict_offset(file,
+                            handle->kvs->getKvsType() == KVS_SUB ?
+                                handle->kvs->getKvsId() : 0,
+                            dict_offset);
+    file->mutexUnlock();
+    free(dict_buf);
+
+    handle->dhandle->setCodec_Docio(FDB_COMPRESSION_ZSTD, dict_offset);
+
+    END_HANDLE_BUSY(handle);
+    return FDB_RESULT_SUCCESS;
+}
+
+LIBFDB_API
+fdb_status fdb_kvs_train_compression_dict(fdb_kvs_handle *handle,
+                                          size_t max_dict_size)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->trainCompressionDict(handle, max_dict_size);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
 fdb_status FdbEngine::getKvsNameList(FdbFileHandle *fhandle,
                                      fdb_kvs_name_list *kvs_name_list)
 {
@@ -1685,6 +2100,8 @@ fdb_status FdbEngine::openKvs(FdbFileHandle *fhandle,
                 root_handle->file->getKVHeader_UNLOCKED()->default_kvs_cmp;
             spin_unlock(&root_handle->file->getKVHeader_UNLOCKED()->lock);
         }
+        // keep the codec for compaction to recompress the docs
+        fdb_kvs_set_codec(root_handle->file, 0, config_local.compression_codec);
 
         handle->fhandle = fhandle;
         fs = openFdb(handle, root_handle->file->getFileName(),
@@ -1737,6 +2154,9 @@ fdb_status FdbEngine::openKvs(FdbFileHandle *fhandle,
                  root_handle->file, root_handle->file->getFileName(),
                  kvs_name, handle);
     if (fs == FDB_RESULT_SUCCESS) {
+        // keep the codec for compaction to recompress the docs
+        fdb_kvs_set_codec(handle->file, handle->kvs->getKvsId(),
+                          config_local.compression_codec);
         *ptr_handle = handle;
     } else {
         *ptr_handle = NULL;
@@ -1807,6 +2227,7 @@ fdb_status FdbEngine::openKvs(FdbKvsHandle *root_handle,
                            "is read-only.", kvs_name ? kvs_name : DEFAULT_KVS_NAME);
         }
     }
+    handle->kvs_config.compression_codec = kvs_config->compression_codec;
     fs = openFdb(handle, filename, FDB_AFILENAME, config);
     if (fs != FDB_RESULT_SUCCESS) {
         if (handle->node) {
@@ -2089,6 +2510,8 @@ fdb_kvs_create_start:
     node->id = kv_header->id_counter++;
     node->seqnum = 0;
     node->flags = 0x0;
+    node->dict_offset = BLK_NOT_FOUND;
+    node->codec = kvs_config->compression_codec;
     node->op_stat.reset();
     // search fhandle's custom cmp func list first
     node->custom_cmp = root_handle->fhandle->getCmpFunctionByName((char *)kvs_name);
@@ -17,10 +17,17 @@
 
 #include <memory_pool.h>
 
-MemoryPool::MemoryPool(int num_bins, size_t bin_size) {
+MemoryPool::MemoryPool(int num_bins, size_t bin_size, size_t alignment)
+    : binAlignment(alignment) {
     spin_init(&lock);
     for (int i = 0; i < num_bins; ++i) {
-        memPool.push_back((uint8_t *) malloc(bin_size));
+        void *bin = NULL;
+        if (binAlignment) {
+            malloc_align(bin, binAlignment, bin_size);
+        } else {
+            bin = malloc(bin_size);
+        }
+        memPool.push_back((uint8_t *) bin);
         enQueue(i);
     }
 }
@@ -28,7 +35,11 @@ MemoryPool::MemoryPool(int num_bins, size_t bin_size) {
 MemoryPool::~MemoryPool() {
     spin_destroy(&lock);
     for (auto &it : memPool) {
-        free(it);
+        if (binAlignment) {
+            free_align(it);
+        } else {
+            free(it);
+        }
     }
 }
 
@@ -50,7 +50,13 @@ class MemoryPool {
 */
 
 public:
-    MemoryPool(int num_bins, size_t bin_size);
+    /**
+     * @param num_bins Number of bins.
+     * @param bin_size Size of each bin.
+     * @param alignment Alignment of each bin (e.g., for direct I/O), or 0 if
+     *        no specific alignment is required.
+     */
+    MemoryPool(int num_bins, size_t bin_size, size_t alignment = 0);
 
     ~MemoryPool();
 
@@ -88,4 +94,6 @@ private:
     std::queue<int> indexQ;
     // Vector of pre-allocated memory
     std::vector<uint8_t*> memPool;
+    // Alignment of the bins, 0 if allocated by malloc
+    size_t binAlignment;
 };
@@ -0,0 +1,198 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ratelimiter.h"
+#include "arch.h"
+#include "time_utils.h"
+
+#include "memleak.h"
+
+std::atomic<IoRateLimiter *> IoRateLimiter::instance(nullptr);
+std::mutex IoRateLimiter::instanceMutex;
+
+static uint64_t _now_us()
+{
+    return gethrtime() / 1000;
+}
+
+IoRateLimiter::IoRateLimiter(const struct ratelimiter_config &config)
+    : maxRate(config.bytes_per_sec), latencyTarget(config.latency_target_us),
+      curRate(config.bytes_per_sec), tokens(0)
+{
+    lastRefill = windowStart = _now_us();
+    for (size_t i = 0; i < RATE_LIMITER_LAT_BUCKETS; ++i) {
+        latHist[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+IoRateLimiter *IoRateLimiter::init(const struct ratelimiter_config &config)
+{
+    IoRateLimiter *tmp = instance.load();
+    if (tmp == nullptr && config.bytes_per_sec) {
+        std::lock_guard<std::mutex> lock(instanceMutex);
+        tmp = instance.load();
+        if (tmp == nullptr) {
+            tmp = new IoRateLimiter(config);
+            instance.store(tmp);
+        }
+    }
+    return tmp;
+}
+
+IoRateLimiter *IoRateLimiter::getInstance()
+{
+    return instance.load(std::memory_order_relaxed);
+}
+
+void IoRateLimiter::destroyInstance()
+{
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    IoRateLimiter *tmp = instance.load();
+    if (tmp != nullptr) {
+        delete tmp;
+        instance = nullptr;
+    }
+}
+
+void IoRateLimiter::request(uint64_t bytes)
+{
+    uint64_t wait_us = 0;
+    {
+        std::lock_guard<std::mutex> lock(bucketLock);
+        uint64_t now = _now_us();
+        if (latencyTarget) {
+            adjustRate_UNLOCKED(now);
+        }
+
+        uint64_t rate = curRate.load(std::memory_order_relaxed);
+        if (now > lastRefill) {
+            // Allow bursts of up to one second's worth of I/O.
+            uint64_t elapsed = now - lastRefill;
+            if (elapsed > 1000000) {
+                elapsed = 1000000;
+            }
+            tokens += static_cast<int64_t>(elapsed * rate / 1000000);
+            if (tokens > static_cast<int64_t>(rate)) {
+                tokens = rate;
+            }
+            lastRefill = now;
+        }
+
+        // Take the tokens first (possibly going negative), so that
+        // concurrent callers queue up behind each other instead of
+        // all waking up at the same time.
+        tokens -= static_cast<int64_t>(bytes);
+        if (tokens < 0) {
+            wait_us = static_cast<uint64_t>(-tokens) * 1000000 / rate;
+        }
+    }
+
+    if (wait_us) {
+        usleep(wait_us);
+    }
+}
+
+void IoRateLimiter::addLatencySample(uint64_t latency_us)
+{
+    size_t idx = 0;
+    while (latency_us > 1 && idx < RATE_LIMITER_LAT_BUCKETS - 1) {
+        latency_us >>= 1;
+        ++idx;
+    }
+    latHist[idx].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t IoRateLimiter::sampleStart()
+{
+    IoRateLimiter *tmp = getInstance();
+    if (!tmp || !tmp->latencyTarget) {
+        return 0;
+    }
+    return gethrtime();
+}
+
+void IoRateLimiter::sampleEnd(fdb_latency_stat_type type, uint64_t begin)
+{
+    if (!begin ||
+        (type != FDB_LATENCY_GETS && type != FDB_LATENCY_ITR_GET)) {
+        return;
+    }
+    IoRateLimiter *tmp = getInstance();
+    if (tmp) {
+        tmp->addLatencySample((gethrtime() - begin) / 1000);
+    }
+}
+
+uint64_t IoRateLimiter::getP99AndReset()
+{
+    uint64_t counts[RATE_LIMITER_LAT_BUCKETS];
+    uint64_t total = 0;
+    for (size_t i = 0; i < RATE_LIMITER_LAT_BUCKETS; ++i) {
+        counts[i] = latHist[i].exchange(0, std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total < RATE_LIMITER_MIN_SAMPLES) {
+        return 0;
+    }
+
+    // Number of samples above p99, rounded down.
+    uint64_t tail = total / 100;
+    uint64_t sum = 0;
+    for (size_t i = RATE_LIMITER_LAT_BUCKETS; i > 0; --i) {
+        sum += counts[i - 1];
+        if (sum > tail) {
+            // Middle of the bucket [2^(i-1), 2^i).
+            return ((uint64_t)3 << (i - 1)) >> 1;
+        }
+    }
+    return 1;
+}
+
+void IoRateLimiter::adjustRate_UNLOCKED(uint64_t now_us)
+{
+    if (now_us < windowStart + RATE_LIMITER_WINDOW_US) {
+        return;
+    }
+    windowStart = now_us;
+
+    uint64_t p99 = getP99AndReset();
+    if (!p99) {
+        // Not enough foreground traffic to tell; keep the current rate.
+        return;
+    }
+
+    uint64_t rate = curRate.load(std::memory_order_relaxed);
+    uint64_t min_rate = maxRate / RATE_LIMITER_MIN_RATE_DIV;
+    if (!min_rate) {
+        min_rate = 1;
+    }
+    if (p99 > latencyTarget) {
+        rate /= 2;
+        if (rate < min_rate) {
+            rate = min_rate;
+        }
+    } else if (rate < maxRate) {
+        rate += maxRate / RATE_LIMITER_RECOVERY_DIV;
+        if (rate > maxRate) {
+            rate = maxRate;
+        }
+    }
+    curRate.store(rate, std::memory_order_relaxed);
+}
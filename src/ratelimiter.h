@@ -0,0 +1,158 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "libforestdb/fdb_types.h"
+#include "common.h"
+
+/**
+ * Number of buckets of the foreground latency histogram. Bucket i counts
+ * samples in [2^i, 2^(i+1)) microseconds, and the last bucket also counts
+ * everything above.
+ */
+#define RATE_LIMITER_LAT_BUCKETS (32)
+/**
+ * Length of the window (in microseconds) over which the foreground p99
+ * latency is estimated before the rate is adjusted.
+ */
+#define RATE_LIMITER_WINDOW_US (1000000)
+/**
+ * Minimum number of foreground samples in a window to adjust the rate.
+ */
+#define RATE_LIMITER_MIN_SAMPLES (100)
+/**
+ * The rate is never decreased below 1/RATE_LIMITER_MIN_RATE_DIV of the
+ * configured rate, so that background I/O always makes progress.
+ */
+#define RATE_LIMITER_MIN_RATE_DIV (16)
+/**
+ * Fraction (1/N) of the configured rate that is added back to the current
+ * rate per window while the foreground latency is within the target.
+ */
+#define RATE_LIMITER_RECOVERY_DIV (8)
+
+struct ratelimiter_config {
+    // Maximum background I/O rate in bytes/sec (0: unlimited).
+    uint64_t bytes_per_sec;
+    // Target p99 latency of foreground reads in microseconds (0: no backoff).
+    uint64_t latency_target_us;
+};
+
+/**
+ * Token-bucket rate limiter shared by all compactions. Tokens are bytes
+ * that are refilled at the current rate, and can be accumulated up to one
+ * second's worth of I/O.
+ *
+ * If a latency target is given, the p99 latency of foreground reads is
+ * estimated for each window, and the current rate is halved whenever the
+ * target is exceeded, then increased linearly back to the configured rate.
+ *
+ * Singleton instance, which exists only if the rate limit is set.
+ */
+class IoRateLimiter {
+public:
+    static IoRateLimiter *init(const struct ratelimiter_config &config);
+    static IoRateLimiter *getInstance();
+    static void destroyInstance();
+
+    /**
+     * Wait until the given number of bytes can be written. This should not be
+     * called while holding any lock that foreground operations may wait for.
+     *
+     * @param bytes Number of bytes to be written.
+     */
+    void request(uint64_t bytes);
+
+    /**
+     * Add a latency sample of a foreground operation.
+     *
+     * @param latency_us Latency in microseconds.
+     */
+    void addLatencySample(uint64_t latency_us);
+
+    /**
+     * Start timing a foreground operation in builds without latency stats.
+     *
+     * @return Current time, or 0 if the background write rate doesn't
+     *         depend on the foreground latency, so that nothing is timed.
+     */
+    static uint64_t sampleStart();
+
+    /**
+     * Add the latency of a foreground operation started by sampleStart(),
+     * if the operation is a read.
+     *
+     * @param type Latency stat type of the operation.
+     * @param begin Return value of sampleStart().
+     */
+    static void sampleEnd(fdb_latency_stat_type type, uint64_t begin);
+
+    uint64_t getMaxRate() const {
+        return maxRate;
+    }
+
+    uint64_t getCurrentRate() const {
+        return curRate.load(std::memory_order_relaxed);
+    }
+
+private:
+    IoRateLimiter(const struct ratelimiter_config &config);
+
+    ~IoRateLimiter() { }
+
+    DISALLOW_COPY_AND_ASSIGN(IoRateLimiter);
+
+    /**
+     * Estimate the p99 latency of the current window in microseconds, and
+     * reset the histogram. Returns 0 if there are not enough samples.
+     */
+    uint64_t getP99AndReset();
+
+    /**
+     * Adjust the current rate if the window has expired. Should be called
+     * while holding 'bucketLock'.
+     */
+    void adjustRate_UNLOCKED(uint64_t now_us);
+
+    static std::atomic<IoRateLimiter *> instance;
+    static std::mutex instanceMutex;
+
+    // Configured rate in bytes/sec
+    const uint64_t maxRate;
+    // Target p99 latency of foreground reads in microseconds
+    const uint64_t latencyTarget;
+    // Current (possibly backed-off) rate in bytes/sec
+    std::atomic<uint64_t> curRate;
+
+    // Lock for the token bucket
+    std::mutex bucketLock;
+    // Available tokens in bytes; negative if the last request borrowed ahead
+    int64_t tokens;
+    // Time of the last refill in microseconds
+    uint64_t lastRefill;
+    // Start time of the current latency window in microseconds
+    uint64_t windowStart;
+
+    // Foreground latency histogram of the current window
+    std::atomic<uint64_t> latHist[RATE_LIMITER_LAT_BUCKETS];
+};
@@ -27,6 +27,8 @@
 #include "fdb_internal.h"
 #include "version.h"
 #include "time_utils.h"
+#include "executorpool.h"
+#include "globaltask.h"
 
 #ifdef _DOC_COMP
 #include "snappy-c.h"
@@ -34,17 +36,42 @@
 
 #include "memleak.h"
 
-static bool compress_inmem_stale_info = true;
+/**
+ * Task decoding the in-memory stale info of a file in the background,
+ * scheduled whenever new stale info is queued.
+ */
+class StaleDecodeTask : public GlobalTask {
+public:
+    StaleDecodeTask(StaleDataManager *_staleData)
+        : GlobalTask(*_staleData->file->getTaskable(),
+                     Priority::StaleDecoderPriority),
+          staleData(_staleData) { }
+
+    bool run() {
+        staleData->decodeQueuedEntries();
+        return false;
+    }
+
+    std::string getDescription() {
+        return std::string("Decoding stale block info of file ") +
+               staleData->file->getFileName();
+    }
+
+private:
+    StaleDataManager *staleData;
+};
 
 void StaleDataManager::addInmemStaleInfo(filemgr_header_revnum_t revnum,
                                      struct docio_object *doc,
                                      uint64_t doc_offset,
                                      bool system_doc_only)
 {
-    int ret;
     size_t buflen = 0;
     StaleInfoCommit *item;
     StaleInfoEntry *entry;
+    bool schedule = false;
+
+    UniqueLock lh(infoLock);
 
     // search using revnum first
     auto cur = staleInfoTree.find(revnum);
@@ -63,30 +90,24 @@ void StaleDataManager::addInmemStaleInfo(filemgr_header_revnum_t revnum,
 
     if (!system_doc_only) {
 #ifdef _DOC_COMP
-        if (compress_inmem_stale_info) {
-            buflen = snappy_max_compressed_length(doc->length.bodylen);;
-            entry->ctx = (void *)calloc(1, buflen);
-            ret = snappy_compress((char*)doc->body, doc->length.bodylen,
-                (char*)entry->ctx, &buflen);
-            if (ret != 0) {
-                fdb_log(NULL, FDB_RESULT_COMPRESSION_FAIL,
-                    "(fdb_add_inmem_stale_info) "
-                    "Compression error from a database file '%s'"
-                    ": return value %d, header revnum %" _F64 ", "
-                    "doc offset %" _F64 "\n",
-                    file->getFileName(), ret, revnum, doc_offset);
-                if (cur == staleInfoTree.end()) {
-                    // 'item' is allocated in this function call.
-                    staleInfoTree.erase(item->revnum);
-                    delete item;
-                }
-                delete entry;
-                return;
+        buflen = snappy_max_compressed_length(doc->length.bodylen);;
+        entry->ctx = (void *)calloc(1, buflen);
+        int ret = snappy_compress((char*)doc->body, doc->length.bodylen,
+            (char*)entry->ctx, &buflen);
+        if (ret != 0) {
+            fdb_log(NULL, FDB_RESULT_COMPRESSION_FAIL,
+                "(fdb_add_inmem_stale_info) "
+                "Compression error from a database file '%s'"
+                ": return value %d, header revnum %" _F64 ", "
+                "doc offset %" _F64 "\n",
+                file->getFileName(), ret, revnum, doc_offset);
+            if (cur == staleInfoTree.end()) {
+                // 'item' is allocated in this function call.
+                staleInfoTree.erase(item->revnum);
+                delete item;
             }
-        } else {
-            buflen = doc->length.bodylen;
-            entry->ctx = (void *)calloc(1, buflen);
-            memcpy(entry->ctx, doc->body, doc->length.bodylen);
+            delete entry;
+            return;
         }
 #else
         buflen = doc->length.bodylen;
@@ -107,6 +128,148 @@ void StaleDataManager::addInmemStaleInfo(filemgr_header_revnum_t revnum,
     entry->doclen = _fdb_get_docsize(doc->length);
     entry->offset = doc_offset;
     item->infoList.push_back(entry);
+
+    if (entry->ctx && file->getConfig()->getBackgroundStaleMerge()) {
+        entry->decoding = true;
+        decodeQueue.push_back(entry);
+        if (!decodeScheduled) {
+            decodeScheduled = true;
+            schedule = true;
+        }
+    }
+    lh.unlock();
+
+    if (schedule) {
+        // only one thread schedules the task at a time, as
+        // 'decodeScheduled' is not cleared until the task runs.
+        if (!decoderRegistered) {
+            ExecutorPool::get()->registerTaskable(*file->getTaskable());
+            decoderRegistered = true;
+        }
+        ExTask task = new StaleDecodeTask(this);
+        ExecutorPool::get()->schedule(task, NONIO_TASK_IDX);
+    }
+}
+
+int StaleDataManager::mergeStaleInfoEntry(StaleInfoEntry *entry,
+                                          std::map<uint64_t, stale_data*> *tree,
+                                          void *&uncomp_buf,
+                                          size_t &uncomp_buflen,
+                                          bool doc_region)
+{
+    uint32_t i;
+    uint64_t prev_offset, prev_hdr;
+
+    if (entry->decoded) {
+        // already sorted and merged by the decoder
+        for (auto &region : entry->regions) {
+            insertNmerge(tree, region.pos, region.len);
+        }
+    } else if (entry->ctx) {
+        void *ctx = entry->ctx;
+#ifdef _DOC_COMP
+        // uncompression
+        if (uncomp_buflen < entry->ctxlen) {
+            uncomp_buflen = entry->ctxlen;
+            uncomp_buf = (void*)realloc(uncomp_buf, uncomp_buflen);
+        }
+        size_t len = uncomp_buflen;
+        int r = snappy_uncompress((char*)entry->ctx, entry->comp_ctxlen,
+                                  (char*)uncomp_buf, &len);
+        if (r != 0) {
+            return r;
+        }
+        ctx = uncomp_buf;
+#endif
+        // fetch the context
+        fetchStaleInfoDoc(ctx, tree, prev_offset, prev_hdr);
+    }
+
+    if (!doc_region) {
+        return 0;
+    }
+
+    // also insert/merge the system doc region
+    struct stale_regions sr;
+    sr = getActualStaleRegionsofDoc(entry->offset, entry->doclen);
+
+    if (sr.n_regions > 1) {
+        for (i=0; i<sr.n_regions; ++i){
+            insertNmerge(tree, sr.regions[i].pos, sr.regions[i].len);
+        }
+        free(sr.regions);
+    } else {
+        insertNmerge(tree, sr.region.pos, sr.region.len);
+    }
+    return 0;
+}
+
+void StaleDataManager::decodeQueuedEntries()
+{
+    void *uncomp_buf = NULL;
+    size_t uncomp_buflen = 0;
+    std::map<uint64_t, stale_data*> tree;
+    std::vector<StaleInfoEntry *> entries;
+    std::vector<bool> succeeded;
+
+    UniqueLock lh(infoLock);
+    while (!decodeQueue.empty()) {
+        entries.swap(decodeQueue);
+        lh.unlock();
+
+        // The queued entries are not freed by others until they are
+        // published below, so that they are decoded without the lock.
+        // Note that the region of the system doc itself is not decoded
+        // here, as it may require reading the doc blocks from the file.
+        for (auto entry : entries) {
+            if (mergeStaleInfoEntry(entry, &tree, uncomp_buf, uncomp_buflen,
+                                    false) == 0) {
+                entry->regions.reserve(tree.size());
+                for (auto &item : tree) {
+                    entry->regions.push_back(*item.second);
+                }
+                succeeded.push_back(true);
+            } else {
+                // leave it to the block reclaim, which will report the error.
+                succeeded.push_back(false);
+            }
+            for (auto &item : tree) {
+                free(item.second);
+            }
+            tree.clear();
+        }
+
+        lh.lock();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            StaleInfoEntry *entry = entries[i];
+            entry->decoding = false;
+            if (entry->removed) {
+                // consumed in the meantime
+                free(entry->ctx);
+                delete entry;
+            } else if (succeeded[i]) {
+                free(entry->ctx);
+                entry->ctx = NULL;
+                entry->decoded = true;
+            }
+        }
+        entries.clear();
+        succeeded.clear();
+    }
+    decodeScheduled = false;
+    lh.unlock();
+
+    free(uncomp_buf);
+}
+
+void StaleDataManager::freeStaleInfoEntry(StaleInfoEntry *entry)
+{
+    if (entry->decoding) {
+        entry->removed = true;
+        return;
+    }
+    free(entry->ctx);
+    delete entry;
 }
 
 void StaleDataManager::loadInmemStaleInfo(FdbKvsHandle *handle)
@@ -631,20 +794,17 @@ reusable_block_list StaleDataManager::getReusableBlocks(FdbKvsHandle *handle,
         last_stalelist = std::prev(staleList.end());
     }
 
+    UniqueLock lh(infoLock);
     if (!staleInfoTree.empty()) {
         // if in-memory stale info exists
         void *uncomp_buf = NULL;
         int r;
-        size_t uncomp_buflen = 128*1024; // 128 KB by default;
+        size_t uncomp_buflen = 0;
         StaleInfoCommit *commit;
         StaleInfoEntry *entry;
 
         stale_tree_scan = false;
 
-        if (compress_inmem_stale_info) {
-            uncomp_buf = (void*)calloc(1, uncomp_buflen);
-        }
-
         cur_commit = staleInfoTree.begin();
         while (cur_commit != staleInfoTree.end()) {
             commit = cur_commit->second;
@@ -672,68 +832,37 @@ reusable_block_list StaleDataManager::getReusableBlocks(FdbKvsHandle *handle,
                 entry = *cur_entry;
                 cur_entry = commit->infoList.erase(cur_entry);
 
-                if (entry->ctx) {
-#ifdef _DOC_COMP
-                    if (compress_inmem_stale_info) {
-                        // uncompression
-                        if (uncomp_buflen < entry->ctxlen) {
-                            uncomp_buflen = entry->ctxlen;
-                            uncomp_buf = (void*)realloc(uncomp_buf, uncomp_buflen);
-                        }
-                        size_t len = uncomp_buflen;
-                        r = snappy_uncompress((char*)entry->ctx, entry->comp_ctxlen,
-                                              (char*)uncomp_buf, &len);
-                        if (r != 0) {
-                            fdb_log(NULL, FDB_RESULT_COMPRESSION_FAIL,
-                                "(fdb_get_reusable_block) "
-                                "Uncompression error from a database file '%s'"
-                                ": return value %d, header revnum %" _F64 ", "
-                                "doc offset %" _F64 "\n",
-                                handle->file->getFileName(), r, revnum,
-                                entry->offset);
-                            free(uncomp_buf);
-                            free(revnum_array);
-
-                            reusable_block_list ret;
-                            ret.n_blocks = 0;
-                            ret.blocks = NULL;
-
-                            return ret;
-                        }
-
-                        // fetch the context
-                        fetchStaleInfoDoc(uncomp_buf, mergetree,
-                                              prev_offset, prev_hdr);
-                    } else {
-                        fetchStaleInfoDoc(entry->ctx, mergetree,
-                                              prev_offset, prev_hdr);
-                    }
-#else
-                    fetchStaleInfoDoc(entry->ctx, mergetree, prev_offset, prev_hdr);
-#endif
-                }
-
-                // also insert/merge the system doc region
-                struct stale_regions sr;
-                sr = getActualStaleRegionsofDoc(entry->offset, entry->doclen);
-
-                if (sr.n_regions > 1) {
-                    for (i=0; i<sr.n_regions; ++i){
-                        insertNmerge(mergetree, sr.regions[i].pos, sr.regions[i].len);
-                    }
-                    free(sr.regions);
-                } else {
-                    insertNmerge(mergetree, sr.region.pos, sr.region.len);
+                // regions already decoded by the background task are
+                // sorted and merged, so that they are simply merged here.
+                r = mergeStaleInfoEntry(entry, mergetree,
+                                        uncomp_buf, uncomp_buflen, true);
+                if (r != 0) {
+                    fdb_log(NULL, FDB_RESULT_COMPRESSION_FAIL,
+                        "(fdb_get_reusable_block) "
+                        "Uncompression error from a database file '%s'"
+                        ": return value %d, header revnum %" _F64 ", "
+                        "doc offset %" _F64 "\n",
+                        handle->file->getFileName(), r, revnum,
+                        entry->offset);
+                    freeStaleInfoEntry(entry);
+                    free(uncomp_buf);
+                    free(revnum_array);
+
+                    reusable_block_list ret;
+                    ret.n_blocks = 0;
+                    ret.blocks = NULL;
+
+                    return ret;
                 }
 
-                free(entry->ctx);
-                delete entry;
+                freeStaleInfoEntry(entry);
             }
 
             delete commit;
         }
         free(uncomp_buf);
     }
+    lh.unlock();
 
     if (stale_tree_scan) {
         // scan stale-block tree and get all stale regions
@@ -983,6 +1112,94 @@ reusable_block_list StaleDataManager::getReusableBlocks(FdbKvsHandle *handle,
     return ret;
 }
 
+// Add stale bytes of the given block into 'cur', and move 'cur' into 'list'
+// if it is partially stale and the block ID changes.
+static void _add_stale_bytes(std::vector<struct fragmented_block> &list,
+                             struct fragmented_block &cur,
+                             bid_t bid, uint32_t len,
+                             size_t blocksize, uint8_t min_stale_ratio)
+{
+    if (cur.bid != bid) {
+        if (cur.bid != BLK_NOT_FOUND && cur.stale_len < blocksize &&
+            (uint64_t)cur.stale_len * 100 >=
+                (uint64_t)min_stale_ratio * blocksize) {
+            list.push_back(cur);
+        }
+        cur.bid = bid;
+        cur.stale_len = 0;
+    }
+    cur.stale_len += len;
+}
+
+std::vector<struct fragmented_block> StaleDataManager::getFragmentedBlocks(
+                                                    uint8_t min_stale_ratio)
+{
+    size_t blocksize = file->getBlockSize();
+    std::map<uint64_t, stale_data*> tree;
+    std::vector<struct fragmented_block> ret;
+    struct stale_data *item;
+
+    // remaining regions of the previous block reclaim
+    for (auto &entry : mergeTree) {
+        insertNmerge(&tree, entry.second->pos, entry.second->len);
+    }
+
+    // regions of the commits that are not reclaimed yet
+    void *uncomp_buf = NULL;
+    size_t uncomp_buflen = 0;
+    infoLock.lock();
+    for (auto &cur_commit : staleInfoTree) {
+        for (auto entry : cur_commit.second->infoList) {
+            // if uncompression fails, skip this entry;
+            // its blocks are simply not reported
+            mergeStaleInfoEntry(entry, &tree, uncomp_buf, uncomp_buflen, true);
+        }
+    }
+    infoLock.unlock();
+    free(uncomp_buf);
+
+    // regions that are not gathered into a system doc yet
+    for (auto entry : staleList) {
+        insertNmerge(&tree, entry->pos, entry->len);
+    }
+
+    // Since merged regions never overlap nor adjoin each other, only the
+    // first and the last block of each region can be partially stale, and
+    // the stale bytes of a block are accumulated from consecutive regions.
+    struct fragmented_block cur;
+    cur.bid = BLK_NOT_FOUND;
+    cur.stale_len = 0;
+
+    auto cur_tree = tree.begin();
+    while (cur_tree != tree.end()) {
+        item = cur_tree->second;
+        cur_tree = tree.erase(cur_tree);
+
+        uint64_t begin = item->pos;
+        uint64_t end = item->pos + item->len;
+        bid_t first_bid = begin / blocksize;
+        bid_t last_bid = (end - 1) / blocksize;
+        free(item);
+
+        if (first_bid == last_bid) {
+            _add_stale_bytes(ret, cur, first_bid, end - begin,
+                             blocksize, min_stale_ratio);
+            continue;
+        }
+        _add_stale_bytes(ret, cur, first_bid,
+                         (first_bid + 1) * blocksize - begin,
+                         blocksize, min_stale_ratio);
+        if (end % blocksize) {
+            // whole blocks in between are already reusable
+            _add_stale_bytes(ret, cur, last_bid, end - last_bid * blocksize,
+                             blocksize, min_stale_ratio);
+        }
+    }
+    _add_stale_bytes(ret, cur, BLK_NOT_FOUND, 0, blocksize, min_stale_ratio);
+
+    return ret;
+}
+
 void StaleDataManager::rollbackStaleBlocks(FdbKvsHandle *handle,
                                filemgr_header_revnum_t cur_revnum)
 {
@@ -1012,6 +1229,7 @@ void StaleDataManager::rollbackStaleBlocks(FdbKvsHandle *handle,
     }
 
     // also remove from in-memory stale-tree
+    LockHolder lh(infoLock);
     auto cur_commit = staleInfoTree.find(handle->rollback_revnum);
     if (cur_commit == staleInfoTree.end()) {
         cur_commit = staleInfoTree.upper_bound(handle->rollback_revnum);
@@ -1026,8 +1244,7 @@ void StaleDataManager::rollbackStaleBlocks(FdbKvsHandle *handle,
             entry = *cur_entry;
             cur_entry = commit->infoList.erase(cur_entry);
 
-            free(entry->ctx);
-            delete entry;
+            freeStaleInfoEntry(entry);
         }
 
         delete commit;
@@ -1038,10 +1255,16 @@ StaleDataManager::StaleDataManager(FileMgr *_file)
 {
     file = _file;
     staleInfoTreeLoaded = false;
+    decodeScheduled = false;
+    decoderRegistered = false;
 }
 
 StaleDataManager::~StaleDataManager()
 {
+    if (decoderRegistered) {
+        // wait for the background task to finish, if it is running
+        ExecutorPool::get()->unregisterTaskable(*file->getTaskable(), false);
+    }
     clearStaleList();
     clearStaleInfoTree();
     clearMergeTree();
@@ -1191,6 +1414,7 @@ void StaleDataManager::clearStaleInfoTree()
     StaleInfoCommit *commit;
     StaleInfoEntry *entry;
 
+    LockHolder lh(infoLock);
     auto cur_commit = staleInfoTree.begin();
     while (cur_commit != staleInfoTree.end()) {
         commit = cur_commit->second;
@@ -1200,8 +1424,7 @@ void StaleDataManager::clearStaleInfoTree()
         while (cur_entry != commit->infoList.end()) {
             entry = *cur_entry;
             cur_entry = commit->infoList.erase(cur_entry);
-            free(entry->ctx);
-            delete entry;
+            freeStaleInfoEntry(entry);
         }
         delete commit;
     }
@@ -24,9 +24,11 @@
 
 #include <list>
 #include <map>
+#include <vector>
 
 #include "filemgr.h"
 #include "avltree.h"
+#include "sync_object.h"
 
 struct reusable_block {
     bid_t bid;
@@ -43,14 +45,21 @@ typedef struct {
     bid_t bid;
 } stale_header_info;
 
+struct fragmented_block {
+    bid_t bid;
+    // number of stale bytes in the block
+    uint32_t stale_len;
+};
+
 
 // in-memory structure for stale info
 // (corresponding to a system doc)
 class StaleInfoEntry {
 public:
-    StaleInfoEntry() : ctx(nullptr), offset(0), doclen(0), ctxlen(0), comp_ctxlen(0) { }
+    StaleInfoEntry() : ctx(nullptr), offset(0), doclen(0), ctxlen(0), comp_ctxlen(0),
+                       decoded(false), decoding(false), removed(false) { }
 
-    // document body
+    // document body (NULL if decoded)
     void *ctx;
     // document offset
     uint64_t offset;
@@ -60,6 +69,16 @@ public:
     uint32_t ctxlen;
     // length of compressed 'ctx'
     uint32_t comp_ctxlen;
+    // true if 'ctx' is already decoded into 'regions' by the background task
+    bool decoded;
+    // true while the entry is queued for, or being decoded by, the background
+    // task; its 'ctx' is not freed by others in the meantime
+    bool decoding;
+    // true if the entry was consumed while 'decoding' was set, so that the
+    // background task frees it instead
+    bool removed;
+    // stale regions in the body, sorted and merged
+    std::vector<struct stale_data> regions;
 };
 
 // in-memory structure for stale info
@@ -109,6 +128,10 @@ public:
     }
     virtual void rollbackStaleBlocks(FdbKvsHandle *handle,
                                    filemgr_header_revnum_t cur_revnum) { }
+    virtual std::vector<struct fragmented_block> getFragmentedBlocks(
+                                                    uint8_t min_stale_ratio) {
+        return std::vector<struct fragmented_block>();
+    }
 
 protected:
     // corresponding filemgr instance
@@ -220,6 +243,18 @@ public:
     void rollbackStaleBlocks(FdbKvsHandle *handle,
                                    filemgr_header_revnum_t cur_revnum);
 
+    /**
+     * Return the list of blocks that are partially stale, i.e., blocks that
+     * still contain live data so that they cannot be reused as they are.
+     * All stale regions that are not reclaimed yet are merged (without
+     * consuming them), so this should be called while holding the file lock.
+     *
+     * @param min_stale_ratio Minimum percentage of stale bytes in a block.
+     * @return List of partially stale blocks, sorted by block ID.
+     */
+    std::vector<struct fragmented_block> getFragmentedBlocks(
+                                                    uint8_t min_stale_ratio);
+
 private:
     /**
      * Get the actual length of the given doc, including the meta data of blocks,
@@ -297,9 +332,58 @@ private:
                        std::list<stale_data*>::iterator e_last,
                        bool from_mergetree);
 
+    /**
+     * Insert and merge all stale regions of the given in-memory stale info
+     * into the given tree.
+     *
+     * @param entry Pointer to the in-memory stale info.
+     * @param tree Pointer to the tree.
+     * @param uncomp_buf Reference to the buffer for uncompression, which is
+     *        reallocated if needed.
+     * @param uncomp_buflen Reference to the size of 'uncomp_buf'.
+     * @param doc_region If true, also insert the region of the system doc
+     *        itself, which may read the doc blocks from the file.
+     * @return Zero on success, or the return value of uncompression on error.
+     */
+    int mergeStaleInfoEntry(StaleInfoEntry *entry,
+                            std::map<uint64_t, stale_data*> *tree,
+                            void *&uncomp_buf,
+                            size_t &uncomp_buflen,
+                            bool doc_region);
+
+    /**
+     * Decode the queued in-memory stale info into sorted and merged regions,
+     * so that block reclaim does not need to uncompress and parse them.
+     * Called by the background task, until the queue becomes empty.
+     *
+     * @return void.
+     */
+    void decodeQueuedEntries();
+
+    /**
+     * Free the given in-memory stale info that was removed from
+     * 'staleInfoTree', or hand it over to the background task if it is
+     * being decoded. 'infoLock' should be held.
+     *
+     * @param entry Pointer to the in-memory stale info.
+     * @return void.
+     */
+    void freeStaleInfoEntry(StaleInfoEntry *entry);
+
+    friend class StaleDecodeTask;
+
     void clearStaleList();
     void clearStaleInfoTree();
     void clearMergeTree();
+
+    // lock for 'staleInfoTree' and the decoder state below
+    SyncObject infoLock;
+    // entries to be decoded by the background task
+    std::vector<StaleInfoEntry *> decodeQueue;
+    // true if the background task is scheduled and not finished yet
+    bool decodeScheduled;
+    // true if the file's taskable is registered to the executor pool
+    bool decoderRegistered;
 };
 
 #endif /* _FDB_STALEBLOCK_H */
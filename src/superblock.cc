@@ -90,23 +90,18 @@ static uint8_t bmp_2d_mask[8][9];
 // rounding down (to the nearest 8)
 #define rd8(x) (((x) >> 3) << 3)
 
-struct bmp_idx_node {
-    uint64_t id;
-    struct avl_node avl;
-};
-
-INLINE int _bmp_idx_cmp(struct avl_node *a, struct avl_node *b, void *aux)
+INLINE int _bmp_extent_cmp(struct avl_node *a, struct avl_node *b, void *aux)
 {
-    struct bmp_idx_node *aa, *bb;
-    aa = _get_entry(a, struct bmp_idx_node, avl);
-    bb = _get_entry(b, struct bmp_idx_node, avl);
+    struct bmp_extent *aa, *bb;
+    aa = _get_entry(a, struct bmp_extent, avl);
+    bb = _get_entry(b, struct bmp_extent, avl);
 
 #ifdef __BIT_CMP
-    return _CMP_U64(aa->id, bb->id);
+    return _CMP_U64(aa->bid, bb->bid);
 #else
-    if (aa->id < bb->id) {
+    if (aa->bid < bb->bid) {
         return -1;
-    } else if (aa->id > bb->id) {
+    } else if (aa->bid > bb->bid) {
         return 1;
     } else {
         return 0;
@@ -317,7 +312,7 @@ fdb_status Superblock::readGivenNum(size_t sb_no,
     int blocksize = file->getBlockSize() - BLK_MARKER_SIZE;
     size_t i, num_docs;
     uint8_t *buf = alca(uint8_t, real_blocksize);
-    uint32_t crc_file, crc, _crc;
+    uint32_t crc_file, _crc;
     uint64_t enc_u64, version, offset, dummy64;
     fdb_status fs;
     struct sb_rsv_bmp *rsv = NULL;
@@ -466,10 +461,12 @@ fdb_status Superblock::readGivenNum(size_t sb_no,
     }
 
     // CRC
-    crc = get_checksum(buf, offset, file->getCrcMode());
+    // (superblocks are read before the DB header that determines the CRC
+    //  mode of the file, so that both modes are checked here.)
+    crc_mode_e crc_mode;
     memcpy(&_crc, buf + offset, sizeof(_crc));
     crc_file = _endian_decode(_crc);
-    if (crc != crc_file) {
+    if (!detect_and_check_crc(buf, offset, crc_file, &crc_mode)) {
         free(bmpDocOffset);
         free(bmpDocs);
         bmpDocOffset = NULL;
@@ -607,10 +604,9 @@ bool Superblock::switchReservedBlocks()
 
 bid_t Superblock::allocBlock()
 {
-    uint64_t i, node_idx, node_off, bmp_idx_no, bmp_off;
     bid_t ret = BLK_NOT_FOUND;
     struct avl_node *a;
-    struct bmp_idx_node *item, query;
+    struct bmp_extent *ext;
 
     numAlloc++;
 sb_alloc_start_over:
@@ -646,51 +642,28 @@ sb_alloc_start_over:
         return ret;
     }
 
-    // find allocable block in the same bmp idx node
-    node_idx = ret >> 8;
-    node_off = (ret & 0xff)+1;
-    do {
-        for (i=node_off; i<256; ++i) {
-            bmp_idx_no = div8(i) + (node_idx * 32);
-            bmp_off = mod8(i);
-
-            if ((bmp_idx_no * 8 + bmp_off) >= bmpSize.load()) {
-                break;
-            }
-
-            if (bmp[bmp_idx_no] & bmp_basic_mask[bmp_off]) {
-                curAllocBid.store(bmp_idx_no * 8 + bmp_off);
-                return ret;
-            }
-        }
-
-        // current bmp_node does not include any free block .. remove
-        query.id = node_idx;
-        a = avl_search(&bmpIdx, &query.avl, _bmp_idx_cmp);
-        if (a) {
-            item = _get_entry(a, struct bmp_idx_node, avl);
-            avl_remove(&bmpIdx, a);
-            free(item);
+    // Blocks are handed out in ascending BID order, so the current extent is
+    // always the first one in the index. Drop the extents that are used up,
+    // and move the cursor to the next reusable block.
+    while ((a = avl_first(&bmpIdx))) {
+        ext = _get_entry(a, struct bmp_extent, avl);
+        if (ret + 1 < ext->bid + ext->count) {
+            curAllocBid.store(ret + 1 > ext->bid ? ret + 1 : ext->bid);
+            return ret;
         }
+        avl_remove(&bmpIdx, a);
+        free(ext);
+    }
 
-        // get next allocable bmp_node
-        a = avl_first(&bmpIdx);
-        if (!a) {
-            // no more free bmp_node
-            numFreeBlocks = 0;
-            bool switched = false;
-            if (rsvBmp) {
-                switched = switchReservedBlocks();
-            }
-            if (!switched) {
-                curAllocBid = BLK_NOT_FOUND;
-            }
-            break;
-        }
-        item = _get_entry(a, struct bmp_idx_node, avl);
-        node_idx = item->id;
-        node_off = 0;
-    } while (true);
+    // no more free extent
+    numFreeBlocks = 0;
+    bool switched = false;
+    if (rsvBmp) {
+        switched = switchReservedBlocks();
+    }
+    if (!switched) {
+        curAllocBid = BLK_NOT_FOUND;
+    }
 
     return ret;
 }
@@ -1311,7 +1284,7 @@ bool Superblock::reclaimReusableBlocks(FdbKvsHandle *handle)
             curAllocBid.store(blist.blocks[i].bid);
         }
         numFreeBlocks += blist.blocks[i].count;
-        // add info for supplementary bmp index
+        // add the region into the extent index
         addBmpIdx(&bmpIdx, blist.blocks[i].bid, blist.blocks[i].count);
     }
     free(blist.blocks);
@@ -1386,51 +1359,10 @@ bool Superblock::reserveNextReusableBlocks(FdbKvsHandle *handle)
 
 void Superblock::returnReusableBlocks(FdbKvsHandle *handle)
 {
-    uint64_t node_id;
-    bid_t cur;
     struct sb_rsv_bmp *rsv;
-    struct avl_node *a;
-    struct bmp_idx_node *item, query;
 
     // re-insert all remaining bitmap into stale list
-    uint64_t sb_bmp_size = bmpSize.load();
-    for (cur = curAllocBid.load(); cur < sb_bmp_size; ++cur) {
-        if (isBmpSet(bmp, cur)) {
-            file->addStaleRegion(cur, 1);
-        }
-
-        if ((cur % 256) == 0 && cur > 0) {
-            // node ID changes
-            // remove & free current bmp node
-            node_id = cur / 256;
-            query.id = node_id - 1;
-            a = avl_search(&bmpIdx, &query.avl, _bmp_idx_cmp);
-            if (a) {
-                item = _get_entry(a, struct bmp_idx_node, avl);
-                avl_remove(&bmpIdx, a);
-                free(item);
-            }
-
-            // move to next bmp node
-            do {
-                a = avl_first(&bmpIdx);
-                if (a) {
-                    item = _get_entry(a, struct bmp_idx_node, avl);
-                    if (item->id <= node_id) {
-                        avl_remove(&bmpIdx, a);
-                        free(item);
-                        continue;
-                    }
-                    cur = item->id * 256;
-                    break;
-                }
-
-                // no more reusable block
-                cur = sb_bmp_size;
-                break;
-            } while (true);
-        }
-    }
+    returnBmpIdx(&bmpIdx, curAllocBid.load());
     numFreeBlocks = 0;
     curAllocBid.store(BLK_NOT_FOUND);
 
@@ -1438,48 +1370,10 @@ void Superblock::returnReusableBlocks(FdbKvsHandle *handle)
     rsv = rsvBmp;
     uint32_t cond = SB_RSV_READY;
     if (rsv && rsv->status.compare_exchange_strong(cond, SB_RSV_VOID)) {
-
-        for (cur = rsv->curAllocBid; cur < rsv->bmpSize; ++cur) {
-            if (isBmpSet(rsv->bmp, cur)) {
-                file->addStaleRegion(cur, 1);
-            }
-
-            if ((cur % 256) == 0 && cur > 0) {
-                // node ID changes
-                // remove & free current bmp node
-                node_id = cur / 256;
-                query.id = node_id - 1;
-                a = avl_search(&rsv->bmpIdx, &query.avl, _bmp_idx_cmp);
-                if (a) {
-                    item = _get_entry(a, struct bmp_idx_node, avl);
-                    avl_remove(&rsv->bmpIdx, a);
-                    free(item);
-                }
-
-                // move to next bmp node
-                do {
-                    a = avl_first(&rsv->bmpIdx);
-                    if (a) {
-                        item = _get_entry(a, struct bmp_idx_node, avl);
-                        if (item->id <= node_id) {
-                            avl_remove(&rsv->bmpIdx, a);
-                            free(item);
-                            continue;
-                        }
-                        cur = item->id * 256;
-                        break;
-                    }
-
-                    // no more reusable block
-                    cur = rsv->bmpSize;
-                    break;
-                } while (true);
-            }
-        }
+        returnBmpIdx(&rsv->bmpIdx, rsv->curAllocBid);
         rsv->numFreeBlocks = 0;
         rsv->curAllocBid = BLK_NOT_FOUND;
 
-        freeBmpIdx(&rsv->bmpIdx);
         freeRsv(rsv);
         free(rsv);
         rsvBmp = NULL;
@@ -1566,93 +1460,150 @@ void Superblock::clearBmp(uint8_t *target_bmp, bid_t bid, uint64_t len)
 
 void Superblock::addBmpIdx(struct avl_tree *target_idx, bid_t bid, bid_t count)
 {
-    bid_t cur, start_id, stop_id;
     struct avl_node *a;
-    struct bmp_idx_node *item, query;
+    struct bmp_extent *item, *next, query;
 
-    // 256 blocks per node
-    start_id = bid >> 8;
-    stop_id = (bid+count-1) >> 8;
+    if (!count) {
+        return;
+    }
 
-    for (cur=start_id; cur<=stop_id; ++cur) {
-        query.id = cur;
-        a = avl_search(target_idx, &query.avl, _bmp_idx_cmp);
-        if (a) {
-            // already exists .. do nothing
+    // merge with the preceding extent if they are adjacent
+    query.bid = bid;
+    a = avl_search_smaller(target_idx, &query.avl, _bmp_extent_cmp);
+    item = NULL;
+    if (a) {
+        item = _get_entry(a, struct bmp_extent, avl);
+        if (item->bid + item->count >= bid) {
+            if (bid + count > item->bid + item->count) {
+                item->count = bid + count - item->bid;
+            }
         } else {
-            // create a node
-            item = (struct bmp_idx_node*)calloc(1, sizeof(struct bmp_idx_node));
-            item->id = query.id;
-            avl_insert(target_idx, &item->avl, _bmp_idx_cmp);
+            item = NULL;
+        }
+    }
+    if (!item) {
+        item = (struct bmp_extent *)calloc(1, sizeof(struct bmp_extent));
+        item->bid = bid;
+        item->count = count;
+        avl_insert(target_idx, &item->avl, _bmp_extent_cmp);
+    }
+
+    // absorb the following extents covered by (or adjacent to) the new one
+    a = avl_next(&item->avl);
+    while (a) {
+        next = _get_entry(a, struct bmp_extent, avl);
+        if (next->bid > item->bid + item->count) {
+            break;
+        }
+        if (next->bid + next->count > item->bid + item->count) {
+            item->count = next->bid + next->count - item->bid;
         }
+        a = avl_next(a);
+        avl_remove(target_idx, &next->avl);
+        free(next);
     }
 }
 
 void Superblock::freeBmpIdx(struct avl_tree *target_idx)
 {
-    // free all supplemental bmp idx nodes
+    // free all extents
     struct avl_node *a;
-    struct bmp_idx_node *item;
+    struct bmp_extent *item;
     a = avl_first(target_idx);
     while (a) {
-        item = _get_entry(a, struct bmp_idx_node, avl);
+        item = _get_entry(a, struct bmp_extent, avl);
         a = avl_next(a);
         avl_remove(target_idx, &item->avl);
         free(item);
     }
 }
 
+void Superblock::returnBmpIdx(struct avl_tree *target_idx, bid_t start_bid)
+{
+    struct avl_node *a;
+    struct bmp_extent *item;
+
+    if (start_bid == BLK_NOT_FOUND) {
+        freeBmpIdx(target_idx);
+        return;
+    }
+
+    a = avl_first(target_idx);
+    while (a) {
+        item = _get_entry(a, struct bmp_extent, avl);
+        a = avl_next(a);
+        if (item->bid + item->count > start_bid) {
+            if (item->bid >= start_bid) {
+                file->addStaleRegion(item->bid, item->count);
+            } else {
+                // the front part of the extent is already allocated
+                file->addStaleRegion(start_bid,
+                                     item->bid + item->count - start_bid);
+            }
+        }
+        avl_remove(target_idx, &item->avl);
+        free(item);
+    }
+}
+
 void Superblock::constructBmpIdx(struct avl_tree *target_idx,
                                uint8_t *src_bmp,
                                uint64_t src_bmp_size,
                                bid_t start_bid)
 {
-    uint64_t i, node_idx;
+    uint64_t i, word;
     uint64_t *bmp64 = (uint64_t*)src_bmp;
-    struct bmp_idx_node *item;
+    bid_t run_start = BLK_NOT_FOUND;
+    bool is_set;
+    struct bmp_extent *item;
 
     if (start_bid == BLK_NOT_FOUND) {
         start_bid = 0;
     }
 
-    // Since a single byte includes 8 bitmaps, an 8-byte integer contains 64 bitmaps.
-    // By converting bitmap array to uint64_t array, we can quickly verify if a
-    // 64-bitmap-group has at least one non-zero bit or not.
-    for (i=start_bid/64; i<src_bmp_size/64; ++i) {
-        // in this loop, 'i' denotes bitmap group number.
-        node_idx = i/4;
-        if (bmp64[i]) {
-            item = (struct bmp_idx_node *)calloc(1, sizeof(struct bmp_idx_node));
-            item->id = node_idx;
-            avl_insert(target_idx, &item->avl, _bmp_idx_cmp);
-            // skip other bitmaps in the same bitmap index node
-            // (1 bitmap index node == 4 bitmap groups == 256 bitmaps)
-            i = (node_idx+1)*4;
+    i = start_bid;
+    while (i < src_bmp_size) {
+        // Since a single byte includes 8 bitmaps, an 8-byte integer contains
+        // 64 bitmaps. Groups of all-zero or all-one bitmaps (which are the
+        // common case) are skipped or absorbed into the current run at once,
+        // otherwise check bitmaps one by one.
+        if ((i % 64) == 0 && i + 64 <= src_bmp_size) {
+            word = bmp64[i / 64];
+            if (word == 0 || word == ~(uint64_t)0) {
+                is_set = (word != 0);
+                if (is_set && run_start == BLK_NOT_FOUND) {
+                    run_start = i;
+                } else if (!is_set && run_start != BLK_NOT_FOUND) {
+                    item = (struct bmp_extent *)
+                           calloc(1, sizeof(struct bmp_extent));
+                    item->bid = run_start;
+                    item->count = i - run_start;
+                    avl_insert(target_idx, &item->avl, _bmp_extent_cmp);
+                    run_start = BLK_NOT_FOUND;
+                }
+                i += 64;
+                continue;
+            }
         }
-    }
 
-    // If there are remaining bitmaps, check if they are non-zero or not one by one.
-    if (src_bmp_size % 64) {
-        uint8_t off;
-        uint64_t idx, start;
-
-        start = (src_bmp_size/64)*64;
-        if (start < start_bid) {
-            start = start_bid;
+        is_set = src_bmp[div8(i)] & bmp_basic_mask[mod8(i)];
+        if (is_set && run_start == BLK_NOT_FOUND) {
+            run_start = i;
+        } else if (!is_set && run_start != BLK_NOT_FOUND) {
+            item = (struct bmp_extent *)calloc(1, sizeof(struct bmp_extent));
+            item->bid = run_start;
+            item->count = i - run_start;
+            avl_insert(target_idx, &item->avl, _bmp_extent_cmp);
+            run_start = BLK_NOT_FOUND;
         }
+        ++i;
+    }
 
-        for (i=start; i<src_bmp_size; ++i) {
-            // in this loop, 'i' denotes bitmap number (i.e., BID).
-            idx = div8(i);
-            off = mod8(i);
-            if (src_bmp[idx] & bmp_basic_mask[off]) {
-                node_idx = i >> 8;
-                item = (struct bmp_idx_node *)calloc(1, sizeof(struct bmp_idx_node));
-                item->id = node_idx;
-                avl_insert(target_idx, &item->avl, _bmp_idx_cmp);
-                i = (node_idx+1)*256;
-            }
-        }
+    if (run_start != BLK_NOT_FOUND) {
+        item = (struct bmp_extent *)calloc(1, sizeof(struct bmp_extent));
+        item->bid = run_start;
+        item->count = src_bmp_size - run_start;
+        avl_insert(target_idx, &item->avl, _bmp_extent_cmp);
     }
 }
 
@@ -80,6 +80,15 @@ struct sb_config {
  */
 #define SB_RSV_READY (0xffff)
 
+/**
+ * A run of consecutive reusable blocks in the bitmap, indexed by its first BID.
+ */
+struct bmp_extent {
+    bid_t bid;
+    uint64_t count;
+    struct avl_node avl;
+};
+
 /**
  * Pre-reclaimed reusable block bitmap info.
  * Each attribute is same as that in superblock.
@@ -98,7 +107,8 @@ struct sb_rsv_bmp {
      */
     uint8_t *bmp;
     /**
-     * Bitmap index for fast searching of next reusable block.
+     * Index of the runs (extents) of consecutive reusable blocks in the bitmap,
+     * ordered by their first BID, for fast searching of next reusable block.
      */
     struct avl_tree bmpIdx;
     /**
@@ -398,7 +408,8 @@ protected:
      */
     uint8_t *bmpPrev;
     /**
-     * Bitmap index for fast searching of next reusable block.
+     * Index of the runs (extents) of consecutive reusable blocks in the bitmap,
+     * ordered by their first BID, for fast searching of next reusable block.
      */
     struct avl_tree bmpIdx;
     /**
@@ -625,6 +636,9 @@ private:
 
     static void updateBmp(uint8_t *bmp, bid_t bid, uint64_t len, int mode);
 
+protected:
+    // bitmap and bitmap index operations (also used by superblock_test)
+
     /**
      * Set bitmap bits for the given blocks.
      *
@@ -646,7 +660,8 @@ private:
     static void clearBmp(uint8_t *bmp, bid_t bid, uint64_t len);
 
     /**
-     * Add the given block region into bitmap index.
+     * Add the given block region into bitmap index. The region is merged with
+     * the existing extents that overlap or are adjacent to it.
      *
      * @param target_idx Pointer to bitmap index.
      * @param bid Starting BID.
@@ -664,7 +679,19 @@ private:
     static void freeBmpIdx(struct avl_tree *target_idx);
 
     /**
-     * Construct a bitmap index from the given bitmap array.
+     * Put the reusable blocks in the given bitmap index that are not allocated
+     * yet back into the stale list of the file, one region per extent, and
+     * free the index.
+     *
+     * @param target_idx Pointer to bitmap index.
+     * @param start_bid BID of the next block to be allocated.
+     * @return void.
+     */
+    void returnBmpIdx(struct avl_tree *target_idx, bid_t start_bid);
+
+    /**
+     * Construct a bitmap index from the given bitmap array, by collecting
+     * runs of set bits starting from the given BID.
      *
      * @param target_idx Pointer to bitmap index.
      * @param src_bmp Pointer to bitmap array.
@@ -677,6 +704,7 @@ private:
                                uint64_t src_bmp_size,
                                bid_t start_bid);
 
+private:
     /**
      * Convert the given bitmap array size to the number of system documents for
      * bitmap.
@@ -28,6 +28,7 @@ const Priority Priority::CompactorPriority(COMPACTOR_ID, 2);
 const Priority Priority::BgFlusherPriority(BGFLUSHER_ID, 1);
 
 // Priorities for NON-IO tasks
+const Priority Priority::StaleDecoderPriority(STALE_DECODER_ID, 1);
 
 const char *Priority::getTypeName(const type_id_t i) {
     switch (i) {
@@ -35,6 +36,8 @@ const char *Priority::getTypeName(const type_id_t i) {
             return "compactor_tasks";
         case BGFLUSHER_ID:
             return "bgflusher_tasks";
+        case STALE_DECODER_ID:
+            return "stale_decoder_tasks";
         default: break;
     }
 
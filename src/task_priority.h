@@ -23,6 +23,7 @@
 enum type_id_t {
     COMPACTOR_ID,
     BGFLUSHER_ID,
+    STALE_DECODER_ID,
     MAX_TYPE_ID // Keep this as the last enum value
 };
 
@@ -38,6 +39,7 @@ public:
     static const Priority BgFlusherPriority;
 
     // Priorities for NON-IO tasks
+    static const Priority StaleDecoderPriority;
 
     bool operator==(const Priority &other) const {
         return other.getPriorityValue() == this->priority;
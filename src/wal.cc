@@ -25,6 +25,7 @@
 #include "docio.h"
 #include "wal.h"
 #include "hash_functions.h"
+#include "bloomfilter.h"
 #include "fdb_internal.h"
 #include "iterator.h"
 
@@ -1680,6 +1681,11 @@ inline fdb_status Wal::_wal_do_flush(struct wal_item *item,
 {
     // check weather this item is updated after insertion into tree
     if (item->flag & WAL_ITEM_FLUSH_READY) {
+        KeyFilter *key_filter = file->getKeyFilter();
+        if (key_filter && item->action != WAL_ACT_REMOVE) {
+            // Add the key before it becomes visible in the main index.
+            key_filter->add(item->header->key, item->header->keylen);
+        }
         fdb_status fs = flush_func(dbhandle, item, stale_seqnum_list, kvs_delta_stats);
         if (fs != FDB_RESULT_SUCCESS) {
             FdbKvsHandle *handle = reinterpret_cast<FdbKvsHandle *>(dbhandle);
@@ -1760,6 +1766,31 @@ static int _wal_flush_cmp_v2(struct avl_node *a, struct avl_node *b, void *aux)
 
 }
 
+// Same as _wal_flush_cmp_v2(), but multiple items of the same key (e.g., the
+// WAL items copied from the old file by compact-upto) are kept in offset order.
+static int _wal_flush_cmp_compactor(struct avl_node *a, struct avl_node *b,
+                                    void *aux)
+{
+    int cmp = _wal_flush_cmp_v2(a, b, aux);
+    if (cmp) {
+        return cmp;
+    }
+
+    struct wal_item *aa, *bb;
+    aa = _get_entry(a, struct wal_item, avl_flush);
+    bb = _get_entry(b, struct wal_item, avl_flush);
+    if (aa->offset < bb->offset) {
+        return -1;
+    } else if (aa->offset > bb->offset) {
+        return 1;
+    } else if (aa->seqnum < bb->seqnum) {
+        return -1;
+    } else if (aa->seqnum > bb->seqnum) {
+        return 1;
+    }
+    return 0;
+}
+
 fdb_status Wal::_flush_Wal(void *dbhandle,
                            wal_flush_func *flush_func,
                            wal_get_old_offset_func *get_old_offset,
@@ -1776,13 +1807,16 @@ fdb_status Wal::_flush_Wal(void *dbhandle,
     struct wal_item_header *header;
     struct fdb_root_info root_info;
     size_t i = 0;
+    uint64_t num_flush_items = 0;
     LATENCY_STAT_START();
     bool btreev2 = ver_btreev2_format(file->getVersion());
     bool do_sort = !file->isFullyResident();
 
-    if (btreev2) {
+    if (btreev2 || by_compactor) {
         // With new B+tree, we don't need to get old offset.
         // Sort them by key.
+        // The compactor also sorts them by key, as they are all new insertions
+        // into the new file's index (see below).
         do_sort = true;
     }
 
@@ -1823,16 +1857,14 @@ fdb_status Wal::_flush_Wal(void *dbhandle,
                         // During the first phase of compaction, we don't need
                         // to retrieve the old offsets of WAL items because they
                         // are all new insertions into new file's hbtrie index.
+                        // Insert them in key order rather than in offset order,
+                        // so that the new index is built by appending keys
+                        // into the rightmost nodes, which are then kept full
+                        // and never modified again once they are split.
                         item->old_offset = 0;
-                        if (do_sort) {
-                            if (btreev2) {
-                                avl_insert(tree, &item->avl_flush, _wal_flush_cmp_v2);
-                            } else {
-                                avl_insert(tree, &item->avl_flush, _wal_flush_cmp);
-                            }
-                        } else {
-                            list_push_back(list_head, &item->list_elem_flush);
-                        }
+                        ++num_flush_items;
+                        avl_insert(tree, &item->avl_flush,
+                                   _wal_flush_cmp_compactor);
                     } else {
                         spin_unlock(&key_shards[i].lock);
                         if (btreev2) {
@@ -1856,6 +1888,7 @@ fdb_status Wal::_flush_Wal(void *dbhandle,
                             item->old_offset = BLK_NOT_FOUND;
                             item->flag |= WAL_ITEM_FLUSHED_OUT;
                         }
+                        ++num_flush_items;
                         if (do_sort) {
                             if (btreev2) {
                                 avl_insert(tree, &item->avl_flush, _wal_flush_cmp_v2);
@@ -1876,6 +1909,10 @@ fdb_status Wal::_flush_Wal(void *dbhandle,
     }
 
     file->setIoInprog(); // MB-16622:prevent parallel writes by flusher
+    if (file->getKeyFilter()) {
+        // Make room for this flush batch in the key filter up front.
+        file->getKeyFilter()->reserve(num_flush_items);
+    }
     fdb_status fs = FDB_RESULT_SUCCESS;
     struct avl_tree stale_seqnum_list;
     struct avl_tree kvs_delta_stats;
@@ -31,6 +31,7 @@
 #include "filemgr.h"
 #include "internal_types.h"
 #include "kvs_handle.h"
+#include "docio.h"
 
 void logCallbackFunc(int err_code,
                      const char *err_msg,
@@ -1000,6 +1001,142 @@ void compaction_failure_hangs_rollback_test()
     TEST_RESULT(bodybuf);
 }
 
+ssize_t pwrite_doc_failure_cb(void *ctx, struct filemgr_ops *normal_ops,
+                              fdb_fileops_handle fops_handle, void *buf,
+                              size_t count, cs_off_t offset)
+{
+    fail_ctx_t *wctx = (fail_ctx_t *)ctx;
+    wctx->num_ops++;
+    // fail only the writes of docs, not the block metadata and the
+    // zero-filled length written while reserving them
+    if (wctx->num_ops > wctx->start_failing_after &&
+        count > sizeof(struct docio_length)) {
+        wctx->num_fails++;
+        errno = -2;
+        return (ssize_t)FDB_RESULT_WRITE_FAIL;
+    }
+    return normal_ops->pwrite(fops_handle, buf, count, offset);
+}
+
+void pipelined_append_failure_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int r;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc1, *doc2, *rdoc;
+    fdb_status status;
+    char bodybuf[256];
+
+    // Get the default callbacks which result in normal operation for other ops
+    struct anomalous_callbacks *write_fail_cb = get_default_anon_cbs();
+    fail_ctx_t fail_ctx;
+    memset(&fail_ctx, 0, sizeof(fail_ctx_t));
+    // Modify the pwrite callback to redirect to test-specific function
+    write_fail_cb->pwrite_cb = &pwrite_doc_failure_cb;
+
+    // remove previous anomaly_test files
+    r = system(SHELL_DEL" anomaly_test* > errorlog.txt");
+    (void)r;
+
+    // Reset anomalous behavior stats..
+    filemgr_ops_anomalous_init(write_fail_cb, &fail_ctx);
+    fail_ctx.start_failing_after = 99999;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    // write docs directly into the file
+    fconfig.buffercache_size = 0;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.purging_interval = 0;
+    fconfig.compaction_threshold = 0;
+    fconfig.pipelined_doc_append = true;
+
+    status = fdb_open(&dbfile, "anomaly_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    fdb_doc_create(&doc1, (void*)"key1", 5, NULL, 0, (void*)"body1", 6);
+    fdb_doc_create(&doc2, (void*)"key2", 5, NULL, 0, (void*)"body2", 6);
+    status = fdb_set(db, doc1);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_set(db, doc2);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // the doc is inserted into WAL, but fails to be written
+    fail_ctx.start_failing_after = fail_ctx.num_ops;
+    status = fdb_doc_update(&doc1, NULL, 0, (void*)"body1-new", 10);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_set(db, doc1);
+    TEST_CHK(status == FDB_RESULT_WRITE_FAIL);
+    TEST_CHK(fail_ctx.num_fails > 0);
+    fail_ctx.start_failing_after = 99999;
+
+    // the unwritten doc is not read
+    fdb_doc_create(&rdoc, (void*)"key1", 5, NULL, 0, NULL, 0);
+    status = fdb_get(db, rdoc);
+    TEST_CHK(status == FDB_RESULT_READ_FAIL);
+    fdb_doc_free(rdoc);
+
+    // other docs are not affected
+    fdb_doc_create(&rdoc, (void*)"key2", 5, NULL, 0, NULL, 0);
+    status = fdb_get(db, rdoc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CMP(rdoc->body, "body2", 6);
+    fdb_doc_free(rdoc);
+
+    // but the file rejects commits, so that the unwritten doc is not
+    // persisted
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_WRITE_FAIL);
+    fdb_close(dbfile);
+
+    // reopen .. the previously committed version is kept
+    status = fdb_open(&dbfile, "anomaly_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_doc_create(&rdoc, (void*)"key1", 5, NULL, 0, NULL, 0);
+    status = fdb_get(db, rdoc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CMP(rdoc->body, "body1", 6);
+    fdb_doc_free(rdoc);
+    fdb_doc_create(&rdoc, (void*)"key2", 5, NULL, 0, NULL, 0);
+    status = fdb_get(db, rdoc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CMP(rdoc->body, "body2", 6);
+    fdb_doc_free(rdoc);
+
+    // and the file accepts commits again
+    status = fdb_set(db, doc1);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_doc_create(&rdoc, (void*)"key1", 5, NULL, 0, NULL, 0);
+    status = fdb_get(db, rdoc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CMP(rdoc->body, "body1-new", 10);
+    fdb_doc_free(rdoc);
+    fdb_close(dbfile);
+
+    fdb_doc_free(doc1);
+    fdb_doc_free(doc2);
+    fdb_shutdown();
+
+    memleak_end();
+
+    sprintf(bodybuf, "pipelined append failure test: %d failures out of "
+            "%d writes", fail_ctx.num_fails, fail_ctx.num_ops);
+
+    TEST_RESULT(bodybuf);
+}
+
 int main(){
 
     /**
@@ -1010,6 +1147,7 @@ int main(){
      */
     //copy_file_range_test();
     write_failure_test();
+    pipelined_append_failure_test();
     read_failure_test();
     handle_busy_test();
     read_old_file();
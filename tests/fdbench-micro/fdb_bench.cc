@@ -31,6 +31,7 @@
 #include "test.h"
 
 #include <libforestdb/forestdb.h>
+#include "encryption.h"
 
 bool track_stat(stat_history_t *stat, uint64_t lat) {
 
@@ -393,6 +394,100 @@ void do_bench() {
     TEST_RESULT("Benchmark done");
 }
 
+/*
+ * Compares block encryption paths on batches of 16 blocks:
+ * one call per block (as done before multi-block support), and one call
+ * for the whole batch, for the crypto library and AES-NI respectively.
+ */
+void crypt_bench() {
+
+    TEST_INIT();
+    int i, j, k;
+    size_t blocksize = 4096;
+    unsigned num_blocks = 16;
+#if defined(THREAD_SANITIZER)
+    int n_loops = 10;
+#else
+    int n_loops = 1000;
+#endif // #if defined(THREAD_SANITIZER)
+    const char *names[2] = {"aes_library", "aes_ni"};
+    const encryption_ops *ops[2] = {fdb_encryption_ops_aes,
+                                    get_aesni_encryption_ops()};
+    uint8_t *plain = (uint8_t*)malloc(blocksize * num_blocks);
+    uint8_t *cipher = (uint8_t*)malloc(blocksize * num_blocks);
+    encryptor e;
+    fdb_status status;
+    ts_nsec start;
+
+    for (i = 0; i < (int)(blocksize * num_blocks); ++i) {
+        plain[i] = (uint8_t)i;
+    }
+
+    // encrypt and decrypt, each per block and per batch
+    StatAggregator *sa = new StatAggregator(8, 1);
+    for (i = 0; i < 2; ++i) {
+        sa->t_stats[i * 4][0].name = std::string(names[i]) + "_enc_per_block";
+        sa->t_stats[i * 4 + 1][0].name = std::string(names[i]) + "_enc_batch";
+        sa->t_stats[i * 4 + 2][0].name = std::string(names[i]) + "_dec_per_block";
+        sa->t_stats[i * 4 + 3][0].name = std::string(names[i]) + "_dec_batch";
+        if (!ops[i]) {
+            printf("%s is not available\n", names[i]);
+            continue;
+        }
+
+        memset(&e, 0, sizeof(e));
+        e.ops = ops[i];
+        e.key.algorithm = FDB_ENCRYPTION_AES256;
+        memset(e.key.bytes, 0x42, sizeof(e.key.bytes));
+        status = e.ops->setup(&e);
+        assert(status == FDB_RESULT_SUCCESS);
+
+        for (j = 0; j < n_loops; ++j) {
+            start = get_monotonic_ts();
+            for (k = 0; k < (int)num_blocks; ++k) {
+                status = fdb_encrypt_blocks(&e, cipher + k * blocksize,
+                                            plain + k * blocksize,
+                                            blocksize, 1, k);
+            }
+            track_stat(&sa->t_stats[i * 4][0],
+                       ts_diff(start, get_monotonic_ts()));
+
+            start = get_monotonic_ts();
+            status = fdb_encrypt_blocks(&e, cipher, plain, blocksize,
+                                        num_blocks, 0);
+            track_stat(&sa->t_stats[i * 4 + 1][0],
+                       ts_diff(start, get_monotonic_ts()));
+
+            start = get_monotonic_ts();
+            for (k = 0; k < (int)num_blocks; ++k) {
+                status = fdb_decrypt_block(&e, cipher + k * blocksize,
+                                           blocksize, k);
+            }
+            track_stat(&sa->t_stats[i * 4 + 2][0],
+                       ts_diff(start, get_monotonic_ts()));
+
+            status = fdb_encrypt_blocks(&e, cipher, plain, blocksize,
+                                        num_blocks, 0);
+            start = get_monotonic_ts();
+            status = fdb_decrypt_blocks(&e, cipher, blocksize,
+                                        num_blocks, 0);
+            track_stat(&sa->t_stats[i * 4 + 3][0],
+                       ts_diff(start, get_monotonic_ts()));
+            assert(memcmp(cipher, plain, blocksize * num_blocks) == 0);
+        }
+    }
+    (void)status;
+
+    // latency of encrypting or decrypting 16 blocks (64KB)
+    sa->aggregateAndPrintStats("CRYPT_BENCH_STATS", n_loops, "µs");
+    delete sa;
+
+    free(plain);
+    free(cipher);
+
+    TEST_RESULT("Encryption benchmark done");
+}
+
 /*
  *  ===================
  *  FDB BENCH MARK TEST
@@ -402,4 +497,5 @@ void do_bench() {
 int main(int argc, char* args[]) {
 
     do_bench();
+    crypt_bench();
 }
@@ -34,6 +34,9 @@
 #include "functional_util.h"
 #include "file_handle.h"
 #include "kvs_handle.h"
+#include "docio.h"
+#include "ratelimiter.h"
+#include "time_utils.h"
 
 struct cb_args {
     int n_moved_docs;
@@ -342,6 +345,1178 @@ void compact_wo_reopen_test()
     TEST_RESULT("compaction without reopen test");
 }
 
+void parallel_compaction_test(bool multi_kv)
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, j, r;
+    int n = 20000;
+    size_t bodylen;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_iterator *iterator;
+    fdb_doc *doc, *rdoc;
+    fdb_file_info info;
+    fdb_status status;
+    char keybuf[256], metabuf[256];
+    char *bodybuf = (char *)malloc(8192);
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 16777216;
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+    fconfig.multi_kv_instances = multi_kv;
+    fconfig.seqtree_opt = FDB_SEQTREE_USE;
+    fconfig.num_compaction_workers = 4;
+
+    fdb_open(&dbfile, "./compact_test1", &fconfig);
+    if (multi_kv) {
+        fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+    } else {
+        fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    }
+    status = fdb_set_log_callback(db, logCallbackFunc,
+                                  (void *) "parallel_compaction_test");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // insert docs of various sizes (including multi-block docs),
+    // and update every third doc so that the file contains stale data
+    for (r = 0; r < 2; ++r) {
+        for (i = 0; i < n; ++i) {
+            if (r == 1 && i % 3) {
+                continue;
+            }
+            sprintf(keybuf, "key%06d", i);
+            sprintf(metabuf, "meta%06d_%d", i, r);
+            bodylen = (i * 31) % 6000 + 1;
+            memset(bodybuf, 'a' + (i + r) % 26, bodylen);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf,
+                           strlen(metabuf), bodybuf, bodylen);
+            status = fdb_set(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(doc);
+        }
+        fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    }
+    // delete every tenth doc
+    for (i = 0; i < n; i += 10) {
+        sprintf(keybuf, "key%06d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_del(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    status = fdb_compact(dbfile, "./compact_test2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // verify all docs both before and after re-opening the compacted file
+    for (j = 0; j < 2; ++j) {
+        fdb_get_file_info(dbfile, &info);
+        TEST_CHK(info.doc_count == (uint64_t)(n - n / 10));
+
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db, rdoc);
+            if (i % 10 == 0) {
+                TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            } else {
+                r = (i % 3) ? 0 : 1;
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                sprintf(metabuf, "meta%06d_%d", i, r);
+                TEST_CMP(rdoc->meta, metabuf, rdoc->metalen);
+                bodylen = (i * 31) % 6000 + 1;
+                memset(bodybuf, 'a' + (i + r) % 26, bodylen);
+                TEST_CHK(rdoc->bodylen == bodylen);
+                TEST_CMP(rdoc->body, bodybuf, bodylen);
+            }
+            fdb_doc_free(rdoc);
+        }
+
+        // sequence index should be consistent as well
+        status = fdb_iterator_sequence_init(db, &iterator, 0, 0,
+                                            FDB_ITR_NO_DELETES);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        i = 0;
+        rdoc = NULL;
+        do {
+            status = fdb_iterator_get(iterator, &rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(rdoc);
+            rdoc = NULL;
+            ++i;
+        } while (fdb_iterator_next(iterator) == FDB_RESULT_SUCCESS);
+        TEST_CHK(i == n - n / 10);
+        fdb_iterator_close(iterator);
+
+        if (j == 0) {
+            fdb_kvs_close(db);
+            fdb_close(dbfile);
+            fdb_open(&dbfile, "./compact_test2", &fconfig);
+            if (multi_kv) {
+                fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+            } else {
+                fdb_kvs_open_default(dbfile, &db, &kvs_config);
+            }
+        }
+    }
+
+    fdb_kvs_close(db);
+    fdb_close(dbfile);
+    fdb_shutdown();
+    free(bodybuf);
+
+    memleak_end();
+
+    sprintf(keybuf, "parallel compaction test %s", multi_kv ?
+            "multiple kv instances" : "single kv instance");
+    TEST_RESULT(keybuf);
+}
+
+void incremental_compaction_test(bool multi_kv)
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, j, r;
+    int n = 10000;
+    int n_relocated;
+    bool reused;
+    uint64_t file_size;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_iterator *iterator;
+    fdb_doc *doc, *rdoc;
+    fdb_file_info info;
+    fdb_status status;
+    char keybuf[256], metabuf[256], bodybuf[1024];
+    fdb_seqnum_t *seqnums = (fdb_seqnum_t *)malloc(sizeof(fdb_seqnum_t) * n);
+    uint64_t *offsets = (uint64_t *)malloc(sizeof(uint64_t) * n);
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 0;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+    fconfig.multi_kv_instances = multi_kv;
+    fconfig.seqtree_opt = FDB_SEQTREE_USE;
+    // blocks are not reused until the relocation is verified
+    fconfig.block_reusing_threshold = 0;
+
+    fdb_open(&dbfile, "./compact_test1", &fconfig);
+    if (multi_kv) {
+        fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+    } else {
+        fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    }
+    status = fdb_set_log_callback(db, logCallbackFunc,
+                                  (void *) "incremental_compaction_test");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // insert docs, and then update two out of every three docs,
+    // so that the blocks written first become fragmented
+    for (r = 0; r < 2; ++r) {
+        for (i = 0; i < n; ++i) {
+            if (r == 1 && i % 3 == 0) {
+                continue;
+            }
+            sprintf(keybuf, "key%06d", i);
+            sprintf(metabuf, "meta%06d_%d", i, r);
+            sprintf(bodybuf, "body%06d_%d_%0900d", i, r, i);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf,
+                           strlen(metabuf), bodybuf, strlen(bodybuf));
+            status = fdb_set(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(doc);
+        }
+        fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    }
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get_metaonly(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        seqnums[i] = rdoc->seqnum;
+        offsets[i] = rdoc->offset;
+        fdb_doc_free(rdoc);
+    }
+
+    // invalid arguments
+    status = fdb_compact_incremental(dbfile, 0, 1000);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    status = fdb_compact_incremental(dbfile, 50, 0);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+
+    status = fdb_compact_incremental(dbfile, 50, n);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // verify all docs both before and after re-opening the file
+    for (j = 0; j < 2; ++j) {
+        fdb_get_file_info(dbfile, &info);
+        TEST_CHK(info.doc_count == (uint64_t)n);
+
+        n_relocated = 0;
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db, rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            r = (i % 3 == 0) ? 0 : 1;
+            sprintf(metabuf, "meta%06d_%d", i, r);
+            sprintf(bodybuf, "body%06d_%d_%0900d", i, r, i);
+            TEST_CHK(rdoc->metalen == strlen(metabuf));
+            TEST_CMP(rdoc->meta, metabuf, rdoc->metalen);
+            TEST_CHK(rdoc->bodylen == strlen(bodybuf));
+            TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            // relocated docs keep their seq numbers
+            TEST_CHK(rdoc->seqnum == seqnums[i]);
+            if (rdoc->offset != offsets[i]) {
+                // only docs left in the fragmented blocks are relocated
+                TEST_CHK(i % 3 == 0);
+                n_relocated++;
+            }
+            fdb_doc_free(rdoc);
+        }
+        TEST_CHK(n_relocated > n / 3 / 2);
+
+        // sequence index should be consistent as well
+        status = fdb_iterator_sequence_init(db, &iterator, 0, 0,
+                                            FDB_ITR_NONE);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        i = 0;
+        rdoc = NULL;
+        do {
+            status = fdb_iterator_get(iterator, &rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(rdoc);
+            rdoc = NULL;
+            ++i;
+        } while (fdb_iterator_next(iterator) == FDB_RESULT_SUCCESS);
+        TEST_CHK(i == n);
+        fdb_iterator_close(iterator);
+
+        if (j == 0) {
+            fdb_kvs_close(db);
+            fdb_close(dbfile);
+            fdb_open(&dbfile, "./compact_test1", &fconfig);
+            if (multi_kv) {
+                fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+            } else {
+                fdb_kvs_open_default(dbfile, &db, &kvs_config);
+            }
+        }
+    }
+
+    // nothing is left to be relocated
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get_metaonly(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        offsets[i] = rdoc->offset;
+        fdb_doc_free(rdoc);
+    }
+    status = fdb_compact_incremental(dbfile, 50, n);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get_metaonly(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CHK(rdoc->offset == offsets[i]);
+        fdb_doc_free(rdoc);
+    }
+
+    // the blocks emptied by the relocation are reclaimed by the next block
+    // reuse check of the superblock, after which the file stops growing
+    status = fdb_set_block_reusing_params(dbfile, 20, 1);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_get_file_info(dbfile, &info);
+    file_size = info.file_size;
+    reused = false;
+    for (r = 2; r < 6 && !reused; ++r) {
+        for (i = 0; i < n && !reused; i += 3) {
+            sprintf(keybuf, "key%06d", i);
+            sprintf(metabuf, "meta%06d_%d", i, r);
+            sprintf(bodybuf, "body%06d_%d_%0900d", i, r, i);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf,
+                           strlen(metabuf), bodybuf, strlen(bodybuf));
+            status = fdb_set(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(doc);
+            if (i % 300 == 0) {
+                fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+                fdb_get_file_info(dbfile, &info);
+                reused = (info.file_size == file_size);
+                file_size = info.file_size;
+            }
+        }
+    }
+    TEST_CHK(reused);
+
+    // another round of updates fits into the reclaimed blocks
+    for (i = 0; i < n; i += 3) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(metabuf, "meta%06d_%d", i, r);
+        sprintf(bodybuf, "body%06d_%d_%0900d", i, r, i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf,
+                       strlen(metabuf), bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+        if (i % 300 == 0) {
+            fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        }
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    fdb_get_file_info(dbfile, &info);
+    TEST_CHK(info.file_size == file_size);
+
+    fdb_kvs_close(db);
+    fdb_close(dbfile);
+    fdb_shutdown();
+    free(seqnums);
+    free(offsets);
+
+    memleak_end();
+
+    sprintf(keybuf, "incremental compaction test %s", multi_kv ?
+            "multiple kv instances" : "single kv instance");
+    TEST_RESULT(keybuf);
+}
+
+void cow_compaction_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, r;
+    int n = 10000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *rdoc;
+    fdb_file_info info;
+    fdb_status status;
+    size_t bodylen;
+    char keybuf[256], bodybuf[8192];
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 0;
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+
+    fdb_open(&dbfile, "./compact_test1", &fconfig);
+    fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    status = fdb_set_log_callback(db, logCallbackFunc,
+                                  (void *) "cow_compaction_test");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // insert docs of various sizes (including multi-block docs),
+    // and then update every other doc
+    for (r = 0; r < 2; ++r) {
+        for (i = r; i < n; i += r + 1) {
+            sprintf(keybuf, "key%06d", i);
+            bodylen = (i * 37) % 6000 + 1;
+            memset(bodybuf, 'a' + (i + r) % 26, bodylen);
+            status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                                bodybuf, bodylen);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+        fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    }
+
+    status = fdb_compact_with_cow(dbfile, "./compact_test2");
+    if (status == FDB_RESULT_COMPACTION_FAIL) {
+        // neither block cloning nor copy_file_range is supported
+        fdb_kvs_close(db);
+        fdb_close(dbfile);
+        fdb_shutdown();
+        memleak_end();
+        TEST_RESULT("cow compaction test (not supported, skipped)");
+        return;
+    }
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // verify all docs both before and after re-opening the compacted file
+    for (r = 0; r < 2; ++r) {
+        fdb_get_file_info(dbfile, &info);
+        TEST_CHK(info.doc_count == (uint64_t)n);
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            bodylen = (i * 37) % 6000 + 1;
+            memset(bodybuf, 'a' + (i + i % 2) % 26, bodylen);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db, rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CHK(rdoc->bodylen == bodylen);
+            TEST_CMP(rdoc->body, bodybuf, bodylen);
+            fdb_doc_free(rdoc);
+        }
+
+        if (r == 0) {
+            fdb_kvs_close(db);
+            fdb_close(dbfile);
+            fdb_open(&dbfile, "./compact_test2", &fconfig);
+            fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        }
+    }
+
+    fdb_kvs_close(db);
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    memleak_end();
+
+    TEST_RESULT("cow compaction test");
+}
+
+static void _cow_compaction_dict_body(char *bodybuf, int i, int r)
+{
+    sprintf(bodybuf, "{\"id\": %d, \"type\": \"user\", \"status\": \"%s\", "
+            "\"email\": \"user%d@example.com\"}",
+            i, r ? "updated" : "active", i);
+}
+
+void cow_compaction_dict_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, r;
+    int n = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_status status;
+    void *value_out;
+    size_t valuelen_out;
+    char keybuf[256], bodybuf[256];
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 0;
+    fconfig.compress_document_body = true;
+    fconfig.compression_codec = FDB_COMPRESSION_ZSTD;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+
+    fdb_open(&dbfile, "./compact_test1", &fconfig);
+    fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    status = fdb_set_log_callback(db, logCallbackFunc,
+                                  (void *) "cow_compaction_dict_test");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        _cow_compaction_dict_body(bodybuf, i, 0);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    status = fdb_kvs_train_compression_dict(db, 4096);
+    if (status == FDB_RESULT_COMPRESSION_FAIL) {
+        // zstd is not supported by the build
+        fdb_kvs_close(db);
+        fdb_close(dbfile);
+        fdb_shutdown();
+        memleak_end();
+        TEST_RESULT("cow compaction with dictionary test "
+                    "(not supported, skipped)");
+        return;
+    }
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // update every other doc, which is compressed with the dictionary
+    for (i = 0; i < n; i += 2) {
+        sprintf(keybuf, "key%06d", i);
+        _cow_compaction_dict_body(bodybuf, i, 1);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    status = fdb_compact_with_cow(dbfile, "./compact_test2");
+    if (status == FDB_RESULT_COMPACTION_FAIL) {
+        // neither block cloning nor copy_file_range is supported
+        fdb_kvs_close(db);
+        fdb_close(dbfile);
+        fdb_shutdown();
+        memleak_end();
+        TEST_RESULT("cow compaction with dictionary test "
+                    "(not supported, skipped)");
+        return;
+    }
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // the old file is removed, so the dict-compressed docs should refer to
+    // the dictionary copied into the new file
+    r = system(SHELL_DEL" compact_test1 > errorlog.txt");
+    (void)r;
+
+    // verify all docs both before and after re-opening the compacted file
+    for (r = 0; r < 2; ++r) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            _cow_compaction_dict_body(bodybuf, i, (i % 2 == 0) ? 1 : 0);
+            status = fdb_get_kv(db, keybuf, strlen(keybuf),
+                                &value_out, &valuelen_out);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CHK(valuelen_out == strlen(bodybuf) + 1);
+            TEST_CMP(value_out, bodybuf, valuelen_out);
+            fdb_free_block(value_out);
+        }
+
+        if (r == 0) {
+            fdb_kvs_close(db);
+            fdb_close(dbfile);
+            fdb_shutdown();
+            fdb_open(&dbfile, "./compact_test2", &fconfig);
+            fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        }
+    }
+
+    fdb_kvs_close(db);
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    memleak_end();
+
+    TEST_RESULT("cow compaction with dictionary test");
+}
+
+// Check the codec of the doc at the given offset, if its body is compressed
+// (codecs that are not built in leave the body uncompressed).
+static bool _compaction_doc_codec_check(fdb_kvs_handle *db, uint64_t offset,
+                                        fdb_compression_codec_t codec)
+{
+    struct docio_length length;
+
+    if (db->dhandle->readDocLength_Docio(&length, offset) !=
+        FDB_RESULT_SUCCESS) {
+        return false;
+    }
+    if (!(length.flag & DOCIO_COMPRESSED)) {
+        return true;
+    }
+    return ((length.flag & DOCIO_CODEC_MASK) >> DOCIO_CODEC_SHIFT) ==
+           doc_codec_from_config(codec);
+}
+
+void compaction_multi_codec_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, j, r;
+    int n = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db[3];
+    fdb_doc *rdoc;
+    fdb_status status;
+    void *value_out;
+    size_t valuelen_out;
+    char keybuf[256], bodybuf[256];
+    const char *kvs_names[] = {NULL, "zstd", "lz4"};
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config[3];
+    fconfig.compress_document_body = true;
+    fconfig.compression_codec = FDB_COMPRESSION_SNAPPY;
+    fconfig.compaction_threshold = 0;
+    // the default KV store uses the file's codec, and the others override
+    // it. The 'lz4' KV store is created last, so its docs are moved last.
+    for (j = 0; j < 3; ++j) {
+        kvs_config[j] = fdb_get_default_kvs_config();
+    }
+    kvs_config[1].compression_codec = FDB_COMPRESSION_ZSTD;
+    kvs_config[2].compression_codec = FDB_COMPRESSION_LZ4;
+
+    fdb_open(&dbfile, "./compact_test1", &fconfig);
+    for (j = 0; j < 3; ++j) {
+        status = fdb_kvs_open(dbfile, &db[j], kvs_names[j], &kvs_config[j]);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    for (j = 0; j < 3; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            sprintf(bodybuf, "{\"id\": %d, \"kvs\": %d, \"status\": "
+                    "\"active\"}", i, j);
+            status = fdb_set_kv(db[j], keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf) + 1);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    status = fdb_compact(dbfile, "./compact_test2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // update a half of docs after the compaction
+    for (j = 0; j < 3; ++j) {
+        for (i = 0; i < n / 2; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            sprintf(bodybuf, "{\"id\": %d, \"kvs\": %d, \"status\": "
+                    "\"updated\"}", i, j);
+            status = fdb_set_kv(db[j], keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf) + 1);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    // the KV header appended by the commit uses the file's codec, not the
+    // codec of the last doc moved by the compaction
+    fdb_kvs_handle *root = dbfile->getRootHandle();
+    TEST_CHK(_compaction_doc_codec_check(root, root->kv_info_offset,
+                                         fconfig.compression_codec));
+
+    // verify all docs both before and after re-opening the compacted file
+    for (r = 0; r < 2; ++r) {
+        for (j = 0; j < 3; ++j) {
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%06d", i);
+                sprintf(bodybuf, "{\"id\": %d, \"kvs\": %d, \"status\": "
+                        "\"%s\"}", i, j, (i < n / 2) ? "updated" : "active");
+                status = fdb_get_kv(db[j], keybuf, strlen(keybuf),
+                                    &value_out, &valuelen_out);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CHK(valuelen_out == strlen(bodybuf) + 1);
+                TEST_CMP(value_out, bodybuf, valuelen_out);
+                fdb_free_block(value_out);
+
+                fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0,
+                               NULL, 0);
+                status = fdb_get_metaonly(db[j], rdoc);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CHK(_compaction_doc_codec_check(
+                             db[j], rdoc->offset,
+                             kvs_config[j].compression_codec ==
+                                 FDB_COMPRESSION_DEFAULT ?
+                                 fconfig.compression_codec :
+                                 kvs_config[j].compression_codec));
+                fdb_doc_free(rdoc);
+            }
+        }
+
+        if (r == 0) {
+            fdb_close(dbfile);
+            fdb_open(&dbfile, "./compact_test2", &fconfig);
+            for (j = 0; j < 3; ++j) {
+                status = fdb_kvs_open(dbfile, &db[j], kvs_names[j],
+                                      &kvs_config[j]);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+            }
+        }
+    }
+
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    memleak_end();
+
+    TEST_RESULT("compaction with multiple codecs test");
+}
+
+void compaction_rate_limit_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, r;
+    int n = 3000;
+    size_t bodylen = 1000;
+    uint64_t rate = 1048576;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_file_info info;
+    fdb_status status;
+    struct timeval ts_begin, ts_end, ts_gap;
+    char keybuf[256], metabuf[256];
+    char bodybuf[1024];
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    // make sure that the new global config takes effect
+    fdb_shutdown();
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 16777216;
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+    fconfig.background_io_rate_limit = rate;
+
+    fdb_open(&dbfile, "./compact_test1", &fconfig);
+    fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    status = fdb_set_log_callback(db, logCallbackFunc,
+                                  (void *) "compaction_rate_limit_test");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // insert ~3MB of docs, which are not throttled
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(metabuf, "meta%06d", i);
+        memset(bodybuf, 'a' + i % 26, bodylen);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf,
+                       strlen(metabuf), bodybuf, bodylen);
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    // writing the docs and index blocks of the new file should take at least
+    // (size / rate) seconds, less the burst allowance (up to one second)
+    // accumulated during the loading
+    gettimeofday(&ts_begin, NULL);
+    status = fdb_compact(dbfile, "./compact_test2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    gettimeofday(&ts_end, NULL);
+    ts_gap = _utime_gap(ts_begin, ts_end);
+
+    fdb_get_file_info(dbfile, &info);
+    TEST_CHK((uint64_t)ts_gap.tv_sec + 1 >= info.file_size / rate);
+    TEST_CHK(info.doc_count == (uint64_t)n);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        memset(bodybuf, 'a' + i % 26, bodylen);
+        TEST_CHK(rdoc->bodylen == bodylen);
+        TEST_CMP(rdoc->body, bodybuf, bodylen);
+        fdb_doc_free(rdoc);
+    }
+
+    fdb_kvs_close(db);
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    memleak_end();
+
+    TEST_RESULT("compaction rate limit test");
+}
+
+void compaction_rate_backoff_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, r;
+    uint64_t rate = 1048576;
+    uint64_t begin;
+    fdb_file_handle *dbfile;
+    IoRateLimiter *limiter;
+
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    // make sure that the new global config takes effect
+    fdb_shutdown();
+
+    fdb_config fconfig = fdb_get_default_config();
+    fconfig.compaction_threshold = 0;
+    fconfig.background_io_rate_limit = rate;
+    fconfig.background_io_latency_target = 1000;
+
+    fdb_open(&dbfile, "./compact_test1", &fconfig);
+    limiter = IoRateLimiter::getInstance();
+    TEST_CHK(limiter != NULL);
+    TEST_CHK(limiter->getCurrentRate() == rate);
+
+    // foreground reads slower than the target, sampled in the same way as
+    // builds without latency stats. Other operations are not sampled.
+    for (i = 0; i < RATE_LIMITER_MIN_SAMPLES; ++i) {
+        begin = gethrtime() - 10000000; // 10 ms ago
+        IoRateLimiter::sampleEnd(FDB_LATENCY_GETS, begin);
+        IoRateLimiter::sampleEnd(FDB_LATENCY_SETS, begin);
+    }
+
+    // the rate is halved once the window expires
+    usleep(RATE_LIMITER_WINDOW_US + 100000);
+    limiter->request(1);
+    TEST_CHK(limiter->getCurrentRate() == rate / 2);
+
+    // too few samples in the next window don't change the rate
+    usleep(RATE_LIMITER_WINDOW_US + 100000);
+    limiter->request(1);
+    TEST_CHK(limiter->getCurrentRate() == rate / 2);
+
+    // and it is raised back once reads are within the target
+    for (i = 0; i < RATE_LIMITER_MIN_SAMPLES; ++i) {
+        IoRateLimiter::sampleEnd(FDB_LATENCY_ITR_GET, gethrtime());
+    }
+    usleep(RATE_LIMITER_WINDOW_US + 100000);
+    limiter->request(1);
+    TEST_CHK(limiter->getCurrentRate() ==
+             rate / 2 + rate / RATE_LIMITER_RECOVERY_DIV);
+
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    memleak_end();
+
+    TEST_RESULT("compaction rate backoff test");
+}
+
+static std::atomic<int> daemon_priority_count(0);
+static char daemon_priority_order[2];
+
+static int cb_daemon_priority(fdb_file_handle *fhandle,
+                              fdb_compaction_status status,
+                              const char *kv_name,
+                              fdb_doc *doc, uint64_t old_offset,
+                              uint64_t new_offset, void *ctx)
+{
+    (void) fhandle;
+    (void) kv_name;
+    (void) doc;
+    (void) old_offset;
+    (void) new_offset;
+
+    if (status == FDB_CS_BEGIN) {
+        int idx = daemon_priority_count++;
+        if (idx < 2) {
+            daemon_priority_order[idx] = *(char *)ctx;
+        }
+    }
+    return 0;
+}
+
+void compaction_daemon_priority_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, j, k, r;
+    int n = 2000;
+    fdb_file_handle *dbfile[2];
+    fdb_kvs_handle *db[2];
+    fdb_status status;
+    struct timeval ts_begin, ts_cur, ts_gap;
+    char keybuf[256], bodybuf[1024];
+    char tags[2] = {'a', 'b'};
+    // Update ratio (%) of each file: 'b' has much more stale data than 'a',
+    // so that it should be compacted first even though 'a' is registered
+    // earlier (i.e., comes first in the file list).
+    int update_ratio[2] = {100, 400};
+
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    // make sure that the new global config takes effect
+    fdb_shutdown();
+    daemon_priority_count = 0;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.compaction_mode = FDB_COMPACTION_AUTO;
+    fconfig.compaction_threshold = 30;
+    fconfig.compactor_sleep_duration = 3;
+    fconfig.num_compactor_threads = 1;
+    fconfig.compaction_cb = cb_daemon_priority;
+    fconfig.compaction_cb_mask = FDB_CS_BEGIN;
+
+    for (k = 0; k < 2; ++k) {
+        sprintf(keybuf, "./compact_test_%c", tags[k]);
+        fconfig.compaction_cb_ctx = &tags[k];
+        status = fdb_open(&dbfile[k], keybuf, &fconfig);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        // hold off the daemon until both files are loaded
+        status = fdb_set_daemon_compaction_interval(dbfile[k], 3600);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_kvs_open_default(dbfile[k], &db[k], &kvs_config);
+
+        memset(bodybuf, 'a' + k, sizeof(bodybuf));
+        for (j = 0; j <= update_ratio[k] / 100; ++j) {
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%06d", i);
+                status = fdb_set_kv(db[k], keybuf, strlen(keybuf),
+                                    bodybuf, sizeof(bodybuf));
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+            }
+            fdb_commit(dbfile[k], FDB_COMMIT_MANUAL_WAL_FLUSH);
+        }
+    }
+    for (k = 0; k < 2; ++k) {
+        status = fdb_set_daemon_compaction_interval(dbfile[k], 0);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    // wait until the daemon compacts both files
+    gettimeofday(&ts_begin, NULL);
+    while (daemon_priority_count.load() < 2) {
+        sleep(1);
+        gettimeofday(&ts_cur, NULL);
+        ts_gap = _utime_gap(ts_begin, ts_cur);
+        TEST_CHK(ts_gap.tv_sec < 60);
+    }
+    TEST_CHK(daemon_priority_order[0] == 'b');
+    TEST_CHK(daemon_priority_order[1] == 'a');
+
+    for (k = 0; k < 2; ++k) {
+        fdb_kvs_close(db[k]);
+        fdb_close(dbfile[k]);
+    }
+    fdb_shutdown();
+
+    memleak_end();
+
+    TEST_RESULT("compaction daemon priority test");
+}
+
+void cluster_docs_compaction_test(bool multi_kv)
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, k, r, idx;
+    int n = 5000;
+    int num_kvs = multi_kv ? 2 : 1;
+    size_t bodylen;
+    uint64_t max_base_offset = 0, min_delta_offset = (uint64_t)-1;
+    uint64_t prev_base_offset = 0, prev_delta_offset = 0;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db[2];
+    fdb_iterator *iterator;
+    fdb_doc *doc, *rdoc;
+    fdb_snapshot_info_t *markers;
+    uint64_t num_markers;
+    fdb_status status;
+    char keybuf[256], metabuf[256], kvsname[16];
+    char *bodybuf = (char *)malloc(8192);
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 16777216;
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+    fconfig.multi_kv_instances = multi_kv;
+    fconfig.seqtree_opt = FDB_SEQTREE_USE;
+    fconfig.num_compaction_workers = 4;
+    fconfig.compaction_cluster_docs = true;
+
+    fdb_open(&dbfile, "./compact_test1", &fconfig);
+    for (k = 0; k < num_kvs; ++k) {
+        if (multi_kv) {
+            sprintf(kvsname, "kv%d", k);
+            fdb_kvs_open(dbfile, &db[k], kvsname, &kvs_config);
+        } else {
+            fdb_kvs_open_default(dbfile, &db[k], &kvs_config);
+        }
+    }
+
+    // insert docs in a scrambled key order (r == 0), then update every
+    // fourth doc twice (r == 1, 2) after taking a snapshot marker, so that
+    // the updates are moved as delta docs by compaction up to the marker.
+    for (r = 0; r < 3; ++r) {
+        for (i = 0; i < n; ++i) {
+            idx = (int)(((uint64_t)i * 7919) % n);
+            if (r > 0 && idx % 4) {
+                continue;
+            }
+            sprintf(keybuf, "key%06d", idx);
+            sprintf(metabuf, "meta%06d_%d", idx, r);
+            bodylen = (idx * 31 + r) % 6000 + 1;
+            memset(bodybuf, 'a' + (idx + r) % 26, bodylen);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf,
+                           strlen(metabuf), bodybuf, bodylen);
+            for (k = 0; k < num_kvs; ++k) {
+                status = fdb_set(db[k], doc);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+            }
+            fdb_doc_free(doc);
+        }
+        if (r != 1) {
+            fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        }
+    }
+
+    status = fdb_get_all_snap_markers(dbfile, &markers, &num_markers);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(num_markers >= 2);
+    status = fdb_compact_upto(dbfile, "./compact_test2", markers[1].marker);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_free_snap_markers(markers, num_markers);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // Docs that were not updated should be laid out in key order of each KV
+    // store (KV stores in the order of their IDs), followed by the delta docs
+    // that are also in key order.
+    for (k = 0; k < num_kvs; ++k) {
+        status = fdb_iterator_init(db[k], &iterator, NULL, 0, NULL, 0,
+                                   FDB_ITR_NONE);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        i = 0;
+        rdoc = NULL;
+        do {
+            status = fdb_iterator_get(iterator, &rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            r = (i % 4) ? 0 : 2;
+            sprintf(keybuf, "key%06d", i);
+            TEST_CMP(rdoc->key, keybuf, rdoc->keylen);
+            sprintf(metabuf, "meta%06d_%d", i, r);
+            TEST_CMP(rdoc->meta, metabuf, rdoc->metalen);
+            bodylen = (i * 31 + r) % 6000 + 1;
+            memset(bodybuf, 'a' + (i + r) % 26, bodylen);
+            TEST_CHK(rdoc->bodylen == bodylen);
+            TEST_CMP(rdoc->body, bodybuf, bodylen);
+            if (r) {
+                TEST_CHK(rdoc->offset > prev_delta_offset);
+                prev_delta_offset = rdoc->offset;
+                if (rdoc->offset < min_delta_offset) {
+                    min_delta_offset = rdoc->offset;
+                }
+            } else {
+                TEST_CHK(rdoc->offset > prev_base_offset);
+                prev_base_offset = max_base_offset = rdoc->offset;
+            }
+            fdb_doc_free(rdoc);
+            rdoc = NULL;
+            ++i;
+        } while (fdb_iterator_next(iterator) == FDB_RESULT_SUCCESS);
+        TEST_CHK(i == n);
+        fdb_iterator_close(iterator);
+    }
+    TEST_CHK(max_base_offset < min_delta_offset);
+
+    for (k = 0; k < num_kvs; ++k) {
+        fdb_kvs_close(db[k]);
+    }
+    fdb_close(dbfile);
+    fdb_shutdown();
+    free(bodybuf);
+
+    memleak_end();
+
+    sprintf(keybuf, "cluster docs compaction test %s", multi_kv ?
+            "multiple kv instances" : "single kv instance");
+    TEST_RESULT(keybuf);
+}
+
+void compaction_index_build_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, f, r, idx;
+    int n = 30000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_file_info info[2];
+    fdb_status status;
+    char keybuf[256], filename[256], bodybuf[128];
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL" compact_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 0;
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+    fconfig.seqtree_opt = FDB_SEQTREE_NOT_USE;
+    memset(bodybuf, 'b', sizeof(bodybuf));
+
+    // Populate the same docs in the key order (file 0) and in a scrambled
+    // order (file 1). Since the new file's index is built from the docs
+    // sorted by key regardless of the order of the old file, both compacted
+    // files should use the same amount of space.
+    for (f = 0; f < 2; ++f) {
+        sprintf(filename, "./compact_test%d", f);
+        fdb_open(&dbfile, filename, &fconfig);
+        fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        for (i = 0; i < n; ++i) {
+            idx = f ? (int)(((uint64_t)i * 7919) % n) : i;
+            sprintf(keybuf, "key%08d", idx);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                           bodybuf, sizeof(bodybuf));
+            status = fdb_set(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(doc);
+        }
+        fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+        sprintf(filename, "./compact_test%d_compacted", f);
+        status = fdb_compact(dbfile, filename);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_get_file_info(dbfile, &info[f]);
+        TEST_CHK(info[f].doc_count == (uint64_t)n);
+
+        for (i = 0; i < n; i += 7) {
+            sprintf(keybuf, "key%08d", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db, rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CMP(rdoc->body, bodybuf, sizeof(bodybuf));
+            fdb_doc_free(rdoc);
+        }
+
+        fdb_kvs_close(db);
+        fdb_close(dbfile);
+    }
+    TEST_CHK(info[1].space_used <= info[0].space_used + 4096);
+
+    fdb_shutdown();
+
+    memleak_end();
+
+    TEST_RESULT("compaction index build test");
+}
+
 void compact_with_reopen_test()
 {
     TEST_INIT();
@@ -3708,6 +4883,19 @@ int main(){
     compaction_callback_test(false); // single kv instance mode
     compact_wo_reopen_test();
     compact_with_reopen_test();
+    parallel_compaction_test(false);
+    parallel_compaction_test(true);
+    incremental_compaction_test(false);
+    incremental_compaction_test(true);
+    cow_compaction_test();
+    cow_compaction_dict_test();
+    compaction_multi_codec_test();
+    compaction_rate_limit_test();
+    compaction_rate_backoff_test();
+    compaction_daemon_priority_test();
+    cluster_docs_compaction_test(false);
+    cluster_docs_compaction_test(true);
+    compaction_index_build_test();
 #if !defined(THREAD_SANITIZER)
     compact_reopen_with_iterator();
 #endif
@@ -4299,6 +4299,1214 @@ void long_key_test()
     TEST_RESULT("long key test");
 }
 
+void bloom_filter_test(bool multi_kv)
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc;
+    fdb_status status;
+    fdb_kvs_ops_info info;
+    char keybuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.wal_threshold = 128;
+    fconfig.compaction_threshold = 0;
+    fconfig.multi_kv_instances = multi_kv;
+    fconfig.bloom_filter_bits_per_key = 10;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    if (multi_kv) {
+        status = fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+    } else {
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    }
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // insert even keys only, flushing WAL multiple times
+    for (i = 0; i < n; i += 2) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%06d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+        if (i % 200 == 0) {
+            fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        }
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    // delete one key; it should still be reported as not found
+    fdb_doc_create(&doc, "key000002", 9, NULL, 0, NULL, 0);
+    status = fdb_del(db, doc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_doc_free(doc);
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    for (r = 0; r < 2; ++r) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db, doc);
+            if (i % 2 == 0 && i != 2) {
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                sprintf(bodybuf, "body%06d", i);
+                TEST_CMP(doc->body, bodybuf, doc->bodylen);
+            } else {
+                TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            }
+            fdb_doc_free(doc);
+        }
+
+        status = fdb_get_kvs_ops_info(db, &info);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        // most of the misses should be answered by the filter
+        TEST_CHK(info.num_filter_negatives > (uint64_t)(n / 2) * 9 / 10);
+        TEST_CHK(info.num_filter_negatives + info.num_filter_false_positives
+                 >= (uint64_t)(n / 2));
+
+        if (r == 0) {
+            // the new file's filter is rebuilt during compaction
+            status = fdb_compact(dbfile, "./func_test2");
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    memleak_end();
+
+    sprintf(bodybuf, "Bloom filter negative lookup test %s", multi_kv ?
+            "multiple kv instances" : "single kv instance");
+    TEST_RESULT(bodybuf);
+}
+
+// Count the runs of index node blocks that are not interleaved with other
+// types of blocks in the given file. Unwritten blocks are ignored.
+static int count_index_block_runs(const char *filename, size_t blocksize)
+{
+    int runs = 0;
+    bool prev_bnode = false;
+    uint8_t *buf = (uint8_t *)malloc(blocksize);
+    FILE *fp = fopen(filename, "rb");
+
+    while (fp && fread(buf, 1, blocksize, fp) == blocksize) {
+        // the last byte of a block is its marker
+        if (buf[blocksize - 1] == 0x0) {
+            continue;
+        }
+        bool bnode = (buf[blocksize - 1] == 0xff);
+        if (bnode && !prev_bnode) {
+            runs++;
+        }
+        prev_bnode = bnode;
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    free(buf);
+    return runs;
+}
+
+void legacy_crc_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 100;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_status status;
+    char keybuf[256], bodybuf[256];
+    void *value_out;
+    size_t valuelen_out;
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.compaction_threshold = 0;
+
+    // create a file with the legacy CRC32
+    fconfig.flags = FDB_OPEN_FLAG_CREATE | FDB_OPEN_WITH_LEGACY_CRC;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+    for (i = 0; i < n / 2; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf) + 1,
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_STATUS(status);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_STATUS(status);
+    fdb_close(dbfile);
+
+    // reopen without the flag and update; the file should keep using CRC32
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+    for (i = n / 2; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf) + 1,
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_STATUS(status);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_STATUS(status);
+    fdb_close(dbfile);
+
+    // opening with the legacy flag is allowed only for CRC32 files
+    fconfig.flags = FDB_OPEN_WITH_LEGACY_CRC;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_get_kv(db, keybuf, strlen(keybuf) + 1,
+                            &value_out, &valuelen_out);
+        TEST_STATUS(status);
+        TEST_CMP(value_out, bodybuf, valuelen_out);
+        fdb_free_block(value_out);
+    }
+
+    // compaction writes the new file with CRC32-C
+    status = fdb_compact(dbfile, "./func_test2");
+    TEST_STATUS(status);
+    fdb_close(dbfile);
+    status = fdb_open(&dbfile, "./func_test2", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+
+    // new files use CRC32-C by default
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    status = fdb_open(&dbfile, "./func_test2", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_get_kv(db, keybuf, strlen(keybuf) + 1,
+                            &value_out, &valuelen_out);
+        TEST_STATUS(status);
+        TEST_CMP(value_out, bodybuf, valuelen_out);
+        fdb_free_block(value_out);
+    }
+    fdb_close(dbfile);
+
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("legacy crc test");
+}
+
+static void _doc_compression_codec_verify(fdb_kvs_handle **db, int n,
+                                          int n_updated)
+{
+    TEST_INIT();
+    int i, j;
+    char keybuf[256], bodybuf[256];
+    void *value_out;
+    size_t valuelen_out;
+    fdb_status status;
+
+    for (j = 0; j < 3; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%d", i);
+            sprintf(bodybuf, "{\"id\": %d, \"kvs\": %d, \"type\": \"user\", "
+                    "\"status\": \"%s\", \"email\": \"user%d@example.com\"}",
+                    i, j, (j == 2 && i < n_updated) ? "updated" : "active", i);
+            status = fdb_get_kv(db[j], keybuf, strlen(keybuf) + 1,
+                                &value_out, &valuelen_out);
+            TEST_STATUS(status);
+            TEST_CMP(value_out, bodybuf, valuelen_out);
+            fdb_free_block(value_out);
+        }
+    }
+}
+
+void doc_compression_codec_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r;
+    int n = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db[3];
+    fdb_status status;
+    char keybuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config[3];
+    fconfig.compress_document_body = true;
+    fconfig.compaction_threshold = 0;
+    // the default KV store uses the file's codec (snappy), and the others
+    // override it
+    for (j = 0; j < 3; ++j) {
+        kvs_config[j] = fdb_get_default_kvs_config();
+    }
+    kvs_config[1].compression_codec = FDB_COMPRESSION_LZ4;
+    kvs_config[2].compression_codec = FDB_COMPRESSION_ZSTD;
+
+    // invalid codec
+    fconfig.compression_codec = 100;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+    fconfig.compression_codec = FDB_COMPRESSION_SNAPPY;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config[0]);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[1], "lz4", &kvs_config[1]);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[2], "zstd", &kvs_config[2]);
+    TEST_STATUS(status);
+
+    for (j = 0; j < 3; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%d", i);
+            sprintf(bodybuf, "{\"id\": %d, \"kvs\": %d, \"type\": \"user\", "
+                    "\"status\": \"active\", \"email\": \"user%d@example.com\"}",
+                    i, j, i);
+            status = fdb_set_kv(db[j], keybuf, strlen(keybuf) + 1,
+                                bodybuf, strlen(bodybuf) + 1);
+            TEST_STATUS(status);
+        }
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_STATUS(status);
+
+    // dictionaries are only for zstd
+    status = fdb_kvs_train_compression_dict(db[1], 4096);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    // fails if zstd is not supported by the build
+    status = fdb_kvs_train_compression_dict(db[2], 4096);
+    TEST_CHK(status == FDB_RESULT_SUCCESS ||
+             status == FDB_RESULT_COMPRESSION_FAIL);
+
+    // update a half of docs, which are compressed with the dictionary
+    for (i = 0; i < n / 2; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "{\"id\": %d, \"kvs\": %d, \"type\": \"user\", "
+                "\"status\": \"updated\", \"email\": \"user%d@example.com\"}",
+                i, 2, i);
+        status = fdb_set_kv(db[2], keybuf, strlen(keybuf) + 1,
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_STATUS(status);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_STATUS(status);
+    _doc_compression_codec_verify(db, n, n / 2);
+    fdb_close(dbfile);
+
+    // reopen, and check docs compressed by different codecs
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config[0]);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[1], "lz4", &kvs_config[1]);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[2], "zstd", &kvs_config[2]);
+    TEST_STATUS(status);
+    _doc_compression_codec_verify(db, n, n / 2);
+
+    // the dictionary is loaded from the KV header for new updates
+    for (i = n / 2; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "{\"id\": %d, \"kvs\": %d, \"type\": \"user\", "
+                "\"status\": \"updated\", \"email\": \"user%d@example.com\"}",
+                i, 2, i);
+        status = fdb_set_kv(db[2], keybuf, strlen(keybuf) + 1,
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_STATUS(status);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_STATUS(status);
+    _doc_compression_codec_verify(db, n, n);
+
+    // compaction recompresses all docs, and copies the dictionary
+    status = fdb_compact(dbfile, "./func_test2");
+    TEST_STATUS(status);
+    _doc_compression_codec_verify(db, n, n);
+    fdb_close(dbfile);
+
+    status = fdb_open(&dbfile, "./func_test2", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config[0]);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[1], "lz4", &kvs_config[1]);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[2], "zstd", &kvs_config[2]);
+    TEST_STATUS(status);
+    _doc_compression_codec_verify(db, n, n);
+    fdb_close(dbfile);
+
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("document compression codec test");
+}
+
+static bool _blob_test_file_exists(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp) {
+        fclose(fp);
+        return true;
+    }
+    return false;
+}
+
+// even-numbered docs have large bodies, which go to blob files
+static size_t _blob_test_body(char *bodybuf, int i, int version)
+{
+    size_t len;
+    if (i % 2 == 0) {
+        len = 4096;
+        memset(bodybuf, 'a' + (i + version) % 26, len);
+        sprintf(bodybuf, "large body%d version %d", i, version);
+    } else {
+        sprintf(bodybuf, "small body%d version %d", i, version);
+        len = strlen(bodybuf) + 1;
+    }
+    return len;
+}
+
+static void _blob_test_verify(fdb_kvs_handle **db, int n, int version)
+{
+    TEST_INIT();
+    int i, j;
+    char keybuf[256], bodybuf[4096];
+    void *value_out;
+    size_t valuelen_out, len;
+    fdb_status status;
+
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%d", i);
+            len = _blob_test_body(bodybuf, i, (i % 2 == 0) ? version : 0);
+            status = fdb_get_kv(db[j], keybuf, strlen(keybuf) + 1,
+                                &value_out, &valuelen_out);
+            TEST_STATUS(status);
+            TEST_CHK(valuelen_out == len);
+            TEST_CMP(value_out, bodybuf, valuelen_out);
+            fdb_free_block(value_out);
+        }
+    }
+}
+
+void blob_file_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r;
+    int n = 100;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db[2];
+    fdb_status status;
+    char keybuf[256], bodybuf[4096];
+    size_t len;
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.compaction_threshold = 0;
+    fconfig.blob_threshold = 1024;
+
+    // invalid configs
+    fconfig.blob_gc_stale_ratio = 101;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+    fconfig.blob_gc_stale_ratio = 50;
+    fconfig.multi_kv_instances = false;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+    fconfig.multi_kv_instances = true;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[1], "kvs", &kvs_config);
+    TEST_STATUS(status);
+
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%d", i);
+            len = _blob_test_body(bodybuf, i, 0);
+            status = fdb_set_kv(db[j], keybuf, strlen(keybuf) + 1,
+                                bodybuf, len);
+            TEST_STATUS(status);
+        }
+    }
+    // read from WAL before commit
+    _blob_test_verify(db, n, 0);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_STATUS(status);
+    TEST_CHK(_blob_test_file_exists("./func_test1.blob"));
+    _blob_test_verify(db, n, 0);
+    fdb_close(dbfile);
+
+    // reopen, and read the bodies from the blob file
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[1], "kvs", &kvs_config);
+    TEST_STATUS(status);
+    _blob_test_verify(db, n, 0);
+
+    // update all large bodies, which makes a half of the blob file stale
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; i += 2) {
+            sprintf(keybuf, "key%d", i);
+            len = _blob_test_body(bodybuf, i, 1);
+            status = fdb_set_kv(db[j], keybuf, strlen(keybuf) + 1,
+                                bodybuf, len);
+            TEST_STATUS(status);
+        }
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_STATUS(status);
+    _blob_test_verify(db, n, 1);
+
+    // compaction moves the references, and the blob file is carried over
+    status = fdb_compact(dbfile, "./func_test2");
+    TEST_STATUS(status);
+    _blob_test_verify(db, n, 1);
+    TEST_CHK(!_blob_test_file_exists("./func_test1"));
+    TEST_CHK(_blob_test_file_exists("./func_test1.blob"));
+    TEST_CHK(!_blob_test_file_exists("./func_test2.blob"));
+
+    // the blob file is now known to be stale by a half, so the next
+    // compaction moves its live bodies, and removes it
+    status = fdb_compact(dbfile, "./func_test3");
+    TEST_STATUS(status);
+    _blob_test_verify(db, n, 1);
+    TEST_CHK(!_blob_test_file_exists("./func_test1.blob"));
+    TEST_CHK(_blob_test_file_exists("./func_test3.blob"));
+    fdb_close(dbfile);
+
+    status = fdb_open(&dbfile, "./func_test3", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[1], "kvs", &kvs_config);
+    TEST_STATUS(status);
+    _blob_test_verify(db, n, 1);
+    fdb_close(dbfile);
+
+    // destroying the file removes its blob file too
+    status = fdb_destroy("./func_test3", &fconfig);
+    TEST_STATUS(status);
+    TEST_CHK(!_blob_test_file_exists("./func_test3.blob"));
+
+    // bodies committed without flushing the WAL are read after the WAL
+    // is restored on reopening
+    status = fdb_open(&dbfile, "./func_test4", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[1], "kvs", &kvs_config);
+    TEST_STATUS(status);
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%d", i);
+            len = _blob_test_body(bodybuf, i, 0);
+            status = fdb_set_kv(db[j], keybuf, strlen(keybuf) + 1,
+                                bodybuf, len);
+            TEST_STATUS(status);
+        }
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_STATUS(status);
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    status = fdb_open(&dbfile, "./func_test4", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config);
+    TEST_STATUS(status);
+    status = fdb_kvs_open(dbfile, &db[1], "kvs", &kvs_config);
+    TEST_STATUS(status);
+    _blob_test_verify(db, n, 0);
+    fdb_close(dbfile);
+    status = fdb_destroy("./func_test4", &fconfig);
+    TEST_STATUS(status);
+
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("blob file test");
+}
+
+void direct_io_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, c, r;
+    int n = 500;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc;
+    fdb_status status;
+    char keybuf[256], metabuf[256], bodybuf[8192];
+    size_t bodylen;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.durability_opt = FDB_DRB_ODIRECT;
+    fconfig.compaction_threshold = 0;
+    fconfig.wal_threshold = 128;
+
+    for (c = 0; c < 2; ++c) {
+        r = system(SHELL_DEL" func_test* > errorlog.txt");
+        (void)r;
+
+        // c == 0: direct I/O without the buffer cache,
+        // c == 1: direct I/O behind the buffer cache
+        fconfig.buffercache_size = c ? 16 * 1024 * 1024 : 0;
+        status = fdb_open(&dbfile, "./func_test1", &fconfig);
+        TEST_STATUS(status);
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_STATUS(status);
+
+        // documents of various sizes, some of which straddle blocks
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%d", i);
+            sprintf(metabuf, "meta%d", i);
+            bodylen = 1 + (i * 37) % sizeof(bodybuf);
+            memset(bodybuf, 'a' + i % 26, bodylen);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf),
+                           metabuf, strlen(metabuf), bodybuf, bodylen);
+            status = fdb_set(db, doc);
+            TEST_STATUS(status);
+            fdb_doc_free(doc);
+            if (i % 100 == 99) {
+                status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+                TEST_STATUS(status);
+            }
+        }
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_STATUS(status);
+        fdb_close(dbfile);
+
+        // verify after reopening, and after compaction
+        status = fdb_open(&dbfile, "./func_test1", &fconfig);
+        TEST_STATUS(status);
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_STATUS(status);
+        for (r = 0; r < 2; ++r) {
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%d", i);
+                sprintf(metabuf, "meta%d", i);
+                bodylen = 1 + (i * 37) % sizeof(bodybuf);
+                memset(bodybuf, 'a' + i % 26, bodylen);
+                fdb_doc_create(&doc, keybuf, strlen(keybuf),
+                               NULL, 0, NULL, 0);
+                status = fdb_get(db, doc);
+                TEST_STATUS(status);
+                TEST_CMP(doc->meta, metabuf, doc->metalen);
+                TEST_CHK(doc->bodylen == bodylen);
+                TEST_CMP(doc->body, bodybuf, bodylen);
+                fdb_doc_free(doc);
+            }
+            if (r == 0) {
+                status = fdb_compact(dbfile, "./func_test2");
+                TEST_STATUS(status);
+            }
+        }
+        fdb_close(dbfile);
+        // the buffer cache is configured at initialization
+        fdb_shutdown();
+    }
+
+    memleak_end();
+    TEST_RESULT("direct I/O test");
+}
+
+struct pipelined_append_args {
+    int tid;
+    int ndocs;
+    bool small;
+    fdb_config *config;
+};
+
+static size_t _pipelined_append_bodylen(int tid, int i, bool small)
+{
+    if (small) {
+        // small documents, many of which share a sector
+        return 1 + ((tid + 1) * 7919 + i * 131) % 200;
+    }
+    // documents of various sizes, some of which span multiple blocks
+    return 1 + ((tid + 1) * 7919 + i * 131) % 20000;
+}
+
+static void *_pipelined_append_writer(void *voidargs)
+{
+    TEST_INIT();
+
+    struct pipelined_append_args *args =
+        (struct pipelined_append_args *)voidargs;
+    int i;
+    char keybuf[256], metabuf[256];
+    char *bodybuf = (char *)malloc(20000);
+    size_t bodylen;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+
+    status = fdb_open(&dbfile, "./func_test1", args->config);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+
+    for (i = 0; i < args->ndocs; ++i) {
+        sprintf(keybuf, "t%d_key%d", args->tid, i);
+        sprintf(metabuf, "meta%d", i);
+        bodylen = _pipelined_append_bodylen(args->tid, i, args->small);
+        memset(bodybuf, 'a' + (args->tid + i) % 26, bodylen);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf),
+                       metabuf, strlen(metabuf), bodybuf, bodylen);
+        status = fdb_set(db, doc);
+        TEST_STATUS(status);
+        fdb_doc_free(doc);
+
+        // read back the doc, which may share the WAL with docs being
+        // written by other threads
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, rdoc);
+        TEST_STATUS(status);
+        TEST_CHK(rdoc->bodylen == bodylen);
+        TEST_CMP(rdoc->body, bodybuf, bodylen);
+        fdb_doc_free(rdoc);
+
+        if (i % 50 == 49) {
+            status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+            TEST_STATUS(status);
+        }
+    }
+
+    fdb_close(dbfile);
+    free(bodybuf);
+    thread_exit(0);
+    return NULL;
+}
+
+void pipelined_doc_append_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, t, c, r;
+    int n = 200;
+    int nthreads = 4;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc;
+    fdb_status status;
+    char keybuf[256], metabuf[256];
+    char *bodybuf = (char *)malloc(20000);
+    size_t bodylen;
+    thread_t *tid = alca(thread_t, nthreads);
+    void **thread_ret = alca(void *, nthreads);
+    struct pipelined_append_args *args =
+        alca(struct pipelined_append_args, nthreads);
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.pipelined_doc_append = true;
+    fconfig.compaction_threshold = 0;
+    fconfig.wal_threshold = 256;
+
+    for (c = 0; c < 3; ++c) {
+        r = system(SHELL_DEL" func_test* > errorlog.txt");
+        (void)r;
+
+        // c == 0: without the buffer cache,
+        // c == 1: with the buffer cache and compressed bodies,
+        // c == 2: direct I/O without the buffer cache, with small docs
+        //         written concurrently into the same sectors
+        fconfig.buffercache_size = (c == 1) ? 16 * 1024 * 1024 : 0;
+        fconfig.compress_document_body = (c == 1);
+        fconfig.durability_opt = (c == 2) ? FDB_DRB_ODIRECT : FDB_DRB_NONE;
+
+        status = fdb_open(&dbfile, "./func_test1", &fconfig);
+        TEST_STATUS(status);
+
+        for (t = 0; t < nthreads; ++t) {
+            args[t].tid = t;
+            args[t].ndocs = n;
+            args[t].small = (c == 2);
+            args[t].config = &fconfig;
+            thread_create(&tid[t], _pipelined_append_writer, &args[t]);
+        }
+        for (t = 0; t < nthreads; ++t) {
+            thread_join(tid[t], &thread_ret[t]);
+        }
+
+        status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+        TEST_STATUS(status);
+        fdb_close(dbfile);
+
+        // verify after reopening, and after compaction
+        status = fdb_open(&dbfile, "./func_test1", &fconfig);
+        TEST_STATUS(status);
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_STATUS(status);
+        for (r = 0; r < 2; ++r) {
+            for (t = 0; t < nthreads; ++t) {
+                for (i = 0; i < n; ++i) {
+                    sprintf(keybuf, "t%d_key%d", t, i);
+                    sprintf(metabuf, "meta%d", i);
+                    bodylen = _pipelined_append_bodylen(t, i, c == 2);
+                    memset(bodybuf, 'a' + (t + i) % 26, bodylen);
+                    fdb_doc_create(&doc, keybuf, strlen(keybuf),
+                                   NULL, 0, NULL, 0);
+                    status = fdb_get(db, doc);
+                    TEST_STATUS(status);
+                    TEST_CMP(doc->meta, metabuf, doc->metalen);
+                    TEST_CHK(doc->bodylen == bodylen);
+                    TEST_CMP(doc->body, bodybuf, bodylen);
+                    fdb_doc_free(doc);
+                }
+            }
+            if (r == 0) {
+                status = fdb_compact(dbfile, "./func_test2");
+                TEST_STATUS(status);
+            }
+        }
+        fdb_close(dbfile);
+        // the buffer cache is configured at initialization
+        fdb_shutdown();
+    }
+    free(bodybuf);
+
+    memleak_end();
+    TEST_RESULT("pipelined document append test");
+}
+
+void separate_doc_bodies_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, f, r;
+    int n = 1000;
+    uint64_t file_size[2];
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_iterator *iterator;
+    fdb_doc *doc;
+    fdb_file_info info;
+    fdb_status status;
+    char filename[256], keybuf[256], metabuf[256], bodybuf[1024];
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.compaction_threshold = 0;
+
+    for (f = 0; f < 2; ++f) {
+        // file 0: bodies stored next to keys and metadata,
+        // file 1: bodies separated into the blob file
+        fconfig.separate_doc_bodies = (f == 1);
+        sprintf(filename, "./func_test%d", f);
+        status = fdb_open(&dbfile, filename, &fconfig);
+        TEST_STATUS(status);
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_STATUS(status);
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            sprintf(metabuf, "meta%06d", i);
+            memset(bodybuf, 'a' + i % 26, sizeof(bodybuf));
+            sprintf(bodybuf, "body%06d", i);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf),
+                           metabuf, strlen(metabuf),
+                           bodybuf, sizeof(bodybuf));
+            status = fdb_set(db, doc);
+            TEST_STATUS(status);
+            fdb_doc_free(doc);
+        }
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_STATUS(status);
+        fdb_get_file_info(dbfile, &info);
+        file_size[f] = info.file_size;
+        fdb_close(dbfile);
+    }
+    TEST_CHK(!_blob_test_file_exists("./func_test0.blob"));
+    TEST_CHK(_blob_test_file_exists("./func_test1.blob"));
+    // key and metadata records are packed into far fewer blocks
+    TEST_CHK(file_size[1] * 4 < file_size[0]);
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+
+    // meta-only iteration
+    status = fdb_iterator_init(db, &iterator, NULL, 0, NULL, 0,
+                               FDB_ITR_NONE);
+    TEST_STATUS(status);
+    i = 0;
+    doc = NULL;
+    do {
+        status = fdb_iterator_get_metaonly(iterator, &doc);
+        TEST_STATUS(status);
+        sprintf(keybuf, "key%06d", i);
+        sprintf(metabuf, "meta%06d", i);
+        TEST_CMP(doc->key, keybuf, doc->keylen);
+        TEST_CMP(doc->meta, metabuf, doc->metalen);
+        TEST_CHK(doc->bodylen == sizeof(bodybuf));
+        TEST_CHK(doc->body == NULL);
+        fdb_doc_free(doc);
+        doc = NULL;
+        ++i;
+    } while (fdb_iterator_next(iterator) == FDB_RESULT_SUCCESS);
+    TEST_CHK(i == n);
+    fdb_iterator_close(iterator);
+
+    // meta-only and full point reads
+    for (i = 0; i < n; i += 7) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(metabuf, "meta%06d", i);
+        memset(bodybuf, 'a' + i % 26, sizeof(bodybuf));
+        sprintf(bodybuf, "body%06d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get_metaonly(db, doc);
+        TEST_STATUS(status);
+        TEST_CMP(doc->meta, metabuf, doc->metalen);
+        TEST_CHK(doc->bodylen == sizeof(bodybuf));
+        TEST_CHK(doc->body == NULL);
+        status = fdb_get(db, doc);
+        TEST_STATUS(status);
+        TEST_CHK(doc->bodylen == sizeof(bodybuf));
+        TEST_CMP(doc->body, bodybuf, doc->bodylen);
+        fdb_doc_free(doc);
+    }
+
+    // bodies remain separated after compaction
+    status = fdb_compact(dbfile, "./func_test2");
+    TEST_STATUS(status);
+    for (i = 0; i < n; i += 7) {
+        sprintf(keybuf, "key%06d", i);
+        memset(bodybuf, 'a' + i % 26, sizeof(bodybuf));
+        sprintf(bodybuf, "body%06d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, doc);
+        TEST_STATUS(status);
+        TEST_CMP(doc->body, bodybuf, doc->bodylen);
+        fdb_doc_free(doc);
+    }
+    fdb_get_file_info(dbfile, &info);
+    TEST_CHK(info.file_size * 4 < file_size[0]);
+    fdb_close(dbfile);
+
+    // bodies not longer than their blob reference are not separated
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+    status = fdb_open(&dbfile, "./func_test3", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+    fdb_doc_create(&doc, "key", 3, NULL, 0, "body", 4);
+    status = fdb_set(db, doc);
+    TEST_STATUS(status);
+    fdb_doc_free(doc);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_STATUS(status);
+    TEST_CHK(!_blob_test_file_exists("./func_test3.blob"));
+    fdb_close(dbfile);
+
+    // options that would silently change the separation are rejected
+    fconfig.blob_threshold = 1024;
+    status = fdb_open(&dbfile, "./func_test3", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+    fconfig.blob_threshold = 0;
+    fconfig.compress_document_body = true;
+    status = fdb_open(&dbfile, "./func_test3", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+    fconfig.compress_document_body = false;
+    fconfig.encryption_key.algorithm = FDB_ENCRYPTION_AES256;
+    status = fdb_open(&dbfile, "./func_test3", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("separate document bodies test");
+}
+
+void index_region_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, f, r;
+    int n = 5000;
+    int runs[2];
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc;
+    fdb_status status;
+    char filename[256], keybuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+    fconfig.block_reusing_threshold = 0;
+
+    for (f = 0; f < 2; ++f) {
+        // file 0: index nodes interleaved with documents,
+        // file 1: index nodes in dedicated regions
+        fconfig.index_region_blocks = f ? 256 : 0;
+        sprintf(filename, "./func_test%d", f);
+        status = fdb_open(&dbfile, filename, &fconfig);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+        // insert and then update all docs in scattered key order,
+        // committing every 100 docs
+        for (j = 0; j < 2; ++j) {
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%06d", (i * 7919) % n);
+                sprintf(bodybuf, "body%06d_%d", (i * 7919) % n, j);
+                fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                               bodybuf, strlen(bodybuf));
+                status = fdb_set(db, doc);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                fdb_doc_free(doc);
+                if (i % 100 == 99) {
+                    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+                    TEST_CHK(status == FDB_RESULT_SUCCESS);
+                }
+            }
+        }
+        fdb_close(dbfile);
+        runs[f] = count_index_block_runs(filename, fconfig.blocksize);
+
+        // verify all docs after reopening, and after compaction
+        for (j = 0; j < 2; ++j) {
+            status = fdb_open(&dbfile, filename, &fconfig);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%06d", i);
+                sprintf(bodybuf, "body%06d_1", i);
+                fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+                status = fdb_get(db, doc);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CMP(doc->body, bodybuf, doc->bodylen);
+                fdb_doc_free(doc);
+            }
+            if (j == 0) {
+                sprintf(filename, "./func_test%d_compact", f);
+                status = fdb_compact(dbfile, filename);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+            }
+            fdb_close(dbfile);
+        }
+    }
+    fdb_shutdown();
+
+    // index nodes written over many commits are packed into a few regions
+    TEST_CHK(runs[1] * 4 < runs[0]);
+
+    memleak_end();
+    TEST_RESULT("index region test");
+}
+
+static bool doc_view_body_cmp(fdb_doc_view *view, const char *body,
+                              size_t bodylen)
+{
+    size_t i, pos = 0;
+    if (view->bodylen != bodylen) {
+        return false;
+    }
+    for (i = 0; i < view->num_segments; ++i) {
+        if (pos + view->segments[i].len > bodylen ||
+            memcmp(view->segments[i].buf, body + pos, view->segments[i].len)) {
+            return false;
+        }
+        pos += view->segments[i].len;
+    }
+    return pos == bodylen;
+}
+
+void doc_view_test(bool multi_kv)
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 300;
+    size_t bodylen;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_iterator *iterator;
+    fdb_doc *doc;
+    fdb_doc_view *view;
+    fdb_status status;
+    char keybuf[256], metabuf[256], cmpbuf[256];
+    char *bodybuf = (char *)malloc(16384);
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+    fconfig.multi_kv_instances = multi_kv;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    if (multi_kv) {
+        status = fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+    } else {
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    }
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // bodies from a few bytes up to several blocks
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(metabuf, "meta%06d", i);
+        bodylen = (i * 997) % 12000 + 1;
+        memset(bodybuf, 'a' + i % 26, bodylen);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf, strlen(metabuf),
+                       bodybuf, bodylen);
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+        if (i == n / 2) {
+            // the first half is read from the main index,
+            // and the rest from WAL
+            fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        }
+    }
+    fdb_doc_create(&doc, "key000003", 9, NULL, 0, NULL, 0);
+    status = fdb_del(db, doc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_doc_free(doc);
+
+    status = fdb_doc_view_create(&view);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (r = 0; r < 2; ++r) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            status = fdb_get_view(db, keybuf, strlen(keybuf), view);
+            if (i == 3) {
+                TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+                continue;
+            }
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CHK(view->keylen == strlen(keybuf));
+            TEST_CMP(view->key, keybuf, view->keylen);
+            sprintf(metabuf, "meta%06d", i);
+            TEST_CHK(view->metalen == strlen(metabuf));
+            TEST_CMP(view->meta, metabuf, view->metalen);
+            TEST_CHK(view->seqnum == (fdb_seqnum_t)i + 1);
+            bodylen = (i * 997) % 12000 + 1;
+            memset(bodybuf, 'a' + i % 26, bodylen);
+            TEST_CHK(doc_view_body_cmp(view, bodybuf, bodylen));
+            if (bodylen > fconfig.blocksize) {
+                TEST_CHK(view->num_segments > 1);
+            }
+
+            // should point to the same doc as fdb_get
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CHK(doc->offset == view->offset);
+            TEST_CHK(doc->size_ondisk == view->size_ondisk);
+            fdb_doc_free(doc);
+        }
+        status = fdb_get_view(db, "non_existing_key", 16, view);
+        TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+
+        // iterate over all docs using the same view
+        status = fdb_iterator_init(db, &iterator, NULL, 0, NULL, 0,
+                                   FDB_ITR_NO_DELETES);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        i = 0;
+        do {
+            if (i == 3) {
+                ++i;
+            }
+            status = fdb_iterator_get_view(iterator, view);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            sprintf(keybuf, "key%06d", i);
+            TEST_CHK(view->keylen == strlen(keybuf));
+            TEST_CMP(view->key, keybuf, view->keylen);
+            sprintf(cmpbuf, "meta%06d", i);
+            TEST_CMP(view->meta, cmpbuf, view->metalen);
+            bodylen = (i * 997) % 12000 + 1;
+            memset(bodybuf, 'a' + i % 26, bodylen);
+            TEST_CHK(doc_view_body_cmp(view, bodybuf, bodylen));
+            ++i;
+        } while (fdb_iterator_next(iterator) == FDB_RESULT_SUCCESS);
+        TEST_CHK(i == n);
+        fdb_iterator_close(iterator);
+
+        if (r == 0) {
+            fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        }
+    }
+
+    fdb_doc_view_free(view);
+    fdb_close(dbfile);
+    fdb_shutdown();
+    free(bodybuf);
+
+    memleak_end();
+
+    sprintf(keybuf, "zero-copy doc view test %s", multi_kv ?
+            "multiple kv instances" : "single kv instance");
+    TEST_RESULT(keybuf);
+}
+
 void open_multi_files_kvs_test()
 {
     TEST_INIT();
@@ -5578,6 +6786,17 @@ int main() {
     multi_thread_fhandle_share(NULL);
     operational_stats_test(false);
     operational_stats_test(true);
+    bloom_filter_test(false);
+    bloom_filter_test(true);
+    index_region_test();
+    legacy_crc_test();
+    doc_compression_codec_test();
+    blob_file_test();
+    separate_doc_bodies_test();
+    direct_io_test();
+    pipelined_doc_append_test();
+    doc_view_test(false);
+    doc_view_test(true);
     open_multi_files_kvs_test();
     rekey_test();
     invalid_get_byoffset_test();
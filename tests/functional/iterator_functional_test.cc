@@ -4271,6 +4271,274 @@ void iterator_seek_to_min_key_with_deletes_test() {
 
     TEST_RESULT("iterator seek to max test");
 }
+static void readahead_stats_callback(fdb_kvs_handle *handle, const char *stat,
+                                     uint64_t value, void *ctx)
+{
+    (void)handle;
+    if (!strcmp(stat, "Block_cache_misses")) {
+        *(uint64_t*)ctx = value;
+    }
+}
+
+static uint64_t readahead_scan(fdb_file_handle **dbfile, fdb_kvs_handle **db,
+                               fdb_config *fconfig, fdb_iterator_opt_t opt,
+                               bool seq_itr, int n)
+{
+    TEST_INIT();
+    int i;
+    uint64_t misses = 0;
+    char keybuf[256], bodybuf[1024];
+    fdb_doc *rdoc = NULL;
+    fdb_iterator *it;
+    fdb_status status;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+
+    // reopen the file to start from the cold block cache
+    fdb_kvs_close(*db);
+    fdb_close(*dbfile);
+    status = fdb_open(dbfile, "./iterator_test1", fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(*dbfile, db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    if (seq_itr) {
+        status = fdb_iterator_sequence_init(*db, &it, 0, 0, opt);
+    } else {
+        status = fdb_iterator_init(*db, &it, NULL, 0, NULL, 0, opt);
+    }
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    i = 0;
+    do {
+        status = fdb_iterator_get(it, &rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%06d", i);
+        TEST_CMP(rdoc->key, keybuf, rdoc->keylen);
+        TEST_CHK(rdoc->bodylen == 512);
+        TEST_CMP(rdoc->body, bodybuf, strlen(bodybuf));
+        fdb_doc_free(rdoc);
+        rdoc = NULL;
+        i++;
+    } while (fdb_iterator_next(it) != FDB_RESULT_ITERATOR_FAIL);
+    TEST_CHK(i == n);
+    fdb_iterator_close(it);
+
+    status = fdb_fetch_handle_stats(*db, readahead_stats_callback, &misses);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    return misses;
+}
+
+void iterator_readahead_test()
+{
+    TEST_INIT();
+    memleak_start();
+    int i, r, n = 4000;
+    uint64_t misses, misses_ra;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    char keybuf[256], bodybuf[1024];
+    fdb_status status;
+
+    r = system(SHELL_DEL" iterator_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 16 * 1024 * 1024;
+    fconfig.seqtree_opt = FDB_SEQTREE_USE;
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+
+    fdb_open(&dbfile, "./iterator_test1", &fconfig);
+    fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+
+    // docs are written in key order
+    memset(bodybuf, 'x', 512);
+    for (i=0;i<n;++i){
+        sprintf(keybuf, "key%06d", i);
+        r = sprintf(bodybuf, "body%06d", i);
+        bodybuf[r] = 'x';
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), bodybuf, 512);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    misses = readahead_scan(&dbfile, &db, &fconfig, FDB_ITR_NONE,
+                            false, n);
+    misses_ra = readahead_scan(&dbfile, &db, &fconfig, FDB_ITR_READAHEAD,
+                               false, n);
+    // most of doc blocks should have been read ahead into the cache
+    TEST_CHK(misses_ra < misses / 2);
+
+    misses_ra = readahead_scan(&dbfile, &db, &fconfig,
+                               FDB_ITR_READAHEAD | FDB_ITR_READAHEAD_DEPTH(2),
+                               false, n);
+    TEST_CHK(misses_ra < misses / 2);
+
+    misses = readahead_scan(&dbfile, &db, &fconfig, FDB_ITR_NONE,
+                            true, n);
+    misses_ra = readahead_scan(&dbfile, &db, &fconfig,
+                               FDB_ITR_READAHEAD | FDB_ITR_NO_DELETES,
+                               true, n);
+    TEST_CHK(misses_ra < misses / 2);
+
+    fdb_kvs_close(db);
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("iterator readahead test");
+}
+
+static int split_range_scan(fdb_kvs_handle *db, fdb_iterator_range *range,
+                            int expected_first)
+{
+    TEST_INIT();
+    int count = 0;
+    char keybuf[256];
+    fdb_doc *rdoc = NULL;
+    fdb_iterator *it;
+    fdb_status status;
+
+    status = fdb_iterator_init(db, &it, range->min_key, range->min_keylen,
+                               range->max_key, range->max_keylen,
+                               range->opt | FDB_ITR_NO_DELETES);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    do {
+        status = fdb_iterator_get(it, &rdoc);
+        if (status != FDB_RESULT_SUCCESS) {
+            break;
+        }
+        // keys should be returned in order, without any gap or overlap
+        sprintf(keybuf, "key%06d", expected_first + count);
+        TEST_CHK(rdoc->keylen == strlen(keybuf));
+        TEST_CMP(rdoc->key, keybuf, rdoc->keylen);
+        fdb_doc_free(rdoc);
+        rdoc = NULL;
+        count++;
+    } while (fdb_iterator_next(it) != FDB_RESULT_ITERATOR_FAIL);
+    fdb_iterator_close(it);
+
+    return count;
+}
+
+void iterator_split_test(bool multi_kv)
+{
+    TEST_INIT();
+    memleak_start();
+    int i, r, n = 20000, count, total;
+    size_t j;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db, *db_other, *snap;
+    fdb_iterator_range_list range_list;
+    char keybuf[256], bodybuf[256], minbuf[256], maxbuf[256];
+    fdb_status status;
+
+    r = system(SHELL_DEL" iterator_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.compaction_threshold = 0;
+
+    fdb_open(&dbfile, "./iterator_test1", &fconfig);
+    if (multi_kv) {
+        fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+        fdb_kvs_open(dbfile, &db_other, "kv2", &kvs_config);
+    } else {
+        fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        db_other = NULL;
+    }
+
+    // empty KV store: a single range covering everything
+    status = fdb_iterator_split(db, NULL, 0, NULL, 0, 4, &range_list);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(range_list.num_ranges == 1);
+    TEST_CHK(range_list.ranges[0].min_key == NULL);
+    TEST_CHK(range_list.ranges[0].max_key == NULL);
+    fdb_free_iterator_range_list(&range_list);
+
+    for (i=0;i<n;++i){
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%06d", i);
+        fdb_set_kv(db, keybuf, strlen(keybuf), bodybuf, strlen(bodybuf));
+        if (db_other) {
+            fdb_set_kv(db_other, keybuf, strlen(keybuf),
+                       bodybuf, strlen(bodybuf));
+        }
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    status = fdb_snapshot_open(db, &snap, FDB_SNAPSHOT_INMEM);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // entire key range
+    status = fdb_iterator_split(snap, NULL, 0, NULL, 0, 4, &range_list);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(range_list.num_ranges == 4);
+    TEST_CHK(range_list.ranges[0].min_key == NULL);
+    TEST_CHK(range_list.ranges[3].max_key == NULL);
+    total = 0;
+    for (j=0;j<range_list.num_ranges;++j){
+        count = split_range_scan(snap, &range_list.ranges[j], total);
+        // ranges should be roughly balanced
+        TEST_CHK(count > n / 4 / 2);
+        TEST_CHK(count < n / 4 * 2);
+        total += count;
+    }
+    TEST_CHK(total == n);
+    fdb_free_iterator_range_list(&range_list);
+
+    // partial key range
+    sprintf(minbuf, "key%06d", 5000);
+    sprintf(maxbuf, "key%06d", 9999);
+    status = fdb_iterator_split(snap, minbuf, strlen(minbuf),
+                                maxbuf, strlen(maxbuf), 3, &range_list);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(range_list.num_ranges == 3);
+    TEST_CMP(range_list.ranges[0].min_key, minbuf, strlen(minbuf));
+    TEST_CMP(range_list.ranges[2].max_key, maxbuf, strlen(maxbuf));
+    TEST_CHK(range_list.ranges[2].opt == FDB_ITR_NONE);
+    total = 0;
+    for (j=0;j<range_list.num_ranges;++j){
+        count = split_range_scan(snap, &range_list.ranges[j], 5000 + total);
+        TEST_CHK(count > 5000 / 3 / 2);
+        total += count;
+    }
+    TEST_CHK(total == 5000);
+    fdb_free_iterator_range_list(&range_list);
+
+    // too narrow range: fewer ranges than requested
+    sprintf(minbuf, "key%06d", 100);
+    sprintf(maxbuf, "key%06d", 101);
+    status = fdb_iterator_split(snap, minbuf, strlen(minbuf),
+                                maxbuf, strlen(maxbuf), 8, &range_list);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(range_list.num_ranges >= 1 && range_list.num_ranges <= 2);
+    total = 0;
+    for (j=0;j<range_list.num_ranges;++j){
+        total += split_range_scan(snap, &range_list.ranges[j], 100 + total);
+    }
+    TEST_CHK(total == 2);
+    fdb_free_iterator_range_list(&range_list);
+
+    fdb_kvs_close(snap);
+    fdb_kvs_close(db);
+    if (db_other) {
+        fdb_kvs_close(db_other);
+    }
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    memleak_end();
+    sprintf(bodybuf, "iterator split test %s", multi_kv ? "multi kv" : "single kv");
+    TEST_RESULT(bodybuf);
+}
+
 int main(){
     iterator_test();
     iterator_with_concurrent_updates_test();
@@ -4306,5 +4574,8 @@ int main(){
     iterator_init_using_substring_test();
     iterator_seek_to_max_key_with_deletes_test();
     iterator_seek_to_min_key_with_deletes_test();
+    iterator_readahead_test();
+    iterator_split_test(false);
+    iterator_split_test(true);
     return 0;
 }
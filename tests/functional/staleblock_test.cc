@@ -20,12 +20,15 @@
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
+#include <atomic>
 
 #include "test.h"
 #include "filemgr.h"
 #include "staleblock.h"
 #include "internal_types.h"
 #include "kvs_handle.h"
+#include "executorpool.h"
+#include "globaltask.h"
 #include "libforestdb/forestdb.h"
 #include "functional_util.h"
 
@@ -1777,6 +1780,254 @@ void reclaim_rollback_point_test() {
     TEST_RESULT("reclaim rollback point test");
 }
 
+static uint64_t _stale_merge_workload(bool background_merge) {
+    TEST_INIT();
+
+    int i, j, r;
+    int ndocs = 2000;
+    int nrounds = 40;
+    char keybuf[64];
+    char bodybuf[512];
+
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_status status;
+    fdb_file_info file_info;
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+
+    void *value_out;
+    size_t valuelen_out;
+
+    r = system(SHELL_DEL" staleblktest* > errorlog.txt");
+    (void)r;
+
+    fconfig.compaction_threshold = 0;
+    fconfig.block_reusing_threshold = 65;
+    fconfig.num_keeping_headers = 2;
+    fconfig.background_stale_merge = background_merge;
+
+    status = fdb_open(&dbfile, "./staleblktest1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+
+    // overwrite all docs repeatedly so that blocks are reclaimed many times
+    for (j = 0; j < nrounds; ++j) {
+        for (i = 0; i < ndocs; ++i) {
+            sprintf(keybuf, "key%d", i);
+            sprintf(bodybuf, "body%d_%d", i, j);
+            fillstr(bodybuf + strlen(bodybuf), 'v', 256);
+            status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf));
+            TEST_STATUS(status);
+        }
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_STATUS(status);
+    }
+    TEST_CHK(db->file->getSb()->bmpExists());
+
+    // verify the latest docs
+    for (i = 0; i < ndocs; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d_%d", i, nrounds - 1);
+        status = fdb_get_kv(db, keybuf, strlen(keybuf),
+                            &value_out, &valuelen_out);
+        TEST_STATUS(status);
+        TEST_CMP(value_out, bodybuf, strlen(bodybuf));
+        free(value_out);
+    }
+
+    status = fdb_get_file_info(dbfile, &file_info);
+    TEST_STATUS(status);
+
+    status = fdb_kvs_close(db);
+    TEST_STATUS(status);
+    status = fdb_close(dbfile);
+    TEST_STATUS(status);
+
+    // verify again after reopen
+    status = fdb_open(&dbfile, "./staleblktest1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+    for (i = 0; i < ndocs; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d_%d", i, nrounds - 1);
+        status = fdb_get_kv(db, keybuf, strlen(keybuf),
+                            &value_out, &valuelen_out);
+        TEST_STATUS(status);
+        TEST_CMP(value_out, bodybuf, strlen(bodybuf));
+        free(value_out);
+    }
+    status = fdb_kvs_close(db);
+    TEST_STATUS(status);
+    status = fdb_close(dbfile);
+    TEST_STATUS(status);
+    status = fdb_shutdown();
+    TEST_STATUS(status);
+
+    return file_info.file_size;
+}
+
+void background_stale_merge_test() {
+    TEST_INIT();
+    memleak_start();
+
+    uint64_t size_fg, size_bg;
+
+    // decoding stale info in advance should not change which blocks are
+    // reclaimed, thus the file should grow exactly the same.
+    size_fg = _stale_merge_workload(false);
+    size_bg = _stale_merge_workload(true);
+    TEST_CHK(size_bg == size_fg);
+
+    memleak_end();
+    TEST_RESULT("background stale merge test");
+}
+
+// Taskable owning the task that occupies the non-IO thread of the pool
+class StallerTaskable : public Taskable {
+public:
+    StallerTaskable() : name("staller"), workloadPolicy(1, 1) { }
+    const std::string& getName() const { return name; }
+    task_gid_t getGID() const { return task_gid_t(this); }
+    bucket_priority_t getWorkloadPriority() const {
+        return LOW_BUCKET_PRIORITY;
+    }
+    void setWorkloadPriority(bucket_priority_t prio) { }
+    WorkLoadPolicy& getWorkLoadPolicy() { return workloadPolicy; }
+    void logQTime(type_id_t id, hrtime_t enqTime) { }
+    void logRunTime(type_id_t id, hrtime_t runTime) { }
+
+private:
+    std::string name;
+    WorkLoadPolicy workloadPolicy;
+};
+
+// Task that keeps the non-IO thread busy until it is released, so that
+// stale info decoding stays queued in the meantime.
+class StallerTask : public GlobalTask {
+public:
+    StallerTask(Taskable &t, std::atomic<bool> &_running,
+                std::atomic<bool> &_release)
+        : GlobalTask(t, Priority::StaleDecoderPriority),
+          running(_running), release(_release) { }
+
+    bool run() {
+        running = true;
+        while (!release) {
+            usleep(1000);
+        }
+        return false;
+    }
+
+    std::string getDescription() {
+        return std::string("Stall the non-IO thread");
+    }
+
+private:
+    std::atomic<bool> &running;
+    std::atomic<bool> &release;
+};
+
+void reclaim_with_queued_decode_test() {
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r;
+    int ndocs = 2000;
+    int nrounds = 40;
+    char keybuf[64];
+    char bodybuf[512];
+
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_status status;
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    StallerTaskable staller;
+    std::atomic<bool> staller_running(false);
+    std::atomic<bool> staller_release(false);
+
+    void *value_out;
+    size_t valuelen_out;
+
+    r = system(SHELL_DEL" staleblktest* > errorlog.txt");
+    (void)r;
+
+    fconfig.compaction_threshold = 0;
+    fconfig.block_reusing_threshold = 65;
+    fconfig.num_keeping_headers = 2;
+    fconfig.background_stale_merge = true;
+    // a single non-IO thread
+    fconfig.num_background_threads = 1;
+
+    status = fdb_open(&dbfile, "./staleblktest1", &fconfig);
+    TEST_STATUS(status);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_STATUS(status);
+
+    ExecutorPool::get()->registerTaskable(staller);
+    ExTask task = new StallerTask(staller, staller_running, staller_release);
+    ExecutorPool::get()->schedule(task, NONIO_TASK_IDX);
+    while (!staller_running) {
+        usleep(1000);
+    }
+
+    // blocks are reclaimed while all stale info is still queued for decoding
+    for (j = 0; j < nrounds; ++j) {
+        for (i = 0; i < ndocs; ++i) {
+            sprintf(keybuf, "key%d", i);
+            sprintf(bodybuf, "body%d_%d", i, j);
+            fillstr(bodybuf + strlen(bodybuf), 'v', 256);
+            status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf));
+            TEST_STATUS(status);
+        }
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_STATUS(status);
+    }
+    TEST_CHK(db->file->getSb()->bmpExists());
+
+    // let the queued entries be decoded, including the consumed ones
+    staller_release = true;
+    ExecutorPool::get()->unregisterTaskable(staller, false);
+
+    // and reclaim again with the decoded ones
+    for (j = nrounds; j < nrounds * 2; ++j) {
+        for (i = 0; i < ndocs; ++i) {
+            sprintf(keybuf, "key%d", i);
+            sprintf(bodybuf, "body%d_%d", i, j);
+            status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf));
+            TEST_STATUS(status);
+        }
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_STATUS(status);
+    }
+
+    for (i = 0; i < ndocs; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d_%d", i, nrounds * 2 - 1);
+        status = fdb_get_kv(db, keybuf, strlen(keybuf),
+                            &value_out, &valuelen_out);
+        TEST_STATUS(status);
+        TEST_CMP(value_out, bodybuf, strlen(bodybuf));
+        free(value_out);
+    }
+
+    status = fdb_kvs_close(db);
+    TEST_STATUS(status);
+    status = fdb_close(dbfile);
+    TEST_STATUS(status);
+    status = fdb_shutdown();
+    TEST_STATUS(status);
+
+    memleak_end();
+    TEST_RESULT("reclaim with queued decode test");
+}
+
 int main() {
     /* Test if basic stale block re-use is functional */
     verify_stale_block_reuse_test();
@@ -1823,5 +2074,9 @@ int main() {
 
     reclaim_rollback_point_test();
 
+    /* Test block reuse with stale info decoded in the background */
+    background_stale_merge_test();
+    reclaim_with_queued_decode_test();
+
     return 0;
 }
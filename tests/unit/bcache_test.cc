@@ -106,6 +106,51 @@ void basic_test2()
 
 }
 
+void is_cached_test()
+{
+    TEST_INIT();
+
+    FileMgr *file;
+    FileMgrConfig config(4096, 5, 1048576, 0x0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8, 0, FDB_ENCRYPTION_NONE,
+                         0x00, 0, 0);
+    int i;
+    uint8_t buf[4096];
+    std::string fname("./bcache_testfile");
+    int r;
+    r = system(SHELL_DEL " bcache_testfile");
+    (void)r;
+
+    filemgr_open_result result = FileMgr::open(fname, get_filemgr_ops(),
+                                               &config, NULL);
+    file = result.file;
+    BlockCacheManager *bcache = BlockCacheManager::getInstance();
+
+    memset(buf, 0x0, sizeof(buf));
+    for (i=0;i<3;++i) {
+        file->alloc_FileMgr(NULL);
+        file->write_FileMgr(i, buf, NULL);
+    }
+    file->commit_FileMgr(true, NULL);
+
+    for (i=0;i<3;++i) {
+        TEST_CHK(bcache->isCached(file, i));
+    }
+    TEST_CHK(!bcache->isCached(file, 3));
+
+    // invalidated blocks are returned to the free list
+    TEST_CHK(bcache->invalidateBlock(file, 1));
+    TEST_CHK(!bcache->isCached(file, 1));
+    TEST_CHK(bcache->isCached(file, 2));
+
+    FileMgr::close(file, true, NULL, NULL);
+    FileMgr::shutdown();
+    r = system(SHELL_DEL " bcache_testfile");
+    (void)r;
+
+    TEST_RESULT("is cached test");
+}
+
 struct worker_args{
     size_t n;
     FileMgr *file;
@@ -247,6 +292,7 @@ void multi_thread_test(int nblocks, int cachesize,
 int main()
 {
     basic_test2();
+    is_cached_test();
 #if !defined(THREAD_SANITIZER)
     /**
      * The following tests will be disabled when the code is run with
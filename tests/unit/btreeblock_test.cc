@@ -308,6 +308,92 @@ void range_test()
     TEST_RESULT("range test");
 }
 
+void sequential_append_test()
+{
+    TEST_INIT();
+
+    int i, r, n = 10000;
+    int blocksize = 4096;
+    FileMgr *file;
+    BTreeBlkHandle *bhandle;
+    BTree *btree;
+    FileMgrConfig fconfig(blocksize, 0, 1048576, 0, 0, FILEMGR_CREATE,
+                          FDB_SEQTREE_NOT_USE, 0, 8, 0, FDB_ENCRYPTION_NONE,
+                          0x00, 0, 0);
+    uint64_t key, value;
+    size_t nodes_full;
+    btree_result br;
+    std::string fname("./btreeblock_testfile");
+
+    r = system(SHELL_DEL" btreeblock_testfile");
+    (void)r;
+
+    filemgr_open_result result = FileMgr::open(fname, get_filemgr_ops(), &fconfig, NULL);
+    file = result.file;
+    bhandle = new BTreeBlkHandle(file, blocksize);
+
+    BTreeKVOps *kv_ops = new FixedKVOps(sizeof(uint64_t),
+                                        sizeof(uint64_t),
+                                        blk_test_cmp64);
+    btree = new BTree(bhandle, kv_ops, blocksize,
+                      sizeof(uint64_t), sizeof(uint64_t), 0x0, NULL);
+
+    // monotonically increasing keys (e.g., sequence numbers)
+    for (i=0;i<n;++i){
+        key = i;
+        value = i*10;
+        btree->insert((void*)&key, (void*)&value);
+        if (i % 1000 == 0) {
+            bhandle->flushBuffer();
+        }
+    }
+    bhandle->flushBuffer();
+
+    // leaf nodes should be (almost) fully packed, instead of half-filled
+    nodes_full = (n * 2 * sizeof(uint64_t)) /
+                 (blocksize - sizeof(struct bnode) - BLK_MARKER_SIZE) + 1;
+    TEST_CHK(bhandle->getNLiveNodes() <= (int64_t)(nodes_full * 11 / 10 + 2));
+
+    // insert keys in the middle of fully packed nodes
+    for (i=1;i<n;i+=100){
+        key = i;
+        value = i*100;
+        br = btree->insert((void*)&key, (void*)&value);
+        TEST_CHK(br == BTREE_RESULT_UPDATE);
+    }
+    for (i=n;i<n*2;i+=2){
+        key = i;
+        value = i*10;
+        btree->insert((void*)&key, (void*)&value);
+    }
+    bhandle->flushBuffer();
+
+    for (i=0;i<n*2;++i){
+        key = i;
+        br = btree->find((void*)&key, (void*)&value);
+        if (i >= n && i % 2) {
+            TEST_CHK(br == BTREE_RESULT_FAIL);
+            continue;
+        }
+        TEST_CHK(br == BTREE_RESULT_SUCCESS);
+        if (i < n && i % 100 == 1) {
+            TEST_CHK(value == (uint64_t)i*100);
+        } else {
+            TEST_CHK(value == (uint64_t)i*10);
+        }
+    }
+
+    delete btree;
+    delete kv_ops;
+    delete bhandle;
+    FileMgr::close(file, true, NULL, NULL);
+    FileMgr::shutdown();
+    r = system(SHELL_DEL" btreeblock_testfile");
+    (void)r;
+
+    TEST_RESULT("sequential append test");
+}
+
 INLINE int is_subblock(bid_t subbid)
 {
     uint8_t flag;
@@ -784,8 +870,12 @@ int main()
     iterator_test();
     two_btree_test();
     range_test();
+    sequential_append_test();
     subblock_test();
     btree_reverse_iterator_test();
 
+    int r = system(SHELL_DEL" btreeblock_testfile");
+    (void)r;
+
     return 0;
 }
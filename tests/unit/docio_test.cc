@@ -115,6 +115,82 @@ void basic_test()
     TEST_RESULT("basic test");
 }
 
+void multi_block_read_test()
+{
+    TEST_INIT();
+
+    int i, r;
+    int blocksize = 128;
+    size_t bodylen = 65536;
+    uint64_t offsets[4];
+    FileMgr *file;
+    char keybuf[256];
+    char metabuf[256];
+    uint8_t *bodybuf = (uint8_t *)malloc(bodylen);
+    struct docio_object doc;
+    FileMgrConfig config(blocksize, 1024, 1048576, 0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8, 0, FDB_ENCRYPTION_NONE,
+                         0x00, 0, 0);
+    std::string fname("./docio_testfile");
+
+    r = system(SHELL_DEL " docio_testfile");
+    (void)r;
+    filemgr_open_result result = FileMgr::open(fname, get_filemgr_ops(),
+                                               &config, NULL);
+    file = result.file;
+    DocioHandle handle(file, false, NULL);
+
+    // large docs spanning hundreds of blocks
+    for (i = 0; i < 4; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(metabuf, "meta%d", i);
+        for (size_t j = 0; j < bodylen; ++j) {
+            bodybuf[j] = (uint8_t)(i + j * 7);
+        }
+        doc.key = (void*)keybuf;
+        doc.length.keylen = strlen(keybuf) + 1;
+        doc.meta = (void*)metabuf;
+        doc.length.metalen = strlen(metabuf) + 1;
+        doc.body = (void*)bodybuf;
+        doc.length.bodylen = bodylen - i * 1000;
+        doc.length.flag = 0;
+        doc.seqnum = i;
+        offsets[i] = handle.appendDoc_Docio(&doc, 0, 0);
+        TEST_CHK(offsets[i] != BLK_NOT_FOUND);
+    }
+
+    // read before and after the commit, where committed blocks are read
+    // using vectored reads
+    for (r = 0; r < 2; ++r) {
+        if (r == 1) {
+            file->commit_FileMgr(true, NULL);
+        }
+        for (i = 0; i < 4; ++i) {
+            struct docio_object rdoc;
+            memset(&rdoc, 0x0, sizeof(rdoc));
+            int64_t _offset = handle.readDoc_Docio(offsets[i], &rdoc, true);
+            TEST_CHK(_offset > 0);
+            sprintf(metabuf, "meta%d", i);
+            TEST_CMP(rdoc.meta, metabuf, rdoc.length.metalen);
+            TEST_CHK(rdoc.length.bodylen == bodylen - i * 1000);
+            for (size_t j = 0; j < rdoc.length.bodylen; ++j) {
+                if (((uint8_t *)rdoc.body)[j] != (uint8_t)(i + j * 7)) {
+                    TEST_CHK(false);
+                    break;
+                }
+            }
+            free(rdoc.key);
+            free(rdoc.meta);
+            free(rdoc.body);
+        }
+    }
+
+    FileMgr::close(file, true, NULL, NULL);
+    free(bodybuf);
+
+    TEST_RESULT("multi-block read test");
+}
+
 int main()
 {
     #ifdef _MEMPOOL
@@ -123,6 +199,7 @@ int main()
 
 
     basic_test();
+    multi_block_read_test();
 
     return 0;
 }
@@ -21,6 +21,7 @@
 
 #include "filemgr.h"
 #include "filemgr_ops.h"
+#include "encryption.h"
 #include "test.h"
 
 void basic_test(fdb_encryption_algorithm_t encryption)
@@ -59,6 +60,96 @@ void basic_test(fdb_encryption_algorithm_t encryption)
     TEST_RESULT(buf);
 }
 
+void aes_encryption_test()
+{
+    TEST_INIT();
+
+    size_t i;
+    size_t blocksize = 4096;
+    unsigned num_blocks = 7;
+    encryptor e, e_lib;
+    fdb_encryption_key key;
+    fdb_status s;
+    uint8_t *plain = (uint8_t *)malloc(blocksize * num_blocks);
+    uint8_t *cipher = (uint8_t *)malloc(blocksize * num_blocks);
+    uint8_t *buf = (uint8_t *)malloc(blocksize * num_blocks);
+
+    // known answer: AES-256-CBC with an ESSIV of block #5
+    static const uint8_t expected[64] = {
+        0x95, 0xcf, 0xe3, 0xa8, 0xd1, 0xbc, 0xc3, 0xa0,
+        0x27, 0x6e, 0xf5, 0x6e, 0xd5, 0x9b, 0x20, 0x44,
+        0xf7, 0xf6, 0x15, 0x40, 0x98, 0x2a, 0xda, 0x87,
+        0x99, 0xce, 0xad, 0xe8, 0xff, 0xac, 0x06, 0x00,
+        0xfa, 0xb6, 0x93, 0x58, 0x98, 0x23, 0x66, 0x71,
+        0x88, 0x94, 0xbc, 0xd3, 0x1e, 0x0d, 0x41, 0x15,
+        0x3a, 0xca, 0xe0, 0x4a, 0x86, 0x83, 0x9b, 0x10,
+        0x96, 0x09, 0xf0, 0xa5, 0xc4, 0xe4, 0x4d, 0xf6};
+
+    key.algorithm = FDB_ENCRYPTION_AES256;
+    for (i = 0; i < sizeof(key.bytes); ++i) {
+        key.bytes[i] = (uint8_t)i;
+    }
+    for (i = 0; i < blocksize * num_blocks; ++i) {
+        plain[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    s = fdb_init_encryptor(&e, &key);
+    if (s != FDB_RESULT_SUCCESS) {
+        // neither AES-NI nor a crypto library is available
+        free(plain);
+        free(cipher);
+        free(buf);
+        TEST_RESULT("AES encryption test (skipped)");
+        return;
+    }
+
+    s = fdb_encrypt_blocks(&e, cipher, plain, 64, 1, 5);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    TEST_CMP(cipher, expected, 64);
+
+    // multiple blocks at once should be the same as one by one
+    s = fdb_encrypt_blocks(&e, cipher, plain, blocksize, num_blocks, 100);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    for (i = 0; i < num_blocks; ++i) {
+        s = fdb_encrypt_blocks(&e, buf + i * blocksize,
+                               plain + i * blocksize, blocksize, 1, 100 + i);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+    }
+    TEST_CMP(buf, cipher, blocksize * num_blocks);
+
+    // the crypto library (if any) produces the same data
+    if (fdb_encryption_ops_aes) {
+        e_lib.ops = fdb_encryption_ops_aes;
+        e_lib.key = key;
+        s = e_lib.ops->setup(&e_lib);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        memcpy(buf, cipher, blocksize * num_blocks);
+        for (i = 0; i < num_blocks; ++i) {
+            s = fdb_decrypt_block(&e_lib, buf + i * blocksize, blocksize,
+                                  100 + i);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+        }
+        TEST_CMP(buf, plain, blocksize * num_blocks);
+    }
+
+    memcpy(buf, cipher, blocksize * num_blocks);
+    s = fdb_decrypt_blocks(&e, buf, blocksize, num_blocks, 100);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    TEST_CMP(buf, plain, blocksize * num_blocks);
+
+    memcpy(buf, cipher, blocksize);
+    s = fdb_decrypt_block(&e, buf, blocksize, 100);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    TEST_CMP(buf, plain, blocksize);
+
+    free(plain);
+    free(cipher);
+    free(buf);
+
+    printf("AES-NI: %s\n", get_aesni_encryption_ops() ? "enabled" : "disabled");
+    TEST_RESULT("AES encryption test");
+}
+
 void mt_init_test()
 {
     TEST_INIT();
@@ -73,6 +164,10 @@ int main()
 
     basic_test(FDB_ENCRYPTION_NONE);
     basic_test(FDB_ENCRYPTION_BOGUS);
+    if (get_encryption_ops(FDB_ENCRYPTION_AES256)) {
+        basic_test(FDB_ENCRYPTION_AES256);
+    }
+    aes_encryption_test();
     mt_init_test();
 
     return 0;
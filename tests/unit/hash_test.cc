@@ -23,6 +23,7 @@
 #include "test.h"
 #include "common.h"
 #include "hash_functions.h"
+#include "crc32c.h"
 
 struct item {
     int val;
@@ -174,11 +175,67 @@ void twohash_test()
     TEST_RESULT("two-integer hash test");
 }
 
+// bitwise CRC32-C as a reference
+static uint32_t crc32c_bitwise(const uint8_t *buf, size_t len, uint32_t pre)
+{
+    uint32_t crc = ~pre;
+    size_t i;
+    int j;
+    for (i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (j = 0; j < 8; ++j) {
+            crc = (crc >> 1) ^ ((crc & 1) * 0x82f63b78);
+        }
+    }
+    return ~crc;
+}
+
+void crc32c_test()
+{
+    TEST_INIT();
+
+    size_t len, offset, split;
+    size_t max_len = 16384;
+    uint8_t *buf = (uint8_t *)malloc(max_len + 8);
+    const char *check = "123456789";
+
+    // standard check value
+    TEST_CHK(crc32c((const uint8_t *)check, 9, 0) == 0xe3069283);
+
+    for (len = 0; len < max_len + 8; ++len) {
+        buf[len] = (uint8_t)(len * 7 + (len >> 8));
+    }
+
+    // various lengths and alignments, to cover both the stripes
+    // processed in parallel and the remaining bytes
+    for (offset = 0; offset < 8; ++offset) {
+        for (len = 0; len <= max_len; len += (len < 512) ? 1 : 509) {
+            TEST_CHK(crc32c(buf + offset, len, 0) ==
+                     crc32c_bitwise(buf + offset, len, 0));
+        }
+    }
+
+    // chaining with 'pre'
+    len = 8192 + 13;
+    for (split = 0; split <= len; split += 997) {
+        uint32_t crc = crc32c(buf, split, 0);
+        crc = crc32c(buf + split, len - split, crc);
+        TEST_CHK(crc == crc32c_bitwise(buf, len, 0));
+    }
+
+    free(buf);
+
+    printf("crc32c hardware acceleration: %s\n",
+           crc32c_hw_enabled() ? "enabled" : "disabled");
+    TEST_RESULT("crc32c test");
+}
+
 int main()
 {
     basic_test();
     string_hash_test();
     //twohash_test();
+    crc32c_test();
 
     return 0;
 }
@@ -147,9 +147,33 @@ void multi_thread_test(int num_threads, int iterations, int num_bins,
     TEST_RESULT(res);
 }
 
+void aligned_bins_test()
+{
+    TEST_INIT();
+
+    MemoryPool *mp = new MemoryPool(4, 4096, 512);
+    uint8_t *bufs[4];
+    int idx[4];
+    for (int i = 0; i < 4; ++i) {
+        idx[i] = mp->fetchBlock(&bufs[i]);
+        TEST_CHK(idx[i] != -1);
+        TEST_CHK((uintptr_t)bufs[i] % 512 == 0);
+        memset(bufs[i], 'X', 4096);
+    }
+    uint8_t *extra;
+    TEST_CHK(mp->fetchBlock(&extra) == -1);
+    for (int i = 0; i < 4; ++i) {
+        mp->returnBlock(idx[i]);
+    }
+    delete mp;
+
+    TEST_RESULT("aligned bins test");
+}
+
 int main()
 {
     basic_test(10000, 8, 10485760); //1000 runs of 8 x 10MB buffers
     multi_thread_test(8, 10000, 8, 10485760); // repeat with 8 threads
+    aligned_bins_test();
     return 0;
 }
@@ -0,0 +1,357 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2010 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "filemgr.h"
+#include "staleblock.h"
+#include "superblock.h"
+#include "test.h"
+
+// Stale data manager that only records the regions returned to it
+class StaleRegionRecorder : public StaleDataManagerBase {
+public:
+    void addStaleRegion(uint64_t pos, size_t len) {
+        struct stale_data item;
+        item.pos = pos;
+        item.len = len;
+        regions.push_back(item);
+    }
+
+    std::vector<struct stale_data> regions;
+};
+
+// Superblock whose bitmap is given by the test, instead of being read from
+// a file
+class TestSuperblock : public Superblock {
+public:
+    TestSuperblock(FileMgr *_file)
+        : Superblock(_file, getDefaultConfig()) { }
+
+    // Set the current bitmap and build its index, as readBmpDoc() does.
+    void loadBmp(uint8_t *src_bmp, uint64_t nbits) {
+        uint64_t i, num_free = 0;
+        uint8_t *new_bmp = (uint8_t*)calloc(1, (nbits + 63) / 64 * 8);
+
+        memcpy(new_bmp, src_bmp, (nbits + 7) / 8);
+        free(bmp.load());
+        bmp = new_bmp;
+        bmpSize = nbits;
+        for (i = 0; i < nbits; ++i) {
+            if (new_bmp[i / 8] & (0x80 >> (i % 8))) {
+                if (!num_free) {
+                    curAllocBid = i;
+                }
+                num_free++;
+            }
+        }
+        numFreeBlocks = num_free;
+
+        freeBmpIdx(&bmpIdx);
+        constructBmpIdx(&bmpIdx, bmp, nbits, curAllocBid.load());
+    }
+
+    struct avl_tree *getIdx() {
+        return &bmpIdx;
+    }
+
+    void returnIdx() {
+        returnBmpIdx(&bmpIdx, curAllocBid.load());
+    }
+
+    static void setBits(uint8_t *target_bmp, bid_t bid, uint64_t len) {
+        setBmp(target_bmp, bid, len);
+    }
+
+    static void addIdx(struct avl_tree *target_idx, bid_t bid, bid_t count) {
+        addBmpIdx(target_idx, bid, count);
+    }
+
+    static void freeIdx(struct avl_tree *target_idx) {
+        freeBmpIdx(target_idx);
+    }
+
+    static void constructIdx(struct avl_tree *target_idx, uint8_t *src_bmp,
+                             uint64_t src_bmp_size, bid_t start_bid) {
+        constructBmpIdx(target_idx, src_bmp, src_bmp_size, start_bid);
+    }
+};
+
+// Collect the extents in the given index, in BID order.
+static std::vector<struct stale_data> _get_extents(struct avl_tree *idx)
+{
+    std::vector<struct stale_data> ret;
+    struct avl_node *a = avl_first(idx);
+    while (a) {
+        struct bmp_extent *ext = _get_entry(a, struct bmp_extent, avl);
+        struct stale_data item;
+        item.pos = ext->bid;
+        item.len = ext->count;
+        ret.push_back(item);
+        a = avl_next(a);
+    }
+    return ret;
+}
+
+// Collect the runs of set bits by scanning the bitmap bit by bit, which is
+// what the block allocation did before the extent index.
+static std::vector<struct stale_data> _scan_runs(uint8_t *bmp, uint64_t nbits,
+                                                 bid_t start_bid)
+{
+    std::vector<struct stale_data> ret;
+    uint64_t i;
+    for (i = start_bid; i < nbits; ++i) {
+        if (bmp[i / 8] & (0x80 >> (i % 8))) {
+            if (!ret.empty() &&
+                ret.back().pos + ret.back().len == i) {
+                ret.back().len++;
+            } else {
+                struct stale_data item;
+                item.pos = i;
+                item.len = 1;
+                ret.push_back(item);
+            }
+        }
+    }
+    return ret;
+}
+
+static bool _same_runs(const std::vector<struct stale_data> &a,
+                       const std::vector<struct stale_data> &b)
+{
+    size_t i;
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (i = 0; i < a.size(); ++i) {
+        if (a[i].pos != b[i].pos || a[i].len != b[i].len) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void extent_merge_test()
+{
+    TEST_INIT();
+
+    struct avl_tree idx;
+    std::vector<struct stale_data> exts;
+
+    avl_init(&idx, NULL);
+
+    TestSuperblock::addIdx(&idx, 10, 5);
+    TestSuperblock::addIdx(&idx, 20, 5);
+    TestSuperblock::addIdx(&idx, 30, 0);
+    exts = _get_extents(&idx);
+    TEST_CHK(exts.size() == 2);
+    TEST_CHK(exts[0].pos == 10 && exts[0].len == 5);
+    TEST_CHK(exts[1].pos == 20 && exts[1].len == 5);
+
+    // fill the gap .. both sides are merged
+    TestSuperblock::addIdx(&idx, 15, 5);
+    exts = _get_extents(&idx);
+    TEST_CHK(exts.size() == 1);
+    TEST_CHK(exts[0].pos == 10 && exts[0].len == 15);
+
+    // adjacent to the rear, and overlapping the front
+    TestSuperblock::addIdx(&idx, 25, 3);
+    TestSuperblock::addIdx(&idx, 7, 5);
+    exts = _get_extents(&idx);
+    TEST_CHK(exts.size() == 1);
+    TEST_CHK(exts[0].pos == 7 && exts[0].len == 21);
+
+    // already covered
+    TestSuperblock::addIdx(&idx, 12, 4);
+    exts = _get_extents(&idx);
+    TEST_CHK(exts.size() == 1);
+    TEST_CHK(exts[0].pos == 7 && exts[0].len == 21);
+
+    // a region covering several extents absorbs all of them
+    TestSuperblock::addIdx(&idx, 40, 2);
+    TestSuperblock::addIdx(&idx, 50, 2);
+    TestSuperblock::addIdx(&idx, 60, 2);
+    exts = _get_extents(&idx);
+    TEST_CHK(exts.size() == 4);
+    TestSuperblock::addIdx(&idx, 30, 31);
+    exts = _get_extents(&idx);
+    TEST_CHK(exts.size() == 2);
+    TEST_CHK(exts[0].pos == 7 && exts[0].len == 21);
+    TEST_CHK(exts[1].pos == 30 && exts[1].len == 32);
+
+    TestSuperblock::freeIdx(&idx);
+    TEST_CHK(avl_first(&idx) == NULL);
+
+    TEST_RESULT("extent merge test");
+}
+
+void alloc_block_test()
+{
+    TEST_INIT();
+
+    uint64_t nbits = 1024;
+    uint8_t *bmp = (uint8_t*)calloc(1, nbits / 8);
+    std::vector<struct stale_data> runs;
+    size_t i;
+    uint64_t j;
+    bid_t bid;
+    FileMgr file;
+    TestSuperblock *sb;
+
+    Superblock::initBmpMask();
+    // runs within a byte, across bytes, and across 64-bit words
+    TestSuperblock::setBits(bmp, 3, 3);
+    TestSuperblock::setBits(bmp, 10, 1);
+    TestSuperblock::setBits(bmp, 60, 200);
+    TestSuperblock::setBits(bmp, 512, 64);
+    TestSuperblock::setBits(bmp, 1020, 4);
+    runs = _scan_runs(bmp, nbits, 0);
+
+    sb = new TestSuperblock(&file);
+    sb->loadBmp(bmp, nbits);
+    TEST_CHK(_same_runs(_get_extents(sb->getIdx()), runs));
+
+    // blocks are allocated in ascending order, exactly as the set bits
+    for (i = 0; i < runs.size(); ++i) {
+        for (j = 0; j < runs[i].len; ++j) {
+            bid = sb->allocBlock();
+            TEST_CHK(bid == runs[i].pos + j);
+        }
+    }
+    TEST_CHK(sb->allocBlock() == BLK_NOT_FOUND);
+
+    delete sb;
+    free(bmp);
+
+    TEST_RESULT("allocate block test");
+}
+
+void return_extent_test()
+{
+    TEST_INIT();
+
+    uint64_t nbits = 512;
+    uint8_t *bmp = (uint8_t*)calloc(1, nbits / 8);
+    bid_t bid;
+    int i;
+    FileMgr file;
+    StaleRegionRecorder recorder;
+    TestSuperblock *sb;
+
+    Superblock::initBmpMask();
+    file.setStaleData(&recorder);
+    TestSuperblock::setBits(bmp, 5, 2);
+    TestSuperblock::setBits(bmp, 100, 50);
+    TestSuperblock::setBits(bmp, 300, 10);
+
+    sb = new TestSuperblock(&file);
+    sb->loadBmp(bmp, nbits);
+
+    // use up the first extent and a part of the second one
+    for (i = 0; i < 12; ++i) {
+        bid = sb->allocBlock();
+    }
+    TEST_CHK(bid == 109);
+    TEST_CHK(sb->getCurAllocBid() == 110);
+
+    // only the rest of the second extent and the third one are returned
+    sb->returnIdx();
+    TEST_CHK(recorder.regions.size() == 2);
+    TEST_CHK(recorder.regions[0].pos == 110 && recorder.regions[0].len == 40);
+    TEST_CHK(recorder.regions[1].pos == 300 && recorder.regions[1].len == 10);
+    TEST_CHK(avl_first(sb->getIdx()) == NULL);
+
+    // nothing is returned if no block is left
+    recorder.regions.clear();
+    sb->loadBmp(bmp, nbits);
+    for (i = 0; i < 62; ++i) {
+        sb->allocBlock();
+    }
+    TEST_CHK(sb->allocBlock() == BLK_NOT_FOUND);
+    sb->returnIdx();
+    TEST_CHK(recorder.regions.empty());
+
+    delete sb;
+    file.setStaleData(NULL);
+    free(bmp);
+
+    TEST_RESULT("return extent test");
+}
+
+void construct_index_test()
+{
+    TEST_INIT();
+
+    uint64_t nbits = 64 * 100 + 37;
+    uint8_t *bmp = (uint8_t*)calloc(1, (nbits + 63) / 64 * 8);
+    bid_t start_bids[] = {0, 1, 63, 64, 1000, 3333, 64 * 100, nbits};
+    struct avl_tree idx;
+    uint64_t i;
+    size_t j;
+
+    Superblock::initBmpMask();
+    srand(0x5eed);
+    // mix of all-zero words, all-one words, and random bits, so that both
+    // the word-at-once path and the bit-by-bit path are taken
+    for (i = 0; i < nbits; i += 64) {
+        switch (rand() % 4) {
+        case 0:
+            break;
+        case 1:
+            TestSuperblock::setBits(bmp, i,
+                                    (i + 64 <= nbits) ? 64 : nbits - i);
+            break;
+        default:
+            for (j = 0; j < 64 && i + j < nbits; ++j) {
+                if (rand() % 2) {
+                    TestSuperblock::setBits(bmp, i + j, 1);
+                }
+            }
+            break;
+        }
+    }
+
+    avl_init(&idx, NULL);
+    for (j = 0; j < sizeof(start_bids) / sizeof(bid_t); ++j) {
+        TestSuperblock::constructIdx(&idx, bmp, nbits, start_bids[j]);
+        TEST_CHK(_same_runs(_get_extents(&idx),
+                            _scan_runs(bmp, nbits, start_bids[j])));
+        TestSuperblock::freeIdx(&idx);
+    }
+
+    // BLK_NOT_FOUND scans the whole bitmap
+    TestSuperblock::constructIdx(&idx, bmp, nbits, BLK_NOT_FOUND);
+    TEST_CHK(_same_runs(_get_extents(&idx), _scan_runs(bmp, nbits, 0)));
+    TestSuperblock::freeIdx(&idx);
+
+    free(bmp);
+
+    TEST_RESULT("construct index test");
+}
+
+int main()
+{
+    extent_merge_test();
+    alloc_block_test();
+    return_extent_test();
+    construct_index_test();
+
+    return 0;
+}
@@ -150,8 +150,17 @@ void print_doc(fdb_kvs_handle *db,
     printf("    Length: %d (key), %d (metadata), %d (body)\n",
            keylen, doc.length.metalen, doc.length.bodylen);
     if (doc.length.flag & DOCIO_COMPRESSED) {
-        printf("    Compressed body size on disk: %d\n",
-               doc.length.bodylen_ondisk);
+        static const char *codec_names[] = {"snappy", "lz4", "zstd",
+                                            "zstd with dictionary"};
+        printf("    Compressed body size on disk: %d (%s)\n",
+               doc.length.bodylen_ondisk,
+               codec_names[(doc.length.flag & DOCIO_CODEC_MASK) >>
+                           DOCIO_CODEC_SHIFT]);
+    }
+    struct docio_length length;
+    if (db->dhandle->readDocLength_Docio(&length, offset) ==
+            FDB_RESULT_SUCCESS && DOCIO_IS_BLOB(length.flag)) {
+        printf("    Body stored in a blob file\n");
     }
     if (doc.length.flag & DOCIO_DELETED) {
         printf("    Status: deleted (timestamp: %u)\n", doc.timestamp);
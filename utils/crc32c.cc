@@ -0,0 +1,244 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * CRC32-C (Castagnoli) with runtime CPU dispatch.
+ *
+ * All functions below except crc32c() work on the raw CRC register,
+ * i.e., without the pre/post inversion.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc32c.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32C_X86_64
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+// Bit-reflected CRC32-C polynomial
+#define CRC32C_POLY (0x82f63b78)
+
+typedef uint32_t (*crc32c_func_t)(const uint8_t *buf, size_t len,
+                                  uint32_t crc);
+
+// Look-up table for the slicing-by-8 algorithm
+static uint32_t crc32c_table[8][256];
+
+static void crc32c_init_table()
+{
+    uint32_t i, j, crc;
+    for (i = 0; i < 256; ++i) {
+        crc = i;
+        for (j = 0; j < 8; ++j) {
+            crc = (crc >> 1) ^ ((crc & 1) * CRC32C_POLY);
+        }
+        crc32c_table[0][i] = crc;
+    }
+    for (i = 0; i < 256; ++i) {
+        for (j = 1; j < 8; ++j) {
+            crc = crc32c_table[j - 1][i];
+            crc32c_table[j][i] = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+        }
+    }
+}
+
+static uint32_t crc32c_sw(const uint8_t *buf, size_t len, uint32_t crc)
+{
+#ifndef _BIG_ENDIAN
+    while (len && ((uintptr_t)buf & 7)) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *buf++) & 0xff];
+        --len;
+    }
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, buf, sizeof(word));
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xff] ^
+              crc32c_table[6][(word >> 8) & 0xff] ^
+              crc32c_table[5][(word >> 16) & 0xff] ^
+              crc32c_table[4][(word >> 24) & 0xff] ^
+              crc32c_table[3][(word >> 32) & 0xff] ^
+              crc32c_table[2][(word >> 40) & 0xff] ^
+              crc32c_table[1][(word >> 48) & 0xff] ^
+              crc32c_table[0][word >> 56];
+        buf += 8;
+        len -= 8;
+    }
+#endif
+    while (len--) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *buf++) & 0xff];
+    }
+    return crc;
+}
+
+#ifdef CRC32C_X86_64
+
+// Multiply a(x) and b(x) modulo the polynomial (bit-reflected).
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t)1 << 31, p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+// x^(8n) modulo the polynomial, i.e., the factor that shifts a CRC
+// over n zero bytes.
+static uint32_t crc32c_x8nmodp(size_t n)
+{
+    uint32_t xp = (uint32_t)1 << 31; // x^0
+    uint32_t sq = (uint32_t)1 << 23; // x^8
+    while (n) {
+        if (n & 1) {
+            xp = crc32c_multmodp(sq, xp);
+        }
+        sq = crc32c_multmodp(sq, sq);
+        n >>= 1;
+    }
+    return xp;
+}
+
+/**
+ * Buffers are split into three stripes that are processed in parallel, to
+ * hide the latency of the crc32 instruction. Large stripes are used first,
+ * then small stripes for the remaining data.
+ */
+#define CRC32C_NUM_STRIPE_SIZES (2)
+static const size_t crc32c_stripe_size[CRC32C_NUM_STRIPE_SIZES] = {1024, 128};
+// Shift factors over one and two stripes, for each stripe size
+static uint32_t crc32c_stripe_shift[CRC32C_NUM_STRIPE_SIZES][2];
+
+static void crc32c_init_shift()
+{
+    for (size_t i = 0; i < CRC32C_NUM_STRIPE_SIZES; ++i) {
+        crc32c_stripe_shift[i][0] = crc32c_x8nmodp(crc32c_stripe_size[i]);
+        crc32c_stripe_shift[i][1] = crc32c_x8nmodp(2 * crc32c_stripe_size[i]);
+    }
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(const uint8_t *buf, size_t len, uint32_t crc)
+{
+    while (len && ((uintptr_t)buf & 7)) {
+        crc = _mm_crc32_u8(crc, *buf++);
+        --len;
+    }
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, buf, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        buf += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *buf++);
+    }
+    return crc;
+}
+
+// Multiply 'crc' by the shift factor 'k' using carry-less multiplication.
+// The 64-bit product is reduced by the crc32 instruction.
+__attribute__((target("sse4.2,pclmul")))
+static inline uint32_t crc32c_shift_hw(uint32_t crc, uint32_t k)
+{
+    __m128i prod = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc),
+                                        _mm_cvtsi32_si128((int)k), 0x00);
+    uint64_t v = (uint64_t)_mm_cvtsi128_si64(prod) << 1;
+    return _mm_crc32_u32(0, (uint32_t)v) ^ (uint32_t)(v >> 32);
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32c_hw_clmul(const uint8_t *buf, size_t len, uint32_t crc)
+{
+    while (len && ((uintptr_t)buf & 7)) {
+        crc = _mm_crc32_u8(crc, *buf++);
+        --len;
+    }
+
+    for (size_t s = 0; s < CRC32C_NUM_STRIPE_SIZES; ++s) {
+        size_t stripe = crc32c_stripe_size[s];
+        while (len >= 3 * stripe) {
+            uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+            for (size_t i = 0; i < stripe; i += 8) {
+                uint64_t w0, w1, w2;
+                memcpy(&w0, buf + i, sizeof(w0));
+                memcpy(&w1, buf + stripe + i, sizeof(w1));
+                memcpy(&w2, buf + 2 * stripe + i, sizeof(w2));
+                crc0 = _mm_crc32_u64(crc0, w0);
+                crc1 = _mm_crc32_u64(crc1, w1);
+                crc2 = _mm_crc32_u64(crc2, w2);
+            }
+            // CRC is linear, so that the CRC of the whole is the XOR of
+            // each stripe's CRC shifted over the following stripes.
+            crc = crc32c_shift_hw((uint32_t)crc0, crc32c_stripe_shift[s][1]) ^
+                  crc32c_shift_hw((uint32_t)crc1, crc32c_stripe_shift[s][0]) ^
+                  (uint32_t)crc2;
+            buf += 3 * stripe;
+            len -= 3 * stripe;
+        }
+    }
+    return crc32c_hw(buf, len, crc);
+}
+
+#endif // CRC32C_X86_64
+
+static crc32c_func_t crc32c_select()
+{
+    crc32c_init_table();
+#ifdef CRC32C_X86_64
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        if (__builtin_cpu_supports("pclmul")) {
+            crc32c_init_shift();
+            return crc32c_hw_clmul;
+        }
+        return crc32c_hw;
+    }
+#endif
+    return crc32c_sw;
+}
+
+static crc32c_func_t crc32c_get_func()
+{
+    static const crc32c_func_t func = crc32c_select();
+    return func;
+}
+
+uint32_t crc32c(const uint8_t* buf, size_t buf_len, uint32_t pre)
+{
+    return ~crc32c_get_func()(buf, buf_len, ~pre);
+}
+
+bool crc32c_hw_enabled(void)
+{
+    return crc32c_get_func() != crc32c_sw;
+}
@@ -0,0 +1,48 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _FDB_CRC32C_H
+#define _FDB_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * CRC32-C (Castagnoli) of buf for buf_len bytes, continuing from the CRC
+ * 'pre' of the preceding data (0 if none). This is compatible with the
+ * platform library's crc32c().
+ *
+ * SSE4.2 crc32 instructions are used if the CPU supports them (with PCLMUL
+ * used to combine independent streams over large buffers), which is
+ * detected at runtime. Otherwise a table-driven implementation is used.
+ */
+uint32_t crc32c(const uint8_t* buf, size_t buf_len, uint32_t pre);
+
+/**
+ * Return true if crc32c() uses the SSE4.2 crc32 instructions.
+ */
+bool crc32c_hw_enabled(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif